@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include <string.h>
+
+#include "aggregate.h"
+#include "../qe/runfile.h"
+#include "../rbf/page.h"
+#include "../rbf/schema.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+static const char *opNames[] = { "MIN", "MAX", "COUNT", "SUM", "AVG" };
+
+// bytes a group takes in the hash table, besides its key
+const unsigned GROUP_ENTRY_BYTES = 64;
+
+struct Accumulator {
+   unsigned count;        // non null values
+   double sum;
+   double min;
+   double max;
+
+   Accumulator() : count (0), sum (0), min (0), max (0) {}
+
+   void add(AttrType type, const char *value) {
+      if (type == TypeVarChar) {
+         ++count;
+         return;
+      }
+      double v;
+      if (type == TypeInt) {
+         int32_t x;
+         memcpy (&x, value, sizeof(x));
+         v = x;
+      } else {
+         float x;
+         memcpy (&x, value, sizeof(x));
+         v = x;
+      }
+      if (count == 0 || v < min) min = v;
+      if (count == 0 || v > max) max = v;
+      sum += v;
+      ++count;
+   }
+
+   // RETURNS: false if the result is null
+   bool result(AggregateOp op, float &value) const {
+      if (op == COUNT) {
+         value = count;
+         return true;
+      }
+      if (count == 0) return false;
+      switch (op) {
+         case MIN: value = min; break;
+         case MAX: value = max; break;
+         case SUM: value = sum; break;
+         default:  value = sum / count; break;
+      }
+      return true;
+   }
+};
+
+// Checks the attributes of an aggregate
+// POST: attr (and group, if groupAttribute is not NULL) are their
+//       positions in descriptor
+static RC checkAggregate(const vector<Attribute> &descriptor,
+                         const string *groupAttribute,
+                         const string &attribute, AggregateOp op,
+                         int &group, int &attr) {
+   const Schema &schema = schemaOf (descriptor);
+   attr = schema.find (attribute);
+   group = groupAttribute == NULL ? 0 : schema.find (*groupAttribute);
+   if (attr < 0 || group < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", attribute.c_str());
+      return rc::attribute_not_found;
+   }
+   if (op != COUNT && descriptor[attr].type == TypeVarChar) {
+      RC_MSG (rc::type_mismatch, "[%s(%s)]\n", opNames[op],
+              attribute.c_str());
+      return rc::type_mismatch;
+   }
+   return rc::success;
+}
+
+// what the passes of a group by share
+struct GroupContext {
+   const vector<Attribute> *descriptor;
+   unsigned group;
+   unsigned attr;
+   AggregateOp op;
+   size_t budget;         // bytes of the hash table
+   unsigned fanOut;       // partitions of a spill
+   const TupleSink *output;
+   AggregateStats *stats;
+};
+
+// Key of a group: [0] for the null group, else [1][value]
+static void groupKey(const GroupContext &ctx, const char *value,
+                     string &key) {
+   if (value == NULL) {
+      key.assign (1, '\0');
+      return;
+   }
+   key.assign (1, '\1');
+   key.append (value, valueLength ((*ctx.descriptor)[ctx.group].type,
+                                   value));
+}
+
+// Gives [nulls][group][aggregate] to the output
+static RC emitGroup(const GroupContext &ctx, const string &key,
+                    const Accumulator &acc) {
+   string tuple (1, '\0');
+   if (key[0] == '\0') setNull (&tuple[0], 0);
+   tuple.append (key, 1, string::npos);
+   float value;
+   if (acc.result (ctx.op, value)) {
+      tuple.append ((const char*) &value, sizeof(value));
+   } else {
+      setNull (&tuple[0], 1);
+   }
+   ++ctx.stats->groups;
+   return (*ctx.output) (tuple.data());
+}
+
+// Aggregates the tuples it is given into a hash table, spilling the
+// tuples of the groups that do not fit to partitions of the next level
+class Grouper {
+public:
+   Grouper(GroupContext &ctx, unsigned level)
+      : _ctx (ctx), _level (level), _bytes (0), _spilling (false),
+        _writers (ctx.fanOut) {
+      ctx.stats->depth = max (ctx.stats->depth, level);
+   }
+
+   RC add(const char *tuple, unsigned len) {
+      const vector<Attribute> &descriptor = *_ctx.descriptor;
+      const char *group = tupleField (descriptor, tuple, _ctx.group);
+      groupKey (_ctx, group, _key);
+      auto it = _groups.find (_key);
+      if (it == _groups.end()) {
+         if (_bytes + _key.size() + GROUP_ENTRY_BYTES > _ctx.budget
+             && !_groups.empty()) {
+            RC rcode = rc::success;
+            for (unsigned i = 0; !_spilling && i < _writers.size(); ++i) {
+               rcode = _writers[i].open ("group_part");
+               if (rcode != rc::success) break;
+            }
+            _spilling = true;
+            if (rcode != rc::success) return rcode;
+            uint32_t hash = group == NULL ? 0 : valueHash (
+                               descriptor[_ctx.group].type, group);
+            return _writers[levelHash (hash, _level) % _writers.size()]
+                      .write (tuple, len);
+         }
+         it = _groups.emplace (_key, Accumulator()).first;
+         _bytes += _key.size() + GROUP_ENTRY_BYTES;
+      }
+      const char *value = tupleField (descriptor, tuple, _ctx.attr);
+      if (value != NULL) it->second.add (descriptor[_ctx.attr].type, value);
+      return rc::success;
+   }
+
+   // Gives the groups of the table to the output
+   // POST: spilled holds the partitions of the tuples of the others
+   RC finish(vector<Run> &spilled) {
+      RC rcode = rc::success;
+      for (auto it = _groups.begin();
+           it != _groups.end() && rcode == rc::success; ++it) {
+         rcode = emitGroup (_ctx, it->first, it->second);
+      }
+      _groups.clear();
+      if (!_spilling) return rcode;
+      spilled.resize (_writers.size());
+      for (unsigned i = 0; i < _writers.size(); ++i) {
+         RC closed = _writers[i].close (spilled[i]);
+         if (rcode == rc::success) rcode = closed;
+         _ctx.stats->pageWrites += spilled[i].pages;
+      }
+      _ctx.stats->partitions += _writers.size();
+      _spilling = false;
+      return rcode;
+   }
+
+private:
+   Grouper(const Grouper&) = delete;
+   Grouper& operator=(const Grouper&) = delete;
+
+   GroupContext &_ctx;
+   unsigned _level;
+   unordered_map<string, Accumulator> _groups;
+   size_t _bytes;             // taken by _groups
+   bool _spilling;
+   vector<RunWriter> _writers;
+   string _key;
+};
+
+// Finishes a group by, aggregating the partitions top spilled. They
+// are kept in a list, each with its level, and every one is destroyed
+// as soon as it is aggregated so that the open files stay within the
+// budget however deep the spills go.
+static RC finishGroups(GroupContext &ctx, Grouper &top) {
+   vector<Run> spilled;
+   RC rcode = top.finish (spilled);
+   vector<pair<Run, unsigned> > pending;
+   for (unsigned i = 0; i < spilled.size(); ++i) {
+      pending.push_back (make_pair (spilled[i], 1));
+   }
+   while (!pending.empty()) {
+      Run run = pending.back().first;
+      unsigned level = pending.back().second;
+      pending.pop_back();
+      spilled.clear();
+      if (rcode == rc::success && run.count > 0) {
+         Grouper grouper (ctx, level);
+         RunReader reader;
+         string tuple;
+         rcode = reader.open (run);
+         while (rcode == rc::success
+                && (rcode = reader.next (tuple)) == rc::success) {
+            rcode = grouper.add (tuple.data(), tuple.size());
+         }
+         ctx.stats->pageReads += reader.pagesRead();
+         reader.close();
+         if (rcode == RBFM_EOF) rcode = rc::success;
+         RC finished = grouper.finish (spilled);
+         if (rcode == rc::success) rcode = finished;
+      }
+      destroyRun (run);
+      for (unsigned i = 0; i < spilled.size(); ++i) {
+         pending.push_back (make_pair (spilled[i], level + 1));
+      }
+   }
+   return rcode;
+}
+
+// Checks a group by and sets up its context
+static RC openGroups(const vector<Attribute> &descriptor,
+                     const string &groupAttribute, const string &attribute,
+                     AggregateOp op, unsigned memoryPages,
+                     const TupleSink &output, AggregateStats &stats,
+                     GroupContext &ctx) {
+   stats.groups = stats.partitions = stats.depth = 0;
+   stats.pageReads = stats.pageWrites = 0;
+   int group, attr;
+   RC rcode = checkAggregate (descriptor, &groupAttribute, attribute, op,
+                              group, attr);
+   if (rcode != rc::success) return rcode;
+   if (memoryPages < 3) {
+      RC_MSG (rc::invalid_budget, "[%u pages]\n", memoryPages);
+      return rc::invalid_budget;
+   }
+
+   // one page of the budget reads the input, the others are split
+   // between the table and the buffers of the spill partitions
+   ctx.descriptor = &descriptor;
+   ctx.group = group;
+   ctx.attr = attr;
+   ctx.op = op;
+   ctx.fanOut = (memoryPages - 1) / 2;
+   ctx.budget = (memoryPages - 1 - ctx.fanOut) * PAGE_SIZE;
+   ctx.output = &output;
+   ctx.stats = &stats;
+   return rc::success;
+}
+
+// Output tuple of a scalar aggregate, [null byte][Real]
+static void aggregateResult(const Accumulator &acc, AggregateOp op,
+                            char *out) {
+   float value;
+   out[0] = 0;
+   if (acc.result (op, value)) {
+      memcpy (out + 1, &value, sizeof(value));
+   } else {
+      setNull (out, 0);
+   }
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+Aggregate::Aggregate(Operator &input, const string &attribute,
+                     AggregateOp op)
+   : Operator ("Aggregate"), _attribute (attribute), _op (op)
+{
+   int attr = schemaOf (input.attributes()).find (attribute);
+   if (attr >= 0) {
+      _attributes.push_back (aggregateAttribute (input.attributes()[attr],
+                                                 op));
+   }
+   _inputs.push_back (&input);
+}
+
+RC Aggregate::produce(const BatchSink &output) {
+   const vector<Attribute> &descriptor = _inputs[0]->attributes();
+   int group, attr;
+   RC rcode = checkAggregate (descriptor, NULL, _attribute, _op, group,
+                              attr);
+   if (rcode != rc::success) return rcode;
+   AttrType type = descriptor[attr].type;
+   Accumulator acc;
+   rcode = _inputs[0]->run ([&](const TupleBatch &batch) {
+      for (unsigned i = 0; i < batch.size(); ++i) {
+         const char *value = tupleField (descriptor, batch.tuple (i), attr);
+         if (value != NULL) acc.add (type, value);
+      }
+      return rc::success;
+   });
+   if (rcode != rc::success) return rcode;
+   char result[1 + sizeof(float)];
+   aggregateResult (acc, _op, result);
+   BatchWriter writer (output);
+   rcode = writer.add (result, tupleSize (_attributes, result));
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+GroupBy::GroupBy(Operator &input, const string &groupAttribute,
+                 const string &attribute, AggregateOp op,
+                 unsigned memoryPages)
+   : Operator ("GroupBy"), _groupAttribute (groupAttribute),
+     _attribute (attribute), _op (op), _memoryPages (memoryPages),
+     _aggregateStats ()
+{
+   _attributes = groupDescriptor (input.attributes(), groupAttribute,
+                                  attribute, op);
+   _inputs.push_back (&input);
+}
+
+RC GroupBy::produce(const BatchSink &output) {
+   BatchWriter writer (output);
+   TupleSink sink = [&](const void *tuple) {
+      return writer.add (tuple, tupleSize (_attributes, tuple));
+   };
+   GroupContext ctx;
+   RC rcode = openGroups (_inputs[0]->attributes(), _groupAttribute,
+                          _attribute, _op, _memoryPages, sink,
+                          _aggregateStats, ctx);
+   if (rcode != rc::success) return rcode;
+   Grouper grouper (ctx, 0);
+   rcode = _inputs[0]->run ([&grouper](const TupleBatch &batch) {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < batch.size() && rcode == rc::success; ++i) {
+         rcode = grouper.add (batch.tuple (i), batch.length (i));
+      }
+      return rcode;
+   });
+   RC finished = finishGroups (ctx, grouper);
+   if (rcode == rc::success) rcode = finished;
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+Attribute aggregateAttribute(const Attribute &attribute, AggregateOp op) {
+   Attribute result;
+   result.name = string (opNames[op]) + "(" + attribute.name + ")";
+   result.type = TypeReal;
+   result.length = sizeof(float);
+   return result;
+}
+
+RC aggregate(RBFM_ScanIterator &input, const vector<Attribute> &descriptor,
+             const string &attribute, AggregateOp op, void *result) {
+   int group, attr;
+   RC rcode = checkAggregate (descriptor, NULL, attribute, op, group, attr);
+   if (rcode != rc::success) return rcode;
+   AttrType type = descriptor[attr].type;
+   vector<char> buffer (tupleMax (descriptor));
+   Accumulator acc;
+   RID rid;
+   while ((rcode = input.getNextRecord (rid, buffer.data())) == rc::success) {
+      const char *value = tupleField (descriptor, buffer.data(), attr);
+      if (value != NULL) acc.add (type, value);
+   }
+   if (rcode != RBFM_EOF) return rcode;
+   aggregateResult (acc, op, (char*) result);
+   return rc::success;
+}
+
+vector<Attribute> groupDescriptor(const vector<Attribute> &descriptor,
+                                  const string &groupAttribute,
+                                  const string &attribute, AggregateOp op) {
+   const Schema &schema = schemaOf (descriptor);
+   int group = schema.find (groupAttribute);
+   int attr = schema.find (attribute);
+   vector<Attribute> result;
+   if (group < 0 || attr < 0) return result;
+   result.push_back (descriptor[group]);
+   result.push_back (aggregateAttribute (descriptor[attr], op));
+   return result;
+}
+
+RC groupAggregate(RBFM_ScanIterator &input,
+                  const vector<Attribute> &descriptor,
+                  const string &groupAttribute, const string &attribute,
+                  AggregateOp op, unsigned memoryPages,
+                  const TupleSink &output, AggregateStats &stats) {
+   GroupContext ctx;
+   RC rcode = openGroups (descriptor, groupAttribute, attribute, op,
+                          memoryPages, output, stats, ctx);
+   if (rcode != rc::success) return rcode;
+   Grouper grouper (ctx, 0);
+   vector<char> buffer (tupleMax (descriptor));
+   RID rid;
+   while ((rcode = input.getNextRecord (rid, buffer.data())) == rc::success) {
+      rcode = grouper.add (buffer.data(),
+                           tupleSize (descriptor, buffer.data()));
+      if (rcode != rc::success) break;
+   }
+   if (rcode == RBFM_EOF) rcode = rc::success;
+   RC finished = finishGroups (ctx, grouper);
+   return rcode != rc::success ? rcode : finished;
+}
@@ -0,0 +1,96 @@
+#ifndef _aggregate_h_
+#define _aggregate_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../qe/tuple.h"
+#include "../qe/operator.h"
+
+// Aggregates over a scan: COUNT of any attribute, MIN, MAX, SUM and AVG
+// of an Int or Real one. The scan does the selection and should project
+// only the attributes the aggregate reads (the descriptor given is that
+// of the projected tuples), so records are never copied out whole, nor
+// read at all when a covering index serves the scan. Values are
+// accumulated as they come out of the scan, in double precision.
+//
+// Every result is a Real, named after the operator and the attribute,
+// e.g. "SUM(Salary)" (see aggregateAttribute). Null values are ignored:
+// COUNT counts the others, and the other operators give null when there
+// are none.
+//
+// A group by keeps one accumulator per group in a hash table. Nulls form
+// one group. Once the table fills the memory budget, the tuples of
+// groups it does not hold yet are spilled by hash to run files
+// (runfile.h) while the groups it holds go on accumulating; every
+// spilled partition is then aggregated the same way with another hash.
+// Every pass completes at least the groups of its table, so it always
+// terminates.
+
+typedef enum { MIN = 0, MAX, COUNT, SUM, AVG } AggregateOp;
+
+struct AggregateStats {
+    unsigned groups;       // output tuples
+    unsigned partitions;   // run files written
+    unsigned depth;        // deepest spill level, 0 in memory
+    unsigned pageReads;    // of the runs
+    unsigned pageWrites;   // of the runs
+};
+
+// RETURNS: attribute of the result of op over attribute
+Attribute aggregateAttribute(const Attribute &attribute, AggregateOp op);
+
+// POST: result is a tuple of aggregateAttribute, [null byte][Real]
+RC aggregate(RBFM_ScanIterator &input, const vector<Attribute> &descriptor,
+             const string &attribute, AggregateOp op, void *result);
+
+// Descriptor of the tuples of a group by: the group attribute, then the
+// aggregate
+vector<Attribute> groupDescriptor(const vector<Attribute> &descriptor,
+                                  const string &groupAttribute,
+                                  const string &attribute, AggregateOp op);
+
+// Gives one tuple of groupDescriptor per group to the output, in no
+// particular order
+// PRE: memoryPages >= 3
+RC groupAggregate(RBFM_ScanIterator &input,
+                  const vector<Attribute> &descriptor,
+                  const string &groupAttribute, const string &attribute,
+                  AggregateOp op, unsigned memoryPages,
+                  const TupleSink &output, AggregateStats &stats);
+
+// Operator giving the one tuple of op over attribute of its input, see
+// aggregate
+class Aggregate : public Operator {
+public:
+  Aggregate(Operator &input, const string &attribute, AggregateOp op);
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  string _attribute;
+  AggregateOp _op;
+};
+
+// Operator giving a tuple per group of its input, see groupAggregate
+class GroupBy : public Operator {
+public:
+  GroupBy(Operator &input, const string &groupAttribute,
+          const string &attribute, AggregateOp op, unsigned memoryPages);
+
+  const AggregateStats& aggregateStats() const { return _aggregateStats; }
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  string _groupAttribute;
+  string _attribute;
+  AggregateOp _op;
+  unsigned _memoryPages;
+  AggregateStats _aggregateStats;
+};
+
+#endif
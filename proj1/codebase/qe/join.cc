@@ -0,0 +1,543 @@
+#include <algorithm>
+
+#include <string.h>
+
+#include "join.h"
+#include "../qe/runfile.h"
+#include "../rbf/page.h"
+#include "../rbf/schema.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+const uint32_t NONE = 0xFFFFFFFF;
+
+struct JoinSide {
+   const vector<Attribute> *descriptor;
+   unsigned attr;
+};
+
+// what the steps of a join share
+struct JoinContext {
+   JoinSide left;         // build side
+   JoinSide right;        // probe side
+   AttrType type;
+   size_t budget;         // bytes of the in-memory table
+   unsigned fanOut;       // partitions of a grace step
+   const TupleSink *output;
+   JoinStats *stats;
+   string joined;         // output buffer
+};
+
+// key of a tuple and its hash
+// RETURNS: false if it is null
+static bool tupleKey(const JoinSide &side, AttrType type,
+                     const char *tuple, const char *&key, uint32_t &hash) {
+   key = tupleField (*side.descriptor, tuple, side.attr);
+   if (key == NULL) return false;
+   hash = valueHash (type, key);
+   return true;
+}
+
+// Gives [nulls of both][left values][right values] to the output
+static RC emitJoined(JoinContext &ctx, const char *left, const char *right) {
+   unsigned nl = ctx.left.descriptor->size();
+   unsigned nr = ctx.right.descriptor->size();
+   unsigned leftNulls = nullBytes (nl);
+   unsigned rightNulls = nullBytes (nr);
+   unsigned leftValues = tupleSize (*ctx.left.descriptor, left) - leftNulls;
+   unsigned rightValues = tupleSize (*ctx.right.descriptor, right)
+                          - rightNulls;
+   unsigned nulls = nullBytes (nl + nr);
+   ctx.joined.assign (nulls, '\0');
+   char *out = &ctx.joined[0];
+   for (unsigned i = 0; i < nl; ++i) {
+      if (isNull (left, i)) setNull (out, i);
+   }
+   for (unsigned i = 0; i < nr; ++i) {
+      if (isNull (right, i)) setNull (out, nl + i);
+   }
+   ctx.joined.append (left + leftNulls, leftValues);
+   ctx.joined.append (right + rightNulls, rightValues);
+   return (*ctx.output) (ctx.joined.data());
+}
+
+// In-memory hash table of build tuples (see join.h)
+class BuildTable {
+public:
+   BuildTable() : _bits (0) {}
+
+   void add(const char *tuple, unsigned len, const char *key,
+            uint32_t hash) {
+      Entry entry;
+      entry.hash = hash;
+      entry.tuple = _arena.size();
+      entry.len = len;
+      entry.key = entry.tuple + (key - tuple);
+      _arena.append (tuple, len);
+      _entries.push_back (entry);
+   }
+
+   // RETURNS: bytes of memory taken once built
+   size_t bytes() const {
+      return _arena.size()
+             + _entries.size() * (sizeof(Entry) + 2 * sizeof(uint32_t));
+   }
+
+   unsigned size() const { return _entries.size(); }
+   unsigned bits() const { return _bits; }
+
+   // the i-th tuple added, before build
+   const char* tuple(unsigned i, unsigned &len) const {
+      len = _entries[i].len;
+      return _arena.data() + _entries[i].tuple;
+   }
+
+   void clear() {
+      _arena.clear();
+      _entries.clear();
+   }
+
+   // Radix partitions the entries on the low bits of their hash and
+   // chains the buckets of every partition on the next bits
+   void build() {
+      _bits = 0;
+      while ((_arena.size() >> _bits) > JOIN_CACHE_BYTES && _bits < 16) {
+         ++_bits;
+      }
+      unsigned partitions = 1u << _bits;
+      uint32_t mask = partitions - 1;
+      _start.assign (partitions + 1, 0);
+      for (unsigned i = 0; i < _entries.size(); ++i) {
+         ++_start[(_entries[i].hash & mask) + 1];
+      }
+      for (unsigned p = 0; p < partitions; ++p) _start[p + 1] += _start[p];
+      vector<Entry> sorted (_entries.size());
+      vector<uint32_t> pos (_start.begin(), _start.end() - 1);
+      for (unsigned i = 0; i < _entries.size(); ++i) {
+         sorted[pos[_entries[i].hash & mask]++] = _entries[i];
+      }
+      _entries.swap (sorted);
+
+      _bucketStart.assign (partitions + 1, 0);
+      for (unsigned p = 0; p < partitions; ++p) {
+         uint32_t buckets = 1;
+         while (buckets < _start[p + 1] - _start[p]) buckets <<= 1;
+         _bucketStart[p + 1] = _bucketStart[p] + buckets;
+      }
+      _buckets.assign (_bucketStart[partitions], NONE);
+      _next.assign (_entries.size(), NONE);
+      for (unsigned i = 0; i < _entries.size(); ++i) {
+         uint32_t b = bucketOf (_entries[i].hash);
+         _next[i] = _buckets[b];
+         _buckets[b] = i;
+      }
+   }
+
+   // Calls match with every build tuple whose key equals key
+   RC probe(AttrType type, const char *key, uint32_t hash,
+            const function<RC (const char*)> &match) const {
+      for (uint32_t i = _buckets[bucketOf (hash)]; i != NONE; i = _next[i]) {
+         const Entry &entry = _entries[i];
+         if (entry.hash != hash
+             || compareValues (type, _arena.data() + entry.key, key) != 0) {
+            continue;
+         }
+         RC rcode = match (_arena.data() + entry.tuple);
+         if (rcode != rc::success) return rcode;
+      }
+      return rc::success;
+   }
+
+private:
+   struct Entry {
+      uint32_t hash;
+      uint32_t tuple;        // offsets in _arena
+      uint32_t len;
+      uint32_t key;
+   };
+
+   uint32_t bucketOf(uint32_t hash) const {
+      uint32_t p = hash & ((1u << _bits) - 1);
+      uint32_t buckets = _bucketStart[p + 1] - _bucketStart[p];
+      return _bucketStart[p] + ((hash >> _bits) & (buckets - 1));
+   }
+
+   string _arena;             // the tuples one after the other
+   vector<Entry> _entries;    // grouped by partition once built
+   unsigned _bits;            // 2^_bits partitions
+   vector<uint32_t> _start;   // first entry of each partition
+   vector<uint32_t> _bucketStart;  // first bucket of each partition
+   vector<uint32_t> _buckets; // first entry of each bucket chain
+   vector<uint32_t> _next;    // next entry of its chain
+};
+
+// Probe tuples, taken a batch at a time and grouped by table partition
+// so that the probes of a batch walk one partition after the other
+class ProbeBatch {
+public:
+   bool full() const { return _probes.size() >= JOIN_PROBE_BATCH; }
+
+   void add(const char *tuple, unsigned len, const char *key,
+            uint32_t hash) {
+      Probe probe;
+      probe.hash = hash;
+      probe.tuple = _batch.size();
+      probe.key = probe.tuple + (key - tuple);
+      _batch.append (tuple, len);
+      _probes.push_back (probe);
+   }
+
+   // Joins the batch with the table and empties it
+   RC flush(JoinContext &ctx, const BuildTable &table) {
+      uint32_t mask = (1u << table.bits()) - 1;
+      stable_sort (_probes.begin(), _probes.end(),
+                   [mask](const Probe &a, const Probe &b) {
+                      return (a.hash & mask) < (b.hash & mask);
+                   });
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < _probes.size() && rcode == rc::success; ++i) {
+         const char *right = _batch.data() + _probes[i].tuple;
+         rcode = table.probe (ctx.type, _batch.data() + _probes[i].key,
+                              _probes[i].hash, [&](const char *left) {
+                                 return emitJoined (ctx, left, right);
+                              });
+      }
+      _batch.clear();
+      _probes.clear();
+      return rcode;
+   }
+
+private:
+   struct Probe {
+      uint32_t hash;
+      uint32_t tuple;        // offsets in _batch
+      uint32_t key;
+   };
+
+   string _batch;
+   vector<Probe> _probes;
+};
+
+// Joins the tuples given to build with those then given to probe, at a
+// partitioning level: in memory while the build side fits, else split
+// (a grace step) and every pair of partitions joined at the next level
+class Joiner {
+public:
+   Joiner(JoinContext &ctx, unsigned level)
+      : _ctx (ctx), _level (level), _spilled (false),
+        _writers (ctx.fanOut) {}
+
+   ~Joiner() {
+      for (unsigned i = 0; i < _buildRuns.size(); ++i) {
+         destroyRun (_buildRuns[i]);
+      }
+      for (unsigned i = 0; i < _probeRuns.size(); ++i) {
+         destroyRun (_probeRuns[i]);
+      }
+   }
+
+   RC build(const char *tuple, unsigned len) {
+      const char *key;
+      uint32_t hash;
+      if (!tupleKey (_ctx.left, _ctx.type, tuple, key, hash)) {
+         return rc::success;
+      }
+      if (_spilled) return write (tuple, len, hash);
+      _table.add (tuple, len, key, hash);
+      if (_table.bytes() <= _ctx.budget) return rc::success;
+
+      // the tuples so far then all the others to partitions
+      _spilled = true;
+      RC rcode = openWriters();
+      for (unsigned i = 0; i < _table.size() && rcode == rc::success; ++i) {
+         tuple = _table.tuple (i, len);
+         tupleKey (_ctx.left, _ctx.type, tuple, key, hash);
+         rcode = write (tuple, len, hash);
+      }
+      _table.clear();
+      return rcode;
+   }
+
+   RC endBuild() {
+      if (!_spilled) {
+         _table.build();
+         return rc::success;
+      }
+      RC rcode = closeWriters (_buildRuns);
+      if (rcode != rc::success) return rcode;
+      return openWriters();
+   }
+
+   RC probe(const char *tuple, unsigned len) {
+      const char *key;
+      uint32_t hash;
+      if (!tupleKey (_ctx.right, _ctx.type, tuple, key, hash)) {
+         return rc::success;
+      }
+      if (_spilled) return write (tuple, len, hash);
+      _batch.add (tuple, len, key, hash);
+      return _batch.full() ? _batch.flush (_ctx, _table) : rc::success;
+   }
+
+   RC finish() {
+      if (!_spilled) return _batch.flush (_ctx, _table);
+      RC rcode = closeWriters (_probeRuns);
+      unsigned i = 0;
+      for (; i < _probeRuns.size() && rcode == rc::success; ++i) {
+         rcode = joinRuns (_buildRuns[i], _probeRuns[i]);
+         destroyRun (_buildRuns[i]);
+         destroyRun (_probeRuns[i]);
+      }
+      // the pairs left after an error
+      for (unsigned j = i; j < _buildRuns.size(); ++j) {
+         destroyRun (_buildRuns[j]);
+      }
+      for (unsigned j = i; j < _probeRuns.size(); ++j) {
+         destroyRun (_probeRuns[j]);
+      }
+      _buildRuns.clear();
+      _probeRuns.clear();
+      return rcode;
+   }
+
+private:
+   Joiner(const Joiner&) = delete;
+   Joiner& operator=(const Joiner&) = delete;
+
+   RC openWriters() {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < _writers.size() && rcode == rc::success; ++i) {
+         rcode = _writers[i].open ("join_part");
+      }
+      return rcode;
+   }
+
+   RC write(const char *tuple, unsigned len, uint32_t hash) {
+      return _writers[levelHash (hash, _level) % _writers.size()].write (
+                tuple, len);
+   }
+
+   // POST: runs are the partitions written, even on error
+   RC closeWriters(vector<Run> &runs) {
+      RC rcode = rc::success;
+      runs.resize (_writers.size());
+      for (unsigned i = 0; i < _writers.size(); ++i) {
+         RC closed = _writers[i].close (runs[i]);
+         if (rcode == rc::success) rcode = closed;
+         _ctx.stats->pageWrites += runs[i].pages;
+      }
+      _ctx.stats->partitions += _writers.size();
+      return rcode;
+   }
+
+   // Joins a pair of partitions at the next level. Past JOIN_MAX_DEPTH,
+   // the build partition is loaded one budget at a time, each joined
+   // with the whole probe partition.
+   RC joinRuns(const Run &build, const Run &probe) {
+      if (build.count == 0 || probe.count == 0) return rc::success;
+      unsigned level = _level + 1;
+      _ctx.stats->depth = max (_ctx.stats->depth, level);
+      RunReader buildReader, probeReader;
+      RC rcode = buildReader.open (build);
+      string tuple;
+      if (level < JOIN_MAX_DEPTH) {
+         Joiner joiner (_ctx, level);
+         while (rcode == rc::success
+                && (rcode = buildReader.next (tuple)) == rc::success) {
+            rcode = joiner.build (tuple.data(), tuple.size());
+         }
+         _ctx.stats->pageReads += buildReader.pagesRead();
+         buildReader.close();
+         if (rcode == RBFM_EOF) rcode = joiner.endBuild();
+         if (rcode == rc::success) rcode = probeReader.open (probe);
+         while (rcode == rc::success
+                && (rcode = probeReader.next (tuple)) == rc::success) {
+            rcode = joiner.probe (tuple.data(), tuple.size());
+         }
+         _ctx.stats->pageReads += probeReader.pagesRead();
+         probeReader.close();
+         if (rcode == RBFM_EOF) rcode = joiner.finish();
+         return rcode;
+      }
+
+      BuildTable table;
+      ProbeBatch batch;
+      const char *key;
+      uint32_t hash;
+      bool more = rcode == rc::success;
+      while (rcode == rc::success && more) {
+         table.clear();
+         while (table.bytes() <= _ctx.budget
+                && (rcode = buildReader.next (tuple)) == rc::success) {
+            tupleKey (_ctx.left, _ctx.type, tuple.data(), key, hash);
+            table.add (tuple.data(), tuple.size(), key, hash);
+         }
+         if (rcode == RBFM_EOF) {
+            more = false;
+            rcode = rc::success;
+         }
+         if (rcode != rc::success) break;
+         table.build();
+         rcode = probeReader.open (probe);
+         while (rcode == rc::success
+                && (rcode = probeReader.next (tuple)) == rc::success) {
+            tupleKey (_ctx.right, _ctx.type, tuple.data(), key, hash);
+            batch.add (tuple.data(), tuple.size(), key, hash);
+            if (batch.full()) rcode = batch.flush (_ctx, table);
+         }
+         if (rcode == RBFM_EOF) rcode = batch.flush (_ctx, table);
+         _ctx.stats->pageReads += probeReader.pagesRead();
+         probeReader.close();
+      }
+      _ctx.stats->pageReads += buildReader.pagesRead();
+      return rcode;
+   }
+
+   JoinContext &_ctx;
+   unsigned _level;
+   BuildTable _table;
+   ProbeBatch _batch;
+   bool _spilled;             // a grace step: tuples go to _writers
+   vector<RunWriter> _writers;
+   vector<Run> _buildRuns;
+   vector<Run> _probeRuns;
+};
+
+// Checks the join attributes and sets up the context of a join
+static RC openJoin(const vector<Attribute> &leftDescriptor,
+                   const string &leftAttribute,
+                   const vector<Attribute> &rightDescriptor,
+                   const string &rightAttribute, unsigned memoryPages,
+                   const TupleSink &output, JoinStats &stats,
+                   JoinContext &ctx) {
+   stats.partitions = stats.depth = stats.pageReads = stats.pageWrites = 0;
+   int leftAttr = schemaOf (leftDescriptor).find (leftAttribute);
+   int rightAttr = schemaOf (rightDescriptor).find (rightAttribute);
+   if (leftAttr < 0 || rightAttr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s / %s]\n", leftAttribute.c_str(),
+              rightAttribute.c_str());
+      return rc::attribute_not_found;
+   }
+   if (leftDescriptor[leftAttr].type != rightDescriptor[rightAttr].type) {
+      RC_MSG (rc::type_mismatch, "[%s / %s]\n", leftAttribute.c_str(),
+              rightAttribute.c_str());
+      return rc::type_mismatch;
+   }
+   if (memoryPages < 3) {
+      RC_MSG (rc::invalid_budget, "[%u pages]\n", memoryPages);
+      return rc::invalid_budget;
+   }
+
+   // one page of the budget reads the input, the others take the table
+   // or, in a grace step, buffer the partitions
+   ctx.left.descriptor = &leftDescriptor;
+   ctx.left.attr = leftAttr;
+   ctx.right.descriptor = &rightDescriptor;
+   ctx.right.attr = rightAttr;
+   ctx.type = leftDescriptor[leftAttr].type;
+   ctx.budget = (memoryPages - 1) * PAGE_SIZE;
+   ctx.fanOut = memoryPages - 1;
+   ctx.output = &output;
+   ctx.stats = &stats;
+   return rc::success;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+HashJoin::HashJoin(Operator &left, Operator &right,
+                   const string &leftAttribute,
+                   const string &rightAttribute, unsigned memoryPages)
+   : Operator ("HashJoin"), _leftAttribute (leftAttribute),
+     _rightAttribute (rightAttribute), _memoryPages (memoryPages),
+     _joinStats ()
+{
+   _attributes = joinDescriptor (left.attributes(), right.attributes());
+   _inputs.push_back (&left);
+   _inputs.push_back (&right);
+}
+
+RC HashJoin::produce(const BatchSink &output) {
+   BatchWriter writer (output);
+   TupleSink sink = [&](const void *tuple) {
+      return writer.add (tuple, tupleSize (_attributes, tuple));
+   };
+   JoinContext ctx;
+   RC rcode = openJoin (_inputs[0]->attributes(), _leftAttribute,
+                        _inputs[1]->attributes(), _rightAttribute,
+                        _memoryPages, sink, _joinStats, ctx);
+   if (rcode != rc::success) return rcode;
+   Joiner joiner (ctx, 0);
+   rcode = _inputs[0]->run ([&joiner](const TupleBatch &batch) {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < batch.size() && rcode == rc::success; ++i) {
+         rcode = joiner.build (batch.tuple (i), batch.length (i));
+      }
+      return rcode;
+   });
+   if (rcode == rc::success) rcode = joiner.endBuild();
+   if (rcode == rc::success) {
+      rcode = _inputs[1]->run ([&joiner](const TupleBatch &batch) {
+         RC rcode = rc::success;
+         for (unsigned i = 0; i < batch.size() && rcode == rc::success;
+              ++i) {
+            rcode = joiner.probe (batch.tuple (i), batch.length (i));
+         }
+         return rcode;
+      });
+   }
+   if (rcode == rc::success) rcode = joiner.finish();
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+vector<Attribute> joinDescriptor(const vector<Attribute> &leftDescriptor,
+                                 const vector<Attribute> &rightDescriptor) {
+   vector<Attribute> joined (leftDescriptor);
+   joined.insert (joined.end(), rightDescriptor.begin(),
+                  rightDescriptor.end());
+   return joined;
+}
+
+RC hashJoin(RBFM_ScanIterator &left,
+            const vector<Attribute> &leftDescriptor,
+            const string &leftAttribute,
+            RBFM_ScanIterator &right,
+            const vector<Attribute> &rightDescriptor,
+            const string &rightAttribute,
+            unsigned memoryPages, const TupleSink &output,
+            JoinStats &stats) {
+   JoinContext ctx;
+   RC rcode = openJoin (leftDescriptor, leftAttribute, rightDescriptor,
+                        rightAttribute, memoryPages, output, stats, ctx);
+   if (rcode != rc::success) return rcode;
+   Joiner joiner (ctx, 0);
+   vector<char> buffer (max (tupleMax (leftDescriptor),
+                             tupleMax (rightDescriptor)));
+   RID rid;
+   while ((rcode = left.getNextRecord (rid, buffer.data())) == rc::success) {
+      rcode = joiner.build (buffer.data(),
+                            tupleSize (leftDescriptor, buffer.data()));
+      if (rcode != rc::success) return rcode;
+   }
+   if (rcode != RBFM_EOF) return rcode;
+   rcode = joiner.endBuild();
+   if (rcode != rc::success) return rcode;
+   while ((rcode = right.getNextRecord (rid, buffer.data())) == rc::success) {
+      rcode = joiner.probe (buffer.data(),
+                            tupleSize (rightDescriptor, buffer.data()));
+      if (rcode != rc::success) return rcode;
+   }
+   if (rcode != RBFM_EOF) return rcode;
+   return joiner.finish();
+}
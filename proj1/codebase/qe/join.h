@@ -0,0 +1,74 @@
+#ifndef _join_h_
+#define _join_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../qe/tuple.h"
+#include "../qe/operator.h"
+
+// Equi-join of two scans, left.leftAttribute = right.rightAttribute,
+// within a memory budget of memoryPages pages. A joined tuple holds the
+// attributes of the left tuple then those of the right one (see
+// joinDescriptor). Null keys never match.
+//
+// The left input is the build side. If it fits in the budget it is
+// loaded in an in-memory hash table and the right input is streamed
+// through it. Otherwise (grace hash join) both inputs are split by hash
+// into memoryPages - 1 partitions written to run files (runfile.h), and
+// every pair of partitions is joined the same way, split again with
+// another hash when its build side is still too large; past
+// JOIN_MAX_DEPTH levels (a heavily repeated key) the build partition is
+// joined one budget at a time.
+//
+// The in-memory table is radix partitioned on the low bits of the hash
+// into partitions of about JOIN_CACHE_BYTES, each with its own bucket
+// chains, and probe tuples are taken in batches partitioned the same
+// way, so that the probes of a batch walk one cache sized partition at
+// a time.
+
+const unsigned JOIN_CACHE_BYTES = 256 * 1024;
+const unsigned JOIN_PROBE_BATCH = 1024;
+const unsigned JOIN_MAX_DEPTH = 4;
+
+struct JoinStats {
+    unsigned partitions;   // run files written
+    unsigned depth;        // deepest partitioning level, 0 in memory
+    unsigned pageReads;    // of the runs
+    unsigned pageWrites;   // of the runs
+};
+
+// Descriptor of the joined tuples
+vector<Attribute> joinDescriptor(const vector<Attribute> &leftDescriptor,
+                                 const vector<Attribute> &rightDescriptor);
+
+// PRE: memoryPages >= 3
+RC hashJoin(RBFM_ScanIterator &left,
+            const vector<Attribute> &leftDescriptor,
+            const string &leftAttribute,
+            RBFM_ScanIterator &right,
+            const vector<Attribute> &rightDescriptor,
+            const string &rightAttribute,
+            unsigned memoryPages, const TupleSink &output,
+            JoinStats &stats);
+
+// Operator joining its left and right inputs, see hashJoin
+class HashJoin : public Operator {
+public:
+  HashJoin(Operator &left, Operator &right, const string &leftAttribute,
+           const string &rightAttribute, unsigned memoryPages);
+
+  const JoinStats& joinStats() const { return _joinStats; }
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  string _leftAttribute;
+  string _rightAttribute;
+  unsigned _memoryPages;
+  JoinStats _joinStats;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include <chrono>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "operator.h"
+#include "../rbf/schema.h"
+
+using namespace std::chrono;
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// RETURNS: copy of an API format value of the attribute, empty if value
+//          is NULL or the attribute unknown
+static string copyValue(const vector<Attribute> &descriptor,
+                        const string &attributeName, const void *value) {
+   int attr = schemaOf (descriptor).find (attributeName);
+   if (value == NULL || attr < 0) return string();
+   return string ((const char*) value,
+                  valueLength (descriptor[attr].type, (const char*) value));
+}
+
+static const char* valueOf(const string &value) {
+   return value.empty() ? NULL : value.data();
+}
+
+// POST: positions are those of attributeNames in descriptor, projected
+//       their descriptor
+// RETURNS: false if one is unknown
+static bool findPositions(const vector<Attribute> &descriptor,
+                          const vector<string> &attributeNames,
+                          vector<unsigned> &positions,
+                          vector<Attribute> &projected) {
+   const Schema &schema = schemaOf (descriptor);
+   bool found = true;
+   for (unsigned i = 0; i < attributeNames.size(); ++i) {
+      int attr = schema.find (attributeNames[i]);
+      if (attr < 0) {
+         found = false;
+         continue;
+      }
+      positions.push_back (attr);
+      projected.push_back (descriptor[attr]);
+   }
+   return found;
+}
+
+static void printOperator(const Operator &op, unsigned depth) {
+   const OperatorStats &stats = op.stats();
+   printf("%*s%s: %llu tuples, %llu batches, %.3f ms\n", 2 * depth, "",
+          op.name().c_str(), (unsigned long long) stats.tuples,
+          (unsigned long long) stats.batches, stats.nanos / 1e6);
+   for (unsigned i = 0; i < op.inputs().size(); ++i) {
+      printOperator (*op.inputs()[i], depth + 1);
+   }
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+void TupleBatch::add(const void *tuple, unsigned len) {
+   _offsets.push_back (_data.size());
+   _data.append ((const char*) tuple, len);
+}
+
+RC Operator::run(const BatchSink &output) {
+   _stats = OperatorStats();
+   nanoseconds consumer (0);
+   steady_clock::time_point start = steady_clock::now();
+   RC rcode = produce ([&](const TupleBatch &batch) {
+      _stats.tuples += batch.size();
+      ++_stats.batches;
+      steady_clock::time_point given = steady_clock::now();
+      RC rcode = output (batch);
+      consumer += steady_clock::now() - given;
+      return rcode;
+   });
+   _stats.nanos = duration_cast<nanoseconds> (steady_clock::now() - start
+                                              - consumer).count();
+   return rcode;
+}
+
+RC Operator::forEach(const TupleSink &output) {
+   return run ([&output](const TupleBatch &batch) {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < batch.size() && rcode == rc::success; ++i) {
+         rcode = output (batch.tuple (i));
+      }
+      return rcode;
+   });
+}
+
+RC BatchWriter::flush() {
+   if (_batch.size() == 0) return rc::success;
+   RC rcode = _output (_batch);
+   _batch.clear();
+   return rcode;
+}
+
+FileScan::FileScan(FileHandle &fileHandle,
+                   const vector<Attribute> &descriptor,
+                   const vector<string> &attributeNames,
+                   const string &conditionAttribute, CompOp compOp,
+                   const void *value)
+   : Operator ("FileScan"), _fileHandle (fileHandle),
+     _descriptor (descriptor), _attributeNames (attributeNames),
+     _conditionAttribute (conditionAttribute), _compOp (compOp),
+     _value (copyValue (descriptor, conditionAttribute, value))
+{
+   vector<unsigned> positions;
+   findPositions (descriptor, attributeNames, positions, _attributes);
+}
+
+RC FileScan::produce(const BatchSink &output) {
+   RBFM_ScanIterator it;
+   RC rcode = RecordBasedFileManager::instance()->scan (
+                 _fileHandle, _descriptor, _conditionAttribute, _compOp,
+                 valueOf (_value), _attributeNames, it);
+   if (rcode != rc::success) return rcode;
+   BatchWriter writer (output);
+   vector<char> buffer (tupleMax (_attributes));
+   RID rid;
+   while ((rcode = it.getNextRecord (rid, buffer.data())) == rc::success) {
+      rcode = writer.add (buffer.data(),
+                          tupleSize (_attributes, buffer.data()));
+      if (rcode != rc::success) break;
+   }
+   it.close();
+   if (rcode != RBFM_EOF) return rcode;
+   return writer.flush();
+}
+
+IndexScan::IndexScan(FileHandle &fileHandle,
+                     const vector<Attribute> &descriptor,
+                     const string &attributeName, const void *lowKey,
+                     const void *highKey, bool lowKeyInclusive,
+                     bool highKeyInclusive,
+                     const vector<string> &attributeNames)
+   : Operator ("IndexScan"), _fileHandle (fileHandle),
+     _descriptor (descriptor), _attributeName (attributeName),
+     _attr (schemaOf (descriptor).find (attributeName)),
+     _low (copyValue (descriptor, attributeName, lowKey)),
+     _high (copyValue (descriptor, attributeName, highKey)),
+     _lowInclusive (lowKeyInclusive), _highInclusive (highKeyInclusive)
+{
+   _found = findPositions (descriptor, attributeNames, _positions,
+                           _attributes);
+}
+
+RC IndexScan::produce(const BatchSink &output) {
+   if (_attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", _attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   if (!_found) {
+      RC_MSG (rc::attribute_not_found, "[projection]\n");
+      return rc::attribute_not_found;
+   }
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   RBFM_IndexScanIterator it;
+   RC rcode = rbfm->indexScan (_fileHandle, _descriptor, _attributeName,
+                               valueOf (_low), valueOf (_high),
+                               _lowInclusive, _highInclusive, it);
+   if (rcode != rc::success) return rcode;
+   AttrType type = _descriptor[_attr].type;
+   unsigned recordMax = tupleMax (_descriptor);
+   vector<char> records (OPERATOR_BATCH * recordMax);
+   vector<char> key (PAGE_SIZE);
+   vector<char> projected (tupleMax (_attributes));
+   vector<RID> rids;
+   vector<void*> data;
+   BatchWriter writer (output);
+   bool more = true;
+   while (rcode == rc::success && more) {
+      rids.clear();
+      data.clear();
+      RID rid;
+      while (rids.size() < OPERATOR_BATCH
+             && (rcode = it.getNextEntry (rid, key.data())) == rc::success) {
+         data.push_back (&records[rids.size() * recordMax]);
+         rids.push_back (rid);
+      }
+      if (rcode == RBFM_EOF) {
+         more = false;
+         rcode = rc::success;
+      }
+      if (rcode == rc::success && !rids.empty()) {
+         rcode = rbfm->readRecords (_fileHandle, _descriptor, rids, data);
+      }
+
+      // long VarChar keys are cut in the tree: the bounds are checked
+      // on the records
+      for (unsigned i = 0; i < rids.size() && rcode == rc::success; ++i) {
+         const char *value = tupleField (_descriptor, data[i], _attr);
+         if ((!_low.empty() && !satisfies (type, value, _lowInclusive
+                                           ? GE_OP : GT_OP, _low.data()))
+             || (!_high.empty() && !satisfies (type, value, _highInclusive
+                                               ? LE_OP : LT_OP,
+                                               _high.data()))) {
+            continue;
+         }
+         unsigned len = projectTuple (_descriptor, data[i], _positions,
+                                      projected.data());
+         rcode = writer.add (projected.data(), len);
+      }
+   }
+   it.close();
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+Filter::Filter(Operator &input, const string &attributeName, CompOp compOp,
+               const void *value)
+   : Operator ("Filter"), _attributeName (attributeName),
+     _attr (schemaOf (input.attributes()).find (attributeName)),
+     _compOp (compOp),
+     _value (copyValue (input.attributes(), attributeName, value))
+{
+   _attributes = input.attributes();
+   _inputs.push_back (&input);
+}
+
+RC Filter::produce(const BatchSink &output) {
+   if (_attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", _attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   AttrType type = _attributes[_attr].type;
+   BatchWriter writer (output);
+   RC rcode = _inputs[0]->run ([&](const TupleBatch &batch) {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < batch.size() && rcode == rc::success; ++i) {
+         const char *tuple = batch.tuple (i);
+         if (satisfies (type, tupleField (_attributes, tuple, _attr),
+                        _compOp, valueOf (_value))) {
+            rcode = writer.add (tuple, batch.length (i));
+         }
+      }
+      return rcode;
+   });
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+Project::Project(Operator &input, const vector<string> &attributeNames)
+   : Operator ("Project")
+{
+   _found = findPositions (input.attributes(), attributeNames, _positions,
+                           _attributes);
+   _inputs.push_back (&input);
+}
+
+RC Project::produce(const BatchSink &output) {
+   if (!_found) {
+      RC_MSG (rc::attribute_not_found, "[projection]\n");
+      return rc::attribute_not_found;
+   }
+   const vector<Attribute> &descriptor = _inputs[0]->attributes();
+   vector<char> projected (tupleMax (_attributes));
+   BatchWriter writer (output);
+   RC rcode = _inputs[0]->run ([&](const TupleBatch &batch) {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < batch.size() && rcode == rc::success; ++i) {
+         unsigned len = projectTuple (descriptor, batch.tuple (i),
+                                      _positions, projected.data());
+         rcode = writer.add (projected.data(), len);
+      }
+      return rcode;
+   });
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+void printStats(const Operator &root) {
+   printOperator (root, 0);
+}
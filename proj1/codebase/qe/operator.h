@@ -0,0 +1,183 @@
+#ifndef _operator_h_
+#define _operator_h_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../qe/tuple.h"
+
+// Query plans are trees of operators whose leaves are file and index
+// scans. Running the root runs the plan as pipelines: every operator
+// pushes its output into its consumer in batches of up to OPERATOR_BATCH
+// tuples, nothing is materialized between them. Only the blocking
+// operators (Sort, the build side of HashJoin, GroupBy, Aggregate) hold
+// or spill their input before giving any output.
+//
+// Every operator counts the tuples and batches it gives and the time
+// spent in it and its inputs (not in its consumer), see printStats.
+//
+// An operator refers to its inputs, which must outlive it. A plan can be
+// run again.
+
+const unsigned OPERATOR_BATCH = 256;
+
+// Tuples of the same descriptor, packed one after the other
+class TupleBatch {
+public:
+  void clear() { _data.clear(); _offsets.clear(); }
+  void add(const void *tuple, unsigned len);
+  unsigned size() const { return _offsets.size(); }
+  const char* tuple(unsigned i) const { return _data.data() + _offsets[i]; }
+  unsigned length(unsigned i) const {
+     return (i + 1 < _offsets.size() ? _offsets[i + 1] : _data.size())
+            - _offsets[i];
+  }
+
+private:
+  string _data;
+  vector<unsigned> _offsets;
+};
+
+// Receives the batches an operator gives, never empty
+typedef function<RC (const TupleBatch &batch)> BatchSink;
+
+struct OperatorStats {
+    uint64_t tuples;
+    uint64_t batches;
+    uint64_t nanos;        // in the operator and its inputs
+};
+
+class Operator {
+public:
+  virtual ~Operator() {}
+
+  const string& name() const { return _name; }
+  // Descriptor of the output tuples
+  const vector<Attribute>& attributes() const { return _attributes; }
+  const vector<Operator*>& inputs() const { return _inputs; }
+  // Counters of the last run
+  const OperatorStats& stats() const { return _stats; }
+
+  // Runs the plan below the operator, giving its output to output
+  RC run(const BatchSink &output);
+  // The same, a tuple at a time
+  RC forEach(const TupleSink &output);
+
+protected:
+  Operator(const string &name) : _name (name), _stats () {}
+
+  // Gives all the output tuples to output
+  virtual RC produce(const BatchSink &output) = 0;
+
+  string _name;
+  vector<Attribute> _attributes;
+  vector<Operator*> _inputs;
+
+private:
+  Operator(const Operator&) = delete;
+  Operator& operator=(const Operator&) = delete;
+
+  OperatorStats _stats;
+};
+
+// Fills batches with the tuples it is given and passes on the full ones
+class BatchWriter {
+public:
+  BatchWriter(const BatchSink &output) : _output (output) {}
+
+  RC add(const void *tuple, unsigned len) {
+     _batch.add (tuple, len);
+     return _batch.size() < OPERATOR_BATCH ? (RC) rc::success : flush();
+  }
+  // Passes on the last batch, if not empty
+  RC flush();
+
+private:
+  const BatchSink &_output;
+  TupleBatch _batch;
+};
+
+// Prints the counters of every operator of a plan, an input below its
+// consumer
+void printStats(const Operator &root);
+
+// The records of a scan (see RecordBasedFileManager::scan), projected on
+// attributeNames
+class FileScan : public Operator {
+public:
+  FileScan(FileHandle &fileHandle, const vector<Attribute> &descriptor,
+           const vector<string> &attributeNames,
+           const string &conditionAttribute = "", CompOp compOp = NO_OP,
+           const void *value = NULL);
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  FileHandle &_fileHandle;
+  vector<Attribute> _descriptor;
+  vector<string> _attributeNames;
+  string _conditionAttribute;
+  CompOp _compOp;
+  string _value;             // API format, empty for no value
+};
+
+// The records with attributeName between lowKey and highKey (NULL for no
+// bound) in key order, through its B+-tree index (see
+// RecordBasedFileManager::indexScan), projected on attributeNames. The
+// records of a batch of entries are read together with readRecords.
+class IndexScan : public Operator {
+public:
+  IndexScan(FileHandle &fileHandle, const vector<Attribute> &descriptor,
+            const string &attributeName, const void *lowKey,
+            const void *highKey, bool lowKeyInclusive,
+            bool highKeyInclusive, const vector<string> &attributeNames);
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  FileHandle &_fileHandle;
+  vector<Attribute> _descriptor;
+  string _attributeName;
+  int _attr;
+  string _low;               // API format, empty for no bound
+  string _high;
+  bool _lowInclusive;
+  bool _highInclusive;
+  vector<unsigned> _positions;  // of the projected attributes
+  bool _found;               // all the projected attributes
+};
+
+// The input tuples whose attributeName compOp value holds
+class Filter : public Operator {
+public:
+  Filter(Operator &input, const string &attributeName, CompOp compOp,
+         const void *value);
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  string _attributeName;
+  int _attr;
+  CompOp _compOp;
+  string _value;
+};
+
+// The input tuples projected on attributeNames
+class Project : public Operator {
+public:
+  Project(Operator &input, const vector<string> &attributeNames);
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  vector<unsigned> _positions;
+  bool _found;               // all the attributes
+};
+
+#endif
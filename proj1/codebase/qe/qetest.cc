@@ -0,0 +1,443 @@
+//qetest.cc -- tests of the query operators
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "../rbf/rbfm.h"
+#include "sort.h"
+#include "runfile.h"
+#include "join.h"
+#include "aggregate.h"
+#include "operator.h"
+
+using namespace std;
+
+// Employee: [null byte][EmpName][Age][Salary]
+static vector<Attribute> employees() {
+   vector<Attribute> desc;
+   Attribute attr;
+   attr.name = "EmpName";
+   attr.type = TypeVarChar;
+   attr.length = 30;
+   desc.push_back (attr);
+   attr.name = "Age";
+   attr.type = TypeInt;
+   attr.length = 4;
+   desc.push_back (attr);
+   attr.name = "Salary";
+   attr.type = TypeInt;
+   attr.length = 4;
+   desc.push_back (attr);
+   return desc;
+}
+
+static string employee(int i) {
+   static const char *names[] = { "Ann", "Bartholomew", "Chen", "Dolores" };
+   string emp (1, '\0');
+   int nameLen = strlen (names[i % 4]);
+   int age = 20 + i % 40;
+   int salary = (i * 7919) % 10007;
+   if (i % 50 == 0) emp[0] = 0x20;   // null Salary
+   emp.append ((char*) &nameLen, 4);
+   emp.append (names[i % 4], nameLen);
+   emp.append ((char*) &age, 4);
+   if (i % 50 != 0) emp.append ((char*) &salary, 4);
+   return emp;
+}
+
+// Checks the order of sorted tuples on Salary, nulls first
+struct OrderCheck {
+   int count;
+   bool sorted;
+   bool seen;             // a non null salary
+   int last;
+
+   OrderCheck() : count (0), sorted (true), seen (false), last (0) {}
+
+   RC operator()(const void *tuple) {
+      const char *in = (const char*) tuple;
+      int nameLen;
+      memcpy (&nameLen, in + 1, 4);
+      ++count;
+      if (in[0] & 0x20) {
+         sorted = sorted && !seen;
+         return rc::success;
+      }
+      int salary;
+      memcpy (&salary, in + 1 + 4 + nameLen + 4, 4);
+      sorted = sorted && (!seen || last <= salary);
+      seen = true;
+      last = salary;
+      return rc::success;
+   }
+};
+
+// Age bands: [null byte][Age][Band]
+static vector<Attribute> bands() {
+   vector<Attribute> desc;
+   Attribute attr;
+   attr.name = "Age";
+   attr.type = TypeInt;
+   attr.length = 4;
+   desc.push_back (attr);
+   attr.name = "Band";
+   attr.type = TypeVarChar;
+   attr.length = 10;
+   desc.push_back (attr);
+   return desc;
+}
+
+// Counts joined tuples and checks their keys, attributes a and b
+struct JoinCheck {
+   vector<Attribute> desc;
+   unsigned a, b;
+   int count;
+   bool equal;
+
+   JoinCheck(const vector<Attribute> &desc, unsigned a, unsigned b)
+      : desc (desc), a (a), b (b), count (0), equal (true) {}
+
+   RC operator()(const void *tuple) {
+      const char *x = tupleField (desc, tuple, a);
+      const char *y = tupleField (desc, tuple, b);
+      ++count;
+      equal = equal && x != NULL && y != NULL
+              && compareValues (desc[a].type, x, y) == 0;
+      return rc::success;
+   }
+};
+
+// Collects the groups of Int group values, the null group at INT_MIN
+struct GroupCheck {
+   map<int, float> groups;
+   int nulls;             // null aggregates
+
+   GroupCheck() : nulls (0) {}
+
+   RC operator()(const void *tuple) {
+      const char *in = (const char*) tuple;
+      int group = INT_MIN;
+      float value = 0;
+      if (!(in[0] & 0x80)) memcpy (&group, in + 1, 4);
+      if (in[0] & 0x40) {
+         ++nulls;
+      } else {
+         memcpy (&value, in + 1 + (in[0] & 0x80 ? 0 : 4), 4);
+      }
+      groups[group] = value;
+      return rc::success;
+   }
+};
+
+int main() {
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   vector<Attribute> empDesc = employees();
+   vector<string> all;
+   for (unsigned i = 0; i < empDesc.size(); ++i) {
+      all.push_back (empDesc[i].name);
+   }
+   FileHandle fh;
+   RBFM_ScanIterator it;
+   RID rid;
+   RC rc;
+
+   string sfname = "emp.t";
+   remove (sfname.c_str());
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, fh);
+   const int numEmp = 5000;
+   for (int i = 0; i < numEmp; ++i) {
+      string emp = employee (i);
+      rbfm->insertRecord (fh, empDesc, emp.data(), rid);
+   }
+
+   // sort of 5000 tuples in 3 pages: many runs, several passes
+   SortStats stats;
+   OrderCheck check;
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, it);
+   rc = externalSort (it, empDesc, "Salary", 3, TupleSink (ref (check)),
+                      stats);
+   it.close();
+   printf("test_sort_00: externalSort(3 pages) returned: %d, tuples: %d, "
+          "sorted: %d, runs: %u, passes: %u, pages read: %u, written: "
+          "%u.\n", rc, check.count, check.sorted, stats.runs, stats.passes,
+          stats.pageReads, stats.pageWrites);
+
+   // the same in 100 pages fits in memory
+   check = OrderCheck();
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, it);
+   rc = externalSort (it, empDesc, "Salary", 100, TupleSink (ref (check)),
+                      stats);
+   it.close();
+   printf("test_sort_01: externalSort(100 pages) returned: %d, tuples: %d, "
+          "sorted: %d, runs: %u, passes: %u.\n", rc, check.count,
+          check.sorted, stats.runs, stats.passes);
+
+   // sorted input file, scanned back in order
+   string sorted = "emp_sorted.t";
+   remove (sorted.c_str());
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, it);
+   rc = externalSort (it, empDesc, "Salary", 8, sorted, stats);
+   it.close();
+   FileHandle out;
+   rbfm->openFile (sorted, out);
+   check = OrderCheck();
+   char buf[100];
+   rbfm->scan (out, empDesc, "", NO_OP, NULL, all, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) check (buf);
+   it.close();
+   printf("test_sort_02: externalSort(8 pages, %s) returned: %d, "
+          "tuples: %d, sorted: %d, runs: %u.\n", sorted.c_str(), rc,
+          check.count, check.sorted, stats.runs);
+   rbfm->closeFile (out);
+   rbfm->destroyFile (sorted);
+
+   rc = externalSort (it, empDesc, "Salary", 2, TupleSink (ref (check)),
+                      stats);
+   printf("test_sort_03: externalSort(2 pages) returned: %d.\n", rc);
+
+   // one band per age from 0 to 99, and one with a null age
+   string bfname = "bands.t";
+   vector<Attribute> bandDesc = bands();
+   vector<string> bandAll = { "Age", "Band" };
+   FileHandle bh;
+   remove (bfname.c_str());
+   rbfm->createFile (bfname);
+   rbfm->openFile (bfname, bh);
+   for (int age = -1; age < 100; ++age) {
+      string band (1, age < 0 ? 0x80 : 0);
+      if (age >= 0) band.append ((char*) &age, 4);
+      int bandLen = 3;
+      char name[12];
+      sprintf (name, "%03d", age < 0 ? 0 : age / 10 * 10);
+      band.append ((char*) &bandLen, 4);
+      band.append (name, bandLen);
+      rbfm->insertRecord (bh, bandDesc, band.data(), rid);
+   }
+
+   // small build side: in memory
+   RBFM_ScanIterator right;
+   JoinStats jstats;
+   vector<Attribute> joined = joinDescriptor (bandDesc, empDesc);
+   JoinCheck jcheck (joined, 0, 3);
+   rbfm->scan (bh, bandDesc, "", NO_OP, NULL, bandAll, it);
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, right);
+   rc = hashJoin (it, bandDesc, "Age", right, empDesc, "Age", 100,
+                  TupleSink (ref (jcheck)), jstats);
+   it.close();
+   right.close();
+   printf("test_join_00: hashJoin(bands, emp, 100 pages) returned: %d, "
+          "tuples: %d, keys equal: %d, partitions: %u, depth: %u.\n", rc,
+          jcheck.count, jcheck.equal, jstats.partitions, jstats.depth);
+
+   // large build side: grace partitions
+   joined = joinDescriptor (empDesc, bandDesc);
+   jcheck = JoinCheck (joined, 1, 3);
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, it);
+   rbfm->scan (bh, bandDesc, "", NO_OP, NULL, bandAll, right);
+   rc = hashJoin (it, empDesc, "Age", right, bandDesc, "Age", 4,
+                  TupleSink (ref (jcheck)), jstats);
+   it.close();
+   right.close();
+   printf("test_join_01: hashJoin(emp, bands, 4 pages) returned: %d, "
+          "tuples: %d, keys equal: %d, partitions: %u, depth: %u, pages "
+          "read: %u, written: %u.\n", rc, jcheck.count, jcheck.equal,
+          jstats.partitions, jstats.depth, jstats.pageReads,
+          jstats.pageWrites);
+
+   // 4 names only: partitions never shrink, joined a budget at a time
+   int young = 30;
+   joined = joinDescriptor (empDesc, empDesc);
+   jcheck = JoinCheck (joined, 0, 3);
+   rbfm->scan (fh, empDesc, "Age", LT_OP, &young, all, it);
+   rbfm->scan (fh, empDesc, "Age", LT_OP, &young, all, right);
+   rc = hashJoin (it, empDesc, "EmpName", right, empDesc, "EmpName", 3,
+                  TupleSink (ref (jcheck)), jstats);
+   it.close();
+   right.close();
+   printf("test_join_02: hashJoin(emp, emp, 3 pages) returned: %d, "
+          "tuples: %d, keys equal: %d, depth: %u.\n", rc, jcheck.count,
+          jcheck.equal, jstats.depth);
+
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, it);
+   rbfm->scan (bh, bandDesc, "", NO_OP, NULL, bandAll, right);
+   rc = hashJoin (it, empDesc, "EmpName", right, bandDesc, "Age", 4,
+                  TupleSink (ref (jcheck)), jstats);
+   it.close();
+   right.close();
+   printf("test_join_03: hashJoin(EmpName = Age) returned: %d.\n", rc);
+
+
+   // SUM(Salary) WHERE Age > 30, projecting Salary only
+   vector<Attribute> salDesc (1, empDesc[2]);
+   vector<string> salary (1, "Salary");
+   int minAge = 30;
+   double expected = 0;
+   for (int i = 0; i < numEmp; ++i) {
+      if (20 + i % 40 > minAge && i % 50 != 0) {
+         expected += (i * 7919) % 10007;
+      }
+   }
+   char result[5];
+   float value;
+   rbfm->scan (fh, empDesc, "Age", GT_OP, &minAge, salary, it);
+   rc = aggregate (it, salDesc, "Salary", SUM, result);
+   it.close();
+   memcpy (&value, result + 1, 4);
+   printf("test_agg_00: aggregate(SUM(Salary), Age > 30) returned: %d, "
+          "null: %d, value: %.0f, expected: %.0f.\n", rc, result[0] != 0,
+          value, expected);
+
+   static const AggregateOp ops[] = { COUNT, MIN, MAX, AVG };
+   for (unsigned i = 0; i < 4; ++i) {
+      rbfm->scan (fh, empDesc, "", NO_OP, NULL, salary, it);
+      rc = aggregate (it, salDesc, "Salary", ops[i], result);
+      it.close();
+      memcpy (&value, result + 1, 4);
+      printf("test_agg_01: aggregate(%s) returned: %d, value: %.2f.\n",
+             aggregateAttribute (empDesc[2], ops[i]).name.c_str(), rc,
+             value);
+   }
+
+   // SUM(Salary) GROUP BY Age in memory
+   vector<Attribute> ageSalDesc (empDesc.begin() + 1, empDesc.end());
+   vector<string> ageSal = { "Age", "Salary" };
+   AggregateStats astats;
+   GroupCheck gcheck;
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, ageSal, it);
+   rc = groupAggregate (it, ageSalDesc, "Age", "Salary", SUM, 100,
+                        TupleSink (ref (gcheck)), astats);
+   it.close();
+   bool same = gcheck.groups.size() == 40;
+   for (int age = 20; age < 60; ++age) {
+      double sum = 0;
+      for (int i = age - 20; i < numEmp; i += 40) {
+         if (i % 50 != 0) sum += (i * 7919) % 10007;
+      }
+      same = same && gcheck.groups[age] == (float) sum;
+   }
+   printf("test_agg_02: groupAggregate(SUM(Salary) BY Age, 100 pages) "
+          "returned: %d, groups: %u, sums right: %d, partitions: %u.\n",
+          rc, astats.groups, same, astats.partitions);
+
+   // COUNT(Age) GROUP BY Salary: thousands of groups in 8 pages
+   vector<Attribute> salAgeDesc = { empDesc[2], empDesc[1] };
+   vector<string> salAge = { "Salary", "Age" };
+   gcheck = GroupCheck();
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, salAge, it);
+   rc = groupAggregate (it, salAgeDesc, "Salary", "Age", COUNT, 8,
+                        TupleSink (ref (gcheck)), astats);
+   it.close();
+   map<int, float> counts;
+   for (int i = 0; i < numEmp; ++i) {
+      ++counts[i % 50 == 0 ? INT_MIN : (i * 7919) % 10007];
+   }
+   printf("test_agg_03: groupAggregate(COUNT(Age) BY Salary, 8 pages) "
+          "returned: %d, groups: %u, counts right: %d, partitions: %u, "
+          "depth: %u.\n", rc, astats.groups, gcheck.groups == counts,
+          astats.partitions, astats.depth);
+
+   rbfm->scan (fh, empDesc, "", NO_OP, NULL, all, it);
+   rc = aggregate (it, empDesc, "EmpName", SUM, result);
+   it.close();
+   printf("test_agg_04: aggregate(SUM(EmpName)) returned: %d.\n", rc);
+
+   // SUM(Salary) WHERE Age > 30 as a pipeline
+   FileScan empScan (fh, empDesc, all);
+   Filter older (empScan, "Age", GT_OP, &minAge);
+   Project salaries (older, salary);
+   Aggregate total (salaries, "Salary", SUM);
+   rc = total.forEach ([&](const void *tuple) {
+      memcpy (&value, (const char*) tuple + 1, 4);
+      return rc::success;
+   });
+   printf("test_op_00: scan > filter > project > SUM returned: %d, value: "
+          "%.0f, tuples: %llu > %llu > %llu > %llu.\n", rc, value,
+          (unsigned long long) empScan.stats().tuples,
+          (unsigned long long) older.stats().tuples,
+          (unsigned long long) salaries.stats().tuples,
+          (unsigned long long) total.stats().tuples);
+
+   // 1000 <= Salary < 2000 through a B+-tree, in key order
+   rbfm->createBTreeIndex (fh, empDesc, "Salary");
+   int low = 1000, high = 2000;
+   IndexScan range (fh, empDesc, "Salary", &low, &high, true, false, all);
+   check = OrderCheck();
+   rc = range.forEach (TupleSink (ref (check)));
+   int inRange = 0;
+   for (int i = 0; i < numEmp; ++i) {
+      int sal = (i * 7919) % 10007;
+      inRange += i % 50 != 0 && sal >= low && sal < high;
+   }
+   printf("test_op_01: index scan returned: %d, tuples: %d, expected: %d, "
+          "sorted: %d, batches: %llu.\n", rc, check.count, inRange,
+          check.sorted, (unsigned long long) range.stats().batches);
+
+   // COUNT(EmpName) GROUP BY Band over bands joined with employees
+   FileScan bandScan (bh, bandDesc, bandAll);
+   HashJoin bandEmp (bandScan, empScan, "Age", "Age", 100);
+   GroupBy perBand (bandEmp, "Band", "EmpName", COUNT, 10);
+   map<string, float> bandCounts;
+   rc = perBand.forEach ([&](const void *tuple) {
+      const char *in = (const char*) tuple;
+      int len;
+      memcpy (&len, in + 1, 4);
+      memcpy (&value, in + 1 + 4 + len, 4);
+      bandCounts[string (in + 5, len)] = value;
+      return rc::success;
+   });
+   printf("test_op_02: join > group by returned: %d, groups: %u,", rc,
+          (unsigned) bandCounts.size());
+   for (auto it = bandCounts.begin(); it != bandCounts.end(); ++it) {
+      printf(" %s: %.0f", it->first.c_str(), it->second);
+   }
+   printf(", joined: %llu.\n", (unsigned long long) bandEmp.stats().tuples);
+
+   // sort of the filtered employees, spilling in 3 pages
+   int maxAge = 25;
+   Filter youngest (empScan, "Age", LT_OP, &maxAge);
+   Sort bySalary (youngest, "Salary", 3);
+   check = OrderCheck();
+   rc = bySalary.forEach (TupleSink (ref (check)));
+   printf("test_op_03: filter > sort returned: %d, tuples: %d, sorted: %d, "
+          "runs: %u.\n", rc, check.count, check.sorted,
+          bySalary.sortStats().runs);
+   printStats (bySalary);
+
+   // unknown attributes fail the index scan instead of reading past the
+   // descriptor
+   vector<string> unknownNames (1, "Weight");
+   IndexScan unknownKey (fh, empDesc, "Weight", &low, &high, true, false,
+                         all);
+   IndexScan unknownProjected (fh, empDesc, "Salary", &low, &high, true,
+                               false, unknownNames);
+   RC keyRc = unknownKey.forEach ([](const void*) { return rc::success; });
+   rc = unknownProjected.forEach ([](const void*) { return rc::success; });
+   printf("test_op_04: index scan on an unknown attribute returned: %d, "
+          "projecting one: %d.\n", keyRc, rc);
+
+   // a run dropped before close(), as on an error, takes its file along
+   string runName;
+   {
+      RunWriter writer;
+      rc = writer.open ("test_run");
+      if (rc == rc::success) rc = writer.write (&maxAge, sizeof(maxAge));
+      runName = writer.fileName();
+   }
+   printf("test_run_00: unfinished run returned: %d, file left: %d.\n", rc,
+          access (runName.c_str(), F_OK) == 0);
+
+   rbfm->closeFile (bh);
+   rbfm->destroyFile (bfname);
+   rbfm->closeFile (fh);
+   rbfm->destroyFile (sfname);
+   cout << "done" << endl;
+   return 0;
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "runfile.h"
+
+// RBFM_EOF
+#include "../rbf/rbfm.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// a file name that is not taken: prefix_<n>.tmp
+static string tempFileName(const string &prefix) {
+   static unsigned counter = 0;
+   string fileName;
+   do {
+      fileName = prefix + "_" + to_string (counter++) + ".tmp";
+   } while (access (fileName.c_str(), F_OK) == 0);
+   return fileName;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+RC destroyRun(const Run &run) {
+   return PagedFileManager::instance()->destroyFile (run.fileName);
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+RunWriter::RunWriter() : _open (false), _page (NULL), _used (0)
+{
+}
+
+RunWriter::~RunWriter()
+{
+   if (_open) {
+      PagedFileManager::instance()->closeFile (_fileHandle);
+      destroyRun (_run);
+   }
+   free (_page);
+}
+
+RC RunWriter::open(const string &prefix) {
+   PagedFileManager *pfm = PagedFileManager::instance();
+   _run.fileName = tempFileName (prefix);
+   _run.count = 0;
+   _run.pages = 0;
+   RC rcode = pfm->createFile (_run.fileName);
+   if (rcode != rc::success) return rcode;
+   rcode = pfm->openFile (_run.fileName, _fileHandle);
+   if (rcode != rc::success) {
+      destroyRun (_run);
+      return rcode;
+   }
+   if (_page == NULL) _page = (char*) malloc (PAGE_SIZE);
+   _open = true;
+   _used = 0;
+   return rc::success;
+}
+
+RC RunWriter::write(const void *tuple, unsigned len) {
+   uint32_t length = len;
+   const char *in[2] = { (const char*) &length, (const char*) tuple };
+   unsigned size[2] = { sizeof(length), len };
+   for (unsigned k = 0; k < 2; ++k) {
+      while (size[k] > 0) {
+         if (_used == PAGE_SIZE) {
+            RC rcode = flush();
+            if (rcode != rc::success) return rcode;
+         }
+         unsigned n = std::min (size[k], PAGE_SIZE - _used);
+         memcpy (_page + _used, in[k], n);
+         _used += n;
+         in[k] += n;
+         size[k] -= n;
+      }
+   }
+   ++_run.count;
+   return rc::success;
+}
+
+RC RunWriter::flush() {
+   RC rcode = _fileHandle.appendPage (_page);
+   if (rcode != rc::success) return rcode;
+   ++_run.pages;
+   _used = 0;
+   return rc::success;
+}
+
+RC RunWriter::close(Run &run) {
+   RC rcode = _used > 0 ? flush() : (RC) rc::success;
+   RC closed = PagedFileManager::instance()->closeFile (_fileHandle);
+   _open = false;
+   run = _run;
+   return rcode != rc::success ? rcode : closed;
+}
+
+RunReader::RunReader() : _open (false), _left (0), _pageNum (0),
+   _page (NULL), _used (PAGE_SIZE)
+{
+}
+
+RunReader::~RunReader()
+{
+   close();
+   free (_page);
+}
+
+RC RunReader::open(const Run &run) {
+   RC rcode = PagedFileManager::instance()->openFile (run.fileName,
+                                                     _fileHandle);
+   if (rcode != rc::success) return rcode;
+   if (_page == NULL) _page = (char*) malloc (PAGE_SIZE);
+   _open = true;
+   _left = run.count;
+   _pageNum = 0;
+   _used = PAGE_SIZE;
+   return rc::success;
+}
+
+RC RunReader::read(char *out, unsigned len) {
+   while (len > 0) {
+      if (_used == PAGE_SIZE) {
+         RC rcode = _fileHandle.readPage (_pageNum++, _page);
+         if (rcode != rc::success) return rcode;
+         _used = 0;
+      }
+      unsigned n = std::min (len, PAGE_SIZE - _used);
+      memcpy (out, _page + _used, n);
+      _used += n;
+      out += n;
+      len -= n;
+   }
+   return rc::success;
+}
+
+RC RunReader::next(string &tuple) {
+   if (_left == 0) return RBFM_EOF;
+   uint32_t length;
+   RC rcode = read ((char*) &length, sizeof(length));
+   if (rcode != rc::success) return rcode;
+   tuple.resize (length);
+   rcode = read (&tuple[0], length);
+   if (rcode != rc::success) return rcode;
+   --_left;
+   return rc::success;
+}
+
+RC RunReader::close() {
+   _left = 0;
+   if (!_open) return rc::success;
+   _open = false;
+   return PagedFileManager::instance()->closeFile (_fileHandle);
+}
@@ -0,0 +1,75 @@
+#ifndef _runfile_h_
+#define _runfile_h_
+
+#include <string>
+
+#include "../rbf/pfm.h"
+
+// Temporary files of tuples written once and read back in order (sort
+// runs, join partitions), through the paged file layer but with no page
+// structure: [uint32 length][tuple] entries are packed one after the
+// other and may span pages.
+
+struct Run {
+    string fileName;
+    unsigned count;        // tuples
+    unsigned pages;
+};
+
+class RunWriter {
+public:
+  RunWriter();
+  ~RunWriter();
+
+  // Creates a new file named after prefix. A run still open when the
+  // writer goes away was not finished: its file is destroyed.
+  RC open(const string &prefix);
+  RC write(const void *tuple, unsigned len);
+  // Writes the last page
+  // POST: run describes the file
+  RC close(Run &run);
+
+  const string& fileName() const { return _run.fileName; }
+
+private:
+  RunWriter(const RunWriter&) = delete;
+  RunWriter& operator=(const RunWriter&) = delete;
+
+  RC flush();
+
+  FileHandle _fileHandle;
+  bool _open;
+  Run _run;
+  char *_page;
+  unsigned _used;            // bytes of _page filled
+};
+
+class RunReader {
+public:
+  RunReader();
+  ~RunReader();
+
+  RC open(const Run &run);
+  // RETURNS: RBFM_EOF after the last tuple
+  RC next(string &tuple);
+  RC close();
+
+  unsigned pagesRead() const { return _pageNum; }
+
+private:
+  RunReader(const RunReader&) = delete;
+  RunReader& operator=(const RunReader&) = delete;
+
+  RC read(char *out, unsigned len);
+
+  FileHandle _fileHandle;
+  bool _open;
+  unsigned _left;            // tuples not read yet
+  PageNum _pageNum;          // next page to read
+  char *_page;
+  unsigned _used;            // bytes of _page consumed
+};
+
+RC destroyRun(const Run &run);
+
+#endif
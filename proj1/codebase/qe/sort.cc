@@ -0,0 +1,326 @@
+#include <algorithm>
+
+#include "sort.h"
+#include "../qe/runfile.h"
+#include "../rbf/schema.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+static void makeItem(const SortKey &key, const char *tuple, unsigned run,
+                     SortItem &item) {
+   item.tuple.assign (tuple, tupleSize (*key.descriptor, tuple));
+   const char *field = tupleField (*key.descriptor, item.tuple.data(),
+                                   key.attr);
+   item.key = field == NULL ? -1 : field - item.tuple.data();
+   item.run = run;
+}
+
+static const char* keyOf(const SortItem &item) {
+   return item.key < 0 ? NULL : item.tuple.data() + item.key;
+}
+
+// Tournament over k inputs where every inner node keeps the loser of
+// its match: when the winner's input moves to its next tuple, only the
+// matches on the path from its leaf to the root are replayed, about
+// log2(k) comparisons. Leaves k..2k-1 stand for the inputs 0..k-1.
+class LoserTree {
+public:
+   // beats (a, b): the current tuple of input a comes before that of b
+   LoserTree(unsigned k, const function<bool (unsigned, unsigned)> &beats)
+      : _k (k), _tree (k), _beats (beats) {
+      _tree[0] = build (1);
+   }
+
+   unsigned winner() const { return _tree[0]; }
+
+   // after the winner's input has moved on
+   void replay() {
+      unsigned w = _tree[0];
+      for (unsigned t = (w + _k) / 2; t > 0; t /= 2) {
+         if (_beats (_tree[t], w)) swap (_tree[t], w);
+      }
+      _tree[0] = w;
+   }
+
+private:
+   // RETURNS: the winner of the subtree of node
+   unsigned build(unsigned node) {
+      if (node >= _k) return node - _k;
+      unsigned a = build (2 * node);
+      unsigned b = build (2 * node + 1);
+      if (_beats (b, a)) swap (a, b);
+      _tree[node] = b;
+      return a;
+   }
+
+   unsigned _k;
+   vector<unsigned> _tree;
+   function<bool (unsigned, unsigned)> _beats;
+};
+
+// Merges runs with a loser tree, giving their tuples in order to sink
+static RC mergeRuns(const vector<Run> &runs, const SortKey &key,
+                    const function<RC (const string&)> &sink,
+                    SortStats &stats) {
+   unsigned k = runs.size();
+   vector<RunReader> readers (k);
+   vector<SortItem> heads (k);
+   vector<bool> done (k, false);
+   RC rcode = rc::success;
+   string tuple;
+   for (unsigned i = 0; i < k && rcode == rc::success; ++i) {
+      rcode = readers[i].open (runs[i]);
+      if (rcode == rc::success) rcode = readers[i].next (tuple);
+      if (rcode == rc::success) makeItem (key, tuple.data(), 0, heads[i]);
+      if (rcode == RBFM_EOF) {
+         done[i] = true;
+         rcode = rc::success;
+      }
+   }
+
+   // equal keys: the earlier run first
+   LoserTree tree (k, [&](unsigned a, unsigned b) {
+      if (done[a] || done[b]) return !done[a];
+      int cmp = compareValues (key.type, keyOf (heads[a]), keyOf (heads[b]));
+      return cmp < 0 || (cmp == 0 && a < b);
+   });
+   while (rcode == rc::success && k > 0 && !done[tree.winner()]) {
+      unsigned w = tree.winner();
+      rcode = sink (heads[w].tuple);
+      if (rcode == rc::success) rcode = readers[w].next (tuple);
+      if (rcode == rc::success) makeItem (key, tuple.data(), 0, heads[w]);
+      if (rcode == RBFM_EOF) {
+         done[w] = true;
+         rcode = rc::success;
+      }
+      tree.replay();
+   }
+   for (unsigned i = 0; i < k; ++i) {
+      stats.pageReads += readers[i].pagesRead();
+      readers[i].close();
+   }
+   return rcode;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+Sorter::Sorter() : _stats (NULL), _writing (false)
+{
+   _after = [this](const SortItem &a, const SortItem &b) {
+      if (a.run != b.run) return a.run > b.run;
+      return compareValues (_key.type, keyOf (a), keyOf (b)) > 0;
+   };
+}
+
+Sorter::~Sorter()
+{
+   for (unsigned i = 0; i < _runs.size(); ++i) destroyRun (_runs[i]);
+}
+
+RC Sorter::open(const vector<Attribute> &descriptor,
+                const string &attributeName, unsigned memoryPages,
+                SortStats &stats) {
+   stats.runs = stats.passes = stats.pageReads = stats.pageWrites = 0;
+   int attr = schemaOf (descriptor).find (attributeName);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   if (memoryPages < 3) {
+      RC_MSG (rc::invalid_budget, "[%u pages]\n", memoryPages);
+      return rc::invalid_budget;
+   }
+   _key.descriptor = &descriptor;
+   _key.attr = attr;
+   _key.type = descriptor[attr].type;
+   // one page of the budget is the output buffer of the runs
+   _budget = (memoryPages - 1) * PAGE_SIZE;
+   _fanIn = memoryPages - 1;
+   _stats = &stats;
+   _heap.clear();
+   _bytes = 0;
+   _writing = false;
+   _current = 0;
+   return rc::success;
+}
+
+// Replacement selection (see sort.h): the heap is only ordered once it
+// overflows, input that fits is sorted in finish
+RC Sorter::add(const void *tuple) {
+   _heap.push_back (SortItem());
+   SortItem &item = _heap.back();
+   makeItem (_key, (const char*) tuple, _current, item);
+   _bytes += item.tuple.size();
+   if (!_writing) {
+      if (_bytes < _budget) return rc::success;
+      make_heap (_heap.begin(), _heap.end(), _after);
+      _writing = true;
+      RC rcode = _writer.open ("sort_run");
+      if (rcode != rc::success) return rcode;
+   } else {
+      // a key smaller than the last one written waits for the next run
+      if (compareValues (_key.type, keyOf (item), keyOf (_last)) < 0) {
+         item.run = _current + 1;
+      }
+      push_heap (_heap.begin(), _heap.end(), _after);
+   }
+   RC rcode = rc::success;
+   while (rcode == rc::success && _bytes >= _budget) rcode = writeNext();
+   return rcode;
+}
+
+RC Sorter::finish(const TupleSink &output) {
+   RC rcode = rc::success;
+   if (!_writing) {
+      stable_sort (_heap.begin(), _heap.end(),
+                   [this](const SortItem &a, const SortItem &b) {
+                      return compareValues (_key.type, keyOf (a),
+                                            keyOf (b)) < 0;
+                   });
+      for (unsigned i = 0; i < _heap.size() && rcode == rc::success; ++i) {
+         rcode = output (_heap[i].tuple.data());
+      }
+      _heap.clear();
+      return rcode;
+   }
+   while (rcode == rc::success && !_heap.empty()) rcode = writeNext();
+   Run run;
+   RC closed = _writer.close (run);
+   _runs.push_back (run);
+   _stats->pageWrites += run.pages;
+   _stats->runs = _runs.size();
+   _writing = false;
+   if (rcode == rc::success) rcode = closed;
+
+   // one input page per run merged and one output page
+   while (rcode == rc::success && _runs.size() > _fanIn) {
+      vector<Run> merged;
+      for (unsigned i = 0; i < _runs.size() && rcode == rc::success;
+           i += _fanIn) {
+         vector<Run> group (_runs.begin() + i,
+                            _runs.begin() + min (i + _fanIn,
+                                                 (unsigned) _runs.size()));
+         RunWriter writer;
+         rcode = writer.open ("sort_run");
+         if (rcode == rc::success) {
+            rcode = mergeRuns (group, _key, [&writer](const string &tuple) {
+                                  return writer.write (tuple.data(),
+                                                       tuple.size());
+                               }, *_stats);
+            RC closed = writer.close (run);
+            if (rcode == rc::success) rcode = closed;
+            _stats->pageWrites += run.pages;
+            merged.push_back (run);
+         }
+      }
+      for (unsigned i = 0; i < _runs.size(); ++i) destroyRun (_runs[i]);
+      _runs.swap (merged);
+      ++_stats->passes;
+   }
+   if (rcode == rc::success) {
+      rcode = mergeRuns (_runs, _key, [&output](const string &tuple) {
+                            return output (tuple.data());
+                         }, *_stats);
+      ++_stats->passes;
+   }
+   for (unsigned i = 0; i < _runs.size(); ++i) destroyRun (_runs[i]);
+   _runs.clear();
+   return rcode;
+}
+
+// Writes the smallest tuple of the heap to its run
+RC Sorter::writeNext() {
+   pop_heap (_heap.begin(), _heap.end(), _after);
+   swap (_last, _heap.back());
+   _heap.pop_back();
+   _bytes -= _last.tuple.size();
+   RC rcode = rc::success;
+   if (_last.run != _current) {
+      Run run;
+      rcode = _writer.close (run);
+      _runs.push_back (run);
+      _stats->pageWrites += run.pages;
+      if (rcode == rc::success) rcode = _writer.open ("sort_run");
+      _current = _last.run;
+   }
+   if (rcode != rc::success) return rcode;
+   return _writer.write (_last.tuple.data(), _last.tuple.size());
+}
+
+Sort::Sort(Operator &input, const string &attributeName,
+           unsigned memoryPages)
+   : Operator ("Sort"), _attributeName (attributeName),
+     _memoryPages (memoryPages), _sortStats ()
+{
+   _attributes = input.attributes();
+   _inputs.push_back (&input);
+}
+
+RC Sort::produce(const BatchSink &output) {
+   Sorter sorter;
+   RC rcode = sorter.open (_attributes, _attributeName, _memoryPages,
+                           _sortStats);
+   if (rcode != rc::success) return rcode;
+   rcode = _inputs[0]->run ([&sorter](const TupleBatch &batch) {
+      RC rcode = rc::success;
+      for (unsigned i = 0; i < batch.size() && rcode == rc::success; ++i) {
+         rcode = sorter.add (batch.tuple (i));
+      }
+      return rcode;
+   });
+   if (rcode != rc::success) return rcode;
+   BatchWriter writer (output);
+   rcode = sorter.finish ([&](const void *tuple) {
+      return writer.add (tuple, tupleSize (_attributes, tuple));
+   });
+   if (rcode != rc::success) return rcode;
+   return writer.flush();
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+RC externalSort(RBFM_ScanIterator &input,
+                const vector<Attribute> &descriptor,
+                const string &attributeName, unsigned memoryPages,
+                const TupleSink &output, SortStats &stats) {
+   Sorter sorter;
+   RC rcode = sorter.open (descriptor, attributeName, memoryPages, stats);
+   if (rcode != rc::success) return rcode;
+   vector<char> buffer (tupleMax (descriptor));
+   RID rid;
+   while ((rcode = input.getNextRecord (rid, buffer.data())) == rc::success) {
+      rcode = sorter.add (buffer.data());
+      if (rcode != rc::success) return rcode;
+   }
+   if (rcode != RBFM_EOF) return rcode;
+   return sorter.finish (output);
+}
+RC externalSort(RBFM_ScanIterator &input,
+                const vector<Attribute> &descriptor,
+                const string &attributeName, unsigned memoryPages,
+                const string &outputFile, SortStats &stats) {
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   RC rcode = rbfm->createFile (outputFile);
+   if (rcode != rc::success) return rcode;
+   FileHandle fileHandle;
+   rcode = rbfm->openFile (outputFile, fileHandle);
+   if (rcode != rc::success) return rcode;
+   RID rid;
+   rcode = externalSort (input, descriptor, attributeName, memoryPages,
+                         [&](const void *tuple) {
+                            return rbfm->appendRecord (fileHandle,
+                                                       descriptor, tuple,
+                                                       rid);
+                         }, stats);
+   RC closed = rbfm->closeFile (fileHandle);
+   return rcode != rc::success ? rcode : closed;
+}
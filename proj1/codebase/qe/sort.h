@@ -0,0 +1,110 @@
+#ifndef _sort_h_
+#define _sort_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../qe/tuple.h"
+#include "../qe/runfile.h"
+#include "../qe/operator.h"
+
+// External merge sort of the tuples of a scan on one attribute, within
+// a memory budget of memoryPages pages.
+//
+// Run generation is replacement selection: a heap of up to
+// memoryPages - 1 pages of tuples, ordered by (run, key), always writes
+// out the smallest tuple that can still extend the current run, so that
+// runs of random input are about twice the memory and sorted input
+// makes a single run. Input that fits in the heap is sorted without any
+// run. Runs (runfile.h) are then merged memoryPages - 1 at a time with a
+// loser tree, in as many passes as needed; the last merge feeds the
+// output. Null keys come first.
+
+struct SortStats {
+    unsigned runs;         // runs generated
+    unsigned passes;       // merge passes, the last one included
+    unsigned pageReads;    // of the runs
+    unsigned pageWrites;   // of the runs
+};
+
+struct SortKey {
+    const vector<Attribute> *descriptor;
+    unsigned attr;
+    AttrType type;
+};
+
+// a tuple with the position of its key
+struct SortItem {
+    string tuple;
+    int key;               // offset of the key in tuple, -1 if null
+    unsigned run;
+};
+
+// Sorts the tuples given to add one at a time, then gives them in order
+// to the output of finish.
+class Sorter {
+public:
+  Sorter();
+  ~Sorter();
+
+  // PRE: memoryPages >= 3
+  RC open(const vector<Attribute> &descriptor, const string &attributeName,
+          unsigned memoryPages, SortStats &stats);
+  RC add(const void *tuple);
+  RC finish(const TupleSink &output);
+
+private:
+  Sorter(const Sorter&) = delete;
+  Sorter& operator=(const Sorter&) = delete;
+
+  RC writeNext();
+
+  SortKey _key;
+  unsigned _budget;          // bytes of the heap
+  unsigned _fanIn;
+  SortStats *_stats;
+  // (run, key) order, the heap puts the smallest first
+  function<bool (const SortItem&, const SortItem&)> _after;
+  vector<SortItem> _heap;        // a heap once _writing
+  unsigned _bytes;           // of the tuples in _heap
+  bool _writing;             // the input overflowed, runs are written
+  unsigned _current;         // run being written
+  SortItem _last;                // last tuple written
+  RunWriter _writer;
+  vector<Run> _runs;
+};
+
+// Sorts the tuples of input, of the given descriptor, on attributeName
+// and gives them in order to output.
+// PRE: memoryPages >= 3
+RC externalSort(RBFM_ScanIterator &input,
+                const vector<Attribute> &descriptor,
+                const string &attributeName, unsigned memoryPages,
+                const TupleSink &output, SortStats &stats);
+
+// The same, appending the sorted tuples to a new record file outputFile
+// (see RecordBasedFileManager::appendRecord), which a scan returns in
+// order.
+RC externalSort(RBFM_ScanIterator &input,
+                const vector<Attribute> &descriptor,
+                const string &attributeName, unsigned memoryPages,
+                const string &outputFile, SortStats &stats);
+
+// Operator giving its input sorted on attributeName, see externalSort
+class Sort : public Operator {
+public:
+  Sort(Operator &input, const string &attributeName, unsigned memoryPages);
+
+  const SortStats& sortStats() const { return _sortStats; }
+
+protected:
+  RC produce(const BatchSink &output);
+
+private:
+  string _attributeName;
+  unsigned _memoryPages;
+  SortStats _sortStats;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include <string.h>
+
+#include "tuple.h"
+#include "../rbf/page.h"
+#include "../rbf/hashindex.h"
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+const char* tupleField(const vector<Attribute> &descriptor,
+                       const void *tuple, unsigned attr) {
+   const char *nulls = (const char*) tuple;
+   if (isNull (nulls, attr)) return NULL;
+   const char *in = nulls + nullBytes (descriptor.size());
+   for (unsigned i = 0; i < attr; ++i) {
+      if (!isNull (nulls, i)) in += valueLength (descriptor[i].type, in);
+   }
+   return in;
+}
+
+int compareValues(AttrType type, const char *a, const char *b) {
+   if (a == NULL || b == NULL) return (a != NULL) - (b != NULL);
+   if (type == TypeInt) {
+      int32_t x, y;
+      memcpy (&x, a, sizeof(x));
+      memcpy (&y, b, sizeof(y));
+      return (x > y) - (x < y);
+   }
+   if (type == TypeReal) {
+      float x, y;
+      memcpy (&x, a, sizeof(x));
+      memcpy (&y, b, sizeof(y));
+      return (x > y) - (x < y);
+   }
+   uint32_t lenA, lenB;
+   memcpy (&lenA, a, sizeof(lenA));
+   memcpy (&lenB, b, sizeof(lenB));
+   int cmp = memcmp (a + sizeof(lenA), b + sizeof(lenB),
+                     std::min (lenA, lenB));
+   if (cmp != 0) return cmp < 0 ? -1 : 1;
+   return (lenA > lenB) - (lenA < lenB);
+}
+
+bool satisfies(AttrType type, const char *value, CompOp compOp,
+               const char *operand) {
+   if (compOp == NO_OP) return true;
+   if (value == NULL || operand == NULL) return false;
+   int cmp = compareValues (type, value, operand);
+   switch (compOp) {
+      case EQ_OP: return cmp == 0;
+      case LT_OP: return cmp < 0;
+      case LE_OP: return cmp <= 0;
+      case GT_OP: return cmp > 0;
+      case GE_OP: return cmp >= 0;
+      case NE_OP: return cmp != 0;
+      default:    return true;
+   }
+}
+
+unsigned projectTuple(const vector<Attribute> &descriptor, const void *tuple,
+                      const vector<unsigned> &positions, void *out) {
+   char *nulls = (char*) out;
+   unsigned size = nullBytes (positions.size());
+   memset (nulls, 0, size);
+   for (unsigned i = 0; i < positions.size(); ++i) {
+      const char *field = tupleField (descriptor, tuple, positions[i]);
+      if (field == NULL) {
+         setNull (nulls, i);
+         continue;
+      }
+      unsigned len = valueLength (descriptor[positions[i]].type, field);
+      memcpy (nulls + size, field, len);
+      size += len;
+   }
+   return size;
+}
+
+uint32_t valueHash(AttrType type, const char *value) {
+   if (type != TypeVarChar) return hashValue (type, value, sizeof(int));
+   uint32_t len;
+   memcpy (&len, value, sizeof(len));
+   return hashValue (type, value + sizeof(len), len);
+}
+
+uint32_t levelHash(uint32_t hash, unsigned level) {
+   hash ^= (level + 1) * 0x9e3779b9u;
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6bu;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35u;
+   hash ^= hash >> 16;
+   return hash;
+}
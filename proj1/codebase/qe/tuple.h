@@ -0,0 +1,44 @@
+#ifndef _tuple_h_
+#define _tuple_h_
+
+#include <functional>
+
+#include "../rbf/rbfm.h"
+#include "../rbf/page.h"
+
+// Tuples are records in the API format of rbfm.h, [null bitmap][values],
+// as returned by scans, described by the descriptor of their attributes
+// (the projected ones for a scan). Their sizes are those of any record
+// in that format: valueLength(), tupleSize() and tupleMax() of page.h.
+
+// Receives the tuples an operator produces
+typedef function<RC (const void *tuple)> TupleSink;
+
+// RETURNS: attribute attr of the tuple (API format, a VarChar with its
+//          length), NULL if it is null
+const char* tupleField(const vector<Attribute> &descriptor,
+                       const void *tuple, unsigned attr);
+
+// Order of two values of an attribute, a null (NULL) before any other
+// RETURNS: < 0, 0 or > 0
+int compareValues(AttrType type, const char *a, const char *b);
+
+// RETURNS: whether value (NULL if null) compOp operand holds; a null
+//          value only satisfies NO_OP
+bool satisfies(AttrType type, const char *value, CompOp compOp,
+               const char *operand);
+
+// Copies the attributes at positions of a tuple, in that order
+// POST: out is a tuple of those attributes
+// RETURNS: its bytes
+unsigned projectTuple(const vector<Attribute> &descriptor, const void *tuple,
+                      const vector<unsigned> &positions, void *out);
+
+// RETURNS: hash of a non null value, the same for equal values
+uint32_t valueHash(AttrType type, const char *value);
+
+// RETURNS: hash for the partitioning level of an operator (grace join,
+//          spilled group by), unrelated to the hashes of other levels
+uint32_t levelHash(uint32_t hash, unsigned level);
+
+#endif
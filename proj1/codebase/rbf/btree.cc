@@ -0,0 +1,527 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "btree.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+const unsigned NODE_CAPACITY = PAGE_SIZE - sizeof(PageFooter);
+
+// bulk loaded nodes are left with some room for the inserts that follow
+const unsigned BULK_FILL = NODE_CAPACITY / 10 * 9;
+
+static int compareRid(const RID &a, const RID &b) {
+   if (a.pageNum != b.pageNum) return a.pageNum < b.pageNum ? -1 : 1;
+   if (a.slotNum != b.slotNum) return a.slotNum < b.slotNum ? -1 : 1;
+   return 0;
+}
+
+// order of the entries: (key, rid)
+static int compareEntry(AttrType type, const string &key, const RID &rid,
+                        const BTreeEntry &entry) {
+   int cmp = btreeCompare (type, key, entry.key);
+   return cmp != 0 ? cmp : compareRid (rid, entry.rid);
+}
+
+static bool nanKey(AttrType type, const string &key) {
+   if (type != TypeReal) return false;
+   float x;
+   memcpy (&x, key.data(), sizeof(x));
+   return x != x;
+}
+
+static unsigned commonPrefix(const string &a, const string &b) {
+   unsigned n = 0;
+   unsigned max = std::min (std::min (a.size(), b.size()), (size_t) 0xFFFF);
+   while (n < max && a[n] == b[n]) ++n;
+   return n;
+}
+
+// Bytes of entry i of a node, its key cut by the prefix it shares with
+// entry i - 1 if prefixed
+static unsigned entrySize(AttrType type, const BTreeNode &node, unsigned i,
+                          bool prefixed) {
+   const string &key = node.entries[i].key;
+   unsigned size;
+   if (type == TypeVarChar) {
+      unsigned prefix = prefixed
+                        ? commonPrefix (node.entries[i - 1].key, key) : 0;
+      size = 2 * sizeof(uint16_t) + key.size() - prefix;
+   } else {
+      size = key.size();
+   }
+   size += 2 * sizeof(uint32_t);
+   if (node.leaf) {
+      size += sizeof(uint16_t) + node.entries[i].payload.size();
+   } else {
+      size += sizeof(uint32_t);
+   }
+   return size;
+}
+
+static unsigned nodeSize(AttrType type, const BTreeNode &node) {
+   unsigned size = sizeof(uint32_t);
+   for (unsigned i = 0; i < node.entries.size(); ++i) {
+      size += entrySize (type, node, i, i > 0);
+   }
+   return size;
+}
+
+// Where to split a node that overflows so that its halves hold about
+// as many bytes: a leaf keeps the entries before mid and the new node
+// gets the others, an inner node also moves entry mid up. The number of
+// entries says little when keys and payloads vary in size.
+static unsigned splitPoint(AttrType type, const BTreeNode &node) {
+   unsigned count = node.entries.size();
+   vector<unsigned> sizes (count);
+   unsigned total = 0;
+   for (unsigned i = 0; i < count; ++i) {
+      sizes[i] = entrySize (type, node, i, i > 0);
+      total += sizes[i];
+   }
+   unsigned best = count / 2, bestSize = ~0u;
+   unsigned left = 0;
+   for (unsigned mid = 1; mid < count; ++mid) {
+      left += sizes[mid - 1];
+      unsigned first = node.leaf ? mid : mid + 1;
+      unsigned right = total - left - (node.leaf ? 0 : sizes[mid]);
+      if (first < count) {
+         // the first key of the new node is not prefix compressed
+         right += entrySize (type, node, first, false) - sizes[first];
+      }
+      unsigned larger = std::max (left, right);
+      if (larger < bestSize) {
+         best = mid;
+         bestSize = larger;
+      }
+   }
+   return best;
+}
+
+// PRE: nodeSize (type, node) <= NODE_CAPACITY
+static void encodeNode(AttrType type, const BTreeNode &node, char *page) {
+   initPage (page, node.leaf ? PAGE_BTREE_LEAF : PAGE_BTREE_INNER);
+   PageFooter *footer = pageFooter (page);
+   footer->numSlots = node.entries.size();
+   footer->next = node.next;
+   char *out = page;
+   memcpy (out, &node.first, sizeof(uint32_t));
+   out += sizeof(uint32_t);
+   for (unsigned i = 0; i < node.entries.size(); ++i) {
+      const BTreeEntry &entry = node.entries[i];
+      if (type == TypeVarChar) {
+         unsigned prefix = i == 0 ? 0
+                           : commonPrefix (node.entries[i - 1].key,
+                                           entry.key);
+         put16 (out, prefix);
+         put16 (out + sizeof(uint16_t), entry.key.size() - prefix);
+         out += 2 * sizeof(uint16_t);
+         memcpy (out, entry.key.data() + prefix, entry.key.size() - prefix);
+         out += entry.key.size() - prefix;
+      } else {
+         memcpy (out, entry.key.data(), entry.key.size());
+         out += entry.key.size();
+      }
+      memcpy (out, &entry.rid.pageNum, sizeof(uint32_t));
+      memcpy (out + sizeof(uint32_t), &entry.rid.slotNum, sizeof(uint32_t));
+      out += 2 * sizeof(uint32_t);
+      if (node.leaf) {
+         put16 (out, entry.payload.size());
+         out += sizeof(uint16_t);
+         memcpy (out, entry.payload.data(), entry.payload.size());
+         out += entry.payload.size();
+      } else {
+         memcpy (out, &entry.child, sizeof(uint32_t));
+         out += sizeof(uint32_t);
+      }
+   }
+   footer->freeOffset = out - page;
+}
+
+static void decodeNode(AttrType type, char *page, BTreeNode &node) {
+   PageFooter *footer = pageFooter (page);
+   node.leaf = footer->type == PAGE_BTREE_LEAF;
+   node.next = footer->next;
+   const char *in = page;
+   memcpy (&node.first, in, sizeof(uint32_t));
+   in += sizeof(uint32_t);
+   node.entries.resize (footer->numSlots);
+   for (unsigned i = 0; i < node.entries.size(); ++i) {
+      BTreeEntry &entry = node.entries[i];
+      if (type == TypeVarChar) {
+         unsigned prefix = get16 (in);
+         unsigned suffixLen = get16 (in + sizeof(uint16_t));
+         in += 2 * sizeof(uint16_t);
+         if (prefix > 0) {
+            entry.key.assign (node.entries[i - 1].key, 0, prefix);
+         } else {
+            entry.key.clear();
+         }
+         entry.key.append (in, suffixLen);
+         in += suffixLen;
+      } else {
+         entry.key.assign (in, sizeof(int));
+         in += sizeof(int);
+      }
+      memcpy (&entry.rid.pageNum, in, sizeof(uint32_t));
+      memcpy (&entry.rid.slotNum, in + sizeof(uint32_t), sizeof(uint32_t));
+      in += 2 * sizeof(uint32_t);
+      entry.child = NO_PAGE;
+      if (node.leaf) {
+         unsigned payloadLen = get16 (in);
+         in += sizeof(uint16_t);
+         entry.payload.assign (in, payloadLen);
+         in += payloadLen;
+      } else {
+         entry.payload.clear();
+         memcpy (&entry.child, in, sizeof(uint32_t));
+         in += sizeof(uint32_t);
+      }
+   }
+}
+
+static RC readNode(FileHandle &fileHandle, AttrType type, PageNum pageNum,
+                   BTreeNode &node) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = fileHandle.readPage (pageNum, page);
+   if (rcode == rc::success) {
+      uint8_t pageType = pageFooter (page)->type;
+      if (pageType != PAGE_BTREE_LEAF && pageType != PAGE_BTREE_INNER) {
+         RC_MSG (rc::bad_page_type, "[pageNum: %u]\n", pageNum);
+         rcode = rc::bad_page_type;
+      } else {
+         decodeNode (type, page, node);
+      }
+   }
+   free (page);
+   return rcode;
+}
+
+static RC writeNode(FileHandle &fileHandle, AttrType type, PageNum pageNum,
+                    const BTreeNode &node) {
+   unsigned size = nodeSize (type, node);
+   if (size > NODE_CAPACITY) {
+      RC_MSG (rc::payload_too_large, "[pageNum: %u, size: %u]\n", pageNum,
+              size);
+      return rc::payload_too_large;
+   }
+   char *page = (char*) malloc (PAGE_SIZE);
+   encodeNode (type, node, page);
+   RC rcode = fileHandle.writePage (pageNum, page);
+   free (page);
+   return rcode;
+}
+
+// a new page for a node
+static RC allocNode(FileHandle &fileHandle, bool leaf, PageNum &pageNum) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = allocPage (fileHandle, leaf ? PAGE_BTREE_LEAF
+                                          : PAGE_BTREE_INNER,
+                         page, pageNum);
+   free (page);
+   return rcode;
+}
+
+// number of entries of an inner node <= (key, rid)
+static unsigned childIndex(AttrType type, const BTreeNode &node,
+                           const string &key, const RID &rid) {
+   unsigned lo = 0, hi = node.entries.size();
+   while (lo < hi) {
+      unsigned mid = (lo + hi) / 2;
+      if (compareEntry (type, key, rid, node.entries[mid]) >= 0) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+// child of an inner node to descend to for (key, rid)
+static PageNum childFor(AttrType type, const BTreeNode &node,
+                        const string &key, const RID &rid) {
+   unsigned i = childIndex (type, node, key, rid);
+   return i == 0 ? node.first : node.entries[i - 1].child;
+}
+
+// first entry of a leaf >= (key, rid)
+static unsigned lowerBound(AttrType type, const BTreeNode &node,
+                           const string &key, const RID &rid) {
+   unsigned lo = 0, hi = node.entries.size();
+   while (lo < hi) {
+      unsigned mid = (lo + hi) / 2;
+      if (compareEntry (type, key, rid, node.entries[mid]) > 0) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+// Inserts into the subtree of pageNum.
+// POST: if split, up is the first entry of the new right sibling of
+//       pageNum and up.child its page
+static RC insertInto(FileHandle &fileHandle, AttrType type,
+                     PageNum pageNum, const BTreeEntry &entry, bool &split,
+                     BTreeEntry &up) {
+   split = false;
+   BTreeNode node;
+   RC rcode = readNode (fileHandle, type, pageNum, node);
+   if (rcode != rc::success) return rcode;
+
+   if (node.leaf) {
+      unsigned pos = lowerBound (type, node, entry.key, entry.rid);
+      node.entries.insert (node.entries.begin() + pos, entry);
+   } else {
+      unsigned pos = childIndex (type, node, entry.key, entry.rid);
+      PageNum child = pos == 0 ? node.first : node.entries[pos - 1].child;
+      bool childSplit;
+      BTreeEntry childUp;
+      rcode = insertInto (fileHandle, type, child, entry, childSplit,
+                          childUp);
+      if (rcode != rc::success || !childSplit) return rcode;
+      node.entries.insert (node.entries.begin() + pos, childUp);
+   }
+   if (nodeSize (type, node) <= NODE_CAPACITY) {
+      return writeNode (fileHandle, type, pageNum, node);
+   }
+
+   // split in two halves, the upper one goes to a new page
+   unsigned mid = splitPoint (type, node);
+   PageNum rightPage;
+   rcode = allocNode (fileHandle, node.leaf, rightPage);
+   if (rcode != rc::success) return rcode;
+   BTreeNode right;
+   right.leaf = node.leaf;
+   right.next = NO_PAGE;
+   if (node.leaf) {
+      right.first = NO_PAGE;
+      right.entries.assign (node.entries.begin() + mid, node.entries.end());
+      right.next = node.next;
+      node.next = rightPage;
+      up = right.entries[0];
+      up.payload.clear();
+   } else {
+      // the middle entry moves up, its child starts the right node
+      up = node.entries[mid];
+      right.first = up.child;
+      right.entries.assign (node.entries.begin() + mid + 1,
+                            node.entries.end());
+   }
+   node.entries.resize (mid);
+   up.child = rightPage;
+   split = true;
+   rcode = writeNode (fileHandle, type, rightPage, right);
+   if (rcode != rc::success) return rcode;
+   return writeNode (fileHandle, type, pageNum, node);
+}
+
+// Packs a sorted level into nodes of at most BULK_FILL bytes.
+// POST: ups[j] is the entry separating nodes[j] and nodes[j+1], its
+//       child is set once the pages are known
+static void packLevel(AttrType type, bool leaf, PageNum first,
+                      const vector<BTreeEntry> &items,
+                      vector<BTreeNode> &nodes, vector<BTreeEntry> &ups) {
+   BTreeNode node;
+   node.leaf = leaf;
+   node.first = first;
+   node.next = NO_PAGE;
+   for (unsigned i = 0; i < items.size(); ++i) {
+      node.entries.push_back (items[i]);
+      if (node.entries.size() == 1
+          || nodeSize (type, node) <= BULK_FILL) {
+         continue;
+      }
+      node.entries.pop_back();
+      nodes.push_back (node);
+      node.entries.clear();
+      ups.push_back (items[i]);
+      ups.back().payload.clear();
+      if (leaf) {
+         node.entries.push_back (items[i]);
+      } else {
+         // moves up, its child starts the next node
+         node.first = items[i].child;
+      }
+   }
+   nodes.push_back (node);
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+string btreeKey(AttrType type, const char *bytes, unsigned len) {
+   if (type != TypeVarChar) return string (bytes, sizeof(int));
+   return string (bytes, std::min (len, BTREE_KEY_MAX));
+}
+
+int btreeCompare(AttrType type, const string &a, const string &b) {
+   if (type == TypeInt) {
+      int32_t x, y;
+      memcpy (&x, a.data(), sizeof(x));
+      memcpy (&y, b.data(), sizeof(y));
+      return (x > y) - (x < y);
+   }
+   if (type == TypeReal) {
+      float x, y;
+      memcpy (&x, a.data(), sizeof(x));
+      memcpy (&y, b.data(), sizeof(y));
+      // NaNs are equal to each other and after every number, so that
+      // keys stay totally ordered
+      bool xNan = x != x, yNan = y != y;
+      if (xNan || yNan) return xNan - yNan;
+      return (x > y) - (x < y);
+   }
+   int cmp = memcmp (a.data(), b.data(), std::min (a.size(), b.size()));
+   if (cmp != 0) return cmp < 0 ? -1 : 1;
+   return (a.size() > b.size()) - (a.size() < b.size());
+}
+
+RC btreeBuild(FileHandle &fileHandle, AttrType type,
+              vector<BTreeEntry> &entries, PageNum &root) {
+   std::sort (entries.begin(), entries.end(),
+              [type](const BTreeEntry &a, const BTreeEntry &b) {
+                 return compareEntry (type, a.key, a.rid, b) < 0;
+              });
+   RC rcode = allocNode (fileHandle, true, root);
+   bool leaf = true;
+   PageNum first = NO_PAGE;
+   vector<BTreeEntry> items (entries);
+   while (rcode == rc::success) {
+      vector<BTreeNode> nodes;
+      vector<BTreeEntry> ups;
+      packLevel (type, leaf, first, items, nodes, ups);
+      if (nodes.size() == 1) {
+         return writeNode (fileHandle, type, root, nodes[0]);
+      }
+      vector<PageNum> pages (nodes.size());
+      for (unsigned j = 0; j < nodes.size() && rcode == rc::success; ++j) {
+         rcode = allocNode (fileHandle, leaf, pages[j]);
+      }
+      for (unsigned j = 0; j < nodes.size() && rcode == rc::success; ++j) {
+         if (leaf && j + 1 < nodes.size()) nodes[j].next = pages[j + 1];
+         rcode = writeNode (fileHandle, type, pages[j], nodes[j]);
+      }
+      for (unsigned j = 0; j < ups.size(); ++j) {
+         ups[j].child = pages[j + 1];
+      }
+      items.swap (ups);
+      first = pages[0];
+      leaf = false;
+   }
+   return rcode;
+}
+
+RC btreeInsert(FileHandle &fileHandle, AttrType type, PageNum root,
+               const string &key, const RID &rid, const string &payload) {
+   BTreeEntry entry;
+   entry.key = key;
+   entry.rid = rid;
+   entry.child = NO_PAGE;
+   entry.payload = payload;
+   bool split;
+   BTreeEntry up;
+   RC rcode = insertInto (fileHandle, type, root, entry, split, up);
+   if (rcode != rc::success || !split) return rcode;
+
+   // the root keeps its page: its left half moves to a new one
+   BTreeNode left;
+   rcode = readNode (fileHandle, type, root, left);
+   PageNum leftPage;
+   if (rcode == rc::success) rcode = allocNode (fileHandle, left.leaf,
+                                                leftPage);
+   if (rcode == rc::success) rcode = writeNode (fileHandle, type, leftPage,
+                                                left);
+   if (rcode != rc::success) return rcode;
+   BTreeNode node;
+   node.leaf = false;
+   node.first = leftPage;
+   node.next = NO_PAGE;
+   node.entries.push_back (up);
+   return writeNode (fileHandle, type, root, node);
+}
+
+RC btreeDelete(FileHandle &fileHandle, AttrType type, PageNum root,
+               const string &key, const RID &rid) {
+   BTreeNode node;
+   PageNum pageNum = root;
+   RC rcode = readNode (fileHandle, type, pageNum, node);
+   while (rcode == rc::success && !node.leaf) {
+      pageNum = childFor (type, node, key, rid);
+      rcode = readNode (fileHandle, type, pageNum, node);
+   }
+   if (rcode != rc::success) return rcode;
+   unsigned pos = lowerBound (type, node, key, rid);
+   if (pos == node.entries.size()
+       || compareEntry (type, key, rid, node.entries[pos]) != 0) {
+      return rc::success;
+   }
+   node.entries.erase (node.entries.begin() + pos);
+   return writeNode (fileHandle, type, pageNum, node);
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+RC BTreeCursor::open(FileHandle &fileHandle, AttrType t, PageNum root,
+                     const string *low, bool lowInclusive,
+                     const string *h, bool hInclusive) {
+   type = t;
+   bounded = low != NULL || h != NULL;
+   hasHigh = h != NULL;
+   if (hasHigh) high = *h;
+   highInclusive = hInclusive;
+   // no key compares with a NaN bound
+   done = (low != NULL && nanKey (type, *low))
+          || (h != NULL && nanKey (type, *h));
+
+   // (low, smallest RID) or, to leave out low itself, (low, largest RID)
+   RID bound;
+   bound.pageNum = bound.slotNum = lowInclusive ? 0 : UINT_MAX;
+   RC rcode = readNode (fileHandle, type, root, node);
+   while (rcode == rc::success && !node.leaf) {
+      PageNum child = low ? childFor (type, node, *low, bound) : node.first;
+      rcode = readNode (fileHandle, type, child, node);
+   }
+   pos = low && rcode == rc::success
+         ? lowerBound (type, node, *low, bound) : 0;
+   return rcode;
+}
+
+RC BTreeCursor::next(FileHandle &fileHandle, BTreeEntry &entry) {
+   while (!done && pos >= node.entries.size()) {
+      if (node.next == NO_PAGE) {
+         done = true;
+         break;
+      }
+      RC rcode = readNode (fileHandle, type, node.next, node);
+      if (rcode != rc::success) return rcode;
+      pos = 0;
+   }
+   if (done) return RBFM_EOF;
+   const BTreeEntry &e = node.entries[pos++];
+   // the NaN keys, last, are in no range
+   if (bounded && nanKey (type, e.key)) {
+      done = true;
+      return RBFM_EOF;
+   }
+   if (hasHigh) {
+      int cmp = btreeCompare (type, e.key, high);
+      if (cmp > 0 || (cmp == 0 && !highInclusive)) {
+         done = true;
+         return RBFM_EOF;
+      }
+   }
+   entry = e;
+   return rc::success;
+}
@@ -0,0 +1,100 @@
+#ifndef _btree_h_
+#define _btree_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../rbf/page.h"
+
+// B+-tree index from the values of one attribute to the RIDs of the
+// records holding them, kept inside the record file.
+//
+// Entries are ordered by (key, RID), so every entry is unique even if
+// keys are not, and an entry is found by a single descent. A key is the
+// attribute value in the internal format; VarChar keys longer than
+// BTREE_KEY_MAX bytes are cut to that length, so a lookup may return
+// records whose value only shares the first BTREE_KEY_MAX bytes with
+// the bounds (rbfm scans check their condition on the record anyway).
+//
+// Leaf entries may carry a payload, the values of other attributes of
+// the record (see RecordBasedFileManager::createBTreeIndex), so that
+// scans projecting only those never read the record.
+//
+// Node page (PAGE_BTREE_INNER / PAGE_BTREE_LEAF):
+//   [uint32 first child][entries ->         free space       ][footer]
+//   - entry: [key][uint32 pageNum][uint32 slotNum], then in leaves
+//     [uint16 payloadLen][payload] and in inner nodes [uint32 child]
+//     the subtree of the entries >= this one
+//   - TypeInt / TypeReal key: 4 bytes
+//   - TypeVarChar key: [uint16 prefix][uint16 suffixLen][suffix],
+//     prefix is the length shared with the key of the entry before
+//   - footer.numSlots is the number of entries, footer.next the right
+//     sibling of a leaf
+//
+// The root page never moves: when it splits, its content goes to a new
+// page which becomes its first child. Nodes are not merged when entries
+// are deleted; an empty leaf is just skipped by the scans.
+
+const unsigned BTREE_KEY_MAX = PAGE_SIZE / 16;
+const unsigned BTREE_PAYLOAD_MAX = PAGE_SIZE / 8;
+
+struct BTreeEntry {
+    string key;
+    RID rid;
+    PageNum child;         // inner nodes only
+    string payload;        // leaves only
+};
+
+// A node decoded from its page
+struct BTreeNode {
+    bool leaf;
+    PageNum first;         // first child of an inner node
+    PageNum next;          // right sibling of a leaf
+    vector<BTreeEntry> entries;
+};
+
+// Key of a field value (internal format, no VarChar length)
+string btreeKey(AttrType type, const char *bytes, unsigned len);
+
+// Order of the keys. A NaN TypeReal key comes after every number and a
+// range (BTreeCursor) never holds it.
+int btreeCompare(AttrType type, const string &a, const string &b);
+
+// Builds a tree holding entries (in any order), packing its nodes
+// bottom up.
+// POST: root is its root page
+RC btreeBuild(FileHandle &fileHandle, AttrType type,
+              vector<BTreeEntry> &entries, PageNum &root);
+
+// PRE: payload.size() <= BTREE_PAYLOAD_MAX
+RC btreeInsert(FileHandle &fileHandle, AttrType type, PageNum root,
+               const string &key, const RID &rid, const string &payload);
+
+// Removes the entry (key, rid), if any
+RC btreeDelete(FileHandle &fileHandle, AttrType type, PageNum root,
+               const string &key, const RID &rid);
+
+// Entries of a key range in (key, RID) order, following the leaf
+// sibling links: a range with k entries reads O(log n + k / fanout)
+// pages.
+struct BTreeCursor {
+    AttrType type;
+    bool bounded;          // by a low or a high key
+    bool hasHigh;
+    string high;
+    bool highInclusive;
+    BTreeNode node;        // current leaf
+    unsigned pos;          // next entry of node
+    bool done;
+
+    // low / high are NULL for an open range
+    RC open(FileHandle &fileHandle, AttrType type, PageNum root,
+            const string *low, bool lowInclusive, const string *high,
+            bool highInclusive);
+
+    // RETURNS: RBFM_EOF past the last entry of the range
+    RC next(FileHandle &fileHandle, BTreeEntry &entry);
+};
+
+#endif
@@ -0,0 +1,491 @@
+#include <algorithm>
+#include <mutex>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "column.h"
+#include "dump.h"
+#include "page.h"
+#include "schema.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+static string columnName(const string &storeName, unsigned attr) {
+   return storeName + "." + to_string (attr);
+}
+
+static unsigned codeBytes(unsigned dictCount) {
+   if (dictCount <= 0x100) return 1;
+   if (dictCount <= 0x10000) return 2;
+   return 4;
+}
+
+// The values of an attribute gathered for the chunk being exported
+struct ColumnBuilder {
+    AttrType type;
+    unsigned records;
+    string nulls;
+    string values;             // TypeInt / TypeReal
+    vector<string> varchars;   // TypeVarChar, "" if null
+    Zone zone;
+};
+
+static void startChunk(ColumnBuilder &builder) {
+   builder.records = 0;
+   builder.nulls.clear();
+   builder.values.clear();
+   builder.varchars.clear();
+   zoneInit (builder.zone);
+}
+
+// Adds the value at *data (API format, NULL if null) to the chunk
+// POST: data is past the value
+static void addValue(ColumnBuilder &builder, const char *&data) {
+   unsigned row = builder.records++;
+   if (row % CHAR_BIT == 0) builder.nulls.push_back ('\0');
+   if (data == NULL) {
+      setNull (&builder.nulls[0], row);
+      if (builder.type == TypeVarChar) {
+         builder.varchars.push_back (string());
+      } else {
+         builder.values.append (sizeof(int), '\0');
+         ++builder.zone.nulls;
+      }
+      return;
+   }
+   if (builder.type == TypeVarChar) {
+      uint32_t len;
+      memcpy (&len, data, sizeof(len));
+      builder.varchars.push_back (string (data + sizeof(len), len));
+      data += sizeof(len) + len;
+      return;
+   }
+   builder.values.append (data, sizeof(int));
+   zoneAdd (builder.zone, builder.type, data);
+   data += sizeof(int);
+}
+
+static bool writeChunk(FILE *file, ColumnBuilder &builder) {
+   ColumnChunk chunk;
+   memset (&chunk, 0, sizeof(chunk));
+   chunk.records = builder.records;
+   chunk.zone = builder.zone;
+   if (builder.type != TypeVarChar) {
+      chunk.bytes = builder.nulls.size() + builder.values.size();
+      return writeBytes (file, &chunk, sizeof(chunk))
+             && writeBytes (file, builder.nulls.data(), builder.nulls.size())
+             && writeBytes (file, builder.values.data(),
+                            builder.values.size());
+   }
+   vector<string> dict;
+   for (unsigned i = 0; i < builder.records; ++i) {
+      if (!isNull (builder.nulls.data(), i)) {
+         dict.push_back (builder.varchars[i]);
+      }
+   }
+   std::sort (dict.begin(), dict.end());
+   dict.erase (std::unique (dict.begin(), dict.end()), dict.end());
+   string payload = builder.nulls;
+   for (unsigned d = 0; d < dict.size(); ++d) {
+      uint32_t len = dict[d].size();
+      payload.append ((const char*) &len, sizeof(len));
+      payload.append (dict[d]);
+   }
+   unsigned bytes = codeBytes (dict.size());
+   for (unsigned i = 0; i < builder.records; ++i) {
+      uint32_t code = 0;
+      if (!isNull (builder.nulls.data(), i)) {
+         code = std::lower_bound (dict.begin(), dict.end(),
+                                  builder.varchars[i]) - dict.begin();
+      }
+      payload.append ((const char*) &code, bytes);
+   }
+   chunk.dictCount = dict.size();
+   chunk.bytes = payload.size();
+   return writeBytes (file, &chunk, sizeof(chunk))
+          && writeBytes (file, payload.data(), payload.size());
+}
+
+static RC readDescriptor(const string &storeName, ColumnHeader &header,
+                         vector<Attribute> &recordDescriptor) {
+   FILE *file = fopen (storeName.c_str(), "rb");
+   if (file == NULL) {
+      RC_MSG (rc::file_does_not_exist, "[store: %s]\n", storeName.c_str());
+      return rc::file_does_not_exist;
+   }
+   bool read = readBytes (file, &header, sizeof(header))
+               && header.magic == COLUMN_MAGIC;
+   recordDescriptor.clear();
+   for (unsigned i = 0; i < header.attrCount && read; ++i) {
+      DumpAttribute attribute;
+      Attribute attr;
+      read = readBytes (file, &attribute, sizeof(attribute))
+             && attribute.nameLength <= PAGE_SIZE;
+      if (!read) break;
+      attr.type = (AttrType) attribute.type;
+      attr.length = attribute.length;
+      attr.name.resize (attribute.nameLength);
+      read = readBytes (file, &attr.name[0], attribute.nameLength);
+      recordDescriptor.push_back (attr);
+   }
+   fclose (file);
+   if (!read) {
+      RC_MSG (rc::file_read_error, "[store: %s]\n", storeName.c_str());
+      return rc::file_read_error;
+   }
+   return rc::success;
+}
+
+// Reads the rest of the chunk of column after its ColumnChunk
+static bool readChunk(ColumnData &column) {
+   const ColumnChunk &chunk = column.chunk;
+   unsigned rows = chunk.records;
+   column.nulls.resize (nullBytes (rows));
+   if (!readBytes (column.file, &column.nulls[0], column.nulls.size())) {
+      return false;
+   }
+   if (column.type != TypeVarChar) {
+      column.values.resize (rows * sizeof(int));
+      return readBytes (column.file, &column.values[0],
+                        column.values.size());
+   }
+   string payload (chunk.bytes - column.nulls.size(), '\0');
+   if (!readBytes (column.file, &payload[0], payload.size())) return false;
+   const char *p = payload.data();
+   const char *end = p + payload.size();
+   column.dict.resize (chunk.dictCount);
+   for (unsigned d = 0; d < chunk.dictCount; ++d) {
+      uint32_t len;
+      if (end - p < (ptrdiff_t) sizeof(len)) return false;
+      memcpy (&len, p, sizeof(len));
+      p += sizeof(len);
+      if ((size_t) (end - p) < len) return false;
+      column.dict[d].assign (p, len);
+      p += len;
+   }
+   unsigned bytes = codeBytes (chunk.dictCount);
+   if ((size_t) (end - p) != (size_t) rows * bytes) return false;
+   column.codes.resize (rows);
+   for (unsigned i = 0; i < rows; ++i) {
+      uint32_t code = 0;
+      memcpy (&code, p + i * bytes, bytes);
+      column.codes[i] = code;
+   }
+   return true;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+RC exportColumns(FileHandle &fileHandle,
+                 const vector<Attribute> &recordDescriptor,
+                 const string &storeName) {
+   lock_guard<HandleLatch> latch (fileHandle.latch());
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   vector<string> attributeNames;
+   vector<ColumnBuilder> builders (recordDescriptor.size());
+   vector<FILE*> files;
+   RC rcode = rc::success;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      attributeNames.push_back (recordDescriptor[i].name);
+      builders[i].type = recordDescriptor[i].type;
+      startChunk (builders[i]);
+      string name = columnName (storeName, i);
+      FILE *file = fopen (name.c_str(), "wb");
+      if (file == NULL) {
+         RC_MSG (rc::file_create_error, "[column: %s]\n", name.c_str());
+         rcode = rc::file_create_error;
+         break;
+      }
+      files.push_back (file);
+   }
+
+   ColumnHeader header;
+   header.magic = COLUMN_MAGIC;
+   header.attrCount = recordDescriptor.size();
+   header.records = 0;
+   RBFM_ScanIterator it;
+   if (rcode == rc::success) {
+      rcode = rbfm->scan (fileHandle, recordDescriptor, "", NO_OP, NULL,
+                          attributeNames, it);
+   }
+   string tuple (tupleMax (recordDescriptor), '\0');
+   RID rid;
+   bool written = true;
+   while (rcode == rc::success && written) {
+      RC next = it.getNextRecord (rid, &tuple[0]);
+      if (next != rc::success && next != RBFM_EOF) {
+         rcode = next;
+         break;
+      }
+      bool end = next == RBFM_EOF;
+      if (!end) {
+         const char *data = tuple.data() + nullBytes (builders.size());
+         for (unsigned i = 0; i < builders.size(); ++i) {
+            if (isNull (tuple.data(), i)) {
+               const char *null = NULL;
+               addValue (builders[i], null);
+            } else {
+               addValue (builders[i], data);
+            }
+         }
+         ++header.records;
+      }
+      unsigned records = builders.empty() ? 0 : builders[0].records;
+      if (records == COLUMN_CHUNK || (end && records > 0)) {
+         for (unsigned i = 0; i < builders.size() && written; ++i) {
+            written = writeChunk (files[i], builders[i]);
+            startChunk (builders[i]);
+         }
+      }
+      if (end) break;
+   }
+   it.close();
+   for (unsigned i = 0; i < files.size(); ++i) {
+      written = fclose (files[i]) == 0 && written;
+   }
+
+   if (rcode == rc::success && written) {
+      FILE *file = fopen (storeName.c_str(), "wb");
+      written = file != NULL && writeBytes (file, &header, sizeof(header));
+      for (unsigned i = 0; i < recordDescriptor.size() && written; ++i) {
+         const Attribute &attr = recordDescriptor[i];
+         DumpAttribute attribute;
+         attribute.type = attr.type;
+         attribute.length = attr.length;
+         attribute.nameLength = attr.name.size();
+         written = writeBytes (file, &attribute, sizeof(attribute))
+                   && writeBytes (file, attr.name.data(), attr.name.size());
+      }
+      if (file != NULL) written = fclose (file) == 0 && written;
+   }
+   if (rcode == rc::success && !written) {
+      RC_MSG (rc::file_write_error, "[store: %s]\n", storeName.c_str());
+      rcode = rc::file_write_error;
+   }
+   if (rcode != rc::success) {
+      // destroyColumns() could not find the files without the store
+      for (unsigned i = 0; i < files.size(); ++i) {
+         remove (columnName (storeName, i).c_str());
+      }
+      remove (storeName.c_str());
+   }
+   return rcode;
+}
+
+RC destroyColumns(const string &storeName) {
+   ColumnHeader header;
+   vector<Attribute> recordDescriptor;
+   RC rcode = readDescriptor (storeName, header, recordDescriptor);
+   if (rcode != rc::success) return rcode;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      remove (columnName (storeName, i).c_str());
+   }
+   if (remove (storeName.c_str()) != 0) {
+      RC_MSG (rc::file_delete_error, "[store: %s]\n", storeName.c_str());
+      return rc::file_delete_error;
+   }
+   return rc::success;
+}
+
+RC scanColumns(const string &storeName, const string &conditionAttribute,
+               const CompOp compOp, const void *value,
+               const vector<string> &attributeNames,
+               ColumnScanIterator &columnScanIterator) {
+   ColumnScanIterator &it = columnScanIterator;
+   it.close();
+   ColumnHeader header;
+   vector<Attribute> recordDescriptor;
+   RC rcode = readDescriptor (storeName, header, recordDescriptor);
+   if (rcode != rc::success) return rcode;
+
+   // the attributes read, each once
+   const Schema &schema = schemaOf (recordDescriptor);
+   vector<unsigned> attrs;
+   for (unsigned i = 0; i <= attributeNames.size(); ++i) {
+      bool condition = i == attributeNames.size();
+      if (condition && compOp == NO_OP) break;
+      const string &name = condition ? conditionAttribute
+                                     : attributeNames[i];
+      int attr = schema.find (name);
+      if (attr < 0) {
+         RC_MSG (rc::attribute_not_found, "[%s]\n", name.c_str());
+         return rc::attribute_not_found;
+      }
+      unsigned position = std::find (attrs.begin(), attrs.end(), attr)
+                          - attrs.begin();
+      if (position == attrs.size()) attrs.push_back (attr);
+      if (condition) {
+         it._condition = position;
+      } else {
+         it._projection.push_back (position);
+      }
+   }
+   for (unsigned i = 0; i < attrs.size(); ++i) {
+      string name = columnName (storeName, attrs[i]);
+      ColumnData column;
+      column.type = recordDescriptor[attrs[i]].type;
+      column.file = fopen (name.c_str(), "rb");
+      if (column.file == NULL) {
+         RC_MSG (rc::file_open_error, "[column: %s]\n", name.c_str());
+         it.close();
+         return rc::file_open_error;
+      }
+      it._columns.push_back (column);
+   }
+   if (it._condition >= 0) {
+      AttrType type = it._columns[it._condition].type;
+      unsigned len = sizeof(int);
+      if (type == TypeVarChar) {
+         uint32_t varcharLen;
+         memcpy (&varcharLen, value, sizeof(varcharLen));
+         len += varcharLen;
+      }
+      it._value.assign ((const char*) value, len);
+   }
+   it._compOp = compOp;
+   it._left = header.records;
+   return rc::success;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+ColumnScanIterator::ColumnScanIterator() {
+   _condition = -1;
+   _compOp = NO_OP;
+   _left = 0;
+   _rows = 0;
+   _row = 0;
+   _skipped = 0;
+}
+
+ColumnScanIterator::~ColumnScanIterator() {
+   close();
+}
+
+RC ColumnScanIterator::close() {
+   for (unsigned i = 0; i < _columns.size(); ++i) fclose (_columns[i].file);
+   _columns.clear();
+   _projection.clear();
+   _condition = -1;
+   _compOp = NO_OP;
+   _value.clear();
+   _left = 0;
+   _rows = 0;
+   _row = 0;
+   _skipped = 0;
+   return rc::success;
+}
+
+// Reads the next chunk that may hold matching records
+// RETURNS: RBFM_EOF after the last one
+RC ColumnScanIterator::nextChunk() {
+   while (_left > 0) {
+      for (unsigned i = 0; i < _columns.size(); ++i) {
+         if (!readBytes (_columns[i].file, &_columns[i].chunk,
+                         sizeof(ColumnChunk))) {
+            RC_MSG (rc::file_read_error, "[column: %u]\n", i);
+            return rc::file_read_error;
+         }
+      }
+      unsigned records = _columns.empty()
+                         ? std::min (_left, (uint64_t) COLUMN_CHUNK)
+                         : _columns[0].chunk.records;
+      _left -= std::min ((uint64_t) records, _left);
+      _row = 0;
+      bool skip = false;
+      if (_condition >= 0) {
+         ColumnData &column = _columns[_condition];
+         if (column.type != TypeVarChar) {
+            skip = zoneExcludes (column.chunk.zone, column.type, _compOp,
+                                 _value.data());
+         } else {
+            // the condition is tested once per distinct value
+            if (!readChunk (column)) {
+               RC_MSG (rc::file_read_error, "[column: %d]\n", _condition);
+               return rc::file_read_error;
+            }
+            column.matches.assign (column.dict.size(), false);
+            skip = true;
+            for (unsigned d = 0; d < column.dict.size(); ++d) {
+               column.matches[d] = compareField (TypeVarChar,
+                                                 column.dict[d].data(),
+                                                 column.dict[d].size(),
+                                                 _compOp, _value.data());
+               skip = skip && !column.matches[d];
+            }
+         }
+      }
+      for (unsigned i = 0; i < _columns.size(); ++i) {
+         ColumnData &column = _columns[i];
+         bool read = column.type == TypeVarChar && (int) i == _condition;
+         if (skip && !read) {
+            if (fseek (column.file, column.chunk.bytes, SEEK_CUR) != 0) {
+               RC_MSG (rc::file_read_error, "[column: %u]\n", i);
+               return rc::file_read_error;
+            }
+         } else if (!read && !readChunk (column)) {
+            RC_MSG (rc::file_read_error, "[column: %u]\n", i);
+            return rc::file_read_error;
+         }
+      }
+      if (!skip) {
+         _rows = records;
+         return rc::success;
+      }
+      ++_skipped;
+   }
+   return RBFM_EOF;
+}
+
+bool ColumnScanIterator::matches(unsigned row) const {
+   if (_condition < 0) return true;
+   const ColumnData &column = _columns[_condition];
+   if (isNull (column.nulls.data(), row)) return false;
+   if (column.type == TypeVarChar) return column.matches[column.codes[row]];
+   return compareField (column.type,
+                        column.values.data() + row * sizeof(int),
+                        sizeof(int), _compOp, _value.data());
+}
+
+RC ColumnScanIterator::getNextRecord(void *data) {
+   while (true) {
+      if (_row == _rows) {
+         RC rcode = nextChunk();
+         if (rcode != rc::success) return rcode;
+         continue;
+      }
+      unsigned row = _row++;
+      if (!matches (row)) continue;
+      char *out = (char*) data;
+      unsigned projBytes = nullBytes (_projection.size());
+      memset (out, 0, projBytes);
+      out += projBytes;
+      for (unsigned i = 0; i < _projection.size(); ++i) {
+         const ColumnData &column = _columns[_projection[i]];
+         if (isNull (column.nulls.data(), row)) {
+            setNull ((char*) data, i);
+         } else if (column.type != TypeVarChar) {
+            memcpy (out, column.values.data() + row * sizeof(int),
+                    sizeof(int));
+            out += sizeof(int);
+         } else {
+            const string &value = column.dict[column.codes[row]];
+            uint32_t len = value.size();
+            memcpy (out, &len, sizeof(len));
+            memcpy (out + sizeof(len), value.data(), len);
+            out += sizeof(len) + len;
+         }
+      }
+      return rc::success;
+   }
+}
@@ -0,0 +1,111 @@
+#ifndef _column_h_
+#define _column_h_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../rbf/zonemap.h"
+
+// Column stores: a copy of the records of a file, one file per
+// attribute, for analytics. A scan reads only the files of the
+// attributes it projects or tests, and skips the chunks whose values
+// cannot satisfy its condition.
+//
+// exportColumns() writes the store named C as the file C, holding a
+// ColumnHeader and the descriptor (as a DumpAttribute (dump.h) and its
+// name per attribute), and the files C.0 to C.(n-1), one per attribute.
+// The values of an attribute are cut in chunks of COLUMN_CHUNK records,
+// the chunk k of every file holding the same records. A chunk is a
+// ColumnChunk, then a null bitmap of its records, then:
+//  - TypeInt / TypeReal: one 4 byte value per record (0 if null), the
+//    min and the max of the chunk are its zone (zonemap.h),
+//  - TypeVarChar: the sorted distinct values of the chunk, each a
+//    uint32_t length and its bytes, so the first one is the min and the
+//    last one the max, then the position of each record's value among
+//    them, on 1, 2 or 4 bytes as the number of values needs.
+// exportColumns() holds the latch of the file meanwhile, like
+// exportFile(): the store is a consistent copy of the file. It is not
+// kept up to date with the file: export it again.
+
+const uint32_t COLUMN_MAGIC = 0x434f4c31;    // "COL1"
+
+// records per chunk, fits Zone::count
+const unsigned COLUMN_CHUNK = 32768;
+
+struct ColumnHeader {
+    uint32_t magic;
+    uint32_t attrCount;
+    uint64_t records;
+};
+
+struct ColumnChunk {
+    uint32_t records;
+    uint32_t bytes;        // that follow, null bitmap included
+    uint32_t dictCount;    // distinct values of a TypeVarChar chunk
+    Zone zone;             // of a TypeInt / TypeReal chunk
+};
+
+// The chunk of an attribute read by a scan
+struct ColumnData {
+    FILE *file;
+    AttrType type;
+    ColumnChunk chunk;
+    string nulls;
+    string values;             // TypeInt / TypeReal
+    vector<string> dict;       // TypeVarChar
+    vector<uint32_t> codes;    // of each record in dict
+    vector<bool> matches;      // the dict values satisfying the condition
+};
+
+class ColumnScanIterator {
+public:
+  ColumnScanIterator();
+  ~ColumnScanIterator();
+
+  // data is the projection, as RBFM_ScanIterator::getNextRecord()
+  RC getNextRecord(void *data);
+  RC close();
+
+  // RETURNS: the chunks skipped so far
+  uint64_t skipped() const { return _skipped; }
+
+private:
+  friend RC scanColumns(const string &storeName,
+                        const string &conditionAttribute,
+                        const CompOp compOp, const void *value,
+                        const vector<string> &attributeNames,
+                        ColumnScanIterator &columnScanIterator);
+
+  ColumnScanIterator(const ColumnScanIterator&) = delete;
+  ColumnScanIterator& operator=(const ColumnScanIterator&) = delete;
+
+  RC nextChunk();
+  bool matches(unsigned row) const;
+
+  vector<ColumnData> _columns;  // the attributes read
+  vector<unsigned> _projection; // position in _columns of each projected
+  int _condition;               // position in _columns, -1 if none
+  CompOp _compOp;
+  string _value;
+  uint64_t _left;               // records of the chunks not read yet
+  unsigned _rows;               // records of the chunks read
+  unsigned _row;                // next one
+  uint64_t _skipped;
+};
+
+RC exportColumns(FileHandle &fileHandle,
+                 const vector<Attribute> &recordDescriptor,
+                 const string &storeName);
+RC destroyColumns(const string &storeName);
+
+// Like RecordBasedFileManager::scan() on the store, in the order of the
+// export
+RC scanColumns(const string &storeName, const string &conditionAttribute,
+               const CompOp compOp, const void *value,
+               const vector<string> &attributeNames,
+               ColumnScanIterator &columnScanIterator);
+
+#endif
@@ -0,0 +1,333 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpage.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+static unsigned bitWidth(uint32_t range) {
+   unsigned width = 0;
+   while (range) {
+      ++width;
+      range >>= 1;
+   }
+   return width;
+}
+
+// dictionary codes of a page with count entries
+static unsigned codeBytes(unsigned count) {
+   return count + 1 <= 0xFF + 1 ? 1 : 2;
+}
+
+static void putCode(string &out, unsigned code, unsigned bytes) {
+   out.push_back ((char) (code & 0xFF));
+   if (bytes == 2) out.push_back ((char) (code >> 8));
+}
+
+static unsigned getCode(const unsigned char *&in, unsigned bytes) {
+   unsigned code = in[0];
+   if (bytes == 2) code |= in[1] << 8;
+   in += bytes;
+   return code;
+}
+
+// little-endian bit stream, LSB first
+struct BitWriter {
+   string &out;
+   uint64_t acc;
+   unsigned bits;
+
+   BitWriter(string &o) : out (o), acc (0), bits (0) {}
+   void put(uint32_t value, unsigned width) {
+      if (width == 0) return;
+      acc |= (uint64_t) value << bits;
+      bits += width;
+      while (bits >= 8) {
+         out.push_back ((char) (acc & 0xFF));
+         acc >>= 8;
+         bits -= 8;
+      }
+   }
+   void flush() {
+      if (bits > 0) out.push_back ((char) (acc & 0xFF));
+      acc = 0;
+      bits = 0;
+   }
+};
+
+struct BitReader {
+   const unsigned char *&in;
+   uint64_t acc;
+   unsigned bits;
+
+   BitReader(const unsigned char *&i) : in (i), acc (0), bits (0) {}
+   uint32_t get(unsigned width) {
+      if (width == 0) return 0;
+      while (bits < width) {
+         acc |= (uint64_t) *in++ << bits;
+         bits += 8;
+      }
+      uint32_t value = (uint32_t) (acc & ((((uint64_t) 1) << width) - 1));
+      acc >>= width;
+      bits -= width;
+      return value;
+   }
+};
+
+
+//
+// PAGE ENCODING
+//
+
+void cpageDecode(char *page, const vector<Attribute> &recordDescriptor,
+                 vector<PageEntry> &entries) {
+   CPageContext context;
+   context.load (page, recordDescriptor);
+   unsigned numSlots = pageFooter (page)->numSlots;
+   entries.resize (numSlots);
+   for (unsigned i = 0; i < numSlots; ++i) {
+      Slot *slot = pageSlot (page, i);
+      PageEntry &entry = entries[i];
+      entry.used = slot->offset != SLOT_EMPTY;
+      entry.flags = slot->length & ~SLOT_LEN_MASK;
+      entry.cell.clear();
+      if (!entry.used) continue;
+      if (entry.flags & SLOT_FORWARD) {
+         entry.cell.assign (pageCell (page, i), sizeof(ForwardRef));
+      } else {
+         context.decode (pageCell (page, i), entry.cell);
+      }
+   }
+   while (!entries.empty() && !entries.back().used) entries.pop_back();
+}
+
+bool cpageEncode(const vector<PageEntry> &entries,
+                 const vector<Attribute> &recordDescriptor, char *page) {
+   unsigned fieldCount = recordDescriptor.size();
+   vector<int32_t> mins (fieldCount, 0), maxs (fieldCount, 0);
+   vector<bool> seen (fieldCount, false);
+   vector<vector<string>> dicts (fieldCount);
+
+   // gather the values of the page
+   for (unsigned e = 0; e < entries.size(); ++e) {
+      const PageEntry &entry = entries[e];
+      if (!entry.used || (entry.flags & SLOT_FORWARD)) continue;
+      const char *record = entry.cell.data();
+      for (unsigned i = 0; i < fieldCount; ++i) {
+         if (isNull (recordNulls (record), i)) continue;
+         unsigned begin, end;
+         bool overflow;
+         fieldBounds (record, i, begin, end, overflow);
+         if (recordDescriptor[i].type == TypeInt) {
+            int32_t value;
+            memcpy (&value, record + begin, sizeof(value));
+            mins[i] = seen[i] ? std::min (mins[i], value) : value;
+            maxs[i] = seen[i] ? std::max (maxs[i], value) : value;
+            seen[i] = true;
+         } else if (recordDescriptor[i].type == TypeVarChar && !overflow) {
+            dicts[i].push_back (string (record + begin, end - begin));
+         }
+      }
+   }
+
+   // context
+   string context;
+   vector<uint8_t> widths (fieldCount, 0);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      if (recordDescriptor[i].type == TypeInt) {
+         widths[i] = bitWidth ((uint32_t) maxs[i] - (uint32_t) mins[i]);
+         context.append ((const char*) &mins[i], sizeof(int32_t));
+         context.push_back ((char) widths[i]);
+      } else if (recordDescriptor[i].type == TypeVarChar) {
+         vector<string> &dict = dicts[i];
+         std::sort (dict.begin(), dict.end());
+         dict.erase (std::unique (dict.begin(), dict.end()), dict.end());
+         if (dict.size() > 0xFFFF - 1) return false;
+         uint16_t count = dict.size();
+         context.append ((const char*) &count, sizeof(count));
+         for (unsigned d = 0; d < dict.size(); ++d) {
+            unsigned prefix = 0;
+            if (d > 0) {
+               const string &prev = dict[d - 1];
+               while (prefix < 0xFF && prefix < prev.size()
+                      && prefix < dict[d].size()
+                      && prev[prefix] == dict[d][prefix]) {
+                  ++prefix;
+               }
+            }
+            uint16_t suffixLen = dict[d].size() - prefix;
+            context.push_back ((char) prefix);
+            context.append ((const char*) &suffixLen, sizeof(suffixLen));
+            context.append (dict[d], prefix, suffixLen);
+         }
+      }
+   }
+
+   // cells
+   unsigned size = context.size() + sizeof(PageFooter)
+                   + entries.size() * sizeof(Slot);
+   vector<string> cells (entries.size());
+   for (unsigned e = 0; e < entries.size(); ++e) {
+      const PageEntry &entry = entries[e];
+      if (!entry.used) continue;
+      string &cell = cells[e];
+      if (entry.flags & SLOT_FORWARD) {
+         cell = entry.cell;
+      } else {
+         const char *record = entry.cell.data();
+         const char *nulls = recordNulls (record);
+         cell.assign (nulls, nullBytes (fieldCount));
+         BitWriter bits (cell);
+         for (unsigned i = 0; i < fieldCount; ++i) {
+            if (recordDescriptor[i].type != TypeInt || isNull (nulls, i)) {
+               continue;
+            }
+            unsigned begin, end;
+            bool overflow;
+            fieldBounds (record, i, begin, end, overflow);
+            int32_t value;
+            memcpy (&value, record + begin, sizeof(value));
+            bits.put ((uint32_t) value - (uint32_t) mins[i], widths[i]);
+         }
+         bits.flush();
+         for (unsigned i = 0; i < fieldCount; ++i) {
+            if (recordDescriptor[i].type == TypeInt || isNull (nulls, i)) {
+               continue;
+            }
+            unsigned begin, end;
+            bool overflow;
+            fieldBounds (record, i, begin, end, overflow);
+            if (recordDescriptor[i].type == TypeReal) {
+               cell.append (record + begin, sizeof(float));
+               continue;
+            }
+            const vector<string> &dict = dicts[i];
+            unsigned bytes = codeBytes (dict.size());
+            if (overflow) {
+               putCode (cell, dict.size(), bytes);
+               cell.append (record + begin, sizeof(OverflowRef));
+            } else {
+               string value (record + begin, end - begin);
+               putCode (cell, std::lower_bound (dict.begin(), dict.end(),
+                                                value) - dict.begin(),
+                        bytes);
+            }
+         }
+      }
+      size += std::max ((unsigned) cell.size(), MIN_CELL);
+   }
+   if (size > PAGE_SIZE) return false;
+
+   char *tmp = (char*) malloc (PAGE_SIZE);
+   memset (tmp, 0, PAGE_SIZE);
+   memcpy (tmp + PAGE_SIZE - sizeof(PageFooter), pageFooter (page),
+           sizeof(PageFooter));
+   PageFooter *footer = pageFooter (tmp);
+   footer->numSlots = entries.size();
+   footer->headerLen = context.size();
+   memcpy (tmp, context.data(), context.size());
+   unsigned offset = context.size();
+   for (unsigned e = 0; e < entries.size(); ++e) {
+      Slot *slot = pageSlot (tmp, e);
+      if (!entries[e].used) {
+         slot->offset = SLOT_EMPTY;
+         slot->length = 0;
+         continue;
+      }
+      unsigned cellLen = std::max ((unsigned) cells[e].size(), MIN_CELL);
+      memcpy (tmp + offset, cells[e].data(), cells[e].size());
+      slot->offset = offset;
+      slot->length = cellLen | entries[e].flags;
+      offset += cellLen;
+   }
+   footer->freeOffset = offset;
+   memcpy (page, tmp, PAGE_SIZE);
+   free (tmp);
+   return true;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+void CPageContext::load(char *page,
+                        const vector<Attribute> &recordDescriptor) {
+   descriptor = recordDescriptor;
+   columns.resize (recordDescriptor.size());
+   const char *in = page;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      Column &column = columns[i];
+      column.dict.clear();
+      if (recordDescriptor[i].type == TypeInt) {
+         memcpy (&column.base, in, sizeof(column.base));
+         column.width = (uint8_t) in[sizeof(column.base)];
+         in += sizeof(column.base) + 1;
+      } else if (recordDescriptor[i].type == TypeVarChar) {
+         uint16_t count;
+         memcpy (&count, in, sizeof(count));
+         in += sizeof(count);
+         column.dict.resize (count);
+         for (unsigned d = 0; d < count; ++d) {
+            unsigned prefix = (unsigned char) in[0];
+            uint16_t suffixLen;
+            memcpy (&suffixLen, in + 1, sizeof(suffixLen));
+            in += 1 + sizeof(suffixLen);
+            if (prefix > 0) column.dict[d].assign (column.dict[d - 1], 0,
+                                                   prefix);
+            column.dict[d].append (in, suffixLen);
+            in += suffixLen;
+         }
+      }
+   }
+}
+
+void CPageContext::decode(const char *cell, string &record) const {
+   unsigned fieldCount = descriptor.size();
+   const char *nulls = cell;
+   const unsigned char *in =
+      (const unsigned char*) cell + nullBytes (fieldCount);
+
+   record.assign (recordHeaderSize (fieldCount), 0);
+   put16 (&record[0], fieldCount);
+   memcpy (&record[sizeof(uint16_t)], nulls, nullBytes (fieldCount));
+   unsigned endsAt = sizeof(uint16_t) + nullBytes (fieldCount);
+
+   // ints first, they share one bit stream
+   vector<int32_t> ints (fieldCount, 0);
+   BitReader bits (in);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      if (descriptor[i].type != TypeInt || isNull (nulls, i)) continue;
+      ints[i] = (int32_t) ((uint32_t) columns[i].base
+                           + bits.get (columns[i].width));
+   }
+
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      uint16_t flag = 0;
+      if (isNull (nulls, i)) {
+         // no bytes
+      } else if (descriptor[i].type == TypeInt) {
+         record.append ((const char*) &ints[i], sizeof(int32_t));
+      } else if (descriptor[i].type == TypeReal) {
+         record.append ((const char*) in, sizeof(float));
+         in += sizeof(float);
+      } else {
+         const vector<string> &dict = columns[i].dict;
+         unsigned code = getCode (in, codeBytes (dict.size()));
+         if (code == dict.size()) {
+            record.append ((const char*) in, sizeof(OverflowRef));
+            in += sizeof(OverflowRef);
+            flag = FIELD_OVERFLOW;
+         } else {
+            record.append (dict[code]);
+         }
+      }
+      put16 (&record[endsAt + i * sizeof(uint16_t)], record.size() | flag);
+   }
+}
+
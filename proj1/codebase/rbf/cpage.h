@@ -0,0 +1,62 @@
+#ifndef _cpage_h_
+#define _cpage_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../rbf/page.h"
+
+// Compressed data pages (files created with RBFM_COMPRESSED).
+//
+//   [context][cells ->         free space        <- slot directory][footer]
+//
+// footer.headerLen is the length of the context. The context holds
+// what the cells of the page are encoded against, for each attribute:
+//   TypeInt:     [int32 base][uint8 width]  frame of reference, a value
+//                is stored as (value - base) in width bits
+//   TypeReal:    nothing, reals are stored as is
+//   TypeVarChar: [uint16 count][count dictionary entries]
+//                the distinct values of the page, sorted and front
+//                coded: entry = [uint8 prefix][uint16 suffixLen][suffix]
+//                where prefix is the length shared with the entry before
+//
+// A record cell is
+//   [null bitmap][bit packed ints][reals][VarChar codes]
+// VarChar codes are 1 byte if the dictionary has less than 255 entries,
+// 2 bytes otherwise. The code equal to the dictionary size is an escape:
+// the OverflowRef of a spilled value follows it. Forwarding cells are
+// stored as is.
+//
+// The page is re-encoded as a whole whenever one of its cells changes,
+// so the cells are packed and the context never holds dead values
+// (rbfm.cc decodes, modifies and encodes). Reading a cell only decodes
+// that cell.
+
+// Decoded context of a compressed page. Load it once per page and
+// decode as many of its cells as needed.
+struct CPageContext {
+    struct Column {
+        int32_t base;
+        uint8_t width;
+        vector<string> dict;
+    };
+    vector<Attribute> descriptor;
+    vector<Column> columns;
+
+    void load(char *page, const vector<Attribute> &recordDescriptor);
+
+    // Rebuilds the internal record of a (non forwarding) cell
+    void decode(const char *cell, string &record) const;
+};
+
+// Decodes every slot of the page to internal records
+void cpageDecode(char *page, const vector<Attribute> &recordDescriptor,
+                 vector<PageEntry> &entries);
+
+// Encodes the entries into page, keeping its footer.
+// RETURNS: false if they do not fit, the page is left untouched
+bool cpageEncode(const vector<PageEntry> &entries,
+                 const vector<Attribute> &recordDescriptor, char *page);
+
+#endif
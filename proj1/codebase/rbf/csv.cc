@@ -0,0 +1,260 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csv.h"
+#include "page.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// A load shared by the parsing threads
+struct CsvLoad {
+    FileHandle *fileHandle;
+    const vector<Attribute> *recordDescriptor;
+    CsvOptions options;
+    vector<pair<const char*, const char*> > chunks;
+    atomic<unsigned> next;     // chunk to parse
+    mutex latch;               // of the fields below
+    condition_variable turn;
+    unsigned loaded;           // chunks appended, in order
+    RC error;                  // first error of bulkAppend()
+    uint64_t records;
+    uint64_t rejected;
+};
+
+static bool parseInt(const char *p, const char *end, int32_t &value) {
+   bool negative = p != end && *p == '-';
+   if (p != end && (*p == '-' || *p == '+')) ++p;
+   if (p == end) return false;
+   int64_t v = 0;
+   for (; p != end; ++p) {
+      if (*p < '0' || *p > '9') return false;
+      v = v * 10 + (*p - '0');
+      if (v > (int64_t) INT32_MAX + 1) return false;
+   }
+   if (negative) v = -v;
+   if (v > INT32_MAX) return false;
+   value = v;
+   return true;
+}
+
+static bool parseReal(const char *p, const char *end, float &value) {
+   char bytes[64];
+   unsigned len = end - p;
+   if (len == 0 || len >= sizeof(bytes)) return false;
+   memcpy (bytes, p, len);
+   bytes[len] = '\0';
+   char *last;
+   value = strtof (bytes, &last);
+   return last == bytes + len;
+}
+
+// Appends the record of the line [p, end) in the API format to record
+// RETURNS: false if the line does not match the descriptor, record is
+// left as it was
+static bool parseLine(const char *p, const char *end,
+                      const vector<Attribute> &recordDescriptor,
+                      const CsvOptions &options, string &scratch,
+                      string &record) {
+   size_t start = record.size();
+   record.append (nullBytes (recordDescriptor.size()), '\0');
+   unsigned i = 0;
+   for (; i < recordDescriptor.size(); ++i) {
+      if (i > 0) {
+         if (p == end || *p != options.delimiter) break;
+         ++p;
+      }
+      const char *fieldBegin = p;
+      const char *fieldEnd;
+      bool quoted = p != end && *p == options.quote;
+      if (quoted) {
+         scratch.clear();
+         for (++p; p != end; ++p) {
+            if (*p != options.quote) {
+               scratch.push_back (*p);
+            } else if (p + 1 != end && p[1] == options.quote) {
+               scratch.push_back (*p++);
+            } else {
+               break;
+            }
+         }
+         if (p == end) break;     // no closing quote
+         ++p;
+         fieldBegin = scratch.data();
+         fieldEnd = fieldBegin + scratch.size();
+      } else {
+         const char *delimiter = (const char*) memchr (p, options.delimiter,
+                                                       end - p);
+         p = delimiter != NULL ? delimiter : end;
+         fieldEnd = p;
+      }
+      if (!quoted && fieldBegin == fieldEnd) {
+         setNull (&record[start], i);
+         continue;
+      }
+      const Attribute &attr = recordDescriptor[i];
+      uint32_t len = fieldEnd - fieldBegin;
+      if (attr.type == TypeInt) {
+         int32_t value;
+         if (!parseInt (fieldBegin, fieldEnd, value)) break;
+         record.append ((const char*) &value, sizeof(value));
+      } else if (attr.type == TypeReal) {
+         float value;
+         if (!parseReal (fieldBegin, fieldEnd, value)) break;
+         record.append ((const char*) &value, sizeof(value));
+      } else {
+         if (len > attr.length) break;
+         record.append ((const char*) &len, sizeof(len));
+         record.append (fieldBegin, len);
+      }
+   }
+   if (i == recordDescriptor.size() && p == end) return true;
+   record.resize (start);
+   return false;
+}
+
+// Parses chunks and appends their records, until there are no more
+static void loadChunks(CsvLoad &load) {
+   string batch;               // records of the chunk, back to back
+   string scratch;
+   vector<unsigned> offsets;   // of each record in batch
+   vector<const void*> records;
+   vector<RID> rids;
+   while (true) {
+      unsigned c = load.next++;
+      if (c >= load.chunks.size()) return;
+      batch.clear();
+      offsets.clear();
+      uint64_t rejected = 0;
+      const char *p = load.chunks[c].first;
+      const char *end = load.chunks[c].second;
+      while (p != end) {
+         const char *lineEnd = (const char*) memchr (p, '\n', end - p);
+         const char *next = lineEnd != NULL ? lineEnd + 1 : end;
+         if (lineEnd == NULL) lineEnd = end;
+         if (lineEnd != p && lineEnd[-1] == '\r') --lineEnd;
+         if (lineEnd != p) {
+            size_t offset = batch.size();
+            if (parseLine (p, lineEnd, *load.recordDescriptor, load.options,
+                           scratch, batch)) {
+               offsets.push_back (offset);
+            } else {
+               ++rejected;
+            }
+         }
+         p = next;
+      }
+      records.clear();
+      for (unsigned i = 0; i < offsets.size(); ++i) {
+         records.push_back (batch.data() + offsets[i]);
+      }
+
+      unique_lock<mutex> latch (load.latch);
+      load.turn.wait (latch, [&load, c]() { return load.loaded == c; });
+      RC rcode = load.error;
+      latch.unlock();
+      if (rcode == rc::success && !records.empty()) {
+         rcode = RecordBasedFileManager::instance()->bulkAppend (
+                    *load.fileHandle, *load.recordDescriptor, records, rids);
+      }
+      latch.lock();
+      if (load.error == rc::success) load.error = rcode;
+      if (rcode == rc::success) {
+         load.records += records.size();
+         load.rejected += rejected;
+      }
+      ++load.loaded;
+      load.turn.notify_all();
+   }
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+RC loadCsv(FileHandle &fileHandle,
+           const vector<Attribute> &recordDescriptor,
+           const string &csvName, const CsvOptions &options,
+           CsvResult &result) {
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   memset (&result, 0, sizeof(result));
+   int fd = open (csvName.c_str(), O_RDONLY);
+   struct stat csvStat;
+   if (fd < 0 || fstat (fd, &csvStat) != 0) {
+      if (fd >= 0) close (fd);
+      RC_MSG (rc::file_open_error, "[csv: %s]\n", csvName.c_str());
+      return rc::file_open_error;
+   }
+   size_t size = csvStat.st_size;
+   const char *text = NULL;
+   if (size > 0) {
+      void *map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+         close (fd);
+         RC_MSG (rc::file_read_error, "[csv: %s]\n", csvName.c_str());
+         return rc::file_read_error;
+      }
+      madvise (map, size, MADV_SEQUENTIAL);
+      text = (const char*) map;
+   }
+   close (fd);
+
+   CsvLoad load;
+   load.fileHandle = &fileHandle;
+   load.recordDescriptor = &recordDescriptor;
+   load.options = options;
+   load.next = 0;
+   load.loaded = 0;
+   load.error = rc::success;
+   load.records = 0;
+   load.rejected = 0;
+
+   // chunks end at line ends
+   const char *p = text;
+   const char *end = text + size;
+   if (options.header && p != end) {
+      const char *lineEnd = (const char*) memchr (p, '\n', end - p);
+      p = lineEnd != NULL ? lineEnd + 1 : end;
+   }
+   while (p != end) {
+      const char *chunkEnd = end;
+      if ((size_t) (end - p) > CSV_CHUNK) {
+         const char *lineEnd = (const char*) memchr (p + CSV_CHUNK, '\n',
+                                                     end - p - CSV_CHUNK);
+         if (lineEnd != NULL) chunkEnd = lineEnd + 1;
+      }
+      load.chunks.push_back (make_pair (p, chunkEnd));
+      p = chunkEnd;
+   }
+
+   unsigned threads = options.threads;
+   if (threads == 0) threads = std::max (thread::hardware_concurrency(), 1u);
+   threads = std::min (threads, (unsigned) load.chunks.size());
+   vector<thread> workers;
+   for (unsigned i = 1; i < threads; ++i) {
+      workers.push_back (thread (loadChunks, ref (load)));
+   }
+   loadChunks (load);
+   for (unsigned i = 0; i < workers.size(); ++i) workers[i].join();
+   if (text != NULL) munmap ((void*) text, size);
+
+   result.records = load.records;
+   result.rejected = load.rejected;
+   result.bytes = size;
+   result.seconds = chrono::duration<double> (chrono::steady_clock::now()
+                                              - start).count();
+   return load.error;
+}
@@ -0,0 +1,50 @@
+#ifndef _csv_h_
+#define _csv_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Loading of delimited text (CSV) into a record file.
+//
+// loadCsv() maps the text file and cuts it into chunks of about
+// CSV_CHUNK bytes at line ends. Threads parse the chunks into records of
+// the API format at the same time, and each chunk is loaded with
+// bulkAppend() once the ones before it are: the records are loaded in
+// the order of the text.
+//
+// A line is a record: its fields, separated by the delimiter, are the
+// attributes of the descriptor in order. A field may be quoted, to hold
+// delimiters, and a quote is doubled inside a quoted field; it may not
+// hold a line end. An empty unquoted field is a null, "" an empty
+// VarChar. An Int is a sign and decimal digits, a Real is read by
+// strtof(). A line with another number of fields, a number that does
+// not parse or a VarChar longer than its attribute is rejected: it is
+// counted and left out. A trailing '\r' and empty lines are ignored.
+
+const unsigned CSV_CHUNK = 4 * 1024 * 1024;
+
+struct CsvOptions {
+    char delimiter;
+    char quote;
+    bool header;           // the first line names the fields, skip it
+    unsigned threads;      // parsing, 0 for one per core
+
+    CsvOptions() : delimiter (','), quote ('"'), header (false),
+                   threads (0) {}
+};
+
+struct CsvResult {
+    uint64_t records;      // loaded
+    uint64_t rejected;     // lines left out
+    uint64_t bytes;        // of the text
+    double seconds;
+};
+
+RC loadCsv(FileHandle &fileHandle,
+           const vector<Attribute> &recordDescriptor,
+           const string &csvName, const CsvOptions &options,
+           CsvResult &result);
+
+#endif
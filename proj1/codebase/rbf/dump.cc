@@ -0,0 +1,280 @@
+#include <mutex>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "page.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+static bool writeFrame(FILE *stream, const void *bytes, uint32_t len) {
+   return writeBytes (stream, &len, sizeof(len))
+          && writeBytes (stream, bytes, len);
+}
+
+static RC writePages(FileHandle &fileHandle, FILE *stream,
+                     uint64_t &frames) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   for (PageNum i = 0; i < fileHandle.getNumberOfPages(); ++i) {
+      rcode = fileHandle.readPage (i, page);
+      if (rcode != rc::success) break;
+      if (!writeFrame (stream, page, PAGE_SIZE)) {
+         RC_MSG (rc::file_write_error, "[pageNum: %d]\n", i);
+         rcode = rc::file_write_error;
+         break;
+      }
+      ++frames;
+   }
+   free (page);
+   return rcode;
+}
+
+static RC writeRecords(FileHandle &fileHandle,
+                       const vector<Attribute> &recordDescriptor,
+                       FILE *stream, uint64_t &frames) {
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   vector<string> attributeNames;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      attributeNames.push_back (recordDescriptor[i].name);
+   }
+   RBFM_ScanIterator it;
+   RC rcode = rbfm->scan (fileHandle, recordDescriptor, "", NO_OP, NULL,
+                          attributeNames, it);
+   if (rcode != rc::success) return rcode;
+   string data (tupleMax (recordDescriptor), '\0');
+   RID rid;
+   while ((rcode = it.getNextRecord (rid, &data[0])) == rc::success) {
+      if (!writeFrame (stream, data.data(),
+                       tupleSize (recordDescriptor, data.data()))) {
+         RC_MSG (rc::file_write_error, "[pageNum: %d, slotNum: %d]\n",
+                 rid.pageNum, rid.slotNum);
+         rcode = rc::file_write_error;
+         break;
+      }
+      ++frames;
+   }
+   it.close();
+   // a record that cannot be read fails the export
+   return rcode == RBFM_EOF ? rc::success : rcode;
+}
+
+// POST: len is the length of the next frame, DUMP_END after the last
+static RC readFrameLength(FILE *stream, uint32_t maxLength, uint32_t &len) {
+   if (!readBytes (stream, &len, sizeof(len))
+       || (len != DUMP_END && len > maxLength)) {
+      RC_MSG (rc::not_a_dump, "[frame length: %u]\n", len);
+      return rc::not_a_dump;
+   }
+   return rc::success;
+}
+
+// The frames of a DUMP_PAGES stream into an empty paged file
+static RC readPages(FILE *stream, FileHandle &fileHandle,
+                    uint64_t &frames) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   while (rcode == rc::success) {
+      uint32_t len;
+      rcode = readFrameLength (stream, PAGE_SIZE, len);
+      if (rcode != rc::success || len == DUMP_END) break;
+      if (len != PAGE_SIZE || !readBytes (stream, page, len)) {
+         RC_MSG (rc::not_a_dump, "[page frame: %llu]\n",
+                 (unsigned long long) frames);
+         rcode = rc::not_a_dump;
+         break;
+      }
+      rcode = fileHandle.appendPage (page);
+      ++frames;
+   }
+   free (page);
+   return rcode;
+}
+
+// The frames of a DUMP_RECORDS stream appended to a record file, in
+// batches of DUMP_BATCH records
+static RC readRecords(FILE *stream, FileHandle &fileHandle,
+                      const vector<Attribute> &recordDescriptor,
+                      uint64_t &frames) {
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   uint32_t maxLength = tupleMax (recordDescriptor);
+   string batch;              // the records, back to back
+   vector<unsigned> offsets;  // of each record in batch
+   vector<const void*> records;
+   vector<RID> rids;
+   bool end = false;
+   RC rcode = rc::success;
+   while (!end && rcode == rc::success) {
+      batch.clear();
+      offsets.clear();
+      while (offsets.size() < DUMP_BATCH) {
+         uint32_t len;
+         rcode = readFrameLength (stream, maxLength, len);
+         if (rcode != rc::success) break;
+         if (len == DUMP_END) {
+            end = true;
+            break;
+         }
+         offsets.push_back (batch.size());
+         batch.resize (batch.size() + len);
+         if (!readBytes (stream, &batch[offsets.back()], len)) {
+            RC_MSG (rc::not_a_dump, "[record frame: %llu]\n",
+                    (unsigned long long) frames);
+            rcode = rc::not_a_dump;
+            break;
+         }
+         ++frames;
+      }
+      if (rcode != rc::success || offsets.empty()) break;
+      records.clear();
+      for (unsigned i = 0; i < offsets.size(); ++i) {
+         records.push_back (batch.data() + offsets[i]);
+      }
+      rcode = rbfm->bulkAppend (fileHandle, recordDescriptor, records, rids);
+   }
+   return rcode;
+}
+
+static RC readDescriptor(FILE *stream, const DumpHeader &header,
+                         vector<Attribute> &recordDescriptor) {
+   recordDescriptor.clear();
+   for (unsigned i = 0; i < header.attrCount; ++i) {
+      DumpAttribute attribute;
+      if (!readBytes (stream, &attribute, sizeof(attribute))
+          || attribute.type > TypeVarChar
+          || attribute.nameLength > PAGE_SIZE) {
+         RC_MSG (rc::not_a_dump, "[attribute: %u]\n", i);
+         return rc::not_a_dump;
+      }
+      Attribute attr;
+      attr.type = (AttrType) attribute.type;
+      attr.length = attribute.length;
+      attr.name.resize (attribute.nameLength);
+      if (!readBytes (stream, &attr.name[0], attribute.nameLength)) {
+         RC_MSG (rc::not_a_dump, "[attribute: %u]\n", i);
+         return rc::not_a_dump;
+      }
+      recordDescriptor.push_back (attr);
+   }
+   return rc::success;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+bool writeBytes(FILE *stream, const void *bytes, size_t len) {
+   return len == 0 || fwrite (bytes, len, 1, stream) == 1;
+}
+
+bool readBytes(FILE *stream, void *bytes, size_t len) {
+   return len == 0 || fread (bytes, len, 1, stream) == 1;
+}
+
+RC exportFile(FileHandle &fileHandle,
+              const vector<Attribute> &recordDescriptor, DumpMode mode,
+              FILE *stream) {
+   lock_guard<HandleLatch> latch (fileHandle.latch());
+   FileHeader fileHeader;
+   RC rcode = readHeader (fileHandle, fileHeader);
+   if (rcode != rc::success) return rcode;
+
+   DumpHeader header;
+   memset (&header, 0, sizeof(header));
+   header.magic = DUMP_MAGIC;
+   header.pageSize = PAGE_SIZE;
+   header.options = fileHeader.flags;
+   header.attrCount = recordDescriptor.size();
+   header.mode = mode;
+   bool written = writeBytes (stream, &header, sizeof(header));
+   for (unsigned i = 0; i < recordDescriptor.size() && written; ++i) {
+      const Attribute &attr = recordDescriptor[i];
+      DumpAttribute attribute;
+      attribute.type = attr.type;
+      attribute.length = attr.length;
+      attribute.nameLength = attr.name.size();
+      written = writeBytes (stream, &attribute, sizeof(attribute))
+                && writeBytes (stream, attr.name.data(), attr.name.size());
+   }
+   if (!written) {
+      RC_MSG (rc::file_write_error, "[dump header]\n");
+      return rc::file_write_error;
+   }
+
+   uint64_t frames = 0;
+   if (mode == DUMP_PAGES) {
+      rcode = writePages (fileHandle, stream, frames);
+   } else {
+      rcode = writeRecords (fileHandle, recordDescriptor, stream, frames);
+   }
+   if (rcode != rc::success) return rcode;
+   uint32_t end = DUMP_END;
+   if (!writeBytes (stream, &end, sizeof(end))
+       || !writeBytes (stream, &frames, sizeof(frames))
+       || fflush (stream) != 0) {
+      RC_MSG (rc::file_write_error, "[dump end]\n");
+      return rc::file_write_error;
+   }
+   return rc::success;
+}
+
+RC importFile(FILE *stream, const string &fileName, unsigned options,
+              vector<Attribute> &recordDescriptor) {
+   DumpHeader header;
+   if (!readBytes (stream, &header, sizeof(header))
+       || header.magic != DUMP_MAGIC || header.mode > DUMP_RECORDS) {
+      RC_MSG (rc::not_a_dump, "[file: %s]\n", fileName.c_str());
+      return rc::not_a_dump;
+   }
+   if (header.pageSize != PAGE_SIZE) {
+      RC_MSG (rc::not_a_dump, "[page size: %u]\n", header.pageSize);
+      return rc::not_a_dump;
+   }
+   RC rcode = readDescriptor (stream, header, recordDescriptor);
+   if (rcode != rc::success) return rcode;
+
+   PagedFileManager *pfm = PagedFileManager::instance();
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   if (header.mode == DUMP_PAGES) {
+      rcode = pfm->createFile (fileName);
+   } else {
+      rcode = rbfm->createFile (fileName, options);
+   }
+   if (rcode != rc::success) return rcode;
+
+   FileHandle fileHandle;
+   uint64_t frames = 0;
+   if (header.mode == DUMP_PAGES) {
+      rcode = pfm->openFile (fileName, fileHandle);
+      if (rcode == rc::success) {
+         rcode = readPages (stream, fileHandle, frames);
+         // the pages must be the ones of a record file
+         FileHeader fileHeader;
+         if (rcode == rc::success) {
+            rcode = readHeader (fileHandle, fileHeader);
+         }
+         pfm->closeFile (fileHandle);
+      }
+   } else {
+      rcode = rbfm->openFile (fileName, fileHandle);
+      if (rcode == rc::success) {
+         rcode = readRecords (stream, fileHandle, recordDescriptor, frames);
+         rbfm->closeFile (fileHandle);
+      }
+   }
+
+   uint64_t count;
+   if (rcode == rc::success
+       && (!readBytes (stream, &count, sizeof(count)) || count != frames)) {
+      RC_MSG (rc::not_a_dump, "[frames: %llu]\n",
+              (unsigned long long) frames);
+      rcode = rc::not_a_dump;
+   }
+   if (rcode != rc::success) pfm->destroyFile (fileName);
+   return rcode;
+}
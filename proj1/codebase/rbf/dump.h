@@ -0,0 +1,78 @@
+#ifndef _dump_h_
+#define _dump_h_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Bulk export and import of record files through a stream (a file, a
+// pipe, a socket with fdopen()), to move a file to another host or keep
+// a copy of it at the speed of sequential I/O.
+//
+// exportFile() writes the file as:
+//  - DUMP_PAGES: its pages as they are, the header page first. The
+//    imported file is the same file: same format, RIDs, indexes and
+//    zone maps.
+//  - DUMP_RECORDS: its records in the API format, in the order of a
+//    scan. The import packs them into new pages with bulkAppend(), in
+//    the page format asked for, leaving the free space, the forwarded
+//    and the deleted records of the file behind. The records get new
+//    RIDs: indexes and zone maps are not carried, they are created
+//    again on the new file.
+// Both hold the latch of the file meanwhile: the stream is a consistent
+// copy of the file.
+//
+// The stream format:
+//   DumpHeader, then for each attribute of the records a DumpAttribute
+//   and its name, then the frames: a uint32_t length and that many
+//   bytes, a page or a record, then DUMP_END and the uint64_t number of
+//   frames, so that a truncated stream is not taken for a whole one.
+
+typedef enum {
+  DUMP_PAGES = 0,
+  DUMP_RECORDS
+} DumpMode;
+
+const uint32_t DUMP_MAGIC = 0x444d5031;      // "DMP1"
+const uint32_t DUMP_END = 0xffffffff;
+
+// records imported per bulkAppend()
+const unsigned DUMP_BATCH = 4096;
+
+struct DumpHeader {
+    uint32_t magic;
+    uint32_t pageSize;     // PAGE_SIZE of the exporting build
+    uint32_t options;      // FileOption of the exported file
+    uint32_t attrCount;
+    uint8_t  mode;         // DumpMode
+    uint8_t  pad[3];
+};
+
+struct DumpAttribute {
+    uint32_t type;         // AttrType
+    uint32_t length;
+    uint32_t nameLength;
+};
+
+// Reads or writes all the len bytes, of the dump and column (column.h)
+// files alike
+// RETURNS: false on an error or a short read or write
+bool writeBytes(FILE *stream, const void *bytes, size_t len);
+bool readBytes(FILE *stream, void *bytes, size_t len);
+
+RC exportFile(FileHandle &fileHandle,
+              const vector<Attribute> &recordDescriptor, DumpMode mode,
+              FILE *stream);
+
+// Creates the record file fileName from a stream of exportFile(), in the
+// format of options (see RecordBasedFileManager::createFile()) for a
+// DUMP_RECORDS stream; a DUMP_PAGES stream keeps the format it was
+// exported in. The file is destroyed again if the import fails.
+// POST: recordDescriptor is the one of the records of the stream
+RC importFile(FILE *stream, const string &fileName, unsigned options,
+              vector<Attribute> &recordDescriptor);
+
+#endif
@@ -0,0 +1,242 @@
+#include <cmath>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "format.h"
+#include "page.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// longest Real written, "-1.17549435e-38"
+const unsigned REAL_MAX = 32;
+
+static char* putBytes(char *out, const char *bytes, unsigned len) {
+   memcpy (out, bytes, len);
+   return out + len;
+}
+
+static char* putInt(char *out, int value) {
+   char digits[10];
+   unsigned count = 0;
+   uint32_t v = value;
+   if (value < 0) {
+      *out++ = '-';
+      v = 0 - v;
+   }
+   do {
+      digits[count++] = '0' + v % 10;
+      v /= 10;
+   } while (v != 0);
+   while (count > 0) *out++ = digits[--count];
+   return out;
+}
+
+static char* putReal(char *out, float value, RecordStyle style) {
+   if (style == STYLE_JSON && !std::isfinite (value)) {
+      return putBytes (out, "null", 4);
+   }
+   // whole values %g would not write with an exponent
+   float limit = style == STYLE_TEXT ? 1e6f : 1e9f;
+   if (value > -limit && value < limit && value == (int) value
+       && !(value == 0 && std::signbit (value))) {
+      return putInt (out, (int) value);
+   }
+   return out + snprintf (out, REAL_MAX, style == STYLE_TEXT ? "%g" : "%.9g",
+                          value);
+}
+
+static char* putJsonString(char *out, const char *bytes, unsigned len) {
+   static const char hex[] = "0123456789abcdef";
+   *out++ = '"';
+   for (unsigned i = 0; i < len; ++i) {
+      unsigned char c = bytes[i];
+      if (c == '"' || c == '\\') {
+         *out++ = '\\';
+         *out++ = c;
+      } else if (c < 0x20) {
+         out = putBytes (out, "\\u00", 4);
+         *out++ = hex[c >> 4];
+         *out++ = hex[c & 0xf];
+      } else {
+         *out++ = c;
+      }
+   }
+   *out++ = '"';
+   return out;
+}
+
+static char* putCsvString(char *out, const char *bytes, unsigned len) {
+   bool quoted = len == 0;
+   for (unsigned i = 0; i < len && !quoted; ++i) {
+      quoted = bytes[i] == ',' || bytes[i] == '"' || bytes[i] == '\n'
+               || bytes[i] == '\r';
+   }
+   if (!quoted) return putBytes (out, bytes, len);
+   *out++ = '"';
+   for (unsigned i = 0; i < len; ++i) {
+      if (bytes[i] == '"') *out++ = '"';
+      *out++ = bytes[i];
+   }
+   *out++ = '"';
+   return out;
+}
+
+// RETURNS: bytes enough for the line of the record
+static unsigned lineBound(const vector<Attribute> &recordDescriptor,
+                          const char *data, RecordStyle style) {
+   const char *in = data + nullBytes (recordDescriptor.size());
+   unsigned bound = 3;      // braces, line end
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      const Attribute &attr = recordDescriptor[i];
+      if (style == STYLE_TEXT) bound += attr.name.size() + 4;
+      if (style == STYLE_JSON) bound += 6 * attr.name.size() + 4;
+      bound += 1;           // comma
+      if (isNull (data, i)) {
+         bound += 4;
+      } else if (attr.type != TypeVarChar) {
+         bound += REAL_MAX;
+         in += sizeof(int);
+      } else {
+         uint32_t len;
+         memcpy (&len, in, sizeof(len));
+         bound += 6 * len + 2;
+         in += sizeof(len) + len;
+      }
+   }
+   return bound;
+}
+
+// Writes the line of the record to out, which holds lineBound() bytes
+// RETURNS: the end of the line
+static char* formatLine(const vector<Attribute> &recordDescriptor,
+                        const char *data, RecordStyle style, char *out) {
+   const char *in = data + nullBytes (recordDescriptor.size());
+   if (style == STYLE_JSON) *out++ = '{';
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      const Attribute &attr = recordDescriptor[i];
+      if (style == STYLE_TEXT) {
+         out = putBytes (out, attr.name.data(), attr.name.size());
+         out = putBytes (out, ": ", 2);
+      } else if (i > 0) {
+         *out++ = ',';
+      }
+      if (style == STYLE_JSON) {
+         out = putJsonString (out, attr.name.data(), attr.name.size());
+         *out++ = ':';
+      }
+      if (isNull (data, i)) {
+         if (style == STYLE_TEXT) out = putBytes (out, "NULL", 4);
+         if (style == STYLE_JSON) out = putBytes (out, "null", 4);
+      } else if (attr.type == TypeInt) {
+         int value;
+         memcpy (&value, in, sizeof(value));
+         out = putInt (out, value);
+         in += sizeof(value);
+      } else if (attr.type == TypeReal) {
+         float value;
+         memcpy (&value, in, sizeof(value));
+         out = putReal (out, value, style);
+         in += sizeof(value);
+      } else {
+         uint32_t len;
+         memcpy (&len, in, sizeof(len));
+         in += sizeof(len);
+         if (style == STYLE_TEXT) out = putBytes (out, in, len);
+         if (style == STYLE_CSV) out = putCsvString (out, in, len);
+         if (style == STYLE_JSON) out = putJsonString (out, in, len);
+         in += len;
+      }
+      if (style == STYLE_TEXT) out = putBytes (out, "  ", 2);
+   }
+   if (style == STYLE_JSON) *out++ = '}';
+   *out++ = '\n';
+   return out;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+unsigned formatRecord(const vector<Attribute> &recordDescriptor,
+                      const void *data, RecordStyle style, char *out,
+                      unsigned capacity) {
+   const char *record = (const char*) data;
+   unsigned bound = lineBound (recordDescriptor, record, style);
+   if (bound <= capacity) {
+      return formatLine (recordDescriptor, record, style, out) - out;
+   }
+   string line (bound, '\0');
+   unsigned len = formatLine (recordDescriptor, record, style, &line[0])
+                  - line.data();
+   if (len > capacity) return 0;
+   memcpy (out, line.data(), len);
+   return len;
+}
+
+void formatRecords(const vector<Attribute> &recordDescriptor,
+                   const vector<const void*> &records, RecordStyle style,
+                   string &out) {
+   size_t start = out.size();
+   size_t bound = 0;
+   for (unsigned i = 0; i < records.size(); ++i) {
+      bound += lineBound (recordDescriptor, (const char*) records[i],
+                          style);
+   }
+   out.resize (start + bound);
+   char *end = &out[start];
+   for (unsigned i = 0; i < records.size(); ++i) {
+      end = formatLine (recordDescriptor, (const char*) records[i], style,
+                        end);
+   }
+   out.resize (end - out.data());
+}
+
+RC writeRecords(FileHandle &fileHandle,
+                const vector<Attribute> &recordDescriptor,
+                RecordStyle style, FILE *stream) {
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   vector<string> attributeNames;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      attributeNames.push_back (recordDescriptor[i].name);
+   }
+   RBFM_ScanIterator it;
+   RC rcode = rbfm->scan (fileHandle, recordDescriptor, "", NO_OP, NULL,
+                          attributeNames, it);
+   if (rcode != rc::success) return rcode;
+   string tuple (tupleMax (recordDescriptor), '\0');
+   string buffer;
+   buffer.reserve (2 * FORMAT_BUFFER);
+   RID rid;
+   bool end = false;
+   while (!end) {
+      RC next = it.getNextRecord (rid, &tuple[0]);
+      if (next != rc::success && next != RBFM_EOF) {
+         rcode = next;
+         break;
+      }
+      end = next == RBFM_EOF;
+      if (!end) {
+         size_t used = buffer.size();
+         buffer.resize (used + lineBound (recordDescriptor, tuple.data(),
+                                          style));
+         char *last = formatLine (recordDescriptor, tuple.data(), style,
+                                  &buffer[used]);
+         buffer.resize (last - buffer.data());
+      }
+      if (buffer.size() >= FORMAT_BUFFER || (end && !buffer.empty())) {
+         if (fwrite (buffer.data(), buffer.size(), 1, stream) != 1) {
+            RC_MSG (rc::file_write_error, "[pageNum: %d]\n", rid.pageNum);
+            rcode = rc::file_write_error;
+            break;
+         }
+         buffer.clear();
+      }
+   }
+   it.close();
+   return rcode;
+}
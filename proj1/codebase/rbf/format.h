@@ -0,0 +1,52 @@
+#ifndef _format_h_
+#define _format_h_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Formatting of records (API format) as text, without iostreams: the
+// numbers are converted by hand (a Real by snprintf()), the bytes
+// written straight into a buffer, so that writing out many records is
+// bound by the I/O.
+//
+// Styles, one line per record:
+//  - STYLE_TEXT: the one of printRecord(), "name: value  " per field,
+//    NULL for a null, a Real with 6 significant digits,
+//  - STYLE_CSV: the values separated by commas, nothing for a null, a
+//    VarChar quoted if it is empty or holds a comma, a quote or a line
+//    end (see loadCsv(), csv.h), a Real with 9 significant digits so
+//    that it reads back the same,
+//  - STYLE_JSON: an object of the attribute names, null for a null,
+//    VarChars escaped, Reals as in STYLE_CSV (nan and inf as null).
+
+typedef enum {
+  STYLE_TEXT = 0,
+  STYLE_CSV,
+  STYLE_JSON
+} RecordStyle;
+
+// bytes buffered by writeRecords() before a write
+const unsigned FORMAT_BUFFER = 64 * 1024;
+
+// Writes the line of a record to out, of capacity bytes
+// RETURNS: the bytes written, 0 if the line does not fit
+unsigned formatRecord(const vector<Attribute> &recordDescriptor,
+                      const void *data, RecordStyle style, char *out,
+                      unsigned capacity);
+
+// Appends the lines of the records to out, e.g. the records of a page
+// read with RecordBasedFileManager::readRecords()
+void formatRecords(const vector<Attribute> &recordDescriptor,
+                   const vector<const void*> &records, RecordStyle style,
+                   string &out);
+
+// Writes the lines of the records of the file to stream, in scan order
+RC writeRecords(FileHandle &fileHandle,
+                const vector<Attribute> &recordDescriptor,
+                RecordStyle style, FILE *stream);
+
+#endif
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <mutex>
+
+#include "fsm.h"
+#include "page.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// the free space maps of the open files
+static unordered_map<FileHandle*, FreeSpaceMap>& maps() {
+   static unordered_map<FileHandle*, FreeSpaceMap> registry;
+   return registry;
+}
+
+// guards the registry, a map is used under the latch of its file
+static mutex mapsLatch;
+
+// The maps where a thread has an insert page, given back when it ends
+struct ThreadClaims {
+    vector<const FreeSpaceMap*> maps;
+
+    ~ThreadClaims() {
+       lock_guard<mutex> latch (mapsLatch);
+       thread::id self = this_thread::get_id();
+       // the maps of the files closed since are gone
+       for (auto i = ::maps().begin(); i != ::maps().end(); ++i) {
+          if (std::find (maps.begin(), maps.end(), &i->second)
+              != maps.end()) {
+             i->second.release (self);
+          }
+       }
+    }
+};
+
+static thread_local ThreadClaims threadClaims;
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+FreeSpaceMap* freeSpaceMap(FileHandle &fileHandle) {
+   lock_guard<mutex> latch (mapsLatch);
+   auto i = maps().find (&fileHandle);
+   return i == maps().end() ? NULL : &i->second;
+}
+
+FreeSpaceMap& openFreeSpaceMap(FileHandle &fileHandle) {
+   lock_guard<mutex> latch (mapsLatch);
+   return maps()[&fileHandle];
+}
+
+void dropFreeSpaceMap(FileHandle &fileHandle) {
+   lock_guard<mutex> latch (mapsLatch);
+   maps().erase (&fileHandle);
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+void FreeSpaceMap::update(PageNum pageNum, unsigned freeBytes) {
+   if (pageNum >= free.size()) free.resize (pageNum + 1, 0);
+   free[pageNum] = freeBytes;
+}
+
+PageNum FreeSpaceMap::insertPage() const {
+   lock_guard<mutex> latch (claimsLatch);
+   auto i = insertPages.find (this_thread::get_id());
+   return i == insertPages.end() ? NO_PAGE : i->second;
+}
+
+void FreeSpaceMap::claim(PageNum pageNum) {
+   release (this_thread::get_id());
+   if (pageNum == NO_PAGE) return;
+   vector<const FreeSpaceMap*> &maps = threadClaims.maps;
+   if (std::find (maps.begin(), maps.end(), this) == maps.end()) {
+      maps.push_back (this);
+   }
+   lock_guard<mutex> latch (claimsLatch);
+   insertPages[this_thread::get_id()] = pageNum;
+   claimed.insert (pageNum);
+}
+
+void FreeSpaceMap::release(thread::id thread) {
+   lock_guard<mutex> latch (claimsLatch);
+   auto i = insertPages.find (thread);
+   if (i != insertPages.end()) {
+      claimed.erase (i->second);
+      insertPages.erase (i);
+   }
+}
+
+PageNum FreeSpaceMap::find(unsigned need, PageNum pageNum) const {
+   lock_guard<mutex> latch (claimsLatch);
+   for (; pageNum < free.size(); ++pageNum) {
+      if (free[pageNum] >= need && !claimed.count (pageNum)) {
+         return pageNum;
+      }
+   }
+   return NO_PAGE;
+}
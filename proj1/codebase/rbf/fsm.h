@@ -0,0 +1,57 @@
+#ifndef _fsm_h_
+#define _fsm_h_
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Free space map of an open file: the free bytes of every data page as
+// it was last written, kept in memory so that an insert finds a page
+// that can hold its record without reading the pages that cannot. It is
+// built with one pass over the file by the first insert and kept up to
+// date by the writes of data pages (rbfm.cc). It is only a hint: the
+// page chosen is checked once it has been read.
+//
+// Each thread inserting into the file is given an insert page of its
+// own, which the other threads do not choose. It keeps it until the
+// page is full, so the records of concurrent threads go to different
+// pages. The map belongs to one FileHandle and lives until the file is
+// closed. A thread's insert page is given back when the thread ends.
+
+struct FreeSpaceMap {
+    vector<uint16_t> free;         // by page, 0 for the other pages
+    unordered_map<thread::id, PageNum> insertPages;
+    unordered_set<PageNum> claimed;  // insert page of some thread
+    // guards insertPages and claimed, which an ending thread changes
+    // without the latch of the file
+    mutable mutex claimsLatch;
+
+    // POST: the free space of the page, 0 if it is not a data page
+    void update(PageNum pageNum, unsigned freeBytes);
+
+    // RETURNS: the insert page of the calling thread, NO_PAGE if it has
+    //          none
+    PageNum insertPage() const;
+    // POST: pageNum is the insert page of the calling thread, NO_PAGE
+    //       for none
+    void claim(PageNum pageNum);
+    // POST: thread has no insert page
+    void release(thread::id thread);
+
+    // RETURNS: the first page from pageNum on with at least need free
+    //          bytes that is not an insert page, NO_PAGE if none is
+    PageNum find(unsigned need, PageNum pageNum) const;
+};
+
+// RETURNS: the free space map of an open file, NULL if it has none
+FreeSpaceMap* freeSpaceMap(FileHandle &fileHandle);
+// The same, created empty if it does not exist yet
+FreeSpaceMap& openFreeSpaceMap(FileHandle &fileHandle);
+// POST: the map of the file is gone (the file is being closed)
+void dropFreeSpaceMap(FileHandle &fileHandle);
+
+#endif
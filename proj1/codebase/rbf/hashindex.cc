@@ -0,0 +1,363 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashindex.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// bucket page numbers held by the root and by the other directory pages
+const unsigned ROOT_DIR_CAPACITY =
+   (PAGE_SIZE - sizeof(PageFooter) - sizeof(HashMeta)) / sizeof(uint32_t);
+const unsigned DIR_CAPACITY =
+   (PAGE_SIZE - sizeof(PageFooter)) / sizeof(uint32_t);
+
+static HashMeta* hashMeta(char *rootPage) {
+   return (HashMeta*) rootPage;
+}
+
+static HashEntry* bucketEntry(char *page, unsigned i) {
+   return (HashEntry*) page + i;
+}
+
+static unsigned bucketOf(const HashMeta *meta, uint32_t hash) {
+   uint32_t bucket = hash & ((1u << meta->level) - 1);
+   if (bucket < meta->split) {
+      // already split in this round
+      bucket = hash & ((1u << (meta->level + 1)) - 1);
+   }
+   return bucket;
+}
+
+// Page of a bucket. rootPage is the root page in memory.
+static RC getBucket(FileHandle &fileHandle, char *rootPage, unsigned bucket,
+                    PageNum &pageNum) {
+   if (bucket < ROOT_DIR_CAPACITY) {
+      memcpy (&pageNum, rootPage + sizeof(HashMeta)
+                        + bucket * sizeof(uint32_t), sizeof(pageNum));
+      return rc::success;
+   }
+   bucket -= ROOT_DIR_CAPACITY;
+   char *page = (char*) malloc (PAGE_SIZE);
+   PageNum current = pageFooter (rootPage)->next;
+   RC rcode;
+   while ((rcode = fileHandle.readPage (current, page)) == rc::success
+          && bucket >= DIR_CAPACITY) {
+      bucket -= DIR_CAPACITY;
+      current = pageFooter (page)->next;
+   }
+   if (rcode == rc::success) {
+      memcpy (&pageNum, page + bucket * sizeof(uint32_t), sizeof(pageNum));
+   }
+   free (page);
+   return rcode;
+}
+
+// Sets the page of a bucket, growing the directory if needed. A change
+// to the root is only made in memory, the caller writes it.
+static RC setBucket(FileHandle &fileHandle, char *rootPage, unsigned bucket,
+                    PageNum pageNum) {
+   if (bucket < ROOT_DIR_CAPACITY) {
+      memcpy (rootPage + sizeof(HashMeta) + bucket * sizeof(uint32_t),
+              &pageNum, sizeof(pageNum));
+      return rc::success;
+   }
+   bucket -= ROOT_DIR_CAPACITY;
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fresh = (char*) malloc (PAGE_SIZE);
+   PageNum current = pageFooter (rootPage)->next;
+   RC rcode;
+   if (current == NO_PAGE) {
+      rcode = allocPage (fileHandle, PAGE_HASHDIR, page, current);
+      pageFooter (rootPage)->next = current;
+   } else {
+      rcode = fileHandle.readPage (current, page);
+   }
+   while (rcode == rc::success && bucket >= DIR_CAPACITY) {
+      bucket -= DIR_CAPACITY;
+      PageNum next = pageFooter (page)->next;
+      if (next == NO_PAGE) {
+         rcode = allocPage (fileHandle, PAGE_HASHDIR, fresh, next);
+         if (rcode != rc::success) break;
+         pageFooter (page)->next = next;
+         rcode = fileHandle.writePage (current, page);
+         memcpy (page, fresh, PAGE_SIZE);
+      } else {
+         rcode = fileHandle.readPage (next, page);
+      }
+      current = next;
+   }
+   if (rcode == rc::success) {
+      memcpy (page + bucket * sizeof(uint32_t), &pageNum, sizeof(pageNum));
+      rcode = fileHandle.writePage (current, page);
+   }
+   free (page);
+   free (fresh);
+   return rcode;
+}
+
+// Every entry of a bucket and the pages of its chain
+static RC readChain(FileHandle &fileHandle, PageNum first,
+                    vector<HashEntry> &entries, vector<PageNum> &pages) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   for (PageNum pageNum = first; pageNum != NO_PAGE;
+        pageNum = pageFooter (page)->next) {
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) break;
+      pages.push_back (pageNum);
+      HashEntry *begin = bucketEntry (page, 0);
+      entries.insert (entries.end(), begin,
+                      begin + pageFooter (page)->numSlots);
+   }
+   free (page);
+   return rcode;
+}
+
+// Writes entries to the chain made of pages, allocating the pages it
+// lacks (at least one) and freeing those it no longer needs
+static RC writeChain(FileHandle &fileHandle, vector<PageNum> &pages,
+                     const vector<HashEntry> &entries) {
+   unsigned count = std::max ((unsigned) 1,
+                              (unsigned) (entries.size() + BUCKET_CAPACITY - 1)
+                              / BUCKET_CAPACITY);
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   while (pages.size() < count && rcode == rc::success) {
+      PageNum pageNum;
+      rcode = allocPage (fileHandle, PAGE_HASHBUCKET, page, pageNum);
+      pages.push_back (pageNum);
+   }
+   for (unsigned i = 0; i < count && rcode == rc::success; ++i) {
+      unsigned begin = i * BUCKET_CAPACITY;
+      unsigned n = std::min ((unsigned) entries.size() - begin,
+                             BUCKET_CAPACITY);
+      initPage (page, PAGE_HASHBUCKET);
+      if (n > 0) {
+         memcpy (page, &entries[begin], n * sizeof(HashEntry));
+      }
+      pageFooter (page)->numSlots = n;
+      pageFooter (page)->next = i + 1 < count ? pages[i + 1] : NO_PAGE;
+      rcode = fileHandle.writePage (pages[i], page);
+   }
+   for (unsigned i = count; i < pages.size() && rcode == rc::success; ++i) {
+      rcode = freePage (fileHandle, pages[i]);
+   }
+   pages.resize (count);
+   free (page);
+   return rcode;
+}
+
+// Splits the next bucket of the round between itself and its image
+static RC splitBucket(FileHandle &fileHandle, char *rootPage) {
+   HashMeta *meta = hashMeta (rootPage);
+   unsigned from = meta->split;
+   unsigned to = from + (1u << meta->level);
+   uint32_t mask = (1u << (meta->level + 1)) - 1;
+
+   PageNum first;
+   RC rcode = getBucket (fileHandle, rootPage, from, first);
+   if (rcode != rc::success) return rcode;
+   vector<HashEntry> entries, stay, move;
+   vector<PageNum> pages, newPages;
+   rcode = readChain (fileHandle, first, entries, pages);
+   if (rcode != rc::success) return rcode;
+   for (unsigned i = 0; i < entries.size(); ++i) {
+      if ((entries[i].hash & mask) == from) {
+         stay.push_back (entries[i]);
+      } else {
+         move.push_back (entries[i]);
+      }
+   }
+   rcode = writeChain (fileHandle, pages, stay);
+   if (rcode == rc::success) rcode = writeChain (fileHandle, newPages, move);
+   if (rcode == rc::success) {
+      rcode = setBucket (fileHandle, rootPage, to, newPages[0]);
+   }
+   if (rcode != rc::success) return rcode;
+   if (++meta->split == (1u << meta->level)) {
+      ++meta->level;
+      meta->split = 0;
+   }
+   return rc::success;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+uint32_t hashValue(AttrType type, const char *bytes, unsigned len) {
+   float real;
+   if (type == TypeReal) {
+      // -0.0 == 0.0
+      memcpy (&real, bytes, sizeof(real));
+      if (real == 0) real = 0;
+      bytes = (const char*) &real;
+   }
+   // FNV-1a, then mixed so that the low bits used for the buckets
+   // depend on every byte
+   uint32_t hash = 2166136261u;
+   for (unsigned i = 0; i < len; ++i) {
+      hash ^= (unsigned char) bytes[i];
+      hash *= 16777619u;
+   }
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6bu;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35u;
+   hash ^= hash >> 16;
+   return hash;
+}
+
+RC hashCreate(FileHandle &fileHandle, PageNum &root) {
+   char *rootPage = (char*) malloc (PAGE_SIZE);
+   char *page = (char*) malloc (PAGE_SIZE);
+   PageNum bucket;
+   RC rcode = allocPage (fileHandle, PAGE_HASHDIR, rootPage, root);
+   if (rcode == rc::success) {
+      rcode = allocPage (fileHandle, PAGE_HASHBUCKET, page, bucket);
+   }
+   if (rcode == rc::success) {
+      memset (hashMeta (rootPage), 0, sizeof(HashMeta));
+      rcode = setBucket (fileHandle, rootPage, 0, bucket);
+   }
+   if (rcode == rc::success) {
+      rcode = fileHandle.writePage (root, rootPage);
+   }
+   free (rootPage);
+   free (page);
+   return rcode;
+}
+
+RC hashInsert(FileHandle &fileHandle, PageNum root, uint32_t hash,
+              const RID &rid) {
+   char *rootPage = (char*) malloc (PAGE_SIZE);
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fresh = (char*) malloc (PAGE_SIZE);
+   PageNum pageNum = NO_PAGE;
+   RC rcode = fileHandle.readPage (root, rootPage);
+   HashMeta *meta = hashMeta (rootPage);
+   if (rcode == rc::success) {
+      rcode = getBucket (fileHandle, rootPage, bucketOf (meta, hash),
+                         pageNum);
+   }
+   // first page of the chain with room, a new one at its end if none
+   while (rcode == rc::success) {
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) break;
+      PageFooter *footer = pageFooter (page);
+      if (footer->numSlots < BUCKET_CAPACITY) break;
+      if (footer->next == NO_PAGE) {
+         PageNum next;
+         rcode = allocPage (fileHandle, PAGE_HASHBUCKET, fresh, next);
+         if (rcode != rc::success) break;
+         footer->next = next;
+         rcode = fileHandle.writePage (pageNum, page);
+         memcpy (page, fresh, PAGE_SIZE);
+         pageNum = next;
+         break;
+      }
+      pageNum = footer->next;
+   }
+   if (rcode == rc::success) {
+      HashEntry *entry = bucketEntry (page, pageFooter (page)->numSlots++);
+      entry->hash = hash;
+      entry->pageNum = rid.pageNum;
+      entry->slotNum = rid.slotNum;
+      rcode = fileHandle.writePage (pageNum, page);
+   }
+   if (rcode == rc::success) {
+      ++meta->entries;
+      unsigned buckets = (1u << meta->level) + meta->split;
+      if (meta->entries > buckets * BUCKET_CAPACITY / 4 * 3) {
+         rcode = splitBucket (fileHandle, rootPage);
+      }
+   }
+   if (rcode == rc::success) {
+      rcode = fileHandle.writePage (root, rootPage);
+   }
+   free (rootPage);
+   free (page);
+   free (fresh);
+   return rcode;
+}
+
+RC hashDelete(FileHandle &fileHandle, PageNum root, uint32_t hash,
+              const RID &rid) {
+   char *rootPage = (char*) malloc (PAGE_SIZE);
+   char *page = (char*) malloc (PAGE_SIZE);
+   PageNum pageNum = NO_PAGE;
+   RC rcode = fileHandle.readPage (root, rootPage);
+   HashMeta *meta = hashMeta (rootPage);
+   if (rcode == rc::success) {
+      rcode = getBucket (fileHandle, rootPage, bucketOf (meta, hash),
+                         pageNum);
+   }
+   bool found = false;
+   while (rcode == rc::success && !found && pageNum != NO_PAGE) {
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) break;
+      PageFooter *footer = pageFooter (page);
+      for (unsigned i = 0; i < footer->numSlots; ++i) {
+         HashEntry *entry = bucketEntry (page, i);
+         if (entry->hash == hash && entry->pageNum == rid.pageNum
+             && entry->slotNum == rid.slotNum) {
+            *entry = *bucketEntry (page, --footer->numSlots);
+            found = true;
+            break;
+         }
+      }
+      if (found) {
+         rcode = fileHandle.writePage (pageNum, page);
+      } else {
+         pageNum = footer->next;
+      }
+   }
+   if (rcode == rc::success && found) {
+      --meta->entries;
+      rcode = fileHandle.writePage (root, rootPage);
+   }
+   free (rootPage);
+   free (page);
+   return rcode;
+}
+
+RC hashLookup(FileHandle &fileHandle, PageNum root, uint32_t hash,
+              vector<RID> &rids) {
+   char *rootPage = (char*) malloc (PAGE_SIZE);
+   char *page = (char*) malloc (PAGE_SIZE);
+   PageNum pageNum = NO_PAGE;
+   rids.clear();
+   RC rcode = fileHandle.readPage (root, rootPage);
+   if (rcode == rc::success) {
+      rcode = getBucket (fileHandle, rootPage,
+                         bucketOf (hashMeta (rootPage), hash), pageNum);
+   }
+   while (rcode == rc::success && pageNum != NO_PAGE) {
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) break;
+      PageFooter *footer = pageFooter (page);
+      for (unsigned i = 0; i < footer->numSlots; ++i) {
+         HashEntry *entry = bucketEntry (page, i);
+         if (entry->hash != hash) continue;
+         RID rid;
+         rid.pageNum = entry->pageNum;
+         rid.slotNum = entry->slotNum;
+         rids.push_back (rid);
+      }
+      pageNum = footer->next;
+   }
+   // in file order
+   std::sort (rids.begin(), rids.end(), [](const RID &a, const RID &b) {
+                 return a.pageNum < b.pageNum
+                        || (a.pageNum == b.pageNum && a.slotNum < b.slotNum);
+              });
+   free (rootPage);
+   free (page);
+   return rcode;
+}
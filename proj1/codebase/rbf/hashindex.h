@@ -0,0 +1,60 @@
+#ifndef _hashindex_h_
+#define _hashindex_h_
+
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../rbf/page.h"
+
+// Linear hash index from the values of one attribute to the RIDs of
+// the records holding them, kept inside the record file.
+//
+// Root page (PAGE_HASHDIR):
+//   [HashMeta][uint32 bucket page[]                    ][footer]
+//   footer.next continues the bucket directory on more PAGE_HASHDIR
+//   pages holding only bucket page numbers.
+// Bucket page (PAGE_HASHBUCKET):
+//   [HashEntry entries ->            free space          ][footer]
+//   footer.numSlots is the number of entries, footer.next the overflow
+//   page of the bucket.
+//
+// Only the 32 bit hash of a value is stored: a lookup returns the RIDs
+// of every entry with the same hash and the caller checks the values
+// (scan evaluates its condition anyway). The table grows one bucket at
+// a time (linear hashing) once it is 3/4 full, so no insert ever
+// rehashes more than a single bucket. Null values are not indexed.
+
+struct HashMeta {
+    uint32_t level;        // 2^level buckets at the start of a round
+    uint32_t split;        // next bucket to split
+    uint32_t entries;
+};
+
+struct HashEntry {
+    uint32_t hash;
+    uint32_t pageNum;      // RID
+    uint32_t slotNum;
+};
+
+const unsigned BUCKET_CAPACITY = (PAGE_SIZE - sizeof(PageFooter))
+                                 / sizeof(HashEntry);
+
+// Hash of a field value (internal format, no VarChar length)
+uint32_t hashValue(AttrType type, const char *bytes, unsigned len);
+
+// Creates an empty index
+// POST: root is its root page
+RC hashCreate(FileHandle &fileHandle, PageNum &root);
+
+RC hashInsert(FileHandle &fileHandle, PageNum root, uint32_t hash,
+              const RID &rid);
+
+// Removes the entry of (hash, rid), if any
+RC hashDelete(FileHandle &fileHandle, PageNum root, uint32_t hash,
+              const RID &rid);
+
+// POST: rids holds the RID of every entry with this hash, sorted
+RC hashLookup(FileHandle &fileHandle, PageNum root, uint32_t hash,
+              vector<RID> &rids);
+
+#endif
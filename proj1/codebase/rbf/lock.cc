@@ -0,0 +1,267 @@
+#include <chrono>
+#include <condition_variable>
+#include <unordered_set>
+
+#include "lock.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// a request of a transaction on one target
+struct LockRequest {
+    uint64_t txn;
+    bool holds;            // mode is granted
+    LockMode mode;
+    bool waiting;          // for wanted
+    LockMode wanted;
+};
+
+struct LockPartition {
+    mutex latch;
+    condition_variable changed;    // a lock was released or granted
+    unordered_map<LockTarget, vector<LockRequest>, LockTargetHash> queues;
+};
+
+// compatible[held][requested]
+static const bool compatible[5][5] = {
+   //          IS     IX     S      SIX    X
+   /* IS  */ { true,  true,  true,  true,  false },
+   /* IX  */ { true,  true,  false, false, false },
+   /* S   */ { true,  false, true,  false, false },
+   /* SIX */ { true,  false, false, false, false },
+   /* X   */ { false, false, false, false, false }
+};
+
+// RETURNS: the weakest mode granting what both a and b grant
+static LockMode combine(LockMode a, LockMode b) {
+   if (a == b || b == LOCK_IS) return a;
+   if (a == LOCK_IS) return b;
+   if (a == LOCK_X || b == LOCK_X) return LOCK_X;
+   return LOCK_SIX;        // two of IX, S and SIX
+}
+
+static LockMode intention(LockMode mode) {
+   return mode == LOCK_IS || mode == LOCK_S ? LOCK_IS : LOCK_IX;
+}
+
+static LockTarget lockTarget(FileHandle &fileHandle, LockLevel level,
+                             PageNum pageNum, unsigned slotNum) {
+   LockTarget target;
+   target.file = &fileHandle;
+   target.level = level;
+   target.pageNum = pageNum;
+   target.slotNum = slotNum;
+   return target;
+}
+
+static unsigned findRequest(const vector<LockRequest> &queue,
+                            uint64_t txn) {
+   unsigned i = 0;
+   while (i < queue.size() && queue[i].txn != txn) ++i;
+   return i;
+}
+
+// The transactions request i of the queue waits for: the holders of a
+// conflicting mode and, unless it is an upgrade, the requests waiting
+// before it
+static void findBlockers(const vector<LockRequest> &queue, unsigned i,
+                         vector<uint64_t> &blockers) {
+   blockers.clear();
+   const LockRequest &request = queue[i];
+   for (unsigned j = 0; j < queue.size(); ++j) {
+      if (j == i) continue;
+      const LockRequest &other = queue[j];
+      if ((other.holds && !compatible[other.mode][request.wanted])
+          || (!request.holds && j < i && other.waiting)) {
+         blockers.push_back (other.txn);
+      }
+   }
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+bool LockTarget::operator==(const LockTarget &other) const {
+   return file == other.file && level == other.level
+          && pageNum == other.pageNum && slotNum == other.slotNum;
+}
+
+size_t LockTargetHash::operator()(const LockTarget &target) const {
+   uint64_t h = (uint64_t) (size_t) target.file;
+   h ^= ((uint64_t) target.pageNum << 32 | target.slotNum)
+        + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+   h ^= target.level;
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdull;
+   h ^= h >> 33;
+   return (size_t) h;
+}
+
+LockManager* LockManager::_lock_manager = 0;
+
+LockManager* LockManager::instance()
+{
+    if(!_lock_manager)
+        _lock_manager = new LockManager();
+
+    return _lock_manager;
+}
+
+LockManager::LockManager() :
+   _partitions (new LockPartition[LOCK_PARTITIONS]), _nextId (1),
+   _timeout (0)
+{
+}
+
+LockManager::~LockManager()
+{
+   delete[] _partitions;
+}
+
+void LockManager::begin(Transaction &txn) {
+   txn.id = _nextId++;
+   txn.held.clear();
+}
+
+RC LockManager::lockFile(Transaction &txn, FileHandle &fileHandle,
+                         LockMode mode) {
+   return lock (txn, lockTarget (fileHandle, LOCK_FILE, 0, 0), mode);
+}
+
+RC LockManager::lockPage(Transaction &txn, FileHandle &fileHandle,
+                         PageNum pageNum, LockMode mode) {
+   RC rcode = lockFile (txn, fileHandle, intention (mode));
+   if (rcode != rc::success) return rcode;
+   return lock (txn, lockTarget (fileHandle, LOCK_PAGE, pageNum, 0), mode);
+}
+
+RC LockManager::lockRecord(Transaction &txn, FileHandle &fileHandle,
+                           const RID &rid, LockMode mode) {
+   RC rcode = lockPage (txn, fileHandle, rid.pageNum, intention (mode));
+   if (rcode != rc::success) return rcode;
+   return lock (txn, lockTarget (fileHandle, LOCK_RECORD, rid.pageNum,
+                                 rid.slotNum), mode);
+}
+
+void LockManager::releaseAll(Transaction &txn) {
+   for (auto held = txn.held.begin(); held != txn.held.end(); ++held) {
+      LockPartition &part = _partitions[LockTargetHash() (held->first)
+                                        % LOCK_PARTITIONS];
+      lock_guard<mutex> latch (part.latch);
+      auto queue = part.queues.find (held->first);
+      if (queue == part.queues.end()) continue;
+      vector<LockRequest> &requests = queue->second;
+      unsigned i = findRequest (requests, txn.id);
+      if (i < requests.size()) requests.erase (requests.begin() + i);
+      if (requests.empty()) part.queues.erase (queue);
+      part.changed.notify_all();
+   }
+   txn.held.clear();
+}
+
+void LockManager::setTimeout(unsigned milliseconds) {
+   _timeout = milliseconds;
+}
+
+// Grants mode on target to txn, or the mode combining it with the one
+// txn already holds there, waiting for the conflicting holders
+RC LockManager::lock(Transaction &txn, const LockTarget &target,
+                     LockMode mode) {
+   auto held = txn.held.find (target);
+   if (held != txn.held.end()) {
+      LockMode wanted = combine (held->second, mode);
+      if (wanted == held->second) return rc::success;
+      mode = wanted;
+   }
+
+   LockPartition &part = _partitions[LockTargetHash() (target)
+                                     % LOCK_PARTITIONS];
+   unique_lock<mutex> latch (part.latch);
+   vector<LockRequest> *queue = &part.queues[target];
+   unsigned i = findRequest (*queue, txn.id);
+   if (i == queue->size()) {
+      LockRequest request = { txn.id, false, LOCK_IS, false, mode };
+      queue->push_back (request);
+   }
+   (*queue)[i].waiting = true;
+   (*queue)[i].wanted = mode;
+
+   auto deadline = chrono::steady_clock::now()
+                   + chrono::milliseconds (_timeout);
+   vector<uint64_t> blockers;
+   RC rcode = rc::success;
+   while (true) {
+      // the requests before it may be gone since the last time
+      i = findRequest (*queue, txn.id);
+      findBlockers (*queue, i, blockers);
+      bool waited = false;
+      {
+         lock_guard<mutex> graph (_graphLatch);
+         if (blockers.empty()) {
+            _waitsFor.erase (txn.id);
+            break;
+         }
+         _waitsFor[txn.id] = blockers;
+         if (closesCycle (txn.id)) {
+            RC_MSG (rc::deadlock, "[txn: %llu]\n",
+                    (unsigned long long) txn.id);
+            rcode = rc::deadlock;
+         } else if (rcode == rc::lock_timeout) {
+            RC_MSG (rc::lock_timeout, "[txn: %llu]\n",
+                    (unsigned long long) txn.id);
+         } else {
+            waited = true;
+         }
+         if (!waited) _waitsFor.erase (txn.id);
+      }
+      if (!waited) {
+         // gives up the request, an upgrade keeps the mode it holds
+         if ((*queue)[i].holds) {
+            (*queue)[i].waiting = false;
+         } else {
+            queue->erase (queue->begin() + i);
+            if (queue->empty()) part.queues.erase (target);
+         }
+         part.changed.notify_all();
+         return rcode;
+      }
+      if (_timeout == 0) {
+         part.changed.wait (latch);
+      } else if (part.changed.wait_until (latch, deadline)
+                 == cv_status::timeout) {
+         rcode = rc::lock_timeout;
+      }
+   }
+
+   LockRequest &request = (*queue)[i];
+   request.holds = true;
+   request.mode = mode;
+   request.waiting = false;
+   txn.held[target] = mode;
+   // the requests queued behind it waited for it too
+   part.changed.notify_all();
+   return rc::success;
+}
+
+// RETURNS: true if txn waits, through the wait-for graph, for itself
+// PRE: _graphLatch is held
+bool LockManager::closesCycle(uint64_t txn) {
+   vector<uint64_t> stack (1, txn);
+   unordered_set<uint64_t> visited;
+   while (!stack.empty()) {
+      uint64_t waiter = stack.back();
+      stack.pop_back();
+      auto edges = _waitsFor.find (waiter);
+      if (edges == _waitsFor.end()) continue;
+      for (unsigned i = 0; i < edges->second.size(); ++i) {
+         uint64_t blocker = edges->second[i];
+         if (blocker == txn) return true;
+         if (visited.insert (blocker).second) stack.push_back (blocker);
+      }
+   }
+   return false;
+}
@@ -0,0 +1,114 @@
+#ifndef _lock_h_
+#define _lock_h_
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Lock manager: two-phase locking of record-based files, for
+// transactions run by concurrent threads.
+//
+// The locks form a hierarchy: a file, its pages, and the records of a
+// page. Locking a page or a record first takes the intention mode on its
+// ancestors: IS for IS and S, IX for the other modes. So a transaction
+// locking a whole file in S or X waits for the transactions working on
+// its records, and they wait for it. A transaction holds its locks until
+// it releases all of them at once, at its commit or abort (strict
+// two-phase locking).
+//
+// A conflicting request waits behind the requests already waiting on
+// the same target; an upgrade only waits for the holders. Before it
+// waits, the transaction is added to the wait-for graph. If that closes
+// a cycle, the request fails with rc::deadlock and the transaction must
+// abort. Edges are removed lazily when a waiter wakes up, so a request
+// may rarely be failed without a real deadlock. A wait longer than the
+// timeout (setTimeout()) fails with rc::lock_timeout.
+//
+// The lock table is split into LOCK_PARTITIONS partitions by the hash
+// of the target, each with its own mutex, so requests on different
+// targets seldom contend.
+//
+// Files are identified by their FileHandle: the threads working on one
+// file share its handle. Locks control what a transaction may see and
+// change. Keeping the pages consistent is a separate job: each record
+// function holds the handle's latch (FileHandle::latch()) for the
+// duration of the call. An update that stays in its page holds it
+// shared, with the latch of the page, so updates of records of
+// different pages run at the same time.
+
+typedef enum {
+  LOCK_IS = 0,     // intention shared
+  LOCK_IX,         // intention exclusive
+  LOCK_S,          // shared
+  LOCK_SIX,        // shared and intention exclusive
+  LOCK_X           // exclusive
+} LockMode;
+
+typedef enum { LOCK_FILE = 0, LOCK_PAGE, LOCK_RECORD } LockLevel;
+
+const unsigned LOCK_PARTITIONS = 64;
+
+// What a lock is taken on
+struct LockTarget {
+    FileHandle *file;
+    uint8_t level;         // LockLevel
+    PageNum pageNum;       // 0 for a file
+    unsigned slotNum;      // 0 for a file or a page
+
+    bool operator==(const LockTarget &other) const;
+};
+
+struct LockTargetHash {
+    size_t operator()(const LockTarget &target) const;
+};
+
+// A transaction, run by one thread at a time
+struct Transaction {
+    uint64_t id;
+    unordered_map<LockTarget, LockMode, LockTargetHash> held;
+};
+
+struct LockPartition;
+
+class LockManager
+{
+public:
+  static LockManager* instance();
+
+  // POST: txn has a new id and holds no lock
+  void begin(Transaction &txn);
+
+  RC lockFile(Transaction &txn, FileHandle &fileHandle, LockMode mode);
+  RC lockPage(Transaction &txn, FileHandle &fileHandle, PageNum pageNum,
+              LockMode mode);
+  // PRE: mode is LOCK_S or LOCK_X
+  RC lockRecord(Transaction &txn, FileHandle &fileHandle, const RID &rid,
+                LockMode mode);
+
+  // Releases every lock of txn
+  void releaseAll(Transaction &txn);
+
+  // Waits longer than milliseconds fail, 0 (the default) waits forever.
+  // Set before the transactions start.
+  void setTimeout(unsigned milliseconds);
+
+protected:
+  LockManager();
+  ~LockManager();
+
+private:
+  RC lock(Transaction &txn, const LockTarget &target, LockMode mode);
+  bool closesCycle(uint64_t txn);
+
+  static LockManager *_lock_manager;
+  LockPartition *_partitions;
+  atomic<uint64_t> _nextId;
+  unsigned _timeout;
+  mutex _graphLatch;        // of _waitsFor, taken after a partition's
+  unordered_map<uint64_t, vector<uint64_t> > _waitsFor;
+};
+
+#endif
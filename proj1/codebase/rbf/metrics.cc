@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+struct MetricShard {
+    atomic<uint64_t> counters[COUNTERS];
+    atomic<uint64_t> counts[LATENCIES];
+    atomic<uint64_t> sums[LATENCIES];
+    atomic<uint64_t> maxima[LATENCIES];
+    atomic<uint64_t> buckets[LATENCIES][HISTOGRAM_BUCKETS];
+    char pad[64];          // no cache line shared with the next shard
+};
+
+static const char *counterNames[COUNTERS] = {
+   "bytes_read", "bytes_written", "compactions", "forward_hops",
+   "fsm_probes"
+};
+
+static const char *latencyNames[LATENCIES] = {
+   "read_page", "write_page", "append_page", "insert", "read", "update",
+   "delete", "scan"
+};
+
+// the metrics the calling thread adds to, see MetricTimer
+static thread_local Metrics *currentMetrics = NULL;
+
+// RETURNS: the shard of the calling thread
+static unsigned threadShard() {
+   static atomic<unsigned> threads (0);
+   static thread_local unsigned shard = threads++ % METRIC_SHARDS;
+   return shard;
+}
+
+static void appendf(string &out, const char *format,
+                    unsigned long long value) {
+   char buf[32];
+   snprintf (buf, sizeof(buf), format, value);
+   out += buf;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+void countMetric(Counter counter, uint64_t n) {
+   if (currentMetrics != NULL) currentMetrics->add (counter, n);
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+Histogram::Histogram() : count (0), sum (0), max (0)
+{
+   memset (buckets, 0, sizeof(buckets));
+}
+
+void Histogram::add(uint64_t value) {
+   ++count;
+   sum += value;
+   if (value > max) max = value;
+   ++buckets[bucketOf (value)];
+}
+
+void Histogram::merge(const Histogram &other) {
+   count += other.count;
+   sum += other.sum;
+   if (other.max > max) max = other.max;
+   for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      buckets[i] += other.buckets[i];
+   }
+}
+
+unsigned Histogram::bucketOf(uint64_t value) {
+   if (value < HISTOGRAM_SUB) return value;
+   unsigned shift = 63 - __builtin_clzll (value) - 3;  // HISTOGRAM_SUB = 2^3
+   unsigned bucket = HISTOGRAM_SUB * (shift + 1)
+                     + ((value >> shift) & (HISTOGRAM_SUB - 1));
+   return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+uint64_t Histogram::bucketLow(unsigned bucket) {
+   if (bucket < HISTOGRAM_SUB) return bucket;
+   unsigned shift = bucket / HISTOGRAM_SUB - 1;
+   return (uint64_t) (HISTOGRAM_SUB + bucket % HISTOGRAM_SUB) << shift;
+}
+
+uint64_t Histogram::quantile(double q) const {
+   if (count == 0) return 0;
+   uint64_t rank = q * count, seen = 0;
+   if (rank >= count) rank = count - 1;
+   for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      seen += buckets[i];
+      if (seen > rank) {
+         if (i + 1 == HISTOGRAM_BUCKETS) return max;
+         uint64_t high = bucketLow (i + 1) - 1;
+         return high < max ? high : max;
+      }
+   }
+   return max;
+}
+
+string MetricsSnapshot::json() const {
+   string out = "{\"counters\": {";
+   for (unsigned i = 0; i < COUNTERS; ++i) {
+      out += i ? ", \"" : "\"";
+      out += counterNames[i];
+      appendf (out, "\": %llu", counters[i]);
+   }
+   out += "}, \"latency_ns\": {";
+   static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+   static const char *quantileNames[] = { "p50", "p90", "p99", "p999" };
+   for (unsigned i = 0; i < LATENCIES; ++i) {
+      const Histogram &h = latencies[i];
+      out += i ? ", \"" : "\"";
+      out += latencyNames[i];
+      appendf (out, "\": {\"count\": %llu", h.count);
+      appendf (out, ", \"mean\": %llu", h.count ? h.sum / h.count : 0);
+      for (unsigned q = 0; q < 4; ++q) {
+         out += ", \"";
+         out += quantileNames[q];
+         appendf (out, "\": %llu", h.quantile (quantiles[q]));
+      }
+      appendf (out, ", \"max\": %llu, \"buckets\": [", h.max);
+      bool first = true;
+      for (unsigned b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+         if (h.buckets[b] == 0) continue;
+         appendf (out, first ? "[%llu, " : ", [%llu, ",
+                  Histogram::bucketLow (b));
+         appendf (out, "%llu]", h.buckets[b]);
+         first = false;
+      }
+      out += "]}";
+   }
+   out += "}}";
+   return out;
+}
+
+Metrics::Metrics() : _shards (new MetricShard[METRIC_SHARDS])
+{
+   reset();
+}
+
+Metrics::~Metrics()
+{
+   delete[] _shards;
+}
+
+void Metrics::add(Counter counter, uint64_t n) {
+   _shards[threadShard()].counters[counter].fetch_add (
+      n, memory_order_relaxed);
+}
+
+void Metrics::record(Latency latency, uint64_t nanoseconds) {
+   MetricShard &shard = _shards[threadShard()];
+   shard.counts[latency].fetch_add (1, memory_order_relaxed);
+   shard.sums[latency].fetch_add (nanoseconds, memory_order_relaxed);
+   shard.buckets[latency][Histogram::bucketOf (nanoseconds)].fetch_add (
+      1, memory_order_relaxed);
+   uint64_t max = shard.maxima[latency].load (memory_order_relaxed);
+   while (nanoseconds > max
+          && !shard.maxima[latency].compare_exchange_weak (
+                max, nanoseconds, memory_order_relaxed)) {
+   }
+}
+
+void Metrics::collect(MetricsSnapshot &snapshot) const {
+   memset (snapshot.counters, 0, sizeof(snapshot.counters));
+   for (unsigned l = 0; l < LATENCIES; ++l) {
+      snapshot.latencies[l] = Histogram();
+   }
+   for (unsigned s = 0; s < METRIC_SHARDS; ++s) {
+      const MetricShard &shard = _shards[s];
+      for (unsigned c = 0; c < COUNTERS; ++c) {
+         snapshot.counters[c] += shard.counters[c].load (
+                                    memory_order_relaxed);
+      }
+      for (unsigned l = 0; l < LATENCIES; ++l) {
+         Histogram &h = snapshot.latencies[l];
+         h.count += shard.counts[l].load (memory_order_relaxed);
+         h.sum += shard.sums[l].load (memory_order_relaxed);
+         uint64_t max = shard.maxima[l].load (memory_order_relaxed);
+         if (max > h.max) h.max = max;
+         for (unsigned b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            h.buckets[b] += shard.buckets[l][b].load (memory_order_relaxed);
+         }
+      }
+   }
+}
+
+void Metrics::reset() {
+   for (unsigned s = 0; s < METRIC_SHARDS; ++s) {
+      MetricShard &shard = _shards[s];
+      for (unsigned c = 0; c < COUNTERS; ++c) shard.counters[c] = 0;
+      for (unsigned l = 0; l < LATENCIES; ++l) {
+         shard.counts[l] = 0;
+         shard.sums[l] = 0;
+         shard.maxima[l] = 0;
+         for (unsigned b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            shard.buckets[l][b] = 0;
+         }
+      }
+   }
+}
+
+MetricTimer::MetricTimer(Metrics &metrics, Latency latency) :
+   _metrics (metrics), _latency (latency), _outer (currentMetrics),
+   _start (chrono::steady_clock::now())
+{
+   currentMetrics = &metrics;
+}
+
+MetricTimer::~MetricTimer()
+{
+   currentMetrics = _outer;
+   _metrics.record (_latency, chrono::duration_cast<chrono::nanoseconds> (
+                                 chrono::steady_clock::now() - _start)
+                                 .count());
+}
@@ -0,0 +1,120 @@
+#ifndef _metrics_h_
+#define _metrics_h_
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+
+// Metrics of a file: latency histograms of the page and record
+// operations, and counters of the work they do. See FileHandle::metrics().
+//
+// Every thread adds to one of METRIC_SHARDS shards, so that threads
+// working on the same file seldom touch the same cache lines; collect()
+// sums the shards when asked.
+//
+// A histogram has HISTOGRAM_SUB buckets per power of 2 (HDR style): a
+// latency is known within 1/HISTOGRAM_SUB of its value, from 1ns to
+// about 18 minutes.
+
+using namespace std;
+
+typedef enum {
+  LATENCY_READ_PAGE = 0,
+  LATENCY_WRITE_PAGE,
+  LATENCY_APPEND_PAGE,
+  LATENCY_INSERT,          // insertRecord() and appendRecord()
+  LATENCY_READ,
+  LATENCY_UPDATE,
+  LATENCY_DELETE,
+  LATENCY_SCAN,            // each getNextRecord() of a scan
+  LATENCIES                // This must be the last latency
+} Latency;
+
+typedef enum {
+  COUNTER_BYTES_READ = 0,
+  COUNTER_BYTES_WRITTEN,   // written and appended
+  COUNTER_COMPACTIONS,     // of the cells of a page
+  COUNTER_FORWARD_HOPS,    // reads through a forwarding RID
+  COUNTER_FSM_PROBES,      // pages an insert tried (fsm.h)
+  COUNTERS                 // This must be the last counter
+} Counter;
+
+const unsigned METRIC_SHARDS = 8;
+const unsigned HISTOGRAM_SUB = 8;
+const unsigned HISTOGRAM_BUCKETS = HISTOGRAM_SUB * 38;   // to 2^40ns
+
+struct Histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+
+    Histogram();
+
+    void add(uint64_t value);
+    void merge(const Histogram &other);
+
+    static unsigned bucketOf(uint64_t value);
+    // RETURNS: the lowest value of bucket
+    static uint64_t bucketLow(unsigned bucket);
+
+    // RETURNS: the highest value of the bucket holding the value ranked
+    // q (0 to 1), no more than max
+    uint64_t quantile(double q) const;
+};
+
+struct MetricsSnapshot {
+    uint64_t counters[COUNTERS];
+    Histogram latencies[LATENCIES];     // in nanoseconds
+
+    // RETURNS: the counters and a summary of each histogram with its
+    // non-empty buckets, as a JSON object
+    string json() const;
+};
+
+struct MetricShard;
+
+class Metrics
+{
+public:
+  Metrics();
+  ~Metrics();
+
+  void add(Counter counter, uint64_t n = 1);
+  void record(Latency latency, uint64_t nanoseconds);
+
+  void collect(MetricsSnapshot &snapshot) const;
+  // Zeroes the metrics, the calls running meanwhile may be half counted
+  void reset();
+
+private:
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  MetricShard *_shards;
+};
+
+// Records the time from its construction to its destruction as a
+// latency. Meanwhile, countMetric() from the same thread adds to metrics.
+class MetricTimer
+{
+public:
+  MetricTimer(Metrics &metrics, Latency latency);
+  ~MetricTimer();
+
+private:
+  MetricTimer(const MetricTimer&) = delete;
+  MetricTimer& operator=(const MetricTimer&) = delete;
+
+  Metrics &_metrics;
+  Latency _latency;
+  Metrics *_outer;         // of the enclosing timer of the thread
+  chrono::steady_clock::time_point _start;
+};
+
+// Adds to the metrics of the innermost MetricTimer of the calling thread,
+// if any, for the code that does not know which file it works on
+void countMetric(Counter counter, uint64_t n = 1);
+
+#endif
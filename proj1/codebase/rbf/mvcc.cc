@@ -0,0 +1,117 @@
+#include <mutex>
+#include <unordered_map>
+
+#include "mvcc.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// the version stores of the open files
+static unordered_map<FileHandle*, VersionStore>& stores() {
+   static unordered_map<FileHandle*, VersionStore> registry;
+   return registry;
+}
+
+// guards the registry, a store is used under the latch of its file
+static mutex storesLatch;
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+uint64_t versionKey(const RID &rid) {
+   return (uint64_t) rid.pageNum << 32 | rid.slotNum;
+}
+
+VersionStore* versionStore(FileHandle &fileHandle) {
+   lock_guard<mutex> latch (storesLatch);
+   auto i = stores().find (&fileHandle);
+   return i == stores().end() ? NULL : &i->second;
+}
+
+VersionStore& openVersionStore(FileHandle &fileHandle) {
+   lock_guard<mutex> latch (storesLatch);
+   return stores()[&fileHandle];
+}
+
+void dropVersionStore(FileHandle &fileHandle) {
+   lock_guard<mutex> latch (storesLatch);
+   stores().erase (&fileHandle);
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+VersionStore::VersionStore() : clock (0)
+{
+}
+
+uint64_t VersionStore::begin() {
+   active.insert (clock);
+   return clock;
+}
+
+void VersionStore::end(uint64_t timestamp) {
+   auto i = active.find (timestamp);
+   if (i != active.end()) active.erase (i);
+   if (active.empty()) {
+      chains.clear();
+      return;
+   }
+
+   // the versions ended by the oldest snapshot are seen by none
+   uint64_t oldest = *active.begin();
+   for (auto chain = chains.begin(); chain != chains.end(); ) {
+      vector<Version> &versions = chain->second;
+      unsigned seen = 0;
+      while (seen < versions.size() && versions[seen].end <= oldest) {
+         ++seen;
+      }
+      versions.erase (versions.begin(), versions.begin() + seen);
+      if (versions.empty()) {
+         chain = chains.erase (chain);
+      } else {
+         ++chain;
+      }
+   }
+}
+
+void VersionStore::keep(const RID &rid, const void *data,
+                        unsigned length) {
+   vector<Version> &versions = chains[versionKey (rid)];
+   uint64_t begin = versions.empty() ? 0 : versions.back().end;
+   ++clock;
+   // with no snapshot taken since the last change of the record, the
+   // version it left is seen by none
+   if (*active.rbegin() < begin) return;
+   versions.push_back (Version());
+   Version &version = versions.back();
+   version.end = clock;
+   version.absent = data == NULL;
+   if (data != NULL) version.data.assign ((const char*) data, length);
+}
+
+const Version* VersionStore::find(const RID &rid,
+                                  uint64_t timestamp) const {
+   auto chain = chains.find (versionKey (rid));
+   if (chain == chains.end()) return NULL;
+   const vector<Version> &versions = chain->second;
+   for (unsigned i = 0; i < versions.size(); ++i) {
+      if (versions[i].end > timestamp) return &versions[i];
+   }
+   return NULL;
+}
+
+unsigned VersionStore::slotLimit(PageNum pageNum) const {
+   RID next = { pageNum + 1, 0 };
+   auto chain = chains.lower_bound (versionKey (next));
+   if (chain == chains.begin()) return 0;
+   --chain;
+   if (chain->first >> 32 != pageNum) return 0;
+   return (unsigned) chain->first + 1;
+}
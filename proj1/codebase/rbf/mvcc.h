@@ -0,0 +1,71 @@
+#ifndef _mvcc_h_
+#define _mvcc_h_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Version store of an open file, for the snapshots of
+// RecordBasedFileManager::beginSnapshot().
+//
+// Every change made while a snapshot of the file is active is given a
+// timestamp (the file's clock, advanced by one) and keeps the record it
+// replaces: the chain of a RID lists the versions it had before its
+// current record, oldest first. Version i was the record of the RID
+// from the end of version i-1 (0 for the first) until its own end, a
+// snapshot taken at time ts sees the first version ending after ts, or
+// the current record if there is none.
+//
+// The versions no active snapshot can see are dropped: when a snapshot
+// ends, and when a change follows another one of the same record
+// without a snapshot taken in between. The store is kept in memory, for
+// one FileHandle, until the file is closed.
+
+struct Version {
+    uint64_t end;          // timestamp of the change that replaced it
+    bool absent;           // there was no record (before an insert)
+    string data;           // else the record, in the API format
+};
+
+struct VersionStore {
+    uint64_t clock;        // timestamp of the last change
+    multiset<uint64_t> active;  // timestamps of the active snapshots
+    map<uint64_t, vector<Version> > chains;  // by versionKey()
+
+    VersionStore();
+
+    // RETURNS: true if the changes must keep the versions they replace
+    bool recording() const { return !active.empty(); }
+
+    // POST: the version store sees the snapshot, taken now
+    uint64_t begin();
+    // POST: drops the versions only the snapshot could see
+    void end(uint64_t timestamp);
+
+    // Keeps the record of rid before a change, data is NULL if there
+    // was none (an insert)
+    // PRE: recording()
+    void keep(const RID &rid, const void *data, unsigned length);
+
+    // RETURNS: the version of rid seen at timestamp, NULL if it is the
+    //          current record
+    const Version* find(const RID &rid, uint64_t timestamp) const;
+
+    // RETURNS: 1 + the largest slot of page pageNum having versions, 0
+    //          if none has
+    unsigned slotLimit(PageNum pageNum) const;
+};
+
+uint64_t versionKey(const RID &rid);
+
+// RETURNS: the version store of an open file, NULL if it has none
+VersionStore* versionStore(FileHandle &fileHandle);
+// The same, created if it does not exist yet
+VersionStore& openVersionStore(FileHandle &fileHandle);
+// POST: the versions of the file are gone (the file is being closed)
+void dropVersionStore(FileHandle &fileHandle);
+
+#endif
@@ -3,15 +3,31 @@
 #include <iostream>
 #include <string>
 #include <cassert>
+#include <cmath>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdexcept>
 #include <stdio.h>
 #include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 #include "pfm.h"
 #include "rbfm.h"
+#include "schema.h"
+#include "lock.h"
+#include "fsm.h"
+#include "partition.h"
+#include "trace.h"
+#include "dump.h"
+#include "csv.h"
+#include "column.h"
+#include "format.h"
 
 using namespace std;
 
@@ -54,6 +70,1405 @@ int main() {
    rc = pfm->closeFile(fh);
    printf("test_04_01: closeFile(fh) returned: %d.\n", rc);
 
+   // record larger than a page: [null byte][Name][Blob][Age]
+   RecordBasedFileManager* rbfm = RecordBasedFileManager::instance();
+   vector<Attribute> desc;
+   Attribute attr;
+   attr.name = "Name"; attr.type = TypeVarChar; attr.length = 30;
+   desc.push_back (attr);
+   attr.name = "Blob"; attr.type = TypeVarChar; attr.length = 10000;
+   desc.push_back (attr);
+   attr.name = "Age"; attr.type = TypeInt; attr.length = 4;
+   desc.push_back (attr);
+
+   char* record = (char*) malloc (12000);
+   char* returned = (char*) malloc (12000);
+   int offset = 1;
+   int len = 4;
+   int age = 42;
+   record[0] = 0;
+   memcpy (record + offset, &len, 4);        offset += 4;
+   memcpy (record + offset, "Jack", len);    offset += len;
+   len = 9000;
+   memcpy (record + offset, &len, 4);        offset += 4;
+   memset (record + offset, 'x', len);       offset += len;
+   memcpy (record + offset, &age, 4);        offset += 4;
+   int recordSize = offset;
+
+   sfname = "05_overflow.t";
+   remove (sfname.c_str());
+   rbfm->createFile (sfname);
+   rc = rbfm->openFile (sfname, fh);
+   RID rid;
+   rc = rbfm->insertRecord (fh, desc, record, rid);
+   printf("test_05_00: insertRecord(9000 byte VarChar) returned: %d.\n",
+          rc);
+   rc = rbfm->readRecord (fh, desc, rid, returned);
+   printf("test_05_01: readRecord returned: %d, data %s.\n", rc,
+          memcmp (record, returned, recordSize) ? "differs" : "matches");
+
+   unsigned reads, writes, appends;
+   fh.collectCounterValues (reads, writes, appends);
+   unsigned before = reads;
+   rc = rbfm->readAttribute (fh, desc, rid, "Age", returned);
+   fh.collectCounterValues (reads, writes, appends);
+   printf("test_05_02: readAttribute(Age) returned: %d, value %d, "
+          "pages read %u.\n", rc, *(int*) (returned + 1), reads - before);
+
+   age = 43;
+   memcpy (record + recordSize - 4, &age, 4);
+   rc = rbfm->updateRecord (fh, desc, record, rid);
+   rc = rbfm->readRecord (fh, desc, rid, returned);
+   printf("test_05_03: updateRecord returned: %d, data %s.\n", rc,
+          memcmp (record, returned, recordSize) ? "differs" : "matches");
+
+   unsigned pages = fh.getNumberOfPages();
+   rc = rbfm->deleteRecord (fh, desc, rid);
+   rc = rbfm->insertRecord (fh, desc, record, rid);
+   printf("test_05_04: reinsert after delete returned: %d, "
+          "overflow pages reused: %s.\n", rc,
+          fh.getNumberOfPages() == pages ? "yes" : "no");
+   rbfm->closeFile (fh);
+   rbfm->destroyFile (sfname);
+   free (record);
+   free (returned);
+
+   // compressed pages: same records, fewer pages
+   vector<Attribute> empDesc;
+   attr.name = "EmpName"; attr.type = TypeVarChar; attr.length = 30;
+   empDesc.push_back (attr);
+   attr.name = "Age"; attr.type = TypeInt; attr.length = 4;
+   empDesc.push_back (attr);
+   attr.name = "Height"; attr.type = TypeReal; attr.length = 4;
+   empDesc.push_back (attr);
+   attr.name = "Salary"; attr.type = TypeInt; attr.length = 4;
+   empDesc.push_back (attr);
+
+   const char* names[] = { "Anteater", "Tom", "Jean", "Marielle" };
+   unsigned numPages[2];
+   int mismatches = 0;
+   for (int compressed = 0; compressed < 2; ++compressed) {
+      sfname = "06_compressed.t";
+      remove (sfname.c_str());
+      rbfm->createFile (sfname, compressed ? RBFM_COMPRESSED : 0);
+      rbfm->openFile (sfname, fh);
+      vector<RID> rids;
+      vector<string> records;
+      for (int i = 0; i < 1000; ++i) {
+         string emp (1, '\0');
+         int nameLen = strlen (names[i % 4]);
+         int empAge = 20 + i % 40;
+         float height = 150 + i % 50;
+         int salary = 5000 + i * 7;
+         emp.append ((char*) &nameLen, 4);
+         emp.append (names[i % 4], nameLen);
+         emp.append ((char*) &empAge, 4);
+         emp.append ((char*) &height, 4);
+         emp.append ((char*) &salary, 4);
+         rbfm->insertRecord (fh, empDesc, emp.data(), rid);
+         rids.push_back (rid);
+         records.push_back (emp);
+      }
+      char buf[100];
+      for (unsigned i = 0; i < rids.size(); ++i) {
+         rbfm->readRecord (fh, empDesc, rids[i], buf);
+         if (memcmp (buf, records[i].data(), records[i].size())) {
+            ++mismatches;
+         }
+      }
+      numPages[compressed] = fh.getNumberOfPages();
+      rbfm->closeFile (fh);
+      rbfm->destroyFile (sfname);
+   }
+   printf("test_06_00: 1000 records, row pages: %u, compressed pages: %u, "
+          "mismatches: %d.\n", numPages[0], numPages[1], mismatches);
+
+   // PAX pages: projected scans with an Int and a VarChar condition
+   sfname = "07_pax.t";
+   remove (sfname.c_str());
+   rc = rbfm->createFile (sfname, RBFM_COMPRESSED | RBFM_PAX);
+   printf("test_07_00: createFile with both page formats returned: %d.\n",
+          rc);
+   remove (sfname.c_str());
+   rbfm->createFile (sfname, RBFM_PAX);
+   rbfm->openFile (sfname, fh);
+   for (int i = 0; i < 1000; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      int salary = 5000 + i * 7;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      rbfm->insertRecord (fh, empDesc, emp.data(), rid);
+   }
+   vector<string> projected (1, "Salary");
+   RBFM_ScanIterator it;
+   char buf[100];
+   int minAge = 50, count = 0;
+   rbfm->scan (fh, empDesc, "Age", GE_OP, &minAge, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   printf("test_07_01: Age >= 50 matched %d of 1000 records.\n", count);
+
+   string tom (4, '\0');
+   *(int*) &tom[0] = 3;
+   tom.append ("Tom");
+   count = 0;
+   rbfm->scan (fh, empDesc, "EmpName", EQ_OP, tom.data(), projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   printf("test_07_02: EmpName = Tom matched %d of 1000 records, "
+          "pages: %u.\n", count, fh.getNumberOfPages());
+   rbfm->closeFile (fh);
+   rbfm->destroyFile (sfname);
+
+   // a full PAX page of tiny rows: one of them moves out on an update
+   vector<Attribute> pairDesc;
+   attr.name = "A"; attr.type = TypeVarChar; attr.length = 300;
+   pairDesc.push_back (attr);
+   attr.name = "B"; attr.type = TypeVarChar; attr.length = 300;
+   pairDesc.push_back (attr);
+   sfname = "07_pax_update.t";
+   remove (sfname.c_str());
+   rbfm->createFile (sfname, RBFM_PAX);
+   rbfm->openFile (sfname, fh);
+   string pair (1, '\0');
+   int one = 1;
+   pair.append ((char*) &one, 4);
+   pair.append ("x");
+   pair.append ((char*) &one, 4);
+   pair.append ("y");
+   RID lastRid;
+   int fill = 0;
+   for (rid.pageNum = 1; rid.pageNum == 1; ++fill) {
+      lastRid = rid;
+      rbfm->insertRecord (fh, pairDesc, pair.data(), rid);
+   }
+   string wide (1, '\0');
+   int wideLen = 300;
+   wide.append ((char*) &wideLen, 4);
+   wide.append (wideLen, 'w');
+   wide.append ((char*) &one, 4);
+   wide.append ("y");
+   rc = rbfm->updateRecord (fh, pairDesc, wide.data(), lastRid);
+   char wideBuf[400];
+   rbfm->readRecord (fh, pairDesc, lastRid, wideBuf);
+   printf("test_07_03: updating the last of %d rows of a PAX page "
+          "returned: %d, same: %d.\n", fill - 1, rc,
+          memcmp (wideBuf, wide.data(), wide.size()) == 0);
+
+   // the moved row outgrows its new page too and moves again: it is
+   // neither lost nor scanned twice
+   PageNum movedTo = fh.getNumberOfPages() - 1;
+   int rows = fill;
+   for (RID filled = rid; filled.pageNum <= movedTo; ++rows) {
+      rbfm->insertRecord (fh, pairDesc, pair.data(), filled);
+   }
+   string wider (1, '\0');
+   wider.append ((char*) &wideLen, 4);
+   wider.append (wideLen, 'w');
+   wider.append ((char*) &wideLen, 4);
+   wider.append (wideLen, 'v');
+   rc = rbfm->updateRecord (fh, pairDesc, wider.data(), lastRid);
+   char widerBuf[700];
+   rbfm->readRecord (fh, pairDesc, lastRid, widerBuf);
+   vector<string> pairNames (1, "B");
+   RBFM_ScanIterator pairIt;
+   int pairsScanned = 0;
+   rbfm->scan (fh, pairDesc, "", NO_OP, NULL, pairNames, pairIt);
+   while (pairIt.getNextRecord (rid, wideBuf) != RBFM_EOF) ++pairsScanned;
+   pairIt.close();
+   printf("test_07_04: moving it again returned: %d, same: %d, rows "
+          "scanned: %d of %d.\n", rc,
+          memcmp (widerBuf, wider.data(), wider.size()) == 0, pairsScanned,
+          rows);
+   rbfm->closeFile (fh);
+   rbfm->destroyFile (sfname);
+
+   // zone map on Salary, which grows with the insertion order
+   sfname = "08_zonemap.t";
+   remove (sfname.c_str());
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, fh);
+   vector<RID> rids;
+   for (int i = 0; i < 1000; ++i) {
+      if (i == 500) {
+         rc = rbfm->createZoneMap (fh, empDesc, "Salary");
+         printf("test_08_00: createZoneMap(Salary) returned: %d.\n", rc);
+      }
+      string emp (1, '\0');
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      int salary = 5000 + i * 7;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      rbfm->insertRecord (fh, empDesc, emp.data(), rid);
+      rids.push_back (rid);
+   }
+   rc = rbfm->createZoneMap (fh, empDesc, "EmpName");
+   printf("test_08_01: createZoneMap(EmpName) returned: %d.\n", rc);
+
+   int maxSalary = 5000 + 100 * 7;
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   count = 0;
+   rbfm->scan (fh, empDesc, "Salary", LT_OP, &maxSalary, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   fh.collectCounterValues (reads, writes, appends);
+   printf("test_08_02: Salary < %d matched %d records, pages read: %u "
+          "of %u.\n", maxSalary, count, reads - before,
+          fh.getNumberOfPages());
+
+   rbfm->deleteRecord (fh, empDesc, rids[0]);
+   count = 0;
+   rbfm->scan (fh, empDesc, "Salary", LT_OP, &maxSalary, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   printf("test_08_03: after a delete Salary < %d matched %d records.\n",
+          maxSalary, count);
+
+   // a NaN on a page summarized by a zone map on Height
+   string nanName = "08_zonemap_nan.t";
+   FileHandle nanFh;
+   remove (nanName.c_str());
+   rbfm->createFile (nanName);
+   rbfm->openFile (nanName, nanFh);
+   float nanHeights[] = { NAN, 1, 2 };
+   for (int i = 0; i < 3; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i]);
+      int empAge = 30;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &nanHeights[i], 4);
+      emp.append ((char*) &empAge, 4);
+      rbfm->insertRecord (nanFh, empDesc, emp.data(), rid);
+   }
+   rc = rbfm->createZoneMap (nanFh, empDesc, "Height");
+   float maxHeight = 5;
+   count = 0;
+   rbfm->scan (nanFh, empDesc, "Height", LT_OP, &maxHeight, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   printf("test_08_04: createZoneMap(Height) returned: %d, Height < 5 of "
+          "NaN, 1, 2 matched %d records.\n", rc, count);
+
+   // a B+-tree on Height sorts the NaNs after the numbers: a range
+   // leaves them out, a full index scan returns them last
+   for (int i = 0; i < 300; ++i) {
+      float height = i % 3 == 0 ? NAN : (float) (i % 50);
+      string emp (1, '\0');
+      int nameLen = strlen (names[0]);
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[0], nameLen);
+      emp.append ((char*) &i, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &i, 4);
+      rbfm->insertRecord (nanFh, empDesc, emp.data(), rid);
+   }
+   rc = rbfm->createBTreeIndex (nanFh, empDesc, "Height");
+   float fromHeight = 10, nanKeyHeight, lastHeight = -1;
+   int inRange = 0, nanInRange = 0, nanKeys = 0;
+   bool nanLast = true;
+   RBFM_IndexScanIterator nanIx;
+   rbfm->indexScan (nanFh, empDesc, "Height", &fromHeight, NULL, false,
+                    false, nanIx);
+   while (nanIx.getNextEntry (rid, &nanKeyHeight) != RBFM_EOF) {
+      ++inRange;
+      nanInRange += std::isnan (nanKeyHeight);
+   }
+   nanIx.close();
+   count = 0;
+   rbfm->indexScan (nanFh, empDesc, "Height", NULL, NULL, false, false,
+                    nanIx);
+   while (nanIx.getNextEntry (rid, &nanKeyHeight) != RBFM_EOF) {
+      ++count;
+      if (std::isnan (nanKeyHeight)) {
+         ++nanKeys;
+      } else {
+         nanLast = nanLast && nanKeys == 0 && nanKeyHeight >= lastHeight;
+         lastHeight = nanKeyHeight;
+      }
+   }
+   nanIx.close();
+   printf("test_08_05: createBTreeIndex(Height) with NaNs returned: %d, "
+          "Height > %.0f: %d entries (%d NaNs), all: %d (%d NaNs), sorted "
+          "with NaNs last: %d.\n", rc, fromHeight, inRange, nanInRange, count,
+          nanKeys, nanLast);
+   rbfm->closeFile (nanFh);
+   rbfm->destroyFile (nanName);
+
+   // hash index on Salary, built on the same records
+   rc = rbfm->createHashIndex (fh, empDesc, "Salary");
+   printf("test_09_00: createHashIndex(Salary) returned: %d.\n", rc);
+   int salary = 5000 + 500 * 7;
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   count = 0;
+   rbfm->scan (fh, empDesc, "Salary", EQ_OP, &salary, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   fh.collectCounterValues (reads, writes, appends);
+   printf("test_09_01: Salary = %d matched %d record, pages read: %u.\n",
+          salary, count, reads - before);
+
+   rbfm->readRecord (fh, empDesc, rids[500], buf);
+   int newSalary = 1;
+   memcpy (buf + 1 + 4 + strlen (names[0]) + 8, &newSalary, 4);
+   rbfm->updateRecord (fh, empDesc, buf, rids[500]);
+   int counts[2] = { 0, 0 };
+   rbfm->scan (fh, empDesc, "Salary", EQ_OP, &salary, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++counts[0];
+   it.close();
+   rbfm->scan (fh, empDesc, "Salary", EQ_OP, &newSalary, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++counts[1];
+   it.close();
+   printf("test_09_02: after an update Salary = %d matched %d, "
+          "Salary = %d matched %d.\n", salary, counts[0], newSalary,
+          counts[1]);
+
+   // B+-tree on Age, which repeats every 40 records
+   rc = rbfm->createBTreeIndex (fh, empDesc, "Age");
+   printf("test_10_00: createBTreeIndex(Age) returned: %d.\n", rc);
+   int fromAge = 59;
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   count = 0;
+   rbfm->scan (fh, empDesc, "Age", GE_OP, &fromAge, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   fh.collectCounterValues (reads, writes, appends);
+   printf("test_10_01: Age >= %d matched %d records, pages read: %u.\n",
+          fromAge, count, reads - before);
+
+   RBFM_IndexScanIterator ix;
+   int lowAge = 30, highAge = 32, key, lastAge = 0;
+   bool sorted = true;
+   rbfm->readRecord (fh, empDesc, rids[1], buf);
+   key = 31;
+   memcpy (buf + 1 + 4 + strlen (names[1]), &key, 4);
+   rbfm->insertRecord (fh, empDesc, buf, rid);
+   count = 0;
+   rbfm->indexScan (fh, empDesc, "Age", &lowAge, &highAge, true, true, ix);
+   while (ix.getNextEntry (rid, &key) != RBFM_EOF) {
+      sorted = sorted && key >= lastAge && key >= lowAge && key <= highAge;
+      lastAge = key;
+      ++count;
+   }
+   ix.close();
+   printf("test_10_02: after an insert %d <= Age <= %d has %d entries, "
+          "sorted: %d.\n", lowAge, highAge, count, sorted);
+
+   // covering B+-tree on Height holding Salary
+   rc = rbfm->createBTreeIndex (fh, empDesc, "Height",
+                                vector<string> (1, "Salary"));
+   printf("test_11_00: createBTreeIndex(Height, {Salary}) returned: %d.\n",
+          rc);
+   float minHeight = 198;
+   int total = 0, scanned = 0;
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   count = 0;
+   rbfm->scan (fh, empDesc, "Height", GT_OP, &minHeight, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+      total += *(int*) (buf + 1);
+      ++count;
+   }
+   it.close();
+   fh.collectCounterValues (reads, writes, appends);
+   rbfm->scan (fh, empDesc, "Height", GT_OP, &minHeight, vector<string>(),
+               it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+      rbfm->readAttribute (fh, empDesc, rid, "Salary", buf);
+      scanned += *(int*) (buf + 1);
+   }
+   it.close();
+   printf("test_11_01: Height > %g matched %d records, pages read: %u, "
+          "same salaries as the records: %d.\n", minHeight, count,
+          reads - before, total == scanned);
+
+   // covering B+-tree on a VarChar: long entries after many short ones
+   vector<Attribute> kpDesc;
+   attr.name = "K"; attr.type = TypeVarChar; attr.length = 300;
+   kpDesc.push_back (attr);
+   attr.name = "P"; attr.type = TypeVarChar; attr.length = 300;
+   kpDesc.push_back (attr);
+   string kpName = "11_btree_split.t";
+   FileHandle kpFh;
+   remove (kpName.c_str());
+   rbfm->createFile (kpName);
+   rbfm->openFile (kpName, kpFh);
+   rc = rbfm->createBTreeIndex (kpFh, kpDesc, "K", vector<string> (1, "P"));
+   for (int i = 0; i < 72; ++i) {
+      char small[8];
+      snprintf (small, sizeof(small), "k%02d", i);
+      string key = i < 60 ? string (small) : string (258, 'a' + i - 60);
+      string value = i < 60 ? string ("p") : string (200, 'p');
+      string kp (1, '\0');
+      int len = key.size();
+      kp.append ((char*) &len, 4);
+      kp.append (key);
+      len = value.size();
+      kp.append ((char*) &len, 4);
+      kp.append (value);
+      rbfm->insertRecord (kpFh, kpDesc, kp.data(), rid);
+   }
+   vector<string> kpNames;
+   kpNames.push_back ("K");
+   kpNames.push_back ("P");
+   string noKey (4, '\0');
+   string kpBuf (1000, '\0');
+   string lastKey;
+   bool kpSorted = true;
+   count = 0;
+   rbfm->scan (kpFh, kpDesc, "K", GE_OP, noKey.data(), kpNames, it);
+   while (it.getNextRecord (rid, &kpBuf[0]) != RBFM_EOF) {
+      string key (&kpBuf[5], *(int*) &kpBuf[1]);
+      kpSorted = kpSorted && lastKey <= key;
+      lastKey = key;
+      ++count;
+   }
+   it.close();
+   printf("test_11_02: createBTreeIndex(K, {P}) returned: %d, K >= \"\" "
+          "matched %d of 72 records, sorted: %d.\n", rc, count, kpSorted);
+   rbfm->closeFile (kpFh);
+   rbfm->destroyFile (kpName);
+
+   // batch read of the records in reverse order (rids[0] is deleted)
+   vector<RID> batch (rids.rbegin(), rids.rend() - 1);
+   vector<string> records (batch.size(), string (100, '\0'));
+   vector<void*> outs;
+   for (unsigned i = 0; i < records.size(); ++i) {
+      outs.push_back (&records[i][0]);
+   }
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   rc = rbfm->readRecords (fh, empDesc, batch, outs);
+   fh.collectCounterValues (reads, writes, appends);
+   bool same = true;
+   for (unsigned i = 0; i < batch.size(); i += 97) {
+      memset (buf, 0, 100);
+      rbfm->readRecord (fh, empDesc, batch[i], buf);
+      same = same && memcmp (buf, records[i].data(), 100) == 0;
+   }
+   printf("test_12_00: readRecords(%u rids) returned: %d, pages read: %u, "
+          "same as readRecord: %d.\n", (unsigned) batch.size(), rc,
+          reads - before, same);
+
+   // [null byte][Salary][EmpName] in one page read
+   vector<string> columns;
+   columns.push_back ("Salary");
+   columns.push_back ("EmpName");
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   rc = rbfm->readAttributes (fh, empDesc, rids[3], columns, buf);
+   fh.collectCounterValues (reads, writes, appends);
+   printf("test_12_01: readAttributes(Salary, EmpName) returned: %d, "
+          "pages read: %u, Salary: %d, EmpName: %.*s.\n", rc,
+          reads - before, *(int*) (buf + 1), *(int*) (buf + 5), buf + 9);
+
+   // equal descriptors share one schema
+   vector<Attribute> copy (empDesc);
+   printf("test_13_00: copy of the descriptor interned once: %d, "
+          "Salary at: %d, Bonus at: %d.\n",
+          &schemaOf (copy) == &schemaOf (empDesc),
+          schemaOf (copy).find ("Salary"), schemaOf (copy).find ("Bonus"));
+
+   // a Schema resolved once reads the same as the descriptor
+   const Schema &empSchema = schemaOf (empDesc);
+   char heldBuf[PAGE_SIZE];
+   rc = rbfm->readAttributes (fh, empSchema, rids[3], columns, heldBuf);
+   // past SCHEMA_LINEAR_MAX the names are hashed
+   vector<Attribute> wideDesc (SCHEMA_LINEAR_MAX + 8, empDesc[1]);
+   for (unsigned i = 0; i < wideDesc.size(); ++i) {
+      wideDesc[i].name = "Col" + to_string (i);
+   }
+   printf("test_13_01: readAttributes(Schema) returned: %d, same: %d, "
+          "Col20 of %u attributes at: %d.\n", rc,
+          memcmp (heldBuf, buf, 9 + *(int*) (buf + 5)) == 0,
+          (unsigned) wideDesc.size(), schemaOf (wideDesc).find ("Col20"));
+
+   // a snapshot keeps seeing the records as they were when it began
+   Snapshot snapshot;
+   int seen[2] = { 0, 0 }, salaries[2] = { 0, 0 }, current = 0;
+   int rcDeleted, rcEnded;
+   rbfm->beginSnapshot (fh, snapshot);
+   for (int pass = 0; pass < 2; ++pass) {
+      if (pass == 1) {
+         // delete, update and insert behind the snapshot's back
+         rbfm->deleteRecord (fh, empDesc, rids[2]);
+         rbfm->readRecord (fh, empDesc, rids[3], buf);
+         *(int*) (buf + 1 + 4 + strlen (names[3]) + 8) += 1000;
+         rbfm->updateRecord (fh, empDesc, buf, rids[3]);
+         rbfm->insertRecord (fh, empDesc, buf, rid);
+      }
+      rbfm->scan (snapshot, empDesc, "Age", NO_OP, NULL, projected, it);
+      while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+         salaries[pass] += *(int*) (buf + 1);
+         ++seen[pass];
+      }
+      it.close();
+   }
+   rbfm->scan (fh, empDesc, "Age", NO_OP, NULL, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++current;
+   it.close();
+   printf("test_14_00: snapshot scan: %d records, after a delete, an "
+          "update and an insert: %d records, same salaries: %d, current "
+          "records: %d.\n", seen[0], seen[1], salaries[0] == salaries[1],
+          current);
+
+   int youngAge = 22;
+   count = 0;
+   rbfm->scan (snapshot, empDesc, "Age", EQ_OP, &youngAge, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   rcDeleted = rbfm->readRecord (snapshot, empDesc, rids[2], buf);
+   age = *(int*) (buf + 1 + 4 + strlen (names[2]));
+   rbfm->endSnapshot (snapshot);
+   rcEnded = rbfm->readRecord (snapshot, empDesc, rids[2], buf);
+   printf("test_14_01: snapshot scan Age = %d matched %d records, deleted "
+          "record read through the snapshot returned: %d, Age %d, after "
+          "endSnapshot: %d.\n", youngAge, count, rcDeleted, age, rcEnded);
+
+   // two-phase locking: shared locks share, a whole file lock waits
+   LockManager *locks = LockManager::instance();
+   Transaction t1, t2;
+   locks->begin (t1);
+   locks->begin (t2);
+   locks->setTimeout (50);
+   int rcShared = locks->lockRecord (t1, fh, rids[5], LOCK_S);
+   rcShared |= locks->lockRecord (t2, fh, rids[5], LOCK_S);
+   int rcFile = locks->lockFile (t2, fh, LOCK_X);
+   locks->releaseAll (t1);
+   locks->releaseAll (t2);
+   printf("test_15_00: two shared record locks returned: %d, exclusive "
+          "file lock over them returned: %d.\n", rcShared, rcFile);
+
+   // t1 and t2 each wait for the record the other holds: one of them
+   // is told to abort, the other one gets the record once it has
+   locks->setTimeout (0);
+   locks->begin (t1);
+   locks->begin (t2);
+   locks->lockRecord (t1, fh, rids[5], LOCK_X);
+   locks->lockRecord (t2, fh, rids[6], LOCK_X);
+   int rcWait[2];
+   thread waiter ([&]() {
+      rcWait[0] = locks->lockRecord (t1, fh, rids[6], LOCK_X);
+      if (rcWait[0] != rc::success) locks->releaseAll (t1);
+   });
+   rcWait[1] = locks->lockRecord (t2, fh, rids[5], LOCK_X);
+   if (rcWait[1] != rc::success) locks->releaseAll (t2);
+   waiter.join();
+   locks->releaseAll (t1);
+   locks->releaseAll (t2);
+   printf("test_15_01: one deadlock: %d, the other lock granted: %d.\n",
+          (rcWait[0] == rc::deadlock) + (rcWait[1] == rc::deadlock) == 1,
+          rcWait[0] == rc::success || rcWait[1] == rc::success);
+
+   // threads updating their own records of one file, and inserting
+   const int threads = 4;
+   int errors = 0;
+   vector<thread> workers;
+   mutex errorsLatch;
+   for (int t = 0; t < threads; ++t) {
+      workers.push_back (thread ([&, t]() {
+         char emp[100];
+         int failed = 0;
+         for (unsigned i = 10 + t; i < rids.size(); i += threads) {
+            Transaction txn;
+            locks->begin (txn);
+            RID inserted;
+            failed += locks->lockRecord (txn, fh, rids[i], LOCK_X) != 0;
+            failed += rbfm->readRecord (fh, empDesc, rids[i], emp) != 0;
+            *(int*) (emp + 1 + 4 + strlen (names[i % 4]) + 8) = -(int) i;
+            failed += rbfm->updateRecord (fh, empDesc, emp, rids[i]) != 0;
+            if (i % 10 == 0) {
+               failed += rbfm->insertRecord (fh, empDesc, emp, inserted) != 0;
+            }
+            locks->releaseAll (txn);
+         }
+         lock_guard<mutex> latch (errorsLatch);
+         errors += failed;
+      }));
+   }
+   for (int t = 0; t < threads; ++t) workers[t].join();
+   bool updated = true;
+   for (unsigned i = 10; i < rids.size(); ++i) {
+      rbfm->readRecord (fh, empDesc, rids[i], buf);
+      updated = updated
+                && *(int*) (buf + 1 + 4 + strlen (names[i % 4]) + 8)
+                   == -(int) i;
+   }
+   count = 0;
+   int salaryLimit = 0;
+   rbfm->scan (fh, empDesc, "Salary", LT_OP, &salaryLimit, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++count;
+   it.close();
+   printf("test_15_02: %d threads updating records returned errors: %d, "
+          "updates all there: %d, negative salaries: %d.\n", threads,
+          errors, updated, count);
+
+   // shared requests waiting behind an exclusive lock: granting one
+   // wakes those queued after it, none waits out the timeout
+   locks->setTimeout (2000);
+   bool sharedGranted = true;
+   chrono::steady_clock::time_point queued = chrono::steady_clock::now();
+   for (int round = 0; round < 20 && sharedGranted; ++round) {
+      Transaction holder, readers[threads];
+      locks->begin (holder);
+      locks->lockRecord (holder, fh, rids[7], LOCK_X);
+      int rcReaders[threads];
+      workers.clear();
+      for (int r = 0; r < threads; ++r) {
+         workers.push_back (thread ([&, r]() {
+            locks->begin (readers[r]);
+            rcReaders[r] = locks->lockRecord (readers[r], fh, rids[7],
+                                              LOCK_S);
+         }));
+      }
+      this_thread::sleep_for (chrono::milliseconds (10));
+      locks->releaseAll (holder);
+      // all granted before any is released
+      for (int r = 0; r < threads; ++r) {
+         workers[r].join();
+         sharedGranted = sharedGranted && rcReaders[r] == rc::success;
+      }
+      for (int r = 0; r < threads; ++r) locks->releaseAll (readers[r]);
+   }
+   double queuedSeconds = chrono::duration<double> (
+                             chrono::steady_clock::now() - queued).count();
+   locks->setTimeout (0);
+   printf("test_15_03: queued shared locks granted: %d, without waiting "
+          "out the timeout: %d.\n", sharedGranted, queuedSeconds < 2);
+
+   // an update in place only holds the latch of its page: it goes on
+   // while another page is latched, an update of that page waits
+   RID near = rids[10], far = rids[10];
+   for (unsigned i = 10; i < rids.size(); ++i) {
+      if (rids[i].pageNum % PAGE_LATCHES != near.pageNum % PAGE_LATCHES) {
+         far = rids[i];
+         break;
+      }
+   }
+   atomic<int> farDone (0), nearDone (0);
+   bool nearWaited;
+   {
+      lock_guard<mutex> held (fh.pageLatch (near.pageNum));
+      workers.clear();
+      workers.push_back (thread ([&]() {
+         char emp[100];
+         rbfm->readRecord (fh, empDesc, far, emp);
+         farDone = rbfm->updateRecord (fh, empDesc, emp, far) == 0 ? 1 : -1;
+      }));
+      workers.push_back (thread ([&]() {
+         char emp[100];
+         while (farDone == 0) this_thread::yield();
+         rbfm->readRecord (fh, empDesc, near, emp);
+         nearDone = rbfm->updateRecord (fh, empDesc, emp, near) == 0
+                    ? 1 : -1;
+      }));
+      while (farDone == 0) this_thread::yield();
+      this_thread::sleep_for (chrono::milliseconds (10));
+      nearWaited = nearDone == 0;
+   }
+   for (int t = 0; t < 2; ++t) workers[t].join();
+   printf("test_15_04: update of another page while one is latched: %d, "
+          "update of the latched page waited: %d, then done: %d.\n",
+          (int) farDone, nearWaited, (int) nearDone);
+
+   // inserts into a file of full pages choose a page from the free
+   // space map, not by reading them
+   rbfm->closeFile (fh);
+   rbfm->openFile (sfname, fh);
+   for (unsigned i = 10; i < rids.size(); i += 20) {
+      rbfm->deleteRecord (fh, empDesc, rids[i]);
+   }
+   rbfm->readRecord (fh, empDesc, rids[11], buf);
+   unsigned filePages = fh.getNumberOfPages();
+   fh.collectCounterValues (reads, writes, appends);
+   before = reads;
+   for (int i = 0; i < 200; ++i) rbfm->insertRecord (fh, empDesc, buf, rid);
+   fh.collectCounterValues (reads, writes, appends);
+   printf("test_16_00: 200 inserts into a file of %u pages read %u pages, "
+          "pages added: %u.\n", filePages, reads - before,
+          fh.getNumberOfPages() - filePages);
+
+   // each inserting thread fills pages of its own; the threads end
+   // together, as the page of an ended thread is given to the others
+   map<unsigned, set<int> > pageThreads;
+   atomic<int> inserting (threads);
+   workers.clear();
+   for (int t = 0; t < threads; ++t) {
+      workers.push_back (thread ([&, t]() {
+         vector<RID> mine;
+         RID inserted;
+         for (int i = 0; i < 250; ++i) {
+            rbfm->insertRecord (fh, empDesc, buf, inserted);
+            mine.push_back (inserted);
+         }
+         --inserting;
+         while (inserting > 0) this_thread::yield();
+         lock_guard<mutex> latch (errorsLatch);
+         for (unsigned i = 0; i < mine.size(); ++i) {
+            pageThreads[mine[i].pageNum].insert (t);
+         }
+      }));
+   }
+   for (int t = 0; t < threads; ++t) workers[t].join();
+   int shared = 0;
+   for (auto i = pageThreads.begin(); i != pageThreads.end(); ++i) {
+      shared += i->second.size() > 1;
+   }
+   printf("test_16_01: %d threads inserted into %u pages, pages shared "
+          "by threads: %d.\n", threads, (unsigned) pageThreads.size(),
+          shared);
+   FreeSpaceMap *fsm = freeSpaceMap (fh);
+   printf("test_16_02: insert pages kept for ended threads: %d.\n",
+          (int) fsm->insertPages.size() - (fsm->insertPage() != NO_PAGE));
+   rbfm->closeFile (fh);
+   rbfm->destroyFile (sfname);
+
+   // threads appending pages of their own to a paged file (as run files
+   // and dumps do, outside the record functions) each get a page
+   string appendName = "append_race";
+   FileHandle appendFh;
+   pfm->createFile (appendName);
+   pfm->openFile (appendName, appendFh);
+   atomic<int> appendErrors (0);
+   workers.clear();
+   for (int t = 0; t < threads; ++t) {
+      workers.push_back (thread ([&, t]() {
+         char page[PAGE_SIZE];
+         for (int i = 0; i < 100; ++i) {
+            memset (page, 0, PAGE_SIZE);
+            int tag = t * 100 + i;
+            memcpy (page, &tag, sizeof(tag));
+            if (appendFh.appendPage (page) != rc::success) ++appendErrors;
+         }
+      }));
+   }
+   for (int t = 0; t < threads; ++t) workers[t].join();
+   set<int> tags;
+   char appended[PAGE_SIZE];
+   for (unsigned i = 0; i < appendFh.getNumberOfPages(); ++i) {
+      int tag = -1;
+      if (appendFh.readPage (i, appended) == rc::success) {
+         memcpy (&tag, appended, sizeof(tag));
+      }
+      tags.insert (tag);
+   }
+   printf("test_16_03: %d threads appended %u pages, errors: %d, "
+          "pages kept: %u.\n", threads, appendFh.getNumberOfPages(),
+          (int) appendErrors, (unsigned) tags.size());
+   pfm->closeFile (appendFh);
+   pfm->destroyFile (appendName);
+
+   // partitioned tables: hash partitions on Age, scanned in parallel or
+   // pruned to the partition of an Age
+   PartitionManager *pm = PartitionManager::instance();
+   sfname = "17_table.t";
+   pm->destroyTable (sfname);
+   PartitionSpec spec;
+   spec.scheme = PARTITION_HASH;
+   spec.count = 4;
+   spec.attribute = "Age";
+   rc = pm->createTable (sfname, empDesc, spec, 0);
+   TableHandle th;
+   pm->openTable (sfname, th);
+   vector<TableRID> trids;
+   TableRID trid;
+   total = 0;
+   scanned = 0;
+   for (int i = 0; i < 1000; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      int salary = 5000 + i * 7;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      pm->insertRecord (th, empDesc, emp.data(), trid);
+      trids.push_back (trid);
+      total += salary;
+   }
+   TableScanIterator tit;
+   pm->scan (th, empDesc, "", NO_OP, NULL, projected, tit);
+   count = 0;
+   while (tit.getNextRecord (trid, buf) != RBFM_EOF) {
+      ++count;
+      scanned += *(int*) (buf + 1);
+   }
+   printf("test_17_00: createTable returned: %d, scan of %u partitions: "
+          "%d records, same salaries: %d.\n", rc, tit.partitions(), count,
+          scanned == total);
+   age = 33;
+   pm->scan (th, empDesc, "Age", EQ_OP, &age, projected, tit);
+   count = 0;
+   while (tit.getNextRecord (trid, buf) != RBFM_EOF) ++count;
+   printf("test_17_01: Age = 33 scanned %u partition(s), records: %d.\n",
+          tit.partitions(), count);
+
+   // a new Age moves the record to its partition
+   trid = trids[0];
+   pm->readRecord (th, empDesc, trid, buf);
+   age = 61;
+   memcpy (buf + 1 + 4 + strlen (names[0]), &age, 4);
+   rc = pm->updateRecord (th, empDesc, buf, trid);
+   int readAge = 0;
+   pm->readRecord (th, empDesc, trid, buf);
+   memcpy (&readAge, buf + 1 + 4 + strlen (names[0]), 4);
+   pm->scan (th, empDesc, "Age", EQ_OP, &age, projected, tit);
+   count = 0;
+   while (tit.getNextRecord (trid, buf) != RBFM_EOF) ++count;
+   tit.close();
+   printf("test_17_02: updateRecord returned: %d, Age read: %d, "
+          "records of Age 61: %d.\n", rc, readAge, count);
+   vector<string> unknownNames (1, "Weight");
+   RC unknownRc = pm->scan (th, empDesc, "", NO_OP, NULL, unknownNames,
+                            tit);
+   TableHandle closedTh;
+   RC closedRc = pm->scan (closedTh, empDesc, "Age", EQ_OP, &age,
+                           projected, tit);
+   pm->closeTable (th);
+   pm->destroyTable (sfname);
+
+   // range partitions on Salary, and round robin ones
+   map<unsigned, int> perPartition;
+   int rangeCounts[2];
+   unsigned rangePartitions[2];
+   for (int scheme = 0; scheme < 2; ++scheme) {
+      spec.scheme = scheme ? PARTITION_ROUND_ROBIN : PARTITION_RANGE;
+      spec.attribute = "Salary";
+      spec.bounds.clear();
+      for (int bound = 6000; bound <= 10000 && !scheme; bound += 2000) {
+         spec.bounds.push_back (string ((char*) &bound, 4));
+      }
+      pm->createTable (sfname, empDesc, spec, 0);
+      pm->openTable (sfname, th);
+      for (int i = 0; i < 1000; ++i) {
+         string emp (1, '\0');
+         int nameLen = strlen (names[i % 4]);
+         int empAge = 20 + i % 40;
+         float height = 150 + i % 50;
+         int salary = 5000 + i * 7;
+         emp.append ((char*) &nameLen, 4);
+         emp.append (names[i % 4], nameLen);
+         emp.append ((char*) &empAge, 4);
+         emp.append ((char*) &height, 4);
+         emp.append ((char*) &salary, 4);
+         pm->insertRecord (th, empDesc, emp.data(), trid);
+         if (scheme) ++perPartition[trid.partition];
+      }
+      for (int op = 0; op < 2 && !scheme; ++op) {
+         int salaryBound = op ? 10000 : 7000;
+         pm->scan (th, empDesc, "Salary", op ? GE_OP : LT_OP, &salaryBound,
+                   projected, tit);
+         rangeCounts[op] = 0;
+         while (tit.getNextRecord (trid, buf) != RBFM_EOF) ++rangeCounts[op];
+         rangePartitions[op] = tit.partitions();
+         tit.close();
+      }
+      pm->closeTable (th);
+      pm->destroyTable (sfname);
+   }
+   printf("test_17_03: Salary < 7000 scanned %u partitions, records: %d, "
+          "Salary >= 10000 scanned %u, records: %d.\n", rangePartitions[0],
+          rangeCounts[0], rangePartitions[1], rangeCounts[1]);
+   printf("test_17_04: round robin records per partition: %d %d %d %d.\n",
+          perPartition[0], perPartition[1], perPartition[2],
+          perPartition[3]);
+   printf("test_17_05: scan projecting an unknown attribute returned: %d, "
+          "scan of a closed table: %d.\n", unknownRc, closedRc);
+
+   // metrics: latencies of the record and page operations, and the work
+   // they did
+   sfname = "18_metrics.t";
+   remove (sfname.c_str());
+   rbfm->createFile (sfname);
+   FileHandle mfh;
+   rbfm->openFile (sfname, mfh);
+   vector<RID> mrids;
+   for (int i = 0; i < 400; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      int salary = 5000 + i * 7;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      rbfm->insertRecord (mfh, empDesc, emp.data(), rid);
+      mrids.push_back (rid);
+   }
+   // longer names move records off their full pages
+   string longName (30, 'x');
+   for (unsigned i = 0; i < mrids.size(); i += 4) {
+      string emp (1, '\0');
+      int nameLen = longName.size(), empAge = 30, salary = 1;
+      float height = 160;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (longName);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      rbfm->updateRecord (mfh, empDesc, emp.data(), mrids[i]);
+   }
+   for (unsigned i = 0; i < mrids.size(); ++i) {
+      rbfm->readRecord (mfh, empDesc, mrids[i], buf);
+   }
+   for (unsigned i = 1; i < mrids.size(); i += 4) {
+      rbfm->deleteRecord (mfh, empDesc, mrids[i]);
+   }
+   for (unsigned i = 1; i < mrids.size(); i += 4) {
+      rbfm->insertRecord (mfh, empDesc, buf, rid);
+   }
+   rbfm->scan (mfh, empDesc, "", NO_OP, NULL, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF);
+   it.close();
+   MetricsSnapshot metrics;
+   mfh.metrics().collect (metrics);
+   mfh.collectCounterValues (reads, writes, appends);
+   const Histogram *latency = metrics.latencies;
+   printf("test_18_00: operations timed, inserts: %llu, updates: %llu, "
+          "reads: %llu, deletes: %llu, scan calls: %llu.\n",
+          (unsigned long long) latency[LATENCY_INSERT].count,
+          (unsigned long long) latency[LATENCY_UPDATE].count,
+          (unsigned long long) latency[LATENCY_READ].count,
+          (unsigned long long) latency[LATENCY_DELETE].count,
+          (unsigned long long) latency[LATENCY_SCAN].count);
+   bool ordered = true;
+   for (int l = 0; l < LATENCIES; ++l) {
+      const Histogram &h = latency[l];
+      ordered = ordered && h.quantile (0.5) <= h.quantile (0.99)
+                && h.quantile (0.99) <= h.max;
+   }
+   printf("test_18_01: page reads timed: %d, bytes read: %d, bytes "
+          "written: %d, quantiles ordered: %d.\n",
+          latency[LATENCY_READ_PAGE].count == reads,
+          metrics.counters[COUNTER_BYTES_READ] == (uint64_t) reads
+                                                  * PAGE_SIZE,
+          metrics.counters[COUNTER_BYTES_WRITTEN]
+             == (uint64_t) (writes + appends) * PAGE_SIZE, ordered);
+   string json = metrics.json();
+   printf("test_18_02: forward hops: %d, compactions: %d, fsm probes: %d, "
+          "json: %s.\n", metrics.counters[COUNTER_FORWARD_HOPS] > 0,
+          metrics.counters[COUNTER_COMPACTIONS] > 0,
+          metrics.counters[COUNTER_FSM_PROBES] > 0,
+          json.substr (0, json.find (',')).c_str());
+   rbfm->closeFile (mfh);
+   rbfm->destroyFile (sfname);
+
+   // traces: the record calls made on a file, replayed on another
+   sfname = "19_trace.t";
+   string traceName = "19_trace.trace.t";
+   remove (sfname.c_str());
+   rbfm->createFile (sfname);
+   FileHandle tfh;
+   rbfm->openFile (sfname, tfh);
+   vector<RID> trace;
+   for (int i = 0; i < 100; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      int salary = 5000 + i * 7;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      rbfm->insertRecord (tfh, empDesc, emp.data(), rid);
+      trace.push_back (rid);
+   }
+   rc = startTrace (tfh, traceName);
+   for (int i = 0; i < 50; ++i) {
+      rbfm->readRecord (tfh, empDesc, trace[i], buf);
+   }
+   for (int i = 0; i < 20; ++i) {
+      rbfm->readRecord (tfh, empDesc, trace[i], buf);
+      rbfm->updateRecord (tfh, empDesc, buf, trace[i]);
+   }
+   for (int i = 20; i < 30; ++i) rbfm->deleteRecord (tfh, empDesc, trace[i]);
+   for (int i = 0; i < 30; ++i) rbfm->insertRecord (tfh, empDesc, buf, rid);
+   rbfm->scan (tfh, empDesc, "", NO_OP, NULL, projected, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF);
+   it.close();
+   RC stopped = stopTrace (tfh);
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   vector<TraceEvent> events;
+   RC read = readTrace (traceName, events);
+   int ops[TRACE_OPS] = { 0 };
+   bool sized = true;
+   for (unsigned i = 0; i < events.size(); ++i) {
+      ++ops[events[i].op];
+      // 1 + 4 + a name of 3 to 8 bytes + 12
+      if (events[i].op <= TRACE_UPDATE) {
+         sized = sized && events[i].size >= 20 && events[i].size <= 25;
+      }
+   }
+   printf("test_19_00: startTrace returned: %d, stopTrace: %d, readTrace: "
+          "%d, inserts: %d, reads: %d, updates: %d, deletes: %d, scans: "
+          "%d, scan calls: %d, sizes traced: %d.\n", rc, stopped, read,
+          ops[TRACE_INSERT], ops[TRACE_READ], ops[TRACE_UPDATE],
+          ops[TRACE_DELETE], ops[TRACE_SCAN_OPEN], ops[TRACE_SCAN_NEXT],
+          sized);
+   rbfm->createFile (sfname, RBFM_PAX);
+   rbfm->openFile (sfname, tfh);
+   ReplayResult replayed;
+   rc = replayTrace (tfh, events, false, replayed);
+   MetricsSnapshot replayMetrics;
+   tfh.metrics().collect (replayMetrics);
+   printf("test_19_01: replayTrace returned: %d, calls: %u, records "
+          "loaded first: %u, failed: %u, reads timed: %llu.\n", rc,
+          replayed.events, replayed.preloaded, replayed.errors,
+          (unsigned long long) replayMetrics.latencies[LATENCY_READ].count);
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   remove (traceName.c_str());
+
+   // bulk loading, then export / import of the file both ways
+   rbfm->createFile (sfname, RBFM_COMPRESSED);
+   rbfm->openFile (sfname, tfh);
+   rbfm->createBTreeIndex (tfh, empDesc, "Salary");
+   vector<string> bulk;
+   for (int i = 0; i < 3000; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      int salary = 5000 + i * 7;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      emp.append ((char*) &height, 4);
+      emp.append ((char*) &salary, 4);
+      bulk.push_back (emp);
+   }
+   vector<const void*> bulkData;
+   for (unsigned i = 0; i < bulk.size(); ++i) {
+      bulkData.push_back (bulk[i].data());
+   }
+   vector<RID> bulkRids;
+   unsigned pagesBefore = tfh.getNumberOfPages();
+   rc = rbfm->bulkAppend (tfh, empDesc, bulkData, bulkRids);
+   unsigned bulkPages = tfh.getNumberOfPages() - pagesBefore;
+   same = true;
+   for (unsigned i = 0; i < bulk.size(); ++i) {
+      rbfm->readRecord (tfh, empDesc, bulkRids[i], buf);
+      same = same && memcmp (buf, bulk[i].data(), bulk[i].size()) == 0;
+   }
+   int wanted = 5000 + 1234 * 7;
+   rbfm->scan (tfh, empDesc, "Salary", EQ_OP, &wanted, projected, it);
+   scanned = 0;
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++scanned;
+   it.close();
+   printf("test_20_00: bulkAppend returned: %d, records read back: %d, "
+          "pages written: %d, index entries found: %d.\n", rc, same,
+          bulkPages > 1 && bulkPages < 3000 / 20, scanned);
+   for (unsigned i = 0; i < 1000; ++i) {
+      rbfm->deleteRecord (tfh, empDesc, bulkRids[i]);
+   }
+   string dumpName = sfname + ".dump";
+   FILE *stream = fopen (dumpName.c_str(), "w+b");
+   RC exported = exportFile (tfh, empDesc, DUMP_PAGES, stream);
+   pages = tfh.getNumberOfPages();
+   rewind (stream);
+   string copyName = sfname + ".copy";
+   vector<Attribute> copyDesc;
+   rc = importFile (stream, copyName, 0, copyDesc);
+   fclose (stream);
+   FileHandle cfh;
+   rbfm->openFile (copyName, cfh);
+   same = cfh.getNumberOfPages() == pages && copyDesc.size() == 4
+          && copyDesc[1].name == "Age";
+   for (unsigned i = 1000; i < bulk.size(); ++i) {
+      rbfm->readRecord (cfh, empDesc, bulkRids[i], buf);
+      same = same && memcmp (buf, bulk[i].data(), bulk[i].size()) == 0;
+   }
+   rbfm->scan (cfh, empDesc, "Salary", EQ_OP, &wanted, projected, it);
+   scanned = 0;
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) ++scanned;
+   it.close();
+   rbfm->closeFile (cfh);
+   rbfm->destroyFile (copyName);
+   printf("test_20_01: page export returned: %d, import: %d, same file: "
+          "%d, index entries found: %d.\n", exported, rc, same, scanned);
+   stream = fopen (dumpName.c_str(), "w+b");
+   exported = exportFile (tfh, empDesc, DUMP_RECORDS, stream);
+   rewind (stream);
+   rc = importFile (stream, copyName, RBFM_PAX, copyDesc);
+   rbfm->openFile (copyName, cfh);
+   rbfm->scan (cfh, empDesc, "", NO_OP, NULL, projected, it);
+   scanned = 0;
+   total = 0;
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+      ++scanned;
+      int salary;
+      memcpy (&salary, buf + 1, 4);
+      total += salary;
+   }
+   it.close();
+   bool packed = cfh.getNumberOfPages() < pages;
+   rbfm->closeFile (cfh);
+   rbfm->destroyFile (copyName);
+   // a truncated stream is refused and leaves no file behind
+   long length = ftell (stream);
+   fclose (stream);
+   truncate (dumpName.c_str(), length - 4);
+   stream = fopen (dumpName.c_str(), "rb");
+   RC truncated = importFile (stream, copyName, 0, copyDesc);
+   fclose (stream);
+   struct stat copyStat;
+   bool left = stat (copyName.c_str(), &copyStat) == 0;
+   remove (dumpName.c_str());
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   printf("test_20_02: record export returned: %d, import: %d, records: "
+          "%d, salaries: %d, fewer pages: %d, truncated import: %d, "
+          "file left: %d.\n", exported, rc, scanned, total,
+          packed, truncated, left);
+
+   // delimited text: quoting, nulls, rejected lines, several chunks
+   string csvName = sfname + ".csv";
+   FILE *csv = fopen (csvName.c_str(), "wb");
+   fprintf (csv, "EmpName,Age,Height,Salary\r\n"
+                 "\"Smith, \"\"Jr\"\"\",41,170.5,9000\r\n"
+                 ",,,\n"
+                 "\"\",30,1e2,-12\n"
+                 "\n"
+                 "Anne,3x,160,100\n"
+                 "Bob,30,160\n"
+                 "A name longer than the thirty bytes,30,160,100\n");
+   fclose (csv);
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, tfh);
+   CsvOptions csvOptions;
+   csvOptions.header = true;
+   CsvResult loaded;
+   rc = loadCsv (tfh, empDesc, csvName, csvOptions, loaded);
+   vector<string> all;
+   for (unsigned i = 0; i < empDesc.size(); ++i) {
+      all.push_back (empDesc[i].name);
+   }
+   string fields;
+   rbfm->scan (tfh, empDesc, "", NO_OP, NULL, all, it);
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+      unsigned nameLen;
+      memcpy (&nameLen, buf + 1, 4);
+      if (buf[0] & 0x80) {
+         fields += "null/";
+         continue;
+      }
+      float height;
+      memcpy (&height, buf + 5 + nameLen + 4, 4);
+      memcpy (&salary, buf + 5 + nameLen + 8, 4);
+      fields += string (buf + 5, nameLen) + "," + to_string ((int) height)
+                + "," + to_string (salary) + "/";
+   }
+   it.close();
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   printf("test_21_00: loadCsv returned: %d, records: %llu, rejected: "
+          "%llu, fields: %s\n", rc, (unsigned long long) loaded.records,
+          (unsigned long long) loaded.rejected, fields.c_str());
+   csv = fopen (csvName.c_str(), "wb");
+   for (int i = 0; i < 300000; ++i) {
+      fprintf (csv, "%s,%d,%d.5,%d\n", names[i % 4], 20 + i % 40,
+               150 + i % 50, i);
+   }
+   fclose (csv);
+   rbfm->createFile (sfname, RBFM_COMPRESSED);
+   rbfm->openFile (sfname, tfh);
+   csvOptions.header = false;
+   csvOptions.threads = 4;
+   rc = loadCsv (tfh, empDesc, csvName, csvOptions, loaded);
+   rbfm->scan (tfh, empDesc, "", NO_OP, NULL, projected, it);
+   scanned = 0;
+   ordered = true;
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+      memcpy (&salary, buf + 1, 4);
+      ordered = ordered && salary == scanned;
+      ++scanned;
+   }
+   it.close();
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   remove (csvName.c_str());
+   printf("test_21_01: loadCsv of %d chunks returned: %d, records: %llu, "
+          "rejected: %llu, scanned: %d, in order: %d.\n",
+          (int) ((loaded.bytes + CSV_CHUNK - 1) / CSV_CHUNK), rc,
+          (unsigned long long) loaded.records,
+          (unsigned long long) loaded.rejected, scanned, ordered);
+
+   // column store: projected scans, chunks skipped by their min / max
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, tfh);
+   bulk.clear();
+   for (int i = 0; i < 100000; ++i) {
+      string emp (1, i % 10 == 0 ? '\x20' : '\0');   // some null heights
+      int nameLen = strlen (names[i % 4]);
+      int empAge = 20 + i % 40;
+      float height = 150 + i % 50;
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i % 4], nameLen);
+      emp.append ((char*) &empAge, 4);
+      if (i % 10 != 0) emp.append ((char*) &height, 4);
+      emp.append ((char*) &i, 4);
+      bulk.push_back (emp);
+   }
+   bulkData.clear();
+   for (unsigned i = 0; i < bulk.size(); ++i) {
+      bulkData.push_back (bulk[i].data());
+   }
+   rbfm->bulkAppend (tfh, empDesc, bulkData, bulkRids);
+   string storeName = sfname + ".cols";
+   rc = exportColumns (tfh, empDesc, storeName);
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   vector<string> heightSalary;
+   heightSalary.push_back ("Height");
+   heightSalary.push_back ("Salary");
+   ColumnScanIterator cit;
+   RC opened = scanColumns (storeName, "", NO_OP, NULL, heightSalary, cit);
+   scanned = 0;
+   ordered = true;
+   int nulls = 0;
+   while (cit.getNextRecord (buf) != RBFM_EOF) {
+      nulls += (buf[0] & 0x80) != 0;
+      memcpy (&salary, buf + 1 + ((buf[0] & 0x80) ? 0 : 4), 4);
+      ordered = ordered && salary == scanned;
+      ++scanned;
+   }
+   cit.close();
+   printf("test_22_00: exportColumns returned: %d, scanColumns: %d, "
+          "records: %d, in order: %d, null heights: %d.\n", rc, opened,
+          scanned, ordered, nulls);
+   int fromSalary = 90000;
+   scanColumns (storeName, "Salary", GE_OP, &fromSalary, projected, cit);
+   scanned = 0;
+   while (cit.getNextRecord (buf) != RBFM_EOF) ++scanned;
+   unsigned skipped = cit.skipped();
+   cit.close();
+   string jean ("\x04\0\0\0Jean", 8);
+   vector<string> nameAge;
+   nameAge.push_back ("EmpName");
+   nameAge.push_back ("Age");
+   scanColumns (storeName, "EmpName", EQ_OP, jean.data(), nameAge, cit);
+   int jeans = 0;
+   same = true;
+   while (cit.getNextRecord (buf) != RBFM_EOF) {
+      ++jeans;
+      same = same && memcmp (buf + 1, jean.data(), jean.size()) == 0;
+   }
+   cit.close();
+   string zed ("\x03\0\0\0Zed", 7);
+   scanColumns (storeName, "EmpName", GE_OP, zed.data(), nameAge, cit);
+   while (cit.getNextRecord (buf) != RBFM_EOF);
+   unsigned allSkipped = cit.skipped();
+   cit.close();
+   RC destroyed = destroyColumns (storeName);
+   printf("test_22_01: salaries from 90000: %d, chunks skipped: %u, "
+          "Jeans: %d, names read: %d, chunks skipped for names >= Zed: "
+          "%u, destroyColumns returned: %d.\n", scanned, skipped, jeans,
+          same, allSkipped, destroyed);
+
+   // a NaN first in a chunk of Height
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, tfh);
+   vector<string> nanBulk;
+   for (int i = 0; i < 3; ++i) {
+      string emp (1, '\0');
+      int nameLen = strlen (names[i]);
+      emp.append ((char*) &nameLen, 4);
+      emp.append (names[i], nameLen);
+      emp.append ((char*) &i, 4);
+      emp.append ((char*) &nanHeights[i], 4);
+      emp.append ((char*) &i, 4);
+      nanBulk.push_back (emp);
+   }
+   vector<const void*> nanData;
+   for (unsigned i = 0; i < nanBulk.size(); ++i) {
+      nanData.push_back (nanBulk[i].data());
+   }
+   rbfm->bulkAppend (tfh, empDesc, nanData, bulkRids);
+   rc = exportColumns (tfh, empDesc, storeName);
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   scanColumns (storeName, "Height", LT_OP, &maxHeight, projected, cit);
+   scanned = 0;
+   while (cit.getNextRecord (buf) != RBFM_EOF) ++scanned;
+   cit.close();
+   destroyColumns (storeName);
+   printf("test_22_02: exportColumns returned: %d, Height < 5 of NaN, 1, "
+          "2 matched %d records.\n", rc, scanned);
+
+   // record formatting, and a CSV written out loaded back
+   string odd (1, '\x20');      // null Height
+   string oddName ("Jo,\t\"Q\"");
+   int oddLen = oddName.size();
+   int oddAge = -2147483647 - 1;
+   int oddSalary = 7;
+   odd.append ((char*) &oddLen, 4);
+   odd.append (oddName);
+   odd.append ((char*) &oddAge, 4);
+   odd.append ((char*) &oddSalary, 4);
+   char line[128];
+   string lines;
+   RecordStyle styles[] = { STYLE_TEXT, STYLE_CSV, STYLE_JSON };
+   for (unsigned i = 0; i < 3; ++i) {
+      unsigned len = formatRecord (empDesc, odd.data(), styles[i], line,
+                                   sizeof(line));
+      lines.append (line, len);
+   }
+   bool cut = formatRecord (empDesc, odd.data(), STYLE_JSON, line, 20) == 0;
+   printf("test_23_00: formatted: %s", lines.c_str());
+   printf("test_23_00: line cut short: %d.\n", cut);
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, tfh);
+   bulkData.assign (1, odd.data());
+   for (unsigned i = 0; i < 5000; ++i) bulkData.push_back (bulk[i].data());
+   rbfm->bulkAppend (tfh, empDesc, bulkData, bulkRids);
+   csv = fopen (csvName.c_str(), "wb");
+   rc = writeRecords (tfh, empDesc, STYLE_CSV, csv);
+   fclose (csv);
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   rbfm->createFile (sfname);
+   rbfm->openFile (sfname, tfh);
+   csvOptions.threads = 1;
+   loadCsv (tfh, empDesc, csvName, csvOptions, loaded);
+   rbfm->scan (tfh, empDesc, "", NO_OP, NULL, all, it);
+   scanned = 0;
+   same = true;
+   while (it.getNextRecord (rid, buf) != RBFM_EOF) {
+      const string &original = scanned == 0 ? odd : bulk[scanned - 1];
+      same = same && memcmp (buf, original.data(), original.size()) == 0;
+      ++scanned;
+   }
+   it.close();
+   rbfm->closeFile (tfh);
+   rbfm->destroyFile (sfname);
+   remove (csvName.c_str());
+   printf("test_23_01: writeRecords returned: %d, records loaded back: "
+          "%d, rejected: %llu, same: %d.\n", rc, scanned,
+          (unsigned long long) loaded.rejected, same);
+
    cout << "done" << endl;
    return 0;
 }
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "page.h"
+#include "metrics.h"
+#include "schema.h"
+
+
+//
+// PAGE LEVEL
+//
+
+void initPage(char *page, uint8_t type) {
+   memset (page, 0, PAGE_SIZE);
+   PageFooter *footer = pageFooter (page);
+   footer->freeOffset = 0;
+   footer->numSlots = 0;
+   footer->next = NO_PAGE;
+   footer->type = type;
+}
+
+// start of the slot directory
+static unsigned slotDirBegin(char *page) {
+   return PAGE_SIZE - sizeof(PageFooter)
+          - pageFooter (page)->numSlots * sizeof(Slot);
+}
+
+unsigned pageFreeSpace(char *page) {
+   PageFooter *footer = pageFooter (page);
+   unsigned used = 0;
+   for (unsigned i = 0; i < footer->numSlots; ++i) {
+      Slot *slot = pageSlot (page, i);
+      if (slot->offset != SLOT_EMPTY) used += cellLength (slot);
+   }
+   return slotDirBegin (page) - footer->headerLen - used;
+}
+
+static int firstEmptySlot(char *page) {
+   PageFooter *footer = pageFooter (page);
+   for (unsigned i = 0; i < footer->numSlots; ++i) {
+      if (pageSlot (page, i)->offset == SLOT_EMPTY) return i;
+   }
+   return -1;
+}
+
+bool pageHasRoom(char *page, unsigned len) {
+   len = std::max (len, MIN_CELL);
+   unsigned need = len;
+   if (firstEmptySlot (page) < 0) need += sizeof(Slot);
+   return need <= pageFreeSpace (page);
+}
+
+void pageCompact(char *page) {
+   countMetric (COUNTER_COMPACTIONS);
+   PageFooter *footer = pageFooter (page);
+   // live slots ordered by cell offset
+   vector<unsigned> order;
+   for (unsigned i = 0; i < footer->numSlots; ++i) {
+      if (pageSlot (page, i)->offset != SLOT_EMPTY) order.push_back (i);
+   }
+   std::sort (order.begin(), order.end(),
+              [page](unsigned a, unsigned b) {
+                 return pageSlot (page, a)->offset
+                        < pageSlot (page, b)->offset;
+              });
+   unsigned dest = footer->headerLen;
+   for (unsigned i : order) {
+      Slot *slot = pageSlot (page, i);
+      unsigned len = cellLength (slot);
+      if (slot->offset != dest) {
+         memmove (page + dest, page + slot->offset, len);
+         slot->offset = dest;
+      }
+      dest += len;
+   }
+   footer->freeOffset = dest;
+}
+
+// Copies a cell to the free space
+// PRE: there is len bytes of contiguous free space
+static void placeCell(char *page, Slot *slot, const void *cell,
+                      unsigned len, uint16_t flags) {
+   PageFooter *footer = pageFooter (page);
+   unsigned cellLen = std::max (len, MIN_CELL);
+   memcpy (page + footer->freeOffset, cell, len);
+   memset (page + footer->freeOffset + len, 0, cellLen - len);
+   slot->offset = footer->freeOffset;
+   slot->length = cellLen | flags;
+   footer->freeOffset += cellLen;
+}
+
+int pageInsertCell(char *page, const void *cell, unsigned len,
+                   uint16_t flags) {
+   if (!pageHasRoom (page, len)) return -1;
+   PageFooter *footer = pageFooter (page);
+   int slotNum = firstEmptySlot (page);
+   unsigned need = std::max (len, MIN_CELL);
+   if (slotNum < 0) need += sizeof(Slot);
+   // compact before the directory grows over the last cell
+   if (footer->freeOffset + need > slotDirBegin (page)) {
+      pageCompact (page);
+   }
+   if (slotNum < 0) {
+      slotNum = footer->numSlots++;
+   }
+   placeCell (page, pageSlot (page, slotNum), cell, len, flags);
+   return slotNum;
+}
+
+bool pageReplaceCell(char *page, unsigned slotNum, const void *cell,
+                     unsigned len, uint16_t flags) {
+   Slot *slot = pageSlot (page, slotNum);
+   unsigned oldLen = cellLength (slot);
+   unsigned cellLen = std::max (len, MIN_CELL);
+   if (cellLen <= oldLen) {
+      // shrink in place, the tail is reclaimed by compaction
+      memmove (page + slot->offset, cell, len);
+      memset (page + slot->offset + len, 0, cellLen - len);
+      slot->length = cellLen | flags;
+      return true;
+   }
+   if (cellLen > pageFreeSpace (page) + oldLen) return false;
+
+   // cell may point into the page
+   vector<char> copy ((const char*) cell, (const char*) cell + len);
+   PageFooter *footer = pageFooter (page);
+   if (slot->offset + oldLen == footer->freeOffset
+       && footer->freeOffset + cellLen - oldLen <= slotDirBegin (page)) {
+      // last cell, grow it in place
+      footer->freeOffset = slot->offset;
+   } else {
+      slot->offset = SLOT_EMPTY;
+      if (footer->freeOffset + cellLen > slotDirBegin (page)) {
+         pageCompact (page);
+      }
+   }
+   placeCell (page, slot, copy.data(), len, flags);
+   return true;
+}
+
+void pageEraseCell(char *page, unsigned slotNum) {
+   PageFooter *footer = pageFooter (page);
+   Slot *slot = pageSlot (page, slotNum);
+   if (slot->offset + cellLength (slot) == footer->freeOffset) {
+      footer->freeOffset = slot->offset;
+   }
+   slot->offset = SLOT_EMPTY;
+   slot->length = 0;
+   // trailing empty slots give their directory space back
+   while (footer->numSlots > 0
+          && pageSlot (page, footer->numSlots - 1)->offset == SLOT_EMPTY) {
+      --footer->numSlots;
+   }
+}
+
+
+//
+// API FORMAT
+//
+
+unsigned valueLength(AttrType type, const char *value) {
+   if (type != TypeVarChar) return sizeof(int);
+   uint32_t len;
+   memcpy (&len, value, sizeof(len));
+   return sizeof(len) + len;
+}
+
+unsigned tupleSize(const vector<Attribute> &recordDescriptor,
+                   const void *data) {
+   const char *nulls = (const char*) data;
+   unsigned size = nullBytes (recordDescriptor.size());
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      if (isNull (nulls, i)) continue;
+      size += valueLength (recordDescriptor[i].type, nulls + size);
+   }
+   return size;
+}
+
+unsigned tupleMax(const vector<Attribute> &recordDescriptor) {
+   const Schema &schema = schemaOf (recordDescriptor);
+   unsigned size = nullBytes (recordDescriptor.size());
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      size += schema.valueMax[i];
+   }
+   return size;
+}
+
+bool compareField(AttrType type, const char *bytes, unsigned len,
+                  CompOp compOp, const char *value) {
+   int cmp = 0;
+   switch (type) {
+      case TypeInt: {
+         int a, b;
+         memcpy (&a, bytes, sizeof(a));
+         memcpy (&b, value, sizeof(b));
+         cmp = (a > b) - (a < b);
+         break;
+      }
+      case TypeReal: {
+         float a, b;
+         memcpy (&a, bytes, sizeof(a));
+         memcpy (&b, value, sizeof(b));
+         cmp = (a > b) - (a < b);
+         break;
+      }
+      case TypeVarChar: {
+         uint32_t valueLen;
+         memcpy (&valueLen, value, sizeof(valueLen));
+         cmp = memcmp (bytes, value + sizeof(valueLen),
+                       std::min (len, valueLen));
+         if (cmp == 0) cmp = (len > valueLen) - (len < valueLen);
+         break;
+      }
+   }
+   switch (compOp) {
+      case EQ_OP: return cmp == 0;
+      case LT_OP: return cmp < 0;
+      case LE_OP: return cmp <= 0;
+      case GT_OP: return cmp > 0;
+      case GE_OP: return cmp >= 0;
+      case NE_OP: return cmp != 0;
+      case NO_OP: return true;
+   }
+   return false;
+}
+
+
+//
+// FILE LEVEL
+//
+
+RC readHeader(FileHandle &fileHandle, FileHeader &header) {
+   if (fileHandle.getNumberOfPages() == 0) {
+      RC_MSG (rc::not_a_record_file, "\n");
+      return rc::not_a_record_file;
+   }
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = fileHandle.readPage (0, page);
+   if (rcode == rc::success) {
+      memcpy (&header, page, sizeof(header));
+      if (header.magic != RBFM_MAGIC
+          || pageFooter (page)->type != PAGE_HEADER) {
+         RC_MSG (rc::not_a_record_file, "\n");
+         rcode = rc::not_a_record_file;
+      }
+   }
+   free (page);
+   return rcode;
+}
+
+RC writeHeader(FileHandle &fileHandle, const FileHeader &header) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   initPage (page, PAGE_HEADER);
+   memcpy (page, &header, sizeof(header));
+   RC rcode;
+   if (fileHandle.getNumberOfPages() == 0) {
+      rcode = fileHandle.appendPage (page);
+   } else {
+      rcode = fileHandle.writePage (0, page);
+   }
+   free (page);
+   return rcode;
+}
+
+RC allocPage(FileHandle &fileHandle, uint8_t type, char *page,
+             PageNum &pageNum) {
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+
+   uint8_t format = FORMAT_ROW;
+   if (header.flags & RBFM_COMPRESSED) format = FORMAT_COMPRESSED;
+   if (header.flags & RBFM_PAX) format = FORMAT_PAX;
+
+   if (header.freeList == NO_PAGE) {
+      initPage (page, type);
+      if (type == PAGE_DATA) pageFooter (page)->format = format;
+      pageNum = fileHandle.getNumberOfPages();
+      return fileHandle.appendPage (page);
+   }
+
+   pageNum = header.freeList;
+   rcode = fileHandle.readPage (pageNum, page);
+   if (rcode != rc::success) return rcode;
+   if (pageFooter (page)->type != PAGE_FREE) {
+      RC_MSG (rc::bad_page_type, "[pageNum: %d]\n", pageNum);
+      return rc::bad_page_type;
+   }
+   header.freeList = pageFooter (page)->next;
+   rcode = writeHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+
+   initPage (page, type);
+   if (type == PAGE_DATA) pageFooter (page)->format = format;
+   return fileHandle.writePage (pageNum, page);
+}
+
+RC freePage(FileHandle &fileHandle, PageNum pageNum) {
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+
+   char *page = (char*) malloc (PAGE_SIZE);
+   initPage (page, PAGE_FREE);
+   pageFooter (page)->next = header.freeList;
+   rcode = fileHandle.writePage (pageNum, page);
+   free (page);
+   if (rcode != rc::success) return rcode;
+
+   header.freeList = pageNum;
+   return writeHeader (fileHandle, header);
+}
+
+RC writeOverflow(FileHandle &fileHandle, const char *bytes,
+                 unsigned len, PageNum &firstPage) {
+   // allocate the whole chain first so that every page can be
+   // written once with its link in place
+   unsigned count = (len + OVERFLOW_CAPACITY - 1) / OVERFLOW_CAPACITY;
+   vector<PageNum> chain (count);
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   for (unsigned i = 0; i < count && rcode == rc::success; ++i) {
+      rcode = allocPage (fileHandle, PAGE_OVERFLOW, page, chain[i]);
+   }
+   for (unsigned i = 0; i < count && rcode == rc::success; ++i) {
+      unsigned chunk = std::min (len - i * OVERFLOW_CAPACITY,
+                                 OVERFLOW_CAPACITY);
+      initPage (page, PAGE_OVERFLOW);
+      memcpy (page, bytes + i * OVERFLOW_CAPACITY, chunk);
+      pageFooter (page)->freeOffset = chunk;
+      pageFooter (page)->next = i + 1 < count ? chain[i + 1] : NO_PAGE;
+      rcode = fileHandle.writePage (chain[i], page);
+   }
+   free (page);
+   firstPage = count > 0 ? chain[0] : NO_PAGE;
+   return rcode;
+}
+
+RC readOverflow(FileHandle &fileHandle, const OverflowRef &ref,
+                char *out) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   unsigned done = 0;
+   PageNum pageNum = ref.firstPage;
+   while (pageNum != NO_PAGE && done < ref.length) {
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) break;
+      PageFooter *footer = pageFooter (page);
+      if (footer->type != PAGE_OVERFLOW) {
+         RC_MSG (rc::bad_page_type, "[pageNum: %d]\n", pageNum);
+         rcode = rc::bad_page_type;
+         break;
+      }
+      unsigned chunk = std::min ((unsigned) footer->freeOffset,
+                                 ref.length - done);
+      memcpy (out + done, page, chunk);
+      done += chunk;
+      pageNum = footer->next;
+   }
+   free (page);
+   return rcode;
+}
+
+RC freeOverflow(FileHandle &fileHandle, PageNum firstPage) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   PageNum pageNum = firstPage;
+   while (pageNum != NO_PAGE) {
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) break;
+      if (pageFooter (page)->type != PAGE_OVERFLOW) {
+         RC_MSG (rc::bad_page_type, "[pageNum: %d]\n", pageNum);
+         rcode = rc::bad_page_type;
+         break;
+      }
+      PageNum next = pageFooter (page)->next;
+      rcode = freePage (fileHandle, pageNum);
+      if (rcode != rc::success) break;
+      pageNum = next;
+   }
+   free (page);
+   return rcode;
+}
@@ -0,0 +1,317 @@
+#ifndef _page_h_
+#define _page_h_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../rbf/pfm.h"
+#include "../rbf/rbfm.h"
+
+// On-disk layout of record-based files.
+//
+// Page 0 of every RBFM file is the header page (FileHeader at offset
+// 0).  Every page, header included, ends with a PageFooter that tells
+// what kind of page it is, so the other pages can be told apart.
+//
+// Data page (FORMAT_ROW, see cpage.h and pax.h for the other formats):
+//   [cells ->            free space           <- slot directory][footer]
+//   - cells grow up from offset 0, footer.freeOffset is the first
+//     byte after the last cell
+//   - slot i lives at PAGE_SIZE - sizeof(PageFooter) - (i+1)*sizeof(Slot)
+//   - a cell is either a record (internal format, below) or a
+//     forwarding RID left behind by an update that did not fit
+//
+// Overflow page (one link of a spilled VarChar value):
+//   [value bytes                                              ][footer]
+//   - footer.freeOffset is the number of value bytes on the page
+//   - footer.next is the next page of the chain, NO_PAGE on the last
+//
+// Free page: only footer.next is used, it links the free page list
+// that starts at FileHeader::freeList.
+//
+// Zone map page (see zonemap.h): [Zone entries][footer], footer.next
+// is the next page of the map.
+//
+// Hash index pages (see hashindex.h): a directory of bucket pages and
+// the bucket pages themselves.
+//
+// B+-tree pages (see btree.h): inner nodes and leaves.
+//
+// Structures kept next to the records (zone maps, ...) are listed in
+// FileHeader::aux with the first page of each.
+//
+// Internal record format (O(1) access to any field):
+//   [uint16 numFields][null bitmap ceil(n/8)][uint16 fieldEnd[n]][data]
+//   - fieldEnd[i] is the offset from the record start one past the
+//     last byte of field i; field i starts where field i-1 ends
+//   - VarChars are stored without their length prefix, the length is
+//     the difference of the two offsets
+//   - a null field takes no bytes (fieldEnd[i] == fieldEnd[i-1])
+//   - if FIELD_OVERFLOW is set in fieldEnd[i] the field bytes are an
+//     OverflowRef to a chain of overflow pages holding the VarChar
+
+#define RBFM_MAGIC      0x4d464252   // "RBFM"
+#define RBFM_VERSION    1
+
+// Records larger than this are kept dense by spilling their largest
+// VarChars to overflow pages.
+#define RBFM_INLINE_MAX (PAGE_SIZE / 4)
+
+const uint32_t NO_PAGE = 0xFFFFFFFF;
+
+enum PageType {
+    PAGE_FREE = 0,
+    PAGE_HEADER,
+    PAGE_DATA,
+    PAGE_OVERFLOW,
+    PAGE_ZONEMAP,
+    PAGE_HASHDIR,
+    PAGE_HASHBUCKET,
+    PAGE_BTREE_INNER,
+    PAGE_BTREE_LEAF
+};
+
+// how the cells of a data page are stored
+enum PageFormat {
+    FORMAT_ROW = 0,
+    FORMAT_COMPRESSED,     // cpage.h
+    FORMAT_PAX             // pax.h
+};
+
+struct PageFooter {
+    uint16_t freeOffset;   // first free byte / bytes used
+    uint16_t numSlots;     // entries in the slot directory
+    uint32_t next;         // overflow chain / free list link
+    uint8_t  type;         // PageType
+    uint8_t  format;       // PageFormat of a data page
+    uint16_t headerLen;    // bytes before the first cell
+};
+
+enum AuxKind {
+    AUX_NONE = 0,
+    AUX_ZONEMAP,
+    AUX_HASH,
+    AUX_BTREE
+};
+
+// a structure built on one attribute of the records
+struct AuxEntry {
+    uint8_t  kind;         // AuxKind
+    uint8_t  type;         // AttrType of the attribute
+    uint16_t attr;         // position of the attribute in the record
+                           // descriptor
+    uint32_t root;         // its first page
+    uint32_t covered;      // AUX_BTREE: bit i is set if the leaf entries
+                           // also hold attribute i (a covering index)
+};
+
+#define RBFM_MAX_AUX    32
+
+struct FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;        // file options (RBFM_* in rbfm.h)
+    uint32_t freeList;     // first page of the free page list
+    uint32_t auxCount;
+    AuxEntry aux[RBFM_MAX_AUX];
+};
+
+// slot directory entry
+struct Slot {
+    uint16_t offset;       // SLOT_EMPTY if the slot is unused
+    uint16_t length;       // cell length | SLOT_* flags
+};
+
+const uint16_t SLOT_EMPTY    = 0xFFFF;
+const uint16_t SLOT_FORWARD  = 0x8000;  // cell is a RID to follow
+const uint16_t SLOT_MOVED    = 0x4000;  // cell was forwarded to, skip
+                                        // it when scanning
+const uint16_t SLOT_LEN_MASK = 0x1FFF;
+
+const uint16_t FIELD_OVERFLOW = 0x8000;
+
+// a spilled VarChar
+struct OverflowRef {
+    uint32_t firstPage;
+    uint32_t length;
+};
+
+// cell of a forwarded slot
+struct ForwardRef {
+    uint32_t pageNum;
+    uint32_t slotNum;
+};
+
+// every cell is at least this long so that it can be turned into a
+// forwarding cell in place
+const unsigned MIN_CELL = sizeof(ForwardRef);
+
+// largest cell an empty data page can hold
+const unsigned MAX_CELL = PAGE_SIZE - sizeof(PageFooter) - sizeof(Slot);
+
+// bytes of value a single overflow page holds
+const unsigned OVERFLOW_CAPACITY = PAGE_SIZE - sizeof(PageFooter);
+
+
+// unaligned access to the uint16 fields inside records
+inline uint16_t get16(const char *p) {
+   uint16_t v;
+   memcpy (&v, p, sizeof(v));
+   return v;
+}
+
+inline void put16(char *p, uint16_t v) {
+   memcpy (p, &v, sizeof(v));
+}
+
+inline unsigned nullBytes(unsigned fieldCount) {
+   return (fieldCount + CHAR_BIT - 1) / CHAR_BIT;
+}
+
+// k-th bit from the left
+inline bool isNull(const char *nulls, unsigned k) {
+   return nulls[k / CHAR_BIT] & (1 << (CHAR_BIT - 1 - k % CHAR_BIT));
+}
+
+inline void setNull(char *nulls, unsigned k) {
+   nulls[k / CHAR_BIT] |= (1 << (CHAR_BIT - 1 - k % CHAR_BIT));
+}
+
+
+//
+// INTERNAL RECORDS
+//
+
+// [numFields][null bitmap][fieldEnd[n]]
+inline unsigned recordHeaderSize(unsigned fieldCount) {
+   return sizeof(uint16_t) + nullBytes (fieldCount)
+          + fieldCount * sizeof(uint16_t);
+}
+
+inline const char* recordNulls(const char *record) {
+   return record + sizeof(uint16_t);
+}
+
+// Bytes [begin, end) of field i of an internal record
+inline void fieldBounds(const char *record, unsigned i, unsigned &begin,
+                        unsigned &end, bool &overflow) {
+   unsigned fieldCount = get16 (record);
+   const char *ends = recordNulls (record) + nullBytes (fieldCount);
+   if (i == 0) {
+      begin = recordHeaderSize (fieldCount);
+   } else {
+      begin = get16 (ends + (i - 1) * sizeof(uint16_t)) & ~FIELD_OVERFLOW;
+   }
+   uint16_t fieldEnd = get16 (ends + i * sizeof(uint16_t));
+   end = fieldEnd & ~FIELD_OVERFLOW;
+   overflow = fieldEnd & FIELD_OVERFLOW;
+}
+
+// A slot of a page decoded to internal records. Pages in the formats
+// that are re-encoded as a whole on every change (FORMAT_COMPRESSED,
+// FORMAT_PAX) are modified through this.
+struct PageEntry {
+    bool used;
+    uint16_t flags;        // SLOT_FORWARD / SLOT_MOVED
+    string cell;           // internal record or ForwardRef
+};
+
+
+//
+// API FORMAT (page.cc)
+//
+
+// RETURNS: bytes of a value, a VarChar with its length
+unsigned valueLength(AttrType type, const char *value);
+
+// RETURNS: bytes of a record
+unsigned tupleSize(const vector<Attribute> &recordDescriptor,
+                   const void *data);
+
+// RETURNS: largest size of a record of the descriptor (see
+//          Schema::valueMax)
+unsigned tupleMax(const vector<Attribute> &recordDescriptor);
+
+// RETURNS: whether "field compOp value" holds, for a non null field of
+//          len bytes (a VarChar without its length) and a value in the
+//          API format
+bool compareField(AttrType type, const char *bytes, unsigned len,
+                  CompOp compOp, const char *value);
+
+
+//
+// PAGE LEVEL (page.cc)
+//
+
+inline PageFooter* pageFooter(char *page) {
+   return (PageFooter*) (page + PAGE_SIZE - sizeof(PageFooter));
+}
+
+inline Slot* pageSlot(char *page, unsigned slotNum) {
+   return (Slot*) (page + PAGE_SIZE - sizeof(PageFooter)) 
+          - (slotNum + 1);
+}
+
+inline char* pageCell(char *page, unsigned slotNum) {
+   return page + pageSlot(page, slotNum)->offset;
+}
+
+inline unsigned cellLength(const Slot *slot) {
+   return slot->length & SLOT_LEN_MASK;
+}
+
+void initPage(char *page, uint8_t type);
+
+// bytes available for cells once the page is compacted
+unsigned pageFreeSpace(char *page);
+
+// true if a new cell of len bytes (and its slot) fits
+bool pageHasRoom(char *page, unsigned len);
+
+// Stores a new cell, compacting the page if needed. Reuses an empty
+// slot before growing the directory.
+// RETURNS: slot number, -1 if there is no room
+int pageInsertCell(char *page, const void *cell, unsigned len,
+                   uint16_t flags);
+
+// Replaces the cell of a live slot keeping its slot number.
+// RETURNS: false if there is no room, the page is left untouched
+bool pageReplaceCell(char *page, unsigned slotNum, const void *cell,
+                     unsigned len, uint16_t flags);
+
+// Empties the slot, the bytes are reclaimed by the next compaction
+void pageEraseCell(char *page, unsigned slotNum);
+
+// Moves all cells down to remove the holes left by erased cells
+void pageCompact(char *page);
+
+
+//
+// FILE LEVEL (page.cc)
+//
+
+RC readHeader(FileHandle &fileHandle, FileHeader &header);
+RC writeHeader(FileHandle &fileHandle, const FileHeader &header);
+
+// Gets an empty page of the given type, from the free list if it is
+// not empty or by appending to the file. A data page gets the format
+// the file options ask for.
+// POST: page holds the initialized (and written) page
+RC allocPage(FileHandle &fileHandle, uint8_t type, char *page, 
+             PageNum &pageNum);
+
+// Puts pageNum on the free page list
+RC freePage(FileHandle &fileHandle, PageNum pageNum);
+
+// Spills len bytes to a new chain of overflow pages
+RC writeOverflow(FileHandle &fileHandle, const char *bytes, 
+                 unsigned len, PageNum &firstPage);
+
+// Reads a whole chain into out (at least ref.length bytes)
+RC readOverflow(FileHandle &fileHandle, const OverflowRef &ref,
+                char *out);
+
+// Frees every page of a chain
+RC freeOverflow(FileHandle &fileHandle, PageNum firstPage);
+
+#endif
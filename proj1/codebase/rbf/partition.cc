@@ -0,0 +1,534 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "partition.h"
+#include "page.h"
+#include "hashindex.h"
+#include "btree.h"
+#include "schema.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+const uint32_t TABLE_MAGIC = 0x54424C31;     // "TBL1"
+
+// Page 0 of the table file, followed by the partitioning attribute and
+// the bounds, each as [uint16_t length][bytes]
+struct TableHeader {
+    uint32_t magic;
+    uint8_t  scheme;           // PartitionScheme
+    uint8_t  type;             // of the partitioning attribute
+    uint16_t count;
+};
+
+static string partitionName(const string &tableName, unsigned i) {
+   return tableName + "." + to_string (i);
+}
+
+// a value in the API format as a btreeKey(), uncut
+static string valueKey(AttrType type, const char *value) {
+   if (type != TypeVarChar) return string (value, sizeof(int));
+   uint32_t len;
+   memcpy (&len, value, sizeof(len));
+   return string (value + sizeof(len), len);
+}
+
+// Finds field attr of a record in the API format
+// RETURNS: false if the field is null
+static bool tupleValue(const vector<Attribute> &recordDescriptor,
+                       const char *data, unsigned attr, string &key) {
+   const char *in = data + nullBytes (recordDescriptor.size());
+   for (unsigned i = 0; i < attr; ++i) {
+      if (isNull (data, i)) continue;
+      uint32_t len = sizeof(int);
+      if (recordDescriptor[i].type == TypeVarChar) {
+         memcpy (&len, in, sizeof(len));
+         len += sizeof(len);
+      }
+      in += len;
+   }
+   if (isNull (data, attr)) return false;
+   key = valueKey (recordDescriptor[attr].type, in);
+   return true;
+}
+
+// RETURNS: the range partition of key, the number of bounds <= key
+static unsigned rangeOf(const TableHandle &tableHandle,
+                        const string &key) {
+   AttrType type = tableHandle.type;
+   return upper_bound (tableHandle.bounds.begin(), tableHandle.bounds.end(),
+                       key, [type](const string &a, const string &b) {
+                          return btreeCompare (type, a, b) < 0;
+                       }) - tableHandle.bounds.begin();
+}
+
+static bool put(string &page, const string &bytes) {
+   uint16_t len = bytes.size();
+   if (page.size() + sizeof(len) + len > PAGE_SIZE) return false;
+   page.append ((const char*) &len, sizeof(len));
+   page.append (bytes);
+   return true;
+}
+
+static bool get(const char *page, unsigned &offset, string &bytes) {
+   uint16_t len;
+   if (offset + sizeof(len) > PAGE_SIZE) return false;
+   memcpy (&len, page + offset, sizeof(len));
+   offset += sizeof(len);
+   if (offset + len > PAGE_SIZE) return false;
+   bytes.assign (page + offset, len);
+   offset += len;
+   return true;
+}
+
+static RC checkSpec(const vector<Attribute> &recordDescriptor,
+                    const PartitionSpec &spec, AttrType &type) {
+   if (spec.count == 0 || spec.count > PARTITION_MAX
+       || spec.scheme > PARTITION_RANGE) {
+      RC_MSG (rc::invalid_file_options, "[partitions: %u]\n", spec.count);
+      return rc::invalid_file_options;
+   }
+   type = TypeInt;
+   if (spec.scheme == PARTITION_ROUND_ROBIN) return rc::success;
+   int attr = schemaOf (recordDescriptor).find (spec.attribute);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", spec.attribute.c_str());
+      return rc::attribute_not_found;
+   }
+   type = recordDescriptor[attr].type;
+   if (spec.scheme == PARTITION_HASH) return rc::success;
+   bool sorted = spec.bounds.size() == spec.count - 1;
+   for (unsigned i = 1; i < spec.bounds.size() && sorted; ++i) {
+      sorted = btreeCompare (type, valueKey (type, spec.bounds[i - 1].data()),
+                             valueKey (type, spec.bounds[i].data())) < 0;
+   }
+   if (!sorted) {
+      RC_MSG (rc::invalid_file_options, "[bounds: %u, partitions: %u]\n",
+              (unsigned) spec.bounds.size(), spec.count);
+      return rc::invalid_file_options;
+   }
+   return rc::success;
+}
+
+static RC readSpec(const string &tableName, PartitionSpec &spec,
+                   AttrType &type) {
+   PagedFileManager *pfm = PagedFileManager::instance();
+   FileHandle fileHandle;
+   RC rcode = pfm->openFile (tableName, fileHandle);
+   if (rcode != rc::success) return rcode;
+   char *page = (char*) malloc (PAGE_SIZE);
+   if (fileHandle.getNumberOfPages() == 0) {
+      rcode = rc::not_a_record_file;
+   } else {
+      rcode = fileHandle.readPage (0, page);
+   }
+   pfm->closeFile (fileHandle);
+
+   TableHeader header;
+   memcpy (&header, page, sizeof(header));
+   unsigned offset = sizeof(header);
+   bool valid = rcode == rc::success && header.magic == TABLE_MAGIC
+                && get (page, offset, spec.attribute);
+   if (valid) {
+      spec.scheme = (PartitionScheme) header.scheme;
+      spec.count = header.count;
+      type = (AttrType) header.type;
+      unsigned bounds = spec.scheme == PARTITION_RANGE ? spec.count - 1 : 0;
+      spec.bounds.resize (bounds);
+      for (unsigned i = 0; i < bounds && valid; ++i) {
+         valid = get (page, offset, spec.bounds[i]);
+      }
+   }
+   free (page);
+   if (rcode == rc::success && !valid) {
+      RC_MSG (rc::not_a_record_file, "[table: %s]\n", tableName.c_str());
+      rcode = rc::not_a_record_file;
+   }
+   return rcode;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+TableHandle::TableHandle() : type (TypeInt), next (0)
+{
+}
+
+TableHandle::~TableHandle()
+{
+   for (unsigned i = 0; i < files.size(); ++i) delete files[i];
+}
+
+PartitionManager* PartitionManager::_partition_manager = 0;
+
+PartitionManager* PartitionManager::instance()
+{
+    if(!_partition_manager)
+        _partition_manager = new PartitionManager();
+
+    return _partition_manager;
+}
+
+PartitionManager::PartitionManager()
+{
+    _rbfm = RecordBasedFileManager::instance();
+}
+
+PartitionManager::~PartitionManager()
+{
+}
+
+RC PartitionManager::createTable(const string &tableName,
+                                 const vector<Attribute> &recordDescriptor,
+                                 const PartitionSpec &spec,
+                                 unsigned options) {
+   AttrType type;
+   RC rcode = checkSpec (recordDescriptor, spec, type);
+   if (rcode != rc::success) return rcode;
+
+   TableHeader header;
+   memset (&header, 0, sizeof(header));
+   header.magic = TABLE_MAGIC;
+   header.scheme = spec.scheme;
+   header.type = type;
+   header.count = spec.count;
+   string page ((const char*) &header, sizeof(header));
+   bool fits = put (page, spec.attribute);
+   for (unsigned i = 0; i < spec.bounds.size() && fits; ++i) {
+      fits = put (page, spec.bounds[i]);
+   }
+   if (!fits) {
+      RC_MSG (rc::header_full, "[table: %s]\n", tableName.c_str());
+      return rc::header_full;
+   }
+   page.resize (PAGE_SIZE, '\0');
+
+   PagedFileManager *pfm = PagedFileManager::instance();
+   rcode = pfm->createFile (tableName);
+   if (rcode != rc::success) return rcode;
+   FileHandle fileHandle;
+   rcode = pfm->openFile (tableName, fileHandle);
+   if (rcode != rc::success) return rcode;
+   rcode = fileHandle.appendPage (page.data());
+   pfm->closeFile (fileHandle);
+   for (unsigned i = 0; i < spec.count && rcode == rc::success; ++i) {
+      rcode = _rbfm->createFile (partitionName (tableName, i), options);
+   }
+   return rcode;
+}
+
+RC PartitionManager::destroyTable(const string &tableName) {
+   PartitionSpec spec;
+   AttrType type;
+   RC rcode = readSpec (tableName, spec, type);
+   if (rcode != rc::success) return rcode;
+   for (unsigned i = 0; i < spec.count; ++i) {
+      RC destroyed = _rbfm->destroyFile (partitionName (tableName, i));
+      if (rcode == rc::success) rcode = destroyed;
+   }
+   RC destroyed = PagedFileManager::instance()->destroyFile (tableName);
+   return rcode == rc::success ? destroyed : rcode;
+}
+
+RC PartitionManager::openTable(const string &tableName,
+                               TableHandle &tableHandle) {
+   if (!tableHandle.files.empty()) {
+      RC_MSG (rc::file_handle_in_use, "[table: %s]\n", tableName.c_str());
+      return rc::file_handle_in_use;
+   }
+   RC rcode = readSpec (tableName, tableHandle.spec, tableHandle.type);
+   if (rcode != rc::success) return rcode;
+   tableHandle.bounds.clear();
+   for (unsigned i = 0; i < tableHandle.spec.bounds.size(); ++i) {
+      tableHandle.bounds.push_back (valueKey (tableHandle.type,
+                                              tableHandle.spec.bounds[i]
+                                                 .data()));
+   }
+   tableHandle.next = 0;
+   for (unsigned i = 0; i < tableHandle.spec.count; ++i) {
+      FileHandle *fileHandle = new FileHandle;
+      rcode = _rbfm->openFile (partitionName (tableName, i), *fileHandle);
+      if (rcode != rc::success) {
+         delete fileHandle;
+         closeTable (tableHandle);
+         return rcode;
+      }
+      tableHandle.files.push_back (fileHandle);
+   }
+   return rc::success;
+}
+
+RC PartitionManager::closeTable(TableHandle &tableHandle) {
+   if (tableHandle.files.empty()) {
+      RC_MSG (rc::file_handle_empty, "\n");
+      return rc::file_handle_empty;
+   }
+   RC rcode = rc::success;
+   for (unsigned i = 0; i < tableHandle.files.size(); ++i) {
+      RC closed = _rbfm->closeFile (*tableHandle.files[i]);
+      if (rcode == rc::success) rcode = closed;
+      delete tableHandle.files[i];
+   }
+   tableHandle.files.clear();
+   return rcode;
+}
+
+RC PartitionManager::insertRecord(TableHandle &tableHandle,
+                                  const vector<Attribute> &recordDescriptor,
+                                  const void *data, TableRID &rid) {
+   RC rcode = partitionOf (tableHandle, recordDescriptor, data,
+                           rid.partition);
+   if (rcode != rc::success) return rcode;
+   return _rbfm->insertRecord (*tableHandle.files[rid.partition],
+                               recordDescriptor, data, rid.rid);
+}
+
+RC PartitionManager::readRecord(TableHandle &tableHandle,
+                                const vector<Attribute> &recordDescriptor,
+                                const TableRID &rid, void *data) {
+   if (rid.partition >= tableHandle.files.size()) {
+      RC_MSG (rc::invalid_rid, "[partition: %u]\n", rid.partition);
+      return rc::invalid_rid;
+   }
+   return _rbfm->readRecord (*tableHandle.files[rid.partition],
+                             recordDescriptor, rid.rid, data);
+}
+
+RC PartitionManager::deleteRecord(TableHandle &tableHandle,
+                                  const vector<Attribute> &recordDescriptor,
+                                  const TableRID &rid) {
+   if (rid.partition >= tableHandle.files.size()) {
+      RC_MSG (rc::invalid_rid, "[partition: %u]\n", rid.partition);
+      return rc::invalid_rid;
+   }
+   return _rbfm->deleteRecord (*tableHandle.files[rid.partition],
+                               recordDescriptor, rid.rid);
+}
+
+RC PartitionManager::updateRecord(TableHandle &tableHandle,
+                                  const vector<Attribute> &recordDescriptor,
+                                  const void *data, TableRID &rid) {
+   if (rid.partition >= tableHandle.files.size()) {
+      RC_MSG (rc::invalid_rid, "[partition: %u]\n", rid.partition);
+      return rc::invalid_rid;
+   }
+   unsigned partition = rid.partition;
+   if (tableHandle.spec.scheme != PARTITION_ROUND_ROBIN) {
+      RC rcode = partitionOf (tableHandle, recordDescriptor, data,
+                              partition);
+      if (rcode != rc::success) return rcode;
+   }
+   if (partition == rid.partition) {
+      return _rbfm->updateRecord (*tableHandle.files[partition],
+                                  recordDescriptor, data, rid.rid);
+   }
+
+   // inserted first, the record is never lost
+   TableRID moved;
+   moved.partition = partition;
+   RC rcode = _rbfm->insertRecord (*tableHandle.files[partition],
+                                   recordDescriptor, data, moved.rid);
+   if (rcode != rc::success) return rcode;
+   rcode = deleteRecord (tableHandle, recordDescriptor, rid);
+   if (rcode != rc::success) {
+      deleteRecord (tableHandle, recordDescriptor, moved);
+      return rcode;
+   }
+   rid = moved;
+   return rc::success;
+}
+
+RC PartitionManager::scan(TableHandle &tableHandle,
+                          const vector<Attribute> &recordDescriptor,
+                          const string &conditionAttribute,
+                          const CompOp compOp, const void *value,
+                          const vector<string> &attributeNames,
+                          TableScanIterator &tableScanIterator) {
+   TableScanIterator &it = tableScanIterator;
+   it.close();
+   if (tableHandle.files.empty()) {
+      RC_MSG (rc::file_handle_empty, "\n");
+      return rc::file_handle_empty;
+   }
+   const Schema &schema = schemaOf (recordDescriptor);
+   for (unsigned i = 0; i < attributeNames.size(); ++i) {
+      int attr = schema.find (attributeNames[i]);
+      if (attr < 0) {
+         RC_MSG (rc::attribute_not_found, "[%s]\n",
+                 attributeNames[i].c_str());
+         it.close();
+         return rc::attribute_not_found;
+      }
+      it._projected.push_back (recordDescriptor[attr]);
+   }
+   it._tupleMax = tupleMax (it._projected);
+
+   // the partitions that may hold matching records
+   const PartitionSpec &spec = tableHandle.spec;
+   unsigned first = 0, last = tableHandle.files.size();
+   if (compOp != NO_OP && compOp != NE_OP
+       && spec.scheme != PARTITION_ROUND_ROBIN
+       && conditionAttribute == spec.attribute) {
+      string key = valueKey (tableHandle.type, (const char*) value);
+      if (spec.scheme == PARTITION_HASH && compOp == EQ_OP) {
+         first = hashValue (tableHandle.type, key.data(), key.size())
+                 % spec.count;
+         last = first + 1;
+      } else if (spec.scheme == PARTITION_RANGE) {
+         unsigned range = rangeOf (tableHandle, key);
+         if (compOp != GT_OP && compOp != GE_OP) last = range + 1;
+         if (compOp != LT_OP && compOp != LE_OP) first = range;
+      }
+   }
+
+   for (unsigned i = first; i < last; ++i) {
+      RBFM_ScanIterator *scan = new RBFM_ScanIterator;
+      RC rcode = _rbfm->scan (*tableHandle.files[i], recordDescriptor,
+                              conditionAttribute, compOp, value,
+                              attributeNames, *scan);
+      if (rcode != rc::success) {
+         delete scan;
+         it.close();
+         return rcode;
+      }
+      it._partitions.push_back (i);
+      it._scans.push_back (scan);
+   }
+   if (it._scans.size() > 1) {
+      it._running = it._scans.size();
+      for (unsigned i = 0; i < it._scans.size(); ++i) {
+         it._workers.push_back (thread (&TableScanIterator::produce, &it,
+                                        i));
+      }
+   }
+   return rc::success;
+}
+
+// PRE: the partitioning attribute of data has the type of the table's
+RC PartitionManager::partitionOf(TableHandle &tableHandle,
+                                 const vector<Attribute> &recordDescriptor,
+                                 const void *data, unsigned &partition) {
+   const PartitionSpec &spec = tableHandle.spec;
+   if (tableHandle.files.empty()) {
+      RC_MSG (rc::file_handle_empty, "\n");
+      return rc::file_handle_empty;
+   }
+   if (spec.scheme == PARTITION_ROUND_ROBIN) {
+      partition = tableHandle.next++ % spec.count;
+      return rc::success;
+   }
+   int attr = schemaOf (recordDescriptor).find (spec.attribute);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", spec.attribute.c_str());
+      return rc::attribute_not_found;
+   }
+   if (recordDescriptor[attr].type != tableHandle.type) {
+      RC_MSG (rc::type_mismatch, "[%s]\n", spec.attribute.c_str());
+      return rc::type_mismatch;
+   }
+   string key;
+   partition = 0;
+   if (!tupleValue (recordDescriptor, (const char*) data, attr, key)) {
+      return rc::success;
+   }
+   if (spec.scheme == PARTITION_HASH) {
+      partition = hashValue (tableHandle.type, key.data(), key.size())
+                  % spec.count;
+   } else {
+      partition = rangeOf (tableHandle, key);
+   }
+   return rc::success;
+}
+
+TableScanIterator::TableScanIterator() :
+   _tupleMax (0), _current (0), _running (0), _stop (false),
+   _error (rc::success)
+{
+}
+
+TableScanIterator::~TableScanIterator()
+{
+   close();
+}
+
+RC TableScanIterator::getNextRecord(TableRID &rid, void *data) {
+   if (_workers.empty()) {
+      // a single partition, read in place
+      for (; _current < _scans.size(); ++_current) {
+         RC rcode = _scans[_current]->getNextRecord (rid.rid, data);
+         if (rcode != RBFM_EOF) {
+            rid.partition = _partitions[_current];
+            return rcode;
+         }
+      }
+      return RBFM_EOF;
+   }
+
+   unique_lock<mutex> latch (_latch);
+   _changed.wait (latch, [this]() {
+      return !_queue.empty() || _running == 0;
+   });
+   if (_queue.empty()) return _error != rc::success ? _error : RBFM_EOF;
+   rid = _queue.front().first;
+   const string &tuple = _queue.front().second;
+   memcpy (data, tuple.data(), tuple.size());
+   _queue.pop_front();
+   _changed.notify_all();
+   return rc::success;
+}
+
+RC TableScanIterator::close() {
+   {
+      lock_guard<mutex> latch (_latch);
+      _stop = true;
+   }
+   _changed.notify_all();
+   for (unsigned i = 0; i < _workers.size(); ++i) _workers[i].join();
+   for (unsigned i = 0; i < _scans.size(); ++i) delete _scans[i];
+   _workers.clear();
+   _scans.clear();
+   _partitions.clear();
+   _projected.clear();
+   _queue.clear();
+   _tupleMax = 0;
+   _current = 0;
+   _running = 0;
+   _stop = false;
+   _error = rc::success;
+   return rc::success;
+}
+
+// Worker of scan i, filling the queue until its partition is done or
+// the iterator is closed
+void TableScanIterator::produce(unsigned i) {
+   string tuple (_tupleMax, '\0');
+   TableRID rid;
+   rid.partition = _partitions[i];
+   RC rcode;
+   while ((rcode = _scans[i]->getNextRecord (rid.rid, &tuple[0]))
+          == rc::success) {
+      unique_lock<mutex> latch (_latch);
+      _changed.wait (latch, [this]() {
+         return _stop || _queue.size() < PARTITION_SCAN_QUEUE;
+      });
+      if (_stop) break;
+      _queue.push_back (make_pair (rid, tuple.substr (0, tupleSize (
+                                                  _projected, tuple.data()))));
+      _changed.notify_all();
+   }
+
+   lock_guard<mutex> latch (_latch);
+   if (rcode != rc::success && rcode != RBFM_EOF && _error == rc::success) {
+      // the other workers stop too
+      _error = rcode;
+      _stop = true;
+   }
+   --_running;
+   _changed.notify_all();
+}
@@ -0,0 +1,160 @@
+#ifndef _partition_h_
+#define _partition_h_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Partitioned tables: a logical table made of several record-based
+// files, its partitions, so that a table is not capped by the size and
+// the I/O of one file.
+//
+// A table named T is the file T, which holds how the records are
+// partitioned, and the record files T.0 to T.(count-1). A record goes
+// to the partition:
+//  - PARTITION_ROUND_ROBIN: after the one of the previous insert,
+//  - PARTITION_HASH: hashValue() of its partitioning attribute modulo
+//    count,
+//  - PARTITION_RANGE: i such that bounds[i-1] <= value < bounds[i],
+//    the first partition below bounds[0], the last one from
+//    bounds[count-2] on.
+// A record whose partitioning attribute is null goes to partition 0.
+//
+// The records are identified by TableRIDs, a RID in their partition. A
+// scan with a condition on the partitioning attribute only reads the
+// partitions that may hold matching records (EQ_OP for hash
+// partitioning, any comparison but NE_OP for range partitioning). The
+// partitions left are scanned by one thread each.
+
+typedef enum {
+  PARTITION_ROUND_ROBIN = 0,
+  PARTITION_HASH,
+  PARTITION_RANGE
+} PartitionScheme;
+
+struct PartitionSpec {
+    PartitionScheme scheme;
+    unsigned count;            // of partitions, 1 to PARTITION_MAX
+    string attribute;          // partitioning attribute (hash, range)
+    vector<string> bounds;     // range: count-1 ascending values, in
+                               // the API format
+};
+
+const unsigned PARTITION_MAX = 256;
+
+// tuples a parallel scan buffers ahead of getNextRecord()
+const unsigned PARTITION_SCAN_QUEUE = 1024;
+
+struct TableRID {
+    unsigned partition;
+    RID rid;
+};
+
+// An open partitioned table, see PartitionManager::openTable()
+struct TableHandle {
+    PartitionSpec spec;
+    AttrType type;             // of the partitioning attribute
+    vector<string> bounds;     // spec.bounds, no VarChar length, in the
+                               // order of btreeCompare() (btree.h)
+    vector<FileHandle*> files; // of the partitions, empty when closed
+    atomic<unsigned> next;     // next round robin partition
+
+    TableHandle();
+    ~TableHandle();
+    TableHandle(const TableHandle&) = delete;
+    TableHandle& operator=(const TableHandle&) = delete;
+};
+
+// Goes through the records of the partitions a scan did not prune, in
+// no particular order across partitions
+class TableScanIterator {
+public:
+  TableScanIterator();
+  ~TableScanIterator();
+
+  RC getNextRecord(TableRID &rid, void *data);
+  RC close();
+
+  // RETURNS: the number of partitions scanned
+  unsigned partitions() const { return _partitions.size(); }
+
+private:
+  friend class PartitionManager;
+
+  TableScanIterator(const TableScanIterator&) = delete;
+  TableScanIterator& operator=(const TableScanIterator&) = delete;
+
+  void produce(unsigned i);
+
+  vector<unsigned> _partitions;
+  vector<RBFM_ScanIterator*> _scans;  // of _partitions
+  vector<Attribute> _projected; // the projected attributes
+  unsigned _tupleMax;        // largest projected record
+  unsigned _current;         // scan read by a sequential scan
+  vector<thread> _workers;   // one per scan if there are several
+  mutex _latch;              // of the fields below
+  condition_variable _changed;
+  deque<pair<TableRID, string> > _queue;
+  unsigned _running;         // workers not done
+  bool _stop;
+  RC _error;                 // first error of a worker
+};
+
+class PartitionManager
+{
+public:
+  static PartitionManager* instance();
+
+  // Creates the table file and the partition files, with options (see
+  // RecordBasedFileManager::createFile())
+  RC createTable(const string &tableName,
+                 const vector<Attribute> &recordDescriptor,
+                 const PartitionSpec &spec, unsigned options);
+  RC destroyTable(const string &tableName);
+
+  RC openTable(const string &tableName, TableHandle &tableHandle);
+  RC closeTable(TableHandle &tableHandle);
+
+  // The record functions of RecordBasedFileManager on the partition of
+  // the record
+  RC insertRecord(TableHandle &tableHandle,
+                  const vector<Attribute> &recordDescriptor,
+                  const void *data, TableRID &rid);
+  RC readRecord(TableHandle &tableHandle,
+                const vector<Attribute> &recordDescriptor,
+                const TableRID &rid, void *data);
+  RC deleteRecord(TableHandle &tableHandle,
+                  const vector<Attribute> &recordDescriptor,
+                  const TableRID &rid);
+  // A record whose partitioning attribute changes is moved to its new
+  // partition: rid is updated
+  RC updateRecord(TableHandle &tableHandle,
+                  const vector<Attribute> &recordDescriptor,
+                  const void *data, TableRID &rid);
+
+  RC scan(TableHandle &tableHandle,
+          const vector<Attribute> &recordDescriptor,
+          const string &conditionAttribute, const CompOp compOp,
+          const void *value, const vector<string> &attributeNames,
+          TableScanIterator &tableScanIterator);
+
+protected:
+  PartitionManager();
+  ~PartitionManager();
+
+private:
+  RC partitionOf(TableHandle &tableHandle,
+                 const vector<Attribute> &recordDescriptor,
+                 const void *data, unsigned &partition);
+
+  static PartitionManager *_partition_manager;
+  RecordBasedFileManager *_rbfm;
+};
+
+#endif
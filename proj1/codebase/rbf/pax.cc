@@ -0,0 +1,272 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pax.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// [rowCount][minipage offsets]
+static unsigned paxHeaderSize(unsigned fieldCount) {
+   return sizeof(uint16_t) + fieldCount * sizeof(uint16_t);
+}
+
+static unsigned align4(unsigned offset) {
+   return (offset + 3) & ~3u;
+}
+
+static unsigned minipage(const char *page, unsigned attr) {
+   return get16 (page + sizeof(uint16_t) + attr * sizeof(uint16_t));
+}
+
+static const char* rowNulls(const char *page, unsigned fieldCount,
+                            unsigned row) {
+   return page + paxHeaderSize (fieldCount) + row * nullBytes (fieldCount);
+}
+
+// One loop per operator so that the compiler can vectorize each of them
+template <typename T>
+static void selectColumn(const T *column, unsigned rows, CompOp compOp,
+                         T value, uint8_t *out) {
+   switch (compOp) {
+      case EQ_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = column[r] == value;
+         break;
+      case LT_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = column[r] < value;
+         break;
+      case LE_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = column[r] <= value;
+         break;
+      case GT_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = column[r] > value;
+         break;
+      case GE_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = column[r] >= value;
+         break;
+      case NE_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = column[r] != value;
+         break;
+      case NO_OP:
+         for (unsigned r = 0; r < rows; ++r) out[r] = 1;
+         break;
+   }
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+bool paxField(const char *page, const vector<Attribute> &recordDescriptor,
+              unsigned row, unsigned attr, const char *&bytes,
+              unsigned &len, bool &overflow) {
+   unsigned fieldCount = recordDescriptor.size();
+   if (isNull (rowNulls (page, fieldCount, row), attr)) return false;
+   unsigned offset = minipage (page, attr);
+   overflow = false;
+   if (recordDescriptor[attr].type != TypeVarChar) {
+      bytes = page + offset + row * sizeof(int);
+      len = sizeof(int);
+      return true;
+   }
+   const char *ends = page + offset;
+   const char *heap = ends + paxRowCount (page) * sizeof(uint16_t);
+   uint16_t end = get16 (ends + row * sizeof(uint16_t));
+   unsigned begin = 0;
+   if (row > 0) {
+      begin = get16 (ends + (row - 1) * sizeof(uint16_t)) & ~FIELD_OVERFLOW;
+   }
+   bytes = heap + begin;
+   len = (end & ~FIELD_OVERFLOW) - begin;
+   overflow = end & FIELD_OVERFLOW;
+   return true;
+}
+
+void paxRecord(const char *page, const vector<Attribute> &recordDescriptor,
+               unsigned row, string &record) {
+   unsigned fieldCount = recordDescriptor.size();
+   const char *nulls = rowNulls (page, fieldCount, row);
+   record.assign (recordHeaderSize (fieldCount), 0);
+   put16 (&record[0], fieldCount);
+   memcpy (&record[sizeof(uint16_t)], nulls, nullBytes (fieldCount));
+   unsigned endsAt = sizeof(uint16_t) + nullBytes (fieldCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      const char *bytes;
+      unsigned len;
+      bool overflow = false;
+      if (paxField (page, recordDescriptor, row, i, bytes, len, overflow)) {
+         record.append (bytes, len);
+      }
+      put16 (&record[endsAt + i * sizeof(uint16_t)],
+             record.size() | (overflow ? FIELD_OVERFLOW : 0));
+   }
+}
+
+void paxSelect(const char *page, const vector<Attribute> &recordDescriptor,
+               unsigned attr, CompOp compOp, const void *value,
+               vector<uint8_t> &selected) {
+   unsigned rows = paxRowCount (page);
+   selected.assign (rows, 0);
+   if (rows == 0) return;
+   const char *column = page + minipage (page, attr);
+   if (recordDescriptor[attr].type == TypeInt) {
+      int32_t v;
+      memcpy (&v, value, sizeof(v));
+      selectColumn ((const int32_t*) column, rows, compOp, v,
+                    selected.data());
+   } else {
+      float v;
+      memcpy (&v, value, sizeof(v));
+      selectColumn ((const float*) column, rows, compOp, v,
+                    selected.data());
+   }
+   unsigned fieldCount = recordDescriptor.size();
+   for (unsigned r = 0; r < rows; ++r) {
+      if (isNull (rowNulls (page, fieldCount, r), attr)) selected[r] = 0;
+   }
+}
+
+void paxDecode(char *page, const vector<Attribute> &recordDescriptor,
+               vector<PageEntry> &entries) {
+   unsigned numSlots = pageFooter (page)->numSlots;
+   entries.resize (numSlots);
+   for (unsigned i = 0; i < numSlots; ++i) {
+      Slot *slot = pageSlot (page, i);
+      PageEntry &entry = entries[i];
+      entry.used = slot->offset != SLOT_EMPTY;
+      entry.flags = slot->length & ~SLOT_LEN_MASK;
+      entry.cell.clear();
+      if (!entry.used) continue;
+      if (entry.flags & SLOT_FORWARD) {
+         entry.cell.assign (pageCell (page, i), sizeof(ForwardRef));
+      } else {
+         paxRecord (page, recordDescriptor, slot->offset, entry.cell);
+      }
+   }
+   while (!entries.empty() && !entries.back().used) entries.pop_back();
+}
+
+bool paxEncode(const vector<PageEntry> &entries,
+               const vector<Attribute> &recordDescriptor, char *page) {
+   unsigned fieldCount = recordDescriptor.size();
+   vector<const char*> rows;
+   unsigned forwards = 0;
+   for (unsigned e = 0; e < entries.size(); ++e) {
+      if (!entries[e].used) continue;
+      if (entries[e].flags & SLOT_FORWARD) {
+         ++forwards;
+      } else {
+         rows.push_back (entries[e].cell.data());
+      }
+   }
+
+   // layout
+   unsigned rowCount = rows.size();
+   unsigned fixedBytes = nullBytes (fieldCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      fixedBytes += recordDescriptor[i].type == TypeVarChar
+                    ? sizeof(uint16_t) : sizeof(int);
+   }
+   vector<unsigned> rowBytes (rowCount, fixedBytes);
+   vector<unsigned> offsets (fieldCount);
+   unsigned offset = paxHeaderSize (fieldCount)
+                     + rowCount * nullBytes (fieldCount);
+   unsigned padding = 0;
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      padding += align4 (offset) - offset;
+      offset = align4 (offset);
+      offsets[i] = offset;
+      if (recordDescriptor[i].type != TypeVarChar) {
+         offset += rowCount * sizeof(int);
+         continue;
+      }
+      offset += rowCount * sizeof(uint16_t);
+      for (unsigned r = 0; r < rowCount; ++r) {
+         unsigned begin, end;
+         bool overflow;
+         fieldBounds (rows[r], i, begin, end, overflow);
+         offset += end - begin;
+         rowBytes[r] += end - begin;
+      }
+   }
+   unsigned minipagesEnd = offset;
+   unsigned size = minipagesEnd + forwards * MIN_CELL
+                   + entries.size() * sizeof(Slot) + sizeof(PageFooter);
+
+   // Turning rows into forwarding cells must always fit (see
+   // pageReplaceCell): keep room for every row smaller than a forwarding
+   // cell to grow to one, and for the alignment of every minipage, which
+   // can take up to 3 bytes more once rows are gone.
+   if (rowCount > 0) {
+      size += 3 * fieldCount - padding;
+      for (unsigned r = 0; r < rowCount; ++r) {
+         if (rowBytes[r] < MIN_CELL) size += MIN_CELL - rowBytes[r];
+      }
+   }
+   if (size > PAGE_SIZE) return false;
+
+   char *tmp = (char*) malloc (PAGE_SIZE);
+   memset (tmp, 0, PAGE_SIZE);
+   memcpy (tmp + PAGE_SIZE - sizeof(PageFooter), pageFooter (page),
+           sizeof(PageFooter));
+   put16 (tmp, rowCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      put16 (tmp + sizeof(uint16_t) + i * sizeof(uint16_t), offsets[i]);
+   }
+   for (unsigned r = 0; r < rowCount; ++r) {
+      memcpy ((char*) rowNulls (tmp, fieldCount, r), recordNulls (rows[r]),
+              nullBytes (fieldCount));
+   }
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      char *column = tmp + offsets[i];
+      char *heap = column + rowCount * sizeof(uint16_t);
+      unsigned heapLen = 0;
+      for (unsigned r = 0; r < rowCount; ++r) {
+         unsigned begin, end;
+         bool overflow;
+         fieldBounds (rows[r], i, begin, end, overflow);
+         if (recordDescriptor[i].type != TypeVarChar) {
+            if (end > begin) {
+               memcpy (column + r * sizeof(int), rows[r] + begin,
+                       sizeof(int));
+            }
+            continue;
+         }
+         memcpy (heap + heapLen, rows[r] + begin, end - begin);
+         heapLen += end - begin;
+         put16 (column + r * sizeof(uint16_t),
+                heapLen | (overflow ? FIELD_OVERFLOW : 0));
+      }
+   }
+
+   PageFooter *footer = pageFooter (tmp);
+   footer->numSlots = entries.size();
+   footer->headerLen = minipagesEnd;
+   offset = minipagesEnd;
+   unsigned row = 0;
+   for (unsigned e = 0; e < entries.size(); ++e) {
+      Slot *slot = pageSlot (tmp, e);
+      const PageEntry &entry = entries[e];
+      if (!entry.used) {
+         slot->offset = SLOT_EMPTY;
+         slot->length = 0;
+      } else if (entry.flags & SLOT_FORWARD) {
+         memcpy (tmp + offset, entry.cell.data(), sizeof(ForwardRef));
+         slot->offset = offset;
+         slot->length = MIN_CELL | entry.flags;
+         offset += MIN_CELL;
+      } else {
+         slot->offset = row++;
+         slot->length = entry.flags;
+      }
+   }
+   footer->freeOffset = offset;
+   memcpy (page, tmp, PAGE_SIZE);
+   free (tmp);
+   return true;
+}
@@ -0,0 +1,61 @@
+#ifndef _pax_h_
+#define _pax_h_
+
+#include <string>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+#include "../rbf/page.h"
+
+// PAX data pages (files created with RBFM_PAX): the records of a page
+// are split into one minipage per attribute, so a scan reads a column
+// as a contiguous array and never touches the attributes it does not
+// project.
+//
+//   [rowCount][minipage offsets][nulls][minipage 0]...[minipage n-1]
+//   [forwarding cells ->      free space      <- slot directory][footer]
+//
+// - rowCount and the minipage offsets are uint16
+// - nulls: the null bitmap of each row, rowCount * ceil(n/8) bytes
+// - TypeInt / TypeReal minipage: rowCount 4 byte values (0 if null),
+//   4 byte aligned
+// - TypeVarChar minipage: [uint16 end[rowCount]][value bytes], end is
+//   relative to the value bytes; if FIELD_OVERFLOW is set the value is
+//   the OverflowRef of a spilled VarChar
+//
+// footer.headerLen is the length of the minipages. The slot of a
+// record holds its row number as offset and no length, so RIDs keep
+// their meaning. Forwarding cells are stored after the minipages like
+// cells of a row page. Rows are in slot order. As compressed pages,
+// the page is re-encoded as a whole whenever one of its records
+// changes.
+
+inline unsigned paxRowCount(const char *page) {
+   return get16 (page);
+}
+
+// Field attr of row. Reading a field only touches its own minipage.
+// RETURNS: false if the field is null
+bool paxField(const char *page, const vector<Attribute> &recordDescriptor,
+              unsigned row, unsigned attr, const char *&bytes,
+              unsigned &len, bool &overflow);
+
+// Rebuilds the internal record of a row
+void paxRecord(const char *page, const vector<Attribute> &recordDescriptor,
+               unsigned row, string &record);
+
+// Evaluates "attr compOp value" for every row of the page in one tight
+// loop over the contiguous column (TypeInt / TypeReal only). A null
+// never matches.
+// POST: selected[row] is 1 for every matching row, 0 otherwise
+void paxSelect(const char *page, const vector<Attribute> &recordDescriptor,
+               unsigned attr, CompOp compOp, const void *value,
+               vector<uint8_t> &selected);
+
+// Same contract as cpageDecode / cpageEncode
+void paxDecode(char *page, const vector<Attribute> &recordDescriptor,
+               vector<PageEntry> &entries);
+bool paxEncode(const vector<PageEntry> &entries,
+               const vector<Attribute> &recordDescriptor, char *page);
+
+#endif
@@ -10,35 +10,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h> // stat
+#include <unistd.h> // pread, pwrite
 
 #include "pfm.h"
 
 
-// rc stands for return code
-// usage: rc::SUCCESS
-
-namespace rc {
-
-    enum RC { 
-        success = 0, 
-        failure,
-        file_already_exists, 
-        file_does_not_exist, 
-        file_create_error,
-        file_delete_error,
-        file_open_error,
-        file_close_error,
-        file_read_error, 
-        file_write_error, 
-        file_handle_in_use,
-        file_handle_empty,
-        page_does_not_exist,
-        incomplete_page_read,
-        incomplete_page_write,
-        last_rc  // This must be the last RC
-    };
-}
-
 const vector<string> rc_msgs = {
    "Success",                      
    "error",                         
@@ -55,6 +31,24 @@ const vector<string> rc_msgs = {
    "error: page does not exist",
    "error: incomplete page read",
    "error: incomplete page write",
+   "error: not a record-based file",
+   "error: unexpected page type",
+   "error: invalid rid",
+   "error: record has been deleted",
+   "error: record too large",
+   "error: attribute not found",
+   "error: invalid file options",
+   "error: attribute type not supported",
+   "error: no room left in the file header",
+   "error: no index on the attribute",
+   "error: included attributes too large for an index entry",
+   "error: memory budget too small",
+   "error: attributes of different types",
+   "error: snapshot has ended",
+   "error: deadlock, the transaction must abort",
+   "error: timed out waiting for a lock",
+   "error: not a trace file",
+   "error: not a dump stream or a truncated one",
    "last return code"
 };
 
@@ -62,19 +56,14 @@ void assertRc() {
    assert(rc_msgs.size() == rc::last_rc + 1);
 }
 
-#define RC_MSG(RCODE, ...) do {\
-       eprintf("%s: %s %d: rc#%d: %s ", __FILE__, __func__, \
-               __LINE__, RCODE, rc_msgs.at(RCODE).c_str()); \
-       eprintf (__VA_ARGS__); } while(0)
-
 //
 // PRIVATE HELPER FUNCTIONS
 //
 
 bool existsFile(const char* cfname);
 
-inline int pageBeginPos(PageNum pageNum);
-inline int pageEndPos(PageNum pageNum);
+inline off_t pageBeginPos(PageNum pageNum);
+inline off_t pageEndPos(PageNum pageNum);
 
 void rcprintf(int rc);
 
@@ -188,8 +177,67 @@ RC PagedFileManager::closeFile(FileHandle &fileHandle)
 }
 
 
+HandleLatch::HandleLatch() : _depth (0), _shared (0), _waiting (0)
+{
+}
+
+
+void HandleLatch::lock()
+{
+   unique_lock<mutex> latch (_mutex);
+   if (_owner == this_thread::get_id()) {
+      ++_depth;
+      return;
+   }
+   ++_waiting;
+   _released.wait (latch, [this]() {
+      return _owner == thread::id() && _shared == 0;
+   });
+   --_waiting;
+   _owner = this_thread::get_id();
+   _depth = 1;
+}
+
+
+void HandleLatch::unlock()
+{
+   lock_guard<mutex> latch (_mutex);
+   if (--_depth > 0) return;
+   _owner = thread::id();
+   _released.notify_all();
+}
+
+
+void HandleLatch::lock_shared()
+{
+   unique_lock<mutex> latch (_mutex);
+   // the thread holding it exclusive already has what it asks for
+   if (_owner == this_thread::get_id()) {
+      ++_depth;
+      return;
+   }
+   _released.wait (latch, [this]() {
+      return _owner == thread::id() && _waiting == 0;
+   });
+   ++_shared;
+}
+
+
+void HandleLatch::unlock_shared()
+{
+   lock_guard<mutex> latch (_mutex);
+   if (_owner == this_thread::get_id()) {
+      if (--_depth > 0) return;
+      _owner = thread::id();
+   } else if (--_shared > 0) {
+      return;
+   }
+   _released.notify_all();
+}
+
+
 FileHandle::FileHandle() : 
-    _fstream (NULL), _page_count (0) 
+    _fstream (NULL), _page_count (0), _metrics (NULL)
 {
     readPageCounter = 0;
     writePageCounter = 0;
@@ -199,6 +247,7 @@ FileHandle::FileHandle() :
 
 FileHandle::~FileHandle()
 {
+    delete _metrics.load();
 }
 
 
@@ -206,11 +255,11 @@ inline bool FileHandle::isEmpty() {
    return _fstream == NULL;
 }
 
-inline int pageBeginPos(PageNum pageNum) {
-   return pageNum * PAGE_SIZE;
+inline off_t pageBeginPos(PageNum pageNum) {
+   return (off_t) pageNum * PAGE_SIZE;
 } 
 
-inline int pageEndPos(PageNum pageNum) {
+inline off_t pageEndPos(PageNum pageNum) {
    return pageBeginPos(pageNum) + PAGE_SIZE - 1;
 }
 
@@ -233,12 +282,13 @@ RC FileHandle::readPage(PageNum pageNum, void *data)
       }
    );
    
-   // unchecked fseek
-   fseek (_fstream, pageBeginPos (pageNum), SEEK_SET);
-   int fread_rc = fread (data, 1, PAGE_SIZE, _fstream);
+   MetricTimer timer (metrics(), LATENCY_READ_PAGE);
+   // no shared file position, threads can read at the same time
+   ssize_t fread_rc = pread (fileno (_fstream), data, PAGE_SIZE,
+                             pageBeginPos (pageNum));
 
    DEBUG_TEST(
-      if (ferror (_fstream)) {
+      if (fread_rc < 0) {
          RC_MSG(rc::file_read_error, "\n");
          return rc::file_read_error;
       }
@@ -249,6 +299,7 @@ RC FileHandle::readPage(PageNum pageNum, void *data)
    );
  
    ++readPageCounter; 
+   metrics().add (COUNTER_BYTES_READ, PAGE_SIZE);
    return rc::success;    
 }
 
@@ -270,33 +321,37 @@ RC FileHandle::writePage(PageNum pageNum, const void *data)
       }
    );
    
-   // unchecked fseek
-   fseek (_fstream, pageBeginPos (pageNum), SEEK_SET);
-   if (fwrite (data, 1, PAGE_SIZE, _fstream) == PAGE_SIZE) {
-      fflush (_fstream);
-   } else {
+   MetricTimer timer (metrics(), LATENCY_WRITE_PAGE);
+   if (pwrite (fileno (_fstream), data, PAGE_SIZE, pageBeginPos (pageNum))
+       != PAGE_SIZE) {
       RC_MSG(rc::file_write_error, "[pageNum: %d]\n", pageNum);
       return rc::file_write_error;
    }
 
    ++writePageCounter; 
+   metrics().add (COUNTER_BYTES_WRITTEN, PAGE_SIZE);
    return rc::success;
 }
 
 
 RC FileHandle::appendPage(const void *data)
 {
-   fseek (_fstream, pageBeginPos(_page_count), SEEK_SET);
-   ++_page_count;
-
-   if (fwrite (data, 1, PAGE_SIZE, _fstream) == PAGE_SIZE) {
-      fflush (_fstream);
-   } else {
+   MetricTimer timer (metrics(), LATENCY_APPEND_PAGE);
+   // appenders outside the record functions (run files, partitions,
+   // dumps) do not hold the latch. Under it the page only counts once
+   // written: a failed append leaves no hole, readers never see a page
+   // that is not there yet and two appenders never take the same page.
+   lock_guard<HandleLatch> latch (_latch);
+   PageNum pageNum = _page_count;
+   if (pwrite (fileno (_fstream), data, PAGE_SIZE, pageBeginPos (pageNum))
+       != PAGE_SIZE) {
       RC_MSG(rc::incomplete_page_write, "\n");
       return rc::incomplete_page_write;
    }
+   ++_page_count;
 
    ++appendPageCounter; 
+   metrics().add (COUNTER_BYTES_WRITTEN, PAGE_SIZE);
    return rc::success;
 }
 
@@ -307,6 +362,30 @@ unsigned FileHandle::getNumberOfPages()
 }
 
 
+HandleLatch& FileHandle::latch()
+{
+   return _latch;
+}
+
+
+mutex& FileHandle::pageLatch(PageNum pageNum)
+{
+   return _pageLatches[pageNum % PAGE_LATCHES];
+}
+
+
+Metrics& FileHandle::metrics()
+{
+   Metrics *metrics = _metrics.load();
+   if (metrics != NULL) return *metrics;
+   // threads racing here keep the first one made
+   Metrics *made = new Metrics;
+   if (_metrics.compare_exchange_strong (metrics, made)) return *made;
+   delete made;
+   return *metrics;
+}
+
+
 RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
 {
     readPageCount = readPageCounter;
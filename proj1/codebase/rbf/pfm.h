@@ -7,13 +7,53 @@ typedef char byte;
 
 #define PAGE_SIZE 4096
 #include <string>
+#include <vector>
+#include <atomic>
 #include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdarg.h>
+
+#include "metrics.h"
 
 #define DEBUG
 using namespace std;
 
 class FileHandle;
 
+// page latches of a FileHandle, pages share them modulo this
+const unsigned PAGE_LATCHES = 64;
+
+// Latch of a FileHandle (FileHandle::latch()). The record functions
+// that change the pages or the structure of the file hold it exclusive,
+// and may take it again in the thread holding it. An update of one
+// record in its page holds it shared, with the latch of the page
+// (FileHandle::pageLatch()), so updates of records of different pages
+// run at the same time. A thread holding it shared must not take it
+// again; threads waiting for it exclusive go first.
+class HandleLatch
+{
+public:
+    HandleLatch();
+
+    void lock();
+    void unlock();
+    void lock_shared();
+    void unlock_shared();
+
+private:
+    HandleLatch(const HandleLatch&) = delete;
+    HandleLatch& operator=(const HandleLatch&) = delete;
+
+    mutex _mutex;
+    condition_variable _released;
+    thread::id _owner;       // holding it exclusive, none if no thread
+    unsigned _depth;         // times _owner took it
+    unsigned _shared;        // threads holding it shared
+    unsigned _waiting;       // threads waiting to take it exclusive
+};
+
 class PagedFileManager
 {
 public:
@@ -44,9 +84,9 @@ public:
     friend class PagedFileManager;
 
     // variables to keep the counter for each operation
-    unsigned readPageCounter;
-    unsigned writePageCounter;
-    unsigned appendPageCounter;
+    atomic<unsigned> readPageCounter;
+    atomic<unsigned> writePageCounter;
+    atomic<unsigned> appendPageCounter;
     
     FileHandle();              // Default constructor
     ~FileHandle();             // Destructor
@@ -59,7 +99,8 @@ public:
     // Write a specific page
     RC writePage(PageNum pageNum, const void *data);  
 
-    // Append a specific page
+    // Append a specific page. Takes the latch of the handle, so threads
+    // appending at the same time write different pages.
     RC appendPage(const void *data);                  
 
     // Get the number of pages in the file
@@ -70,12 +111,77 @@ public:
                             unsigned &writePageCount, 
                             unsigned &appendPageCount);  
 
+    // Held by the record functions (rbfm.h) for the time of a call, so
+    // that the threads sharing the handle change its pages one call at
+    // a time, or shared by updates in place (see HandleLatch)
+    HandleLatch& latch();
+    // Held with the latch shared while the page is changed
+    mutex& pageLatch(PageNum pageNum);
+
+    // Latencies and counters of the operations on the file (metrics.h),
+    // kept for the life of the handle
+    Metrics& metrics();
+
 private:
-    FILE* _fstream;
-    size_t _page_count;
+    FILE* _fstream;          // read and written at explicit offsets
+    atomic<size_t> _page_count;
+    HandleLatch _latch;
+    mutex _pageLatches[PAGE_LATCHES];
+    atomic<Metrics*> _metrics;   // made by the first metrics()
 }; 
 
 
+// rc stands for return code
+// usage: rc::SUCCESS
+
+namespace rc {
+
+    enum RC { 
+        success = 0, 
+        failure,
+        file_already_exists, 
+        file_does_not_exist, 
+        file_create_error,
+        file_delete_error,
+        file_open_error,
+        file_close_error,
+        file_read_error, 
+        file_write_error, 
+        file_handle_in_use,
+        file_handle_empty,
+        page_does_not_exist,
+        incomplete_page_read,
+        incomplete_page_write,
+        not_a_record_file,
+        bad_page_type,
+        invalid_rid,
+        record_deleted,
+        record_too_large,
+        attribute_not_found,
+        invalid_file_options,
+        unsupported_type,
+        header_full,
+        index_not_found,
+        payload_too_large,
+        invalid_budget,
+        type_mismatch,
+        snapshot_ended,
+        deadlock,
+        lock_timeout,
+        not_a_trace_file,
+        not_a_dump,
+        last_rc  // This must be the last RC
+    };
+}
+
+extern const vector<string> rc_msgs;
+
+#define RC_MSG(RCODE, ...) do {\
+       eprintf("%s: %s %d: rc#%d: %s ", __FILE__, __func__, \
+               __LINE__, RCODE, rc_msgs.at(RCODE).c_str()); \
+       eprintf (__VA_ARGS__); } while(0)
+
+
 // PUBLIC HELPER FUNCTIONS
 // error messaging
 void veprintf (const char* format, va_list args);
@@ -1,10 +1,1128 @@
+#include <algorithm>
+#include <bitset>
+#include <functional>
+#include <iostream>
+
+#include <stdlib.h>
+#include <string.h>
+
 #include "rbfm.h"
+#include "page.h"
+#include "cpage.h"
+#include "pax.h"
+#include "zonemap.h"
+#include "hashindex.h"
+#include "btree.h"
+#include "schema.h"
+#include "mvcc.h"
+#include "fsm.h"
+#include "trace.h"
+#include "format.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// held for the time of a call on a file (see FileHandle::latch())
+typedef lock_guard<HandleLatch> FileLatch;
+
+// held shared for the time of an update in place (see updateInPlace())
+class SharedFileLatch {
+public:
+  SharedFileLatch(HandleLatch &latch) : _latch (latch) {
+     _latch.lock_shared();
+  }
+  ~SharedFileLatch() { _latch.unlock_shared(); }
+
+private:
+  HandleLatch &_latch;
+};
+
+// Gets the bytes of field i, reading the overflow chain into scratch
+// if the field has been spilled.
+// PRE: field i is not null
+static RC readField(FileHandle &fileHandle, const char *record,
+                    unsigned i, string &scratch, const char *&bytes,
+                    unsigned &len) {
+   unsigned begin, end;
+   bool overflow;
+   fieldBounds (record, i, begin, end, overflow);
+   if (!overflow) {
+      bytes = record + begin;
+      len = end - begin;
+      return rc::success;
+   }
+   OverflowRef ref;
+   memcpy (&ref, record + begin, sizeof(ref));
+   scratch.resize (ref.length);
+   bytes = scratch.data();
+   len = ref.length;
+   return readOverflow (fileHandle, ref, &scratch[0]);
+}
+
+// Writes a field value in the API format
+// RETURNS: bytes written
+static unsigned writeValue(AttrType type, const char *bytes, unsigned len,
+                           char *out) {
+   if (type != TypeVarChar) {
+      memcpy (out, bytes, sizeof(int));
+      return sizeof(int);
+   }
+   uint32_t varcharLen = len;
+   memcpy (out, &varcharLen, sizeof(varcharLen));
+   memcpy (out + sizeof(varcharLen), bytes, len);
+   return sizeof(varcharLen) + len;
+}
+
+// Gives overflow chains back to the free list
+static RC freeChains(FileHandle &fileHandle, const vector<PageNum> &chains) {
+   for (unsigned i = 0; i < chains.size(); ++i) {
+      RC rcode = freeOverflow (fileHandle, chains[i]);
+      if (rcode != rc::success) return rcode;
+   }
+   return rc::success;
+}
+
+// Converts a record from the API format (see insertRecord) to the
+// internal format. The largest VarChars are spilled to overflow pages
+// until the record fits in RBFM_INLINE_MAX bytes.
+// The values of a record in the API format (see insertRecord): bytes[i]
+// and lens[i] of field i, NULL and 0 if it is null
+// RETURNS: size of the record in the internal format, no field spilled
+static unsigned recordValues(const vector<Attribute> &recordDescriptor,
+                             const void *data, vector<const char*> &bytes,
+                             vector<unsigned> &lens) {
+   unsigned fieldCount = recordDescriptor.size();
+   const char *nulls = (const char*) data;
+   const char *in = nulls + nullBytes (fieldCount);
+   bytes.assign (fieldCount, NULL);
+   lens.assign (fieldCount, 0);
+   unsigned size = recordHeaderSize (fieldCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      if (isNull (nulls, i)) continue;
+      if (recordDescriptor[i].type == TypeVarChar) {
+         uint32_t len;
+         memcpy (&len, in, sizeof(len));
+         bytes[i] = in + sizeof(len);
+         lens[i] = len;
+         in += sizeof(len) + len;
+      } else {
+         bytes[i] = in;
+         lens[i] = sizeof(int);
+         in += sizeof(int);
+      }
+      size += lens[i];
+   }
+   return size;
+}
+
+// Converts a record from the API format (see insertRecord) to the
+// internal format. The largest VarChars are spilled to overflow pages
+// until the record fits in RBFM_INLINE_MAX bytes.
+static RC encodeRecord(FileHandle &fileHandle,
+                       const vector<Attribute> &recordDescriptor,
+                       const void *data, string &record) {
+   unsigned fieldCount = recordDescriptor.size();
+   const char *nulls = (const char*) data;
+   vector<const char*> bytes;
+   vector<unsigned> lens;
+   vector<bool> spill (fieldCount, false);
+   unsigned size = recordValues (recordDescriptor, data, bytes, lens);
+
+   while (size > RBFM_INLINE_MAX) {
+      int largest = -1;
+      for (unsigned i = 0; i < fieldCount; ++i) {
+         if (recordDescriptor[i].type == TypeVarChar && !spill[i]
+             && lens[i] > sizeof(OverflowRef)
+             && (largest < 0 || lens[i] > lens[largest])) {
+            largest = i;
+         }
+      }
+      if (largest < 0) break;
+      spill[largest] = true;
+      size -= lens[largest] - sizeof(OverflowRef);
+   }
+   if (size > MAX_CELL) {
+      RC_MSG (rc::record_too_large, "[size: %u]\n", size);
+      return rc::record_too_large;
+   }
+
+   record.assign (size, 0);
+   char *out = &record[0];
+   vector<PageNum> chains;   // written so far, freed if one fails
+   put16 (out, fieldCount);
+   memcpy (out + sizeof(uint16_t), nulls, nullBytes (fieldCount));
+   char *ends = out + sizeof(uint16_t) + nullBytes (fieldCount);
+   unsigned offset = recordHeaderSize (fieldCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      uint16_t flag = 0;
+      if (spill[i]) {
+         OverflowRef ref;
+         ref.length = lens[i];
+         RC rcode = writeOverflow (fileHandle, bytes[i], lens[i],
+                                   ref.firstPage);
+         if (rcode != rc::success) {
+            freeChains (fileHandle, chains);
+            return rcode;
+         }
+         chains.push_back (ref.firstPage);
+         memcpy (out + offset, &ref, sizeof(ref));
+         offset += sizeof(ref);
+         flag = FIELD_OVERFLOW;
+      } else if (lens[i] > 0) {
+         memcpy (out + offset, bytes[i], lens[i]);
+         offset += lens[i];
+      }
+      put16 (ends + i * sizeof(uint16_t), offset | flag);
+   }
+   return rc::success;
+}
+
+// Converts an internal record to the API format
+static RC decodeRecord(FileHandle &fileHandle,
+                       const vector<Attribute> &recordDescriptor,
+                       const char *record, void *data) {
+   unsigned fieldCount = recordDescriptor.size();
+   const char *nulls = recordNulls (record);
+   memcpy (data, nulls, nullBytes (fieldCount));
+   char *out = (char*) data + nullBytes (fieldCount);
+   string scratch;
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      if (isNull (nulls, i)) continue;
+      const char *bytes;
+      unsigned len;
+      RC rcode = readField (fileHandle, record, i, scratch, bytes, len);
+      if (rcode != rc::success) return rcode;
+      out += writeValue (recordDescriptor[i].type, bytes, len, out);
+   }
+   return rc::success;
+}
+
+// size of an internal record in the API format
+static unsigned decodedSize(const vector<Attribute> &recordDescriptor,
+                            const char *record) {
+   unsigned fieldCount = recordDescriptor.size();
+   const char *nulls = recordNulls (record);
+   unsigned size = nullBytes (fieldCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      if (isNull (nulls, i)) continue;
+      if (recordDescriptor[i].type != TypeVarChar) {
+         size += sizeof(int);
+         continue;
+      }
+      unsigned begin, end;
+      bool overflow;
+      fieldBounds (record, i, begin, end, overflow);
+      unsigned len = end - begin;
+      if (overflow) {
+         OverflowRef ref;
+         memcpy (&ref, record + begin, sizeof(ref));
+         len = ref.length;
+      }
+      size += sizeof(uint32_t) + len;
+   }
+   return size;
+}
+
+// Appends the first pages of the overflow chains of a record to chains
+static void recordChains(const char *record, vector<PageNum> &chains) {
+   unsigned fieldCount = get16 (record);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      unsigned begin, end;
+      bool overflow;
+      fieldBounds (record, i, begin, end, overflow);
+      if (!overflow) continue;
+      OverflowRef ref;
+      memcpy (&ref, record + begin, sizeof(ref));
+      chains.push_back (ref.firstPage);
+   }
+}
+
+// Gives the overflow pages of a record back to the free list
+static RC freeRecordOverflow(FileHandle &fileHandle, const char *record) {
+   vector<PageNum> chains;
+   recordChains (record, chains);
+   return freeChains (fileHandle, chains);
+}
+
+static RC readDataPage(FileHandle &fileHandle, PageNum pageNum,
+                       char *page) {
+   if (pageNum == 0 || pageNum >= fileHandle.getNumberOfPages()) {
+      RC_MSG (rc::invalid_rid, "[pageNum: %u]\n", pageNum);
+      return rc::invalid_rid;
+   }
+   RC rcode = fileHandle.readPage (pageNum, page);
+   if (rcode != rc::success) return rcode;
+   if (pageFooter (page)->type != PAGE_DATA) {
+      RC_MSG (rc::invalid_rid, "[pageNum: %u]\n", pageNum);
+      return rc::invalid_rid;
+   }
+   return rc::success;
+}
+
+static RC checkSlot(char *page, unsigned slotNum) {
+   if (slotNum >= pageFooter (page)->numSlots) {
+      RC_MSG (rc::invalid_rid, "[slotNum: %u]\n", slotNum);
+      return rc::invalid_rid;
+   }
+   if (pageSlot (page, slotNum)->offset == SLOT_EMPTY) {
+      return rc::record_deleted;
+   }
+   return rc::success;
+}
+
+// Reads the page of rid into page, unless it is loaded there already,
+// and, if the record has been moved by an update, the page it was moved
+// to into fwdPage.
+// POST: home is the RID of the cell holding the record
+static RC fetchRecord(FileHandle &fileHandle, const RID &rid, char *page,
+                      char *fwdPage, RID &home, bool loaded = false) {
+   RC rcode = rc::success;
+   if (!loaded) rcode = readDataPage (fileHandle, rid.pageNum, page);
+   if (rcode != rc::success) return rcode;
+   rcode = checkSlot (page, rid.slotNum);
+   if (rcode != rc::success) return rcode;
+
+   Slot *slot = pageSlot (page, rid.slotNum);
+   if (slot->length & SLOT_MOVED) {
+      // only reachable through its forwarding RID
+      RC_MSG (rc::invalid_rid, "[slotNum: %u]\n", rid.slotNum);
+      return rc::invalid_rid;
+   }
+   home = rid;
+   if (!(slot->length & SLOT_FORWARD)) return rc::success;
+
+   ForwardRef fwd;
+   memcpy (&fwd, pageCell (page, rid.slotNum), sizeof(fwd));
+   home.pageNum = fwd.pageNum;
+   home.slotNum = fwd.slotNum;
+   fileHandle.metrics().add (COUNTER_FORWARD_HOPS);
+   rcode = readDataPage (fileHandle, home.pageNum, fwdPage);
+   if (rcode != rc::success) return rcode;
+   return checkSlot (fwdPage, home.slotNum);
+}
+
+// Record cell of a slot whatever the format of the page. A compressed
+// cell or a PAX row is decoded into scratch, a forwarding cell is
+// returned as is.
+static const char* recordCell(char *page,
+                              const vector<Attribute> &recordDescriptor,
+                              unsigned slotNum, string &scratch) {
+   Slot *slot = pageSlot (page, slotNum);
+   uint8_t format = pageFooter (page)->format;
+   if (format == FORMAT_ROW || (slot->length & SLOT_FORWARD)) {
+      return pageCell (page, slotNum);
+   }
+   if (format == FORMAT_PAX) {
+      paxRecord (page, recordDescriptor, slot->offset, scratch);
+   } else {
+      CPageContext context;
+      context.load (page, recordDescriptor);
+      context.decode (pageCell (page, slotNum), scratch);
+   }
+   return scratch.data();
+}
+
+// Field attr of a record which is either an internal record or, if
+// record is NULL, row of the PAX page paxPage. Only a spilled field
+// touches its overflow pages.
+static RC recordField(FileHandle &fileHandle,
+                      const vector<Attribute> &recordDescriptor,
+                      const char *record, const char *paxPage, unsigned row,
+                      unsigned attr, string &scratch, const char *&bytes,
+                      unsigned &len, bool &null) {
+   if (record != NULL) {
+      null = isNull (recordNulls (record), attr);
+      if (null) return rc::success;
+      return readField (fileHandle, record, attr, scratch, bytes, len);
+   }
+   bool overflow = false;
+   null = !paxField (paxPage, recordDescriptor, row, attr, bytes, len,
+                     overflow);
+   if (null || !overflow) return rc::success;
+   OverflowRef ref;
+   memcpy (&ref, bytes, sizeof(ref));
+   scratch.resize (ref.length);
+   bytes = scratch.data();
+   len = ref.length;
+   return readOverflow (fileHandle, ref, &scratch[0]);
+}
+
+// Pages that are not FORMAT_ROW are decoded, changed and encoded again
+static void decodeEntries(char *page,
+                          const vector<Attribute> &recordDescriptor,
+                          vector<PageEntry> &entries) {
+   if (pageFooter (page)->format == FORMAT_PAX) {
+      paxDecode (page, recordDescriptor, entries);
+   } else {
+      cpageDecode (page, recordDescriptor, entries);
+   }
+}
+
+static bool encodeEntries(const vector<PageEntry> &entries,
+                          const vector<Attribute> &recordDescriptor,
+                          char *page) {
+   if (pageFooter (page)->format == FORMAT_PAX) {
+      return paxEncode (entries, recordDescriptor, page);
+   }
+   return cpageEncode (entries, recordDescriptor, page);
+}
+
+// Same contract as pageInsertCell
+static int insertCell(char *page, const vector<Attribute> &recordDescriptor,
+                      const string &cell, uint16_t flags) {
+   if (pageFooter (page)->format == FORMAT_ROW) {
+      return pageInsertCell (page, cell.data(), cell.size(), flags);
+   }
+   vector<PageEntry> entries;
+   decodeEntries (page, recordDescriptor, entries);
+   unsigned slotNum = 0;
+   while (slotNum < entries.size() && entries[slotNum].used) ++slotNum;
+   if (slotNum == entries.size()) entries.push_back (PageEntry());
+   entries[slotNum].used = true;
+   entries[slotNum].flags = flags;
+   entries[slotNum].cell = cell;
+   if (!encodeEntries (entries, recordDescriptor, page)) return -1;
+   return slotNum;
+}
+
+// Same contract as pageReplaceCell
+static bool replaceCell(char *page, const vector<Attribute> &recordDescriptor,
+                        unsigned slotNum, const string &cell,
+                        uint16_t flags) {
+   if (pageFooter (page)->format == FORMAT_ROW) {
+      return pageReplaceCell (page, slotNum, cell.data(), cell.size(),
+                              flags);
+   }
+   vector<PageEntry> entries;
+   decodeEntries (page, recordDescriptor, entries);
+   entries[slotNum].flags = flags;
+   entries[slotNum].cell = cell;
+   return encodeEntries (entries, recordDescriptor, page);
+}
+
+// Removing a record never makes an encoded page larger, so this always
+// fits
+static void eraseCell(char *page, const vector<Attribute> &recordDescriptor,
+                      unsigned slotNum) {
+   if (pageFooter (page)->format == FORMAT_ROW) {
+      pageEraseCell (page, slotNum);
+      return;
+   }
+   vector<PageEntry> entries;
+   decodeEntries (page, recordDescriptor, entries);
+   entries[slotNum].used = false;
+   entries[slotNum].cell.clear();
+   while (!entries.empty() && !entries.back().used) entries.pop_back();
+   encodeEntries (entries, recordDescriptor, page);
+}
+
+// Zone of attribute attr over the records of a data page. A record
+// forwarded to another page is still returned by scans of this one,
+// so a page with forwarding cells is left unknown.
+static void summarizePage(char *page,
+                          const vector<Attribute> &recordDescriptor,
+                          unsigned attr, Zone &zone) {
+   zoneInit (zone);
+   uint8_t format = pageFooter (page)->format;
+   CPageContext context;
+   if (format == FORMAT_COMPRESSED) context.load (page, recordDescriptor);
+   string scratch;
+   for (unsigned i = 0; i < pageFooter (page)->numSlots; ++i) {
+      Slot *slot = pageSlot (page, i);
+      if (slot->offset == SLOT_EMPTY || (slot->length & SLOT_MOVED)) {
+         continue;
+      }
+      if (slot->length & SLOT_FORWARD) {
+         zone.state = ZONE_UNKNOWN;
+         return;
+      }
+      const char *bytes;
+      unsigned len;
+      bool null, overflow;
+      if (format == FORMAT_PAX) {
+         null = !paxField (page, recordDescriptor, slot->offset, attr, bytes,
+                           len, overflow);
+      } else {
+         const char *record = pageCell (page, i);
+         if (format == FORMAT_COMPRESSED) {
+            context.decode (record, scratch);
+            record = scratch.data();
+         }
+         unsigned begin, end;
+         fieldBounds (record, attr, begin, end, overflow);
+         null = isNull (recordNulls (record), attr);
+         bytes = record + begin;
+      }
+      if (null) {
+         ++zone.nulls;
+      } else {
+         zoneAdd (zone, recordDescriptor[attr].type, bytes);
+      }
+   }
+}
 
-struct slot {
-void* rptr;
-size_t rsize;
+static bool sameZone(const Zone &a, const Zone &b) {
+   if (a.state != b.state) return false;
+   return a.state != ZONE_VALID || (a.min == b.min && a.max == b.max
+                                    && a.count == b.count
+                                    && a.nulls == b.nulls);
 }
 
+// Brings the zones and the free space of a data page just written up
+// to date
+static RC noteDataPage(FileHandle &fileHandle, const FileHeader &header,
+                       const vector<Attribute> &recordDescriptor,
+                       PageNum pageNum, char *page) {
+   FreeSpaceMap *map = freeSpaceMap (fileHandle);
+   if (map != NULL) map->update (pageNum, pageFreeSpace (page));
+   RC rcode = rc::success;
+   for (unsigned i = 0; i < header.auxCount && rcode == rc::success; ++i) {
+      const AuxEntry &aux = header.aux[i];
+      if (aux.kind != AUX_ZONEMAP || aux.attr >= recordDescriptor.size()) {
+         continue;
+      }
+      Zone zone;
+      summarizePage (page, recordDescriptor, aux.attr, zone);
+      rcode = zoneWrite (fileHandle, aux.root, pageNum, zone);
+   }
+   return rcode;
+}
+
+// Writes a data page back, see noteDataPage()
+static RC writeDataPage(FileHandle &fileHandle, const FileHeader &header,
+                        const vector<Attribute> &recordDescriptor,
+                        PageNum pageNum, char *page) {
+   RC rcode = fileHandle.writePage (pageNum, page);
+   if (rcode != rc::success) return rcode;
+   return noteDataPage (fileHandle, header, recordDescriptor, pageNum, page);
+}
+
+static unsigned coveredCount(uint32_t covered) {
+   return bitset<32> (covered).count();
+}
+
+// The attributes of covered (bit i for attribute i) of an internal
+// record as the payload of a covering index entry: the projected format
+// of a scan, [null bitmap][values in the API format]
+static RC recordPayload(FileHandle &fileHandle,
+                        const vector<Attribute> &recordDescriptor,
+                        const char *record, uint32_t covered,
+                        string &payload) {
+   payload.assign (nullBytes (coveredCount (covered)), '\0');
+   string scratch, value;
+   unsigned n = 0;
+   for (unsigned i = 0; i < recordDescriptor.size() && i < 32; ++i) {
+      if (!(covered & 1u << i)) continue;
+      if (isNull (recordNulls (record), i)) {
+         setNull (&payload[0], n++);
+         continue;
+      }
+      ++n;
+      const char *bytes;
+      unsigned len;
+      RC rcode = readField (fileHandle, record, i, scratch, bytes, len);
+      if (rcode != rc::success) return rcode;
+      value.resize (sizeof(uint32_t) + len);
+      payload.append (&value[0], writeValue (recordDescriptor[i].type,
+                                             bytes, len, &value[0]));
+   }
+   return rc::success;
+}
+
+// Key of an index in a record
+struct IndexKey {
+   bool null;             // null keys are not indexed
+   uint32_t hash;         // AUX_HASH
+   string key;            // AUX_BTREE
+   string payload;        // AUX_BTREE, see recordPayload
+};
+
+// Keys of the indexes of the file (keys[i] for header.aux[i]) in an
+// internal record
+static RC indexKeys(FileHandle &fileHandle, const FileHeader &header,
+                    const vector<Attribute> &recordDescriptor,
+                    const char *record, vector<IndexKey> &keys) {
+   keys.assign (header.auxCount, IndexKey());
+   string scratch;
+   for (unsigned i = 0; i < header.auxCount; ++i) {
+      const AuxEntry &aux = header.aux[i];
+      keys[i].null = true;
+      if ((aux.kind != AUX_HASH && aux.kind != AUX_BTREE)
+          || aux.attr >= recordDescriptor.size()
+          || isNull (recordNulls (record), aux.attr)) {
+         continue;
+      }
+      const char *bytes;
+      unsigned len;
+      RC rcode = readField (fileHandle, record, aux.attr, scratch, bytes,
+                            len);
+      if (rcode != rc::success) return rcode;
+      AttrType type = recordDescriptor[aux.attr].type;
+      keys[i].null = false;
+      if (aux.kind == AUX_HASH) {
+         keys[i].hash = hashValue (type, bytes, len);
+         continue;
+      }
+      keys[i].key = btreeKey (type, bytes, len);
+      if (aux.covered != 0) {
+         rcode = recordPayload (fileHandle, recordDescriptor, record,
+                                aux.covered, keys[i].payload);
+         if (rcode != rc::success) return rcode;
+      }
+   }
+   return rc::success;
+}
+
+// RETURNS: true if an index has the same entry for both keys
+static bool sameKey(const IndexKey &a, const IndexKey &b) {
+   if (a.null || b.null) return a.null == b.null;
+   return a.hash == b.hash && a.key == b.key && a.payload == b.payload;
+}
+
+// Moves the entries of rid in the indexes from its old keys to its new
+// keys (NULL for a record that is inserted / deleted)
+static RC updateIndexes(FileHandle &fileHandle, const FileHeader &header,
+                        const RID &rid, const vector<IndexKey> *oldKeys,
+                        const vector<IndexKey> *newKeys) {
+   RC rcode = rc::success;
+   for (unsigned i = 0; i < header.auxCount && rcode == rc::success; ++i) {
+      const AuxEntry &aux = header.aux[i];
+      if (aux.kind != AUX_HASH && aux.kind != AUX_BTREE) continue;
+      if (oldKeys != NULL && newKeys != NULL
+          && sameKey ((*oldKeys)[i], (*newKeys)[i])) {
+         continue;
+      }
+      bool hasOld = oldKeys != NULL && !(*oldKeys)[i].null;
+      bool hasNew = newKeys != NULL && !(*newKeys)[i].null;
+      AttrType type = (AttrType) aux.type;
+      if (hasOld && aux.kind == AUX_HASH) {
+         rcode = hashDelete (fileHandle, aux.root, (*oldKeys)[i].hash, rid);
+      } else if (hasOld) {
+         rcode = btreeDelete (fileHandle, type, aux.root, (*oldKeys)[i].key,
+                              rid);
+      }
+      if (rcode != rc::success || !hasNew) continue;
+      if (aux.kind == AUX_HASH) {
+         rcode = hashInsert (fileHandle, aux.root, (*newKeys)[i].hash, rid);
+      } else {
+         rcode = btreeInsert (fileHandle, type, aux.root, (*newKeys)[i].key,
+                              rid, (*newKeys)[i].payload);
+      }
+   }
+   return rcode;
+}
+
+// One pass over the file for its free space map
+static RC buildFreeSpaceMap(FileHandle &fileHandle, FreeSpaceMap &map,
+                            char *page) {
+   for (PageNum i = 1; i < fileHandle.getNumberOfPages(); ++i) {
+      RC rcode = fileHandle.readPage (i, page);
+      if (rcode != rc::success) return rcode;
+      map.update (i, pageFooter (page)->type == PAGE_DATA
+                     ? pageFreeSpace (page) : 0);
+   }
+   return rc::success;
+}
+
+// Inserts a cell into the insert page of the calling thread, else into
+// the first page the free space map says may hold it (see fsm.h)
+// POST: slotNum is -1 if none could, page holds the last page read
+static RC placeCell(FileHandle &fileHandle, const FileHeader &header,
+                    const vector<Attribute> &recordDescriptor,
+                    const string &cell, uint16_t flags, char *page,
+                    PageNum &pageNum, int &slotNum) {
+   FreeSpaceMap *map = freeSpaceMap (fileHandle);
+   if (map == NULL) {
+      map = &openFreeSpaceMap (fileHandle);
+      RC rcode = buildFreeSpaceMap (fileHandle, *map, page);
+      if (rcode != rc::success) {
+         dropFreeSpaceMap (fileHandle);
+         return rcode;
+      }
+   }
+   // the encoded formats may store the cell in less than its size
+   unsigned need = MIN_CELL + sizeof(Slot);
+   if (!(header.flags & (RBFM_COMPRESSED | RBFM_PAX))) {
+      need = std::max (need, (unsigned) cell.size());
+   }
+   PageNum next = 1;
+   pageNum = map->insertPage();
+   slotNum = -1;
+   while (true) {
+      if (pageNum == NO_PAGE) {
+         pageNum = map->find (need, next);
+         if (pageNum == NO_PAGE) return rc::success;
+         next = pageNum + 1;
+      }
+      fileHandle.metrics().add (COUNTER_FSM_PROBES);
+      RC rcode = fileHandle.readPage (pageNum, page);
+      if (rcode != rc::success) return rcode;
+      unsigned room = pageFooter (page)->type == PAGE_DATA
+                      ? pageFreeSpace (page) : 0;
+      if (room >= MIN_CELL + sizeof(Slot)) {
+         slotNum = insertCell (page, recordDescriptor, cell, flags);
+      }
+      if (slotNum >= 0) return rc::success;
+      map->update (pageNum, room);
+      pageNum = NO_PAGE;
+   }
+}
+
+// Stores a cell in a data page with room for it, a new one if there is
+// none. An append only tries the last page of the file.
+static RC storeCell(FileHandle &fileHandle, const FileHeader &header,
+                    const vector<Attribute> &recordDescriptor,
+                    const string &cell, uint16_t flags, RID &rid,
+                    bool append = false) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   RC rcode = rc::success;
+   PageNum numPages = fileHandle.getNumberOfPages();
+   PageNum pageNum = NO_PAGE;
+   int slotNum = -1;
+   if (!append) {
+      rcode = placeCell (fileHandle, header, recordDescriptor, cell, flags,
+                         page, pageNum, slotNum);
+   } else if (numPages > 1) {
+      pageNum = numPages - 1;
+      rcode = fileHandle.readPage (pageNum, page);
+      if (rcode == rc::success && pageFooter (page)->type == PAGE_DATA
+          && pageFreeSpace (page) >= MIN_CELL + sizeof(Slot)) {
+         slotNum = insertCell (page, recordDescriptor, cell, flags);
+      }
+   }
+   if (rcode == rc::success && slotNum < 0) {
+      rcode = allocPage (fileHandle, PAGE_DATA, page, pageNum);
+      if (rcode == rc::success) {
+         slotNum = insertCell (page, recordDescriptor, cell, flags);
+      }
+   }
+   if (rcode == rc::success && !append) {
+      openFreeSpaceMap (fileHandle).claim (pageNum);
+   }
+   if (rcode == rc::success) {
+      rid.pageNum = pageNum;
+      rid.slotNum = slotNum;
+      rcode = writeDataPage (fileHandle, header, recordDescriptor, pageNum,
+                             page);
+   }
+   free (page);
+   return rcode;
+}
+
+// Lays the first count entries out on an empty data page of format
+// RETURNS: false if they do not fit
+static bool fillDataPage(const vector<PageEntry> &entries, unsigned count,
+                         const vector<Attribute> &recordDescriptor,
+                         uint8_t format, char *page) {
+   initPage (page, PAGE_DATA);
+   pageFooter (page)->format = format;
+   if (format != FORMAT_ROW) {
+      vector<PageEntry> prefix (entries.begin(), entries.begin() + count);
+      return encodeEntries (prefix, recordDescriptor, page);
+   }
+   for (unsigned i = 0; i < count; ++i) {
+      if (pageInsertCell (page, entries[i].cell.data(),
+                          entries[i].cell.size(), 0) < 0) {
+         return false;
+      }
+   }
+   return true;
+}
+
+// Appends a data page with as many of the leading entries as fit, at
+// least fits of them (known to fit), and removes them from entries once
+// the page is written.
+// If filled, page already holds the first fits entries, which are the
+// ones appended. The RIDs of their records are set and their index
+// entries added.
+static RC appendDataPage(FileHandle &fileHandle, const FileHeader &header,
+                         const vector<Attribute> &recordDescriptor,
+                         uint8_t format, vector<PageEntry> &entries,
+                         vector<unsigned> &owners, unsigned fits,
+                         bool filled, vector<RID> &rids, char *page) {
+   unsigned count = filled ? fits : entries.size();
+   if (!filled
+       && !fillDataPage (entries, count, recordDescriptor, format, page)) {
+      // binary search of the largest prefix that fits: count = lo
+      unsigned lo = fits, hi = entries.size();
+      while (hi - lo > 1) {
+         unsigned mid = lo + (hi - lo) / 2;
+         if (fillDataPage (entries, mid, recordDescriptor, format, page)) {
+            lo = mid;
+         } else {
+            hi = mid;
+         }
+      }
+      count = lo;
+      if (count == 0 || !fillDataPage (entries, count, recordDescriptor,
+                                        format, page)) {
+         return rc::record_too_large;
+      }
+   }
+   PageNum pageNum = fileHandle.getNumberOfPages();
+   RC rcode = fileHandle.appendPage (page);
+   if (rcode != rc::success) return rcode;
+   rcode = noteDataPage (fileHandle, header, recordDescriptor, pageNum, page);
+   vector<IndexKey> keys;
+   for (unsigned i = 0; i < count && rcode == rc::success; ++i) {
+      RID &rid = rids[owners[i]];
+      rid.pageNum = pageNum;
+      rid.slotNum = i;
+      rcode = indexKeys (fileHandle, header, recordDescriptor,
+                         entries[i].cell.data(), keys);
+      if (rcode == rc::success) {
+         rcode = updateIndexes (fileHandle, header, rid, NULL, &keys);
+      }
+   }
+   entries.erase (entries.begin(), entries.begin() + count);
+   owners.erase (owners.begin(), owners.begin() + count);
+   return rcode;
+}
+
+static RC snapshotEnded(const Snapshot &snapshot) {
+   RC_MSG (rc::snapshot_ended, "[timestamp: %llu]\n",
+           (unsigned long long) snapshot.timestamp);
+   return rc::snapshot_ended;
+}
+
+static string forwardCell(const RID &rid) {
+   ForwardRef fwd;
+   fwd.pageNum = rid.pageNum;
+   fwd.slotNum = rid.slotNum;
+   return string ((const char*) &fwd, sizeof(fwd));
+}
+
+static int findAttribute(const vector<Attribute> &recordDescriptor,
+                         const string &attributeName) {
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      if (recordDescriptor[i].name == attributeName) return i;
+   }
+   return -1;
+}
+
+static int findAttribute(const Schema &schema, const string &attributeName) {
+   return schema.find (attributeName);
+}
+
+// Descriptor: a record descriptor, or its Schema
+// POST: attrs holds the positions of names in the descriptor
+template <class Descriptor>
+static RC findAttributes(const Descriptor &descriptor,
+                         const vector<string> &names,
+                         vector<unsigned> &attrs) {
+   attrs.clear();
+   for (unsigned i = 0; i < names.size(); ++i) {
+      int attr = findAttribute (descriptor, names[i]);
+      if (attr < 0) {
+         RC_MSG (rc::attribute_not_found, "[%s]\n", names[i].c_str());
+         return rc::attribute_not_found;
+      }
+      attrs.push_back (attr);
+   }
+   return rc::success;
+}
+
+// Writes the projection of a record (see recordField) to data:
+// [null bitmap of the projection][projected values]
+static RC projectRecord(FileHandle &fileHandle,
+                        const vector<Attribute> &recordDescriptor,
+                        const char *record, const char *paxPage,
+                        unsigned row, const vector<unsigned> &projection,
+                        void *data) {
+   string scratch;
+   const char *bytes;
+   unsigned len;
+   bool null;
+   char *out = (char*) data;
+   unsigned projBytes = nullBytes (projection.size());
+   memset (out, 0, projBytes);
+   out += projBytes;
+   for (unsigned i = 0; i < projection.size(); ++i) {
+      unsigned attr = projection[i];
+      RC rcode = recordField (fileHandle, recordDescriptor, record, paxPage,
+                              row, attr, scratch, bytes, len, null);
+      if (rcode != rc::success) return rcode;
+      if (null) {
+         setNull ((char*) data, i);
+      } else {
+         out += writeValue (recordDescriptor[attr].type, bytes, len, out);
+      }
+   }
+   return rc::success;
+}
+
+// Reads the projection of the record of rid (see projectRecord)
+static RC readProjection(FileHandle &fileHandle,
+                         const vector<Attribute> &recordDescriptor,
+                         const RID &rid, const vector<unsigned> &projection,
+                         void *data) {
+   FileLatch latch (fileHandle.latch());
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fwdPage = (char*) malloc (PAGE_SIZE);
+   RID home;
+   RC rcode = fetchRecord (fileHandle, rid, page, fwdPage, home);
+   if (rcode == rc::success) {
+      char *homePage = home.pageNum == rid.pageNum ? page : fwdPage;
+      string cellScratch;
+      const char *record = NULL;
+      const char *paxPage = NULL;
+      unsigned row = 0;
+      if (pageFooter (homePage)->format == FORMAT_PAX) {
+         // straight to the minipages of the attributes
+         paxPage = homePage;
+         row = pageSlot (homePage, home.slotNum)->offset;
+      } else {
+         record = recordCell (homePage, recordDescriptor, home.slotNum,
+                              cellScratch);
+      }
+      rcode = projectRecord (fileHandle, recordDescriptor, record, paxPage,
+                             row, projection, data);
+   }
+   free (page);
+   free (fwdPage);
+   return rcode;
+}
+
+
+// bytes of a value in the API format, without the VarChar length
+static const char* valueBytes(AttrType type, const char *value,
+                              unsigned &len) {
+   if (type != TypeVarChar) {
+      len = sizeof(int);
+      return value;
+   }
+   uint32_t varcharLen;
+   memcpy (&varcharLen, value, sizeof(varcharLen));
+   len = varcharLen;
+   return value + sizeof(varcharLen);
+}
+
+// RETURNS: position in FileHeader::aux of the structure of this kind
+//          on attr, -1 if there is none
+static int findAux(const FileHeader &header, uint8_t kind, int attr) {
+   for (unsigned i = 0; i < header.auxCount; ++i) {
+      if (header.aux[i].kind == kind && (int) header.aux[i].attr == attr) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+// Before building a structure: exists tells whether it is already
+// there, an error if it could not be listed in the header
+static RC checkAux(FileHandle &fileHandle, uint8_t kind, int attr,
+                   bool &exists) {
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   exists = findAux (header, kind, attr) >= 0;
+   if (!exists && header.auxCount == RBFM_MAX_AUX) {
+      RC_MSG (rc::header_full, "\n");
+      return rc::header_full;
+   }
+   return rc::success;
+}
+
+// Lists a structure built on attr in the header page
+static RC addAux(FileHandle &fileHandle, uint8_t kind, AttrType type,
+                 unsigned attr, PageNum root, uint32_t covered = 0) {
+   // read again, building it may have changed the free list
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   AuxEntry &aux = header.aux[header.auxCount++];
+   aux.kind = kind;
+   aux.type = type;
+   aux.attr = attr;
+   aux.root = root;
+   aux.covered = covered;
+   return writeHeader (fileHandle, header);
+}
+
+// Calls visit with the RID, the value (internal format) and the
+// payload of the attributes of covered (see recordPayload) of every
+// record where attr is not null
+static RC visitValues(FileHandle &fileHandle,
+                      const vector<Attribute> &recordDescriptor,
+                      unsigned attr, uint32_t covered,
+                      const function<RC (const RID&, const char*, unsigned,
+                                         const string&)> &visit) {
+   // [null bitmap][covered values][value of attr]
+   const Schema &schema = schemaOf (recordDescriptor);
+   vector<string> projection;
+   unsigned size = 0;
+   for (unsigned i = 0; i < recordDescriptor.size() && i < 32; ++i) {
+      if (!(covered & 1u << i)) continue;
+      projection.push_back (recordDescriptor[i].name);
+      size += schema.valueMax[i];
+   }
+   unsigned n = projection.size();
+   projection.push_back (recordDescriptor[attr].name);
+   size += nullBytes (n + 1) + schema.valueMax[attr];
+
+   RBFM_ScanIterator it;
+   RC rcode = RecordBasedFileManager::instance()->scan (fileHandle,
+                 recordDescriptor, "", NO_OP, NULL, projection, it);
+   vector<char> value (size);
+   string payload;
+   RID rid;
+   while (rcode == rc::success
+          && (rcode = it.getNextRecord (rid, value.data())) == rc::success) {
+      if (isNull (value.data(), n)) continue;
+      payload.assign (nullBytes (n), '\0');
+      const char *in = value.data() + nullBytes (n + 1);
+      for (unsigned i = 0, j = 0; j < n; ++i) {
+         if (!(covered & 1u << i)) continue;
+         if (isNull (value.data(), j)) {
+            setNull (&payload[0], j);
+         } else {
+            unsigned valueLen = valueLength (recordDescriptor[i].type, in);
+            payload.append (in, valueLen);
+            in += valueLen;
+         }
+         ++j;
+      }
+      unsigned len;
+      const char *bytes = valueBytes (recordDescriptor[attr].type, in, len);
+      rcode = visit (rid, bytes, len, payload);
+   }
+   it.close();
+   return rcode == RBFM_EOF ? (RC) rc::success : rcode;
+}
+
+// Value of attr in the payload of a covering index entry
+// RETURNS: false if the payload does not hold it
+static bool payloadField(const vector<Attribute> &recordDescriptor,
+                         uint32_t covered, const string &payload,
+                         unsigned attr, const char *&bytes, unsigned &len,
+                         bool &null) {
+   if (attr >= 32 || !(covered & 1u << attr)) return false;
+   const char *in = payload.data() + nullBytes (coveredCount (covered));
+   for (unsigned i = 0, j = 0; i <= attr; ++i) {
+      if (!(covered & 1u << i)) continue;
+      null = isNull (payload.data(), j++);
+      if (i == attr) break;
+      if (!null) in += valueLength (recordDescriptor[i].type, in);
+   }
+   if (!null) bytes = valueBytes (recordDescriptor[attr].type, in, len);
+   return true;
+}
+
+// Value of attr in an entry of a B+-tree on keyAttr with the payload
+// of the attributes of covered
+// RETURNS: false if the entry does not hold it
+static bool entryField(const vector<Attribute> &recordDescriptor,
+                       unsigned keyAttr, uint32_t covered,
+                       const BTreeEntry &entry, unsigned attr,
+                       const char *&bytes, unsigned &len, bool &null) {
+   if (payloadField (recordDescriptor, covered, entry.payload, attr, bytes,
+                     len, null)) {
+      return true;
+   }
+   // a VarChar key this long may have been cut
+   if (attr != keyAttr || (recordDescriptor[attr].type == TypeVarChar
+                           && entry.key.size() >= BTREE_KEY_MAX)) {
+      return false;
+   }
+   bytes = entry.key.data();
+   len = entry.key.size();
+   null = false;
+   return true;
+}
+
+// Updates a record that stays in its page and changes nothing else in
+// the file: no overflow page, index entry, zone or version. It holds the
+// latch of the file shared and the latch of the page, so that updates
+// of records of other pages go on at the same time; the record locks
+// (lock.h) keep transactions off each other's records.
+// RETURNS: false if the update is not one of those, nothing has been
+//          written then; else true, with the result of the update in
+//          rcode
+static bool updateInPlace(FileHandle &fileHandle,
+                          const vector<Attribute> &recordDescriptor,
+                          const void *data, const RID &rid, RC &rcode) {
+   SharedFileLatch latch (fileHandle.latch());
+   VersionStore *versions = versionStore (fileHandle);
+   if ((versions != NULL && versions->recording()) || traced (fileHandle)) {
+      return false;
+   }
+   vector<const char*> bytes;
+   vector<unsigned> lens;
+   if (recordValues (recordDescriptor, data, bytes, lens) > RBFM_INLINE_MAX
+       || rid.pageNum == 0 || rid.pageNum >= fileHandle.getNumberOfPages()) {
+      return false;
+   }
+   FileHeader header;
+   if (readHeader (fileHandle, header) != rc::success) return false;
+   // the map only grows with the latch exclusive
+   FreeSpaceMap *map = freeSpaceMap (fileHandle);
+   if (map != NULL && rid.pageNum >= map->free.size()) return false;
+
+   lock_guard<mutex> pageLatch (fileHandle.pageLatch (rid.pageNum));
+   char *page = (char*) malloc (PAGE_SIZE);
+   // an update that fails is left to updateRecord(), which reports it
+   bool inPlace = fileHandle.readPage (rid.pageNum, page) == rc::success
+                  && pageFooter (page)->type == PAGE_DATA
+                  && rid.slotNum < pageFooter (page)->numSlots;
+   if (inPlace) {
+      Slot *slot = pageSlot (page, rid.slotNum);
+      inPlace = slot->offset != SLOT_EMPTY
+                && !(slot->length & (SLOT_FORWARD | SLOT_MOVED));
+   }
+   string scratch, record;
+   vector<IndexKey> oldKeys, newKeys;
+   if (inPlace) {
+      const char *old = recordCell (page, recordDescriptor, rid.slotNum,
+                                    scratch);
+      vector<PageNum> chains;
+      recordChains (old, chains);
+      // the new record fits inline, nothing is spilled
+      inPlace = chains.empty()
+                && indexKeys (fileHandle, header, recordDescriptor, old,
+                              oldKeys) == rc::success
+                && encodeRecord (fileHandle, recordDescriptor, data,
+                                 record) == rc::success
+                && indexKeys (fileHandle, header, recordDescriptor,
+                              record.data(), newKeys) == rc::success;
+   }
+   for (unsigned i = 0; inPlace && i < header.auxCount; ++i) {
+      inPlace = sameKey (oldKeys[i], newKeys[i]);
+   }
+   bool zoned = false;
+   for (unsigned i = 0; i < header.auxCount; ++i) {
+      zoned = zoned || header.aux[i].kind == AUX_ZONEMAP;
+   }
+   string before;
+   if (zoned) before.assign (page, PAGE_SIZE);
+   inPlace = inPlace && replaceCell (page, recordDescriptor, rid.slotNum,
+                                     record, 0);
+   for (unsigned i = 0; inPlace && i < header.auxCount; ++i) {
+      const AuxEntry &aux = header.aux[i];
+      if (aux.kind != AUX_ZONEMAP || aux.attr >= recordDescriptor.size()) {
+         continue;
+      }
+      // the zone of the page must stay as it is
+      Zone oldZone, newZone;
+      summarizePage (&before[0], recordDescriptor, aux.attr, oldZone);
+      summarizePage (page, recordDescriptor, aux.attr, newZone);
+      inPlace = sameZone (oldZone, newZone);
+   }
+   if (inPlace) {
+      rcode = fileHandle.writePage (rid.pageNum, page);
+      if (rcode == rc::success && map != NULL) {
+         map->update (rid.pageNum, pageFreeSpace (page));
+      }
+   }
+   free (page);
+   return inPlace;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
 
 RecordBasedFileManager* RecordBasedFileManager::_rbf_manager = 0;
 
@@ -17,7 +1135,7 @@ RecordBasedFileManager* RecordBasedFileManager::instance()
 }
 
 
-RecordBasedFileManager::RecordBasedFileManager() 
+RecordBasedFileManager::RecordBasedFileManager()
 {
     _pfm = PagedFileManager::instance();
 }
@@ -26,47 +1144,1161 @@ RecordBasedFileManager::~RecordBasedFileManager()
 {
 }
 
-RC RecordBasedFileManager::createFile(const string &fileName) 
+RC RecordBasedFileManager::createFile(const string &fileName)
+{
+   return createFile (fileName, 0);
+}
+
+RC RecordBasedFileManager::createFile(const string &fileName,
+                                      unsigned options)
 {
-    _pfm->createFile(fileName);
-    return -1;
+   if ((options & RBFM_COMPRESSED) && (options & RBFM_PAX)) {
+      RC_MSG (rc::invalid_file_options, "[options: %#x]\n", options);
+      return rc::invalid_file_options;
+   }
+   RC rcode = _pfm->createFile (fileName);
+   if (rcode != rc::success) return rcode;
+
+   FileHandle fileHandle;
+   rcode = _pfm->openFile (fileName, fileHandle);
+   if (rcode != rc::success) return rcode;
+
+   FileHeader header;
+   memset (&header, 0, sizeof(header));
+   header.magic = RBFM_MAGIC;
+   header.version = RBFM_VERSION;
+   header.flags = options;
+   header.freeList = NO_PAGE;
+   rcode = writeHeader (fileHandle, header);
+   _pfm->closeFile (fileHandle);
+   return rcode;
 }
 
-RC RecordBasedFileManager::destroyFile(const string &fileName) 
+RC RecordBasedFileManager::destroyFile(const string &fileName)
 {
-    _pfm->destroyFile(fileName);
-    return -1;
+   return _pfm->destroyFile (fileName);
 }
 
-RC RecordBasedFileManager::openFile(const string &fileName, 
-                                    FileHandle &fileHandle) 
+RC RecordBasedFileManager::openFile(const string &fileName,
+                                    FileHandle &fileHandle)
 {
-    _pfm->openFile(fileName, fileHandle);
-    return -1;
+   RC rcode = _pfm->openFile (fileName, fileHandle);
+   if (rcode != rc::success) return rcode;
+
+   FileHeader header;
+   rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) {
+      _pfm->closeFile (fileHandle);
+   }
+   return rcode;
 }
 
-RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) 
+RC RecordBasedFileManager::closeFile(FileHandle &fileHandle)
 {
-    _pfm->closeFile(fileHandle);
-    return -1;
+   FileLatch latch (fileHandle.latch());
+   dropVersionStore (fileHandle);
+   dropFreeSpaceMap (fileHandle);
+   dropTrace (fileHandle);
+   return _pfm->closeFile (fileHandle);
 }
 
-RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, 
+RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle,
  const vector<Attribute> &recordDescriptor, const void *data, RID &rid) {
-    return -1;
+   return storeRecord (fileHandle, recordDescriptor, data, rid, false);
+}
+
+RC RecordBasedFileManager::appendRecord(FileHandle &fileHandle,
+                                        const vector<Attribute> &recordDescriptor,
+                                        const void *data, RID &rid) {
+   return storeRecord (fileHandle, recordDescriptor, data, rid, true);
+}
+
+RC RecordBasedFileManager::storeRecord(FileHandle &fileHandle,
+                                       const vector<Attribute> &recordDescriptor,
+                                       const void *data, RID &rid,
+                                       bool append) {
+   MetricTimer timer (fileHandle.metrics(), LATENCY_INSERT);
+   FileLatch latch (fileHandle.latch());
+   TraceCall call (fileHandle, TRACE_INSERT, rid);
+   if (call.active()) call.setSize (tupleSize (recordDescriptor, data));
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   string record;
+   rcode = encodeRecord (fileHandle, recordDescriptor, data, record);
+   vector<IndexKey> keys;
+   if (rcode == rc::success) {
+      rcode = indexKeys (fileHandle, header, recordDescriptor, record.data(),
+                         keys);
+      if (rcode == rc::success) {
+         rcode = storeCell (fileHandle, header, recordDescriptor, record, 0,
+                            rid, append);
+      }
+      // the overflow chains written by encodeRecord() are not referenced
+      if (rcode != rc::success) freeRecordOverflow (fileHandle, record.data());
+   }
+   if (rcode == rc::success) {
+      rcode = keepVersion (fileHandle, recordDescriptor, rid, false);
+   }
+   if (rcode == rc::success) {
+      rcode = updateIndexes (fileHandle, header, rid, NULL, &keys);
+   }
+   return rcode;
+}
+
+RC RecordBasedFileManager::bulkAppend(FileHandle &fileHandle,
+                                      const vector<Attribute> &recordDescriptor,
+                                      const vector<const void*> &records,
+                                      vector<RID> &rids) {
+   FileLatch latch (fileHandle.latch());
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   uint8_t format = FORMAT_ROW;
+   if (header.flags & RBFM_COMPRESSED) format = FORMAT_COMPRESSED;
+   if (header.flags & RBFM_PAX) format = FORMAT_PAX;
+
+   // A row page is filled one cell at a time. Encoding a page of another
+   // format is linear in its records, so whether the pending records
+   // still fit is only checked now and then: at growing steps from
+   // about as many records as the previous page held.
+   rids.assign (records.size(), RID());
+   char *page = (char*) malloc (PAGE_SIZE);
+   fillDataPage (vector<PageEntry>(), 0, recordDescriptor, format, page);
+   vector<PageEntry> entries;   // records of the page being built
+   vector<unsigned> owners;     // index in records of each entry
+   unsigned fits = 0;           // leading entries known to fit a page
+   unsigned probe = 1;          // entries at the next check
+   unsigned step = 1;           // from that check to the one after
+   for (unsigned i = 0; i < records.size() && rcode == rc::success; ++i) {
+      PageEntry entry;
+      entry.used = true;
+      entry.flags = 0;
+      rcode = encodeRecord (fileHandle, recordDescriptor, records[i],
+                            entry.cell);
+      if (rcode != rc::success) break;
+      entries.push_back (entry);
+      owners.push_back (i);
+      if (format == FORMAT_ROW) {
+         const string &cell = entries.back().cell;
+         if (pageInsertCell (page, cell.data(), cell.size(), 0) >= 0) {
+            fits = entries.size();
+            continue;
+         }
+         if (fits > 0) {
+            rcode = appendDataPage (fileHandle, header, recordDescriptor,
+                                    format, entries, owners, fits, true,
+                                    rids, page);
+         }
+         // the record starts the next page
+         if (rcode == rc::success
+             && !fillDataPage (entries, 1, recordDescriptor, format, page)) {
+            rcode = rc::record_too_large;
+         }
+         fits = 1;
+         continue;
+      }
+      if (entries.size() < probe) continue;
+      if (fillDataPage (entries, entries.size(), recordDescriptor, format,
+                        page)) {
+         fits = entries.size();
+         probe = fits + step;
+         step *= 2;
+         continue;
+      }
+      unsigned pending = entries.size();
+      rcode = appendDataPage (fileHandle, header, recordDescriptor, format,
+                              entries, owners, fits, false, rids, page);
+      unsigned count = pending - entries.size();
+      step = std::max (count / 16, 1u);
+      probe = std::max (count - step, 1u);
+      fits = 0;
+   }
+   if (format == FORMAT_ROW && !entries.empty() && rcode == rc::success) {
+      rcode = appendDataPage (fileHandle, header, recordDescriptor, format,
+                              entries, owners, fits, true, rids, page);
+   }
+   while (!entries.empty() && rcode == rc::success) {
+      rcode = appendDataPage (fileHandle, header, recordDescriptor, format,
+                              entries, owners, 0, false, rids, page);
+   }
+   // the overflow chains of the records not written are not referenced
+   for (unsigned i = 0; i < entries.size(); ++i) {
+      freeRecordOverflow (fileHandle, entries[i].cell.data());
+   }
+   free (page);
+   for (unsigned i = 0; i < records.size() && rcode == rc::success; ++i) {
+      rcode = keepVersion (fileHandle, recordDescriptor, rids[i], false);
+   }
+   return rcode;
 }
 
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data) {
-        void* page = malloc(PAGE_SIZE);
-        void* curr = page + PAGE_SIZE - 4;
-        fileHandle.readpage(rid.pageNum, page);
-	//data now has page
-        int slot = rid.slotNum;
-        int NumberofSlots = 0;
-	
-	return -1;
+   MetricTimer timer (fileHandle.metrics(), LATENCY_READ);
+   FileLatch latch (fileHandle.latch());
+   TraceCall call (fileHandle, TRACE_READ, rid);
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fwdPage = (char*) malloc (PAGE_SIZE);
+   RID home;
+   RC rcode = fetchRecord (fileHandle, rid, page, fwdPage, home);
+   if (rcode == rc::success) {
+      char *homePage = home.pageNum == rid.pageNum ? page : fwdPage;
+      string scratch;
+      rcode = decodeRecord (fileHandle, recordDescriptor,
+                            recordCell (homePage, recordDescriptor,
+                                        home.slotNum, scratch), data);
+   }
+   if (call.active() && rcode == rc::success) {
+      call.setSize (tupleSize (recordDescriptor, data));
+   }
+   free (page);
+   free (fwdPage);
+   return rcode;
+}
+
+RC RecordBasedFileManager::beginSnapshot(FileHandle &fileHandle,
+                                         Snapshot &snapshot) {
+   FileLatch latch (fileHandle.latch());
+   snapshot.fileHandle = &fileHandle;
+   snapshot.timestamp = openVersionStore (fileHandle).begin();
+   return rc::success;
+}
+
+RC RecordBasedFileManager::endSnapshot(Snapshot &snapshot) {
+   if (snapshot.fileHandle == NULL) return rc::success;
+   FileLatch latch (snapshot.fileHandle->latch());
+   VersionStore *versions = versionStore (*snapshot.fileHandle);
+   if (versions != NULL) versions->end (snapshot.timestamp);
+   snapshot.fileHandle = NULL;
+   return rc::success;
+}
+
+// Keeps the record of rid as it is before a change (none if it does not
+// exist yet) for the active snapshots of the file
+RC RecordBasedFileManager::keepVersion(FileHandle &fileHandle,
+                                       const vector<Attribute> &recordDescriptor,
+                                       const RID &rid, bool exists) {
+   VersionStore *versions = versionStore (fileHandle);
+   if (versions == NULL || !versions->recording()) return rc::success;
+   if (!exists) {
+      versions->keep (rid, NULL, 0);
+      return rc::success;
+   }
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fwdPage = (char*) malloc (PAGE_SIZE);
+   RID home;
+   RC rcode = fetchRecord (fileHandle, rid, page, fwdPage, home);
+   if (rcode == rc::success) {
+      char *homePage = home.pageNum == rid.pageNum ? page : fwdPage;
+      string scratch;
+      const char *record = recordCell (homePage, recordDescriptor,
+                                       home.slotNum, scratch);
+      string data (decodedSize (recordDescriptor, record), '\0');
+      rcode = decodeRecord (fileHandle, recordDescriptor, record, &data[0]);
+      if (rcode == rc::success) {
+         versions->keep (rid, data.data(), data.size());
+      }
+   }
+   free (page);
+   free (fwdPage);
+   return rcode;
+}
+
+RC RecordBasedFileManager::readRecord(const Snapshot &snapshot,
+                                      const vector<Attribute> &recordDescriptor,
+                                      const RID &rid, void *data) {
+   if (snapshot.fileHandle == NULL) return snapshotEnded (snapshot);
+   // the version store is dropped under the latch by closeFile()
+   FileLatch latch (snapshot.fileHandle->latch());
+   VersionStore *versions = versionStore (*snapshot.fileHandle);
+   if (versions == NULL) return snapshotEnded (snapshot);
+   const Version *version = versions->find (rid, snapshot.timestamp);
+   if (version == NULL) {
+      return readRecord (*snapshot.fileHandle, recordDescriptor, rid, data);
+   }
+   if (version->absent) return rc::record_deleted;
+   memcpy (data, version->data.data(), version->data.size());
+   return rc::success;
+}
+
+RC RecordBasedFileManager::readRecords(FileHandle &fileHandle,
+                                       const vector<Attribute> &recordDescriptor,
+                                       const vector<RID> &rids,
+                                       const vector<void*> &data) {
+   FileLatch latch (fileHandle.latch());
+   // in page order, so that the records of a page share one read
+   vector<unsigned> order (rids.size());
+   for (unsigned i = 0; i < order.size(); ++i) order[i] = i;
+   stable_sort (order.begin(), order.end(),
+                [&rids](unsigned a, unsigned b) {
+                   return rids[a].pageNum != rids[b].pageNum
+                          ? rids[a].pageNum < rids[b].pageNum
+                          : rids[a].slotNum < rids[b].slotNum;
+                });
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fwdPage = (char*) malloc (PAGE_SIZE);
+   PageNum pageNum = 0;       // the one in page, 0 if none
+   string scratch;
+   RC rcode = rc::success;
+   for (unsigned i = 0; i < order.size() && rcode == rc::success; ++i) {
+      const RID &rid = rids[order[i]];
+      bool loaded = rid.pageNum == pageNum;
+      pageNum = 0;
+      RID home;
+      rcode = fetchRecord (fileHandle, rid, page, fwdPage, home, loaded);
+      if (rcode != rc::success) break;
+      pageNum = rid.pageNum;
+      char *homePage = home.pageNum == rid.pageNum ? page : fwdPage;
+      rcode = decodeRecord (fileHandle, recordDescriptor,
+                            recordCell (homePage, recordDescriptor,
+                                        home.slotNum, scratch),
+                            data[order[i]]);
+   }
+   free (page);
+   free (fwdPage);
+   return rcode;
 }
 
 RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor, const void *data) {
-    return -1;
+   char line[256];
+   unsigned len = formatRecord (recordDescriptor, data, STYLE_TEXT, line,
+                                sizeof(line));
+   if (len > 0) {
+      cout.write (line, len);
+      return rc::success;
+   }
+   string lines;
+   formatRecords (recordDescriptor, vector<const void*> (1, data),
+                  STYLE_TEXT, lines);
+   cout << lines;
+   return rc::success;
+}
+
+RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle,
+                                        const vector<Attribute> &recordDescriptor,
+                                        const RID &rid) {
+   MetricTimer timer (fileHandle.metrics(), LATENCY_DELETE);
+   FileLatch latch (fileHandle.latch());
+   TraceCall call (fileHandle, TRACE_DELETE, rid);
+   RC rcode = keepVersion (fileHandle, recordDescriptor, rid, true);
+   if (rcode != rc::success) return rcode;
+   FileHeader header;
+   rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fwdPage = (char*) malloc (PAGE_SIZE);
+   RID home;
+   vector<IndexKey> keys;
+   vector<PageNum> chains;
+   rcode = fetchRecord (fileHandle, rid, page, fwdPage, home);
+   if (rcode == rc::success) {
+      char *homePage = home.pageNum == rid.pageNum ? page : fwdPage;
+      string scratch;
+      const char *record = recordCell (homePage, recordDescriptor,
+                                       home.slotNum, scratch);
+      rcode = indexKeys (fileHandle, header, recordDescriptor, record, keys);
+      recordChains (record, chains);
+   }
+   if (rcode == rc::success && home.pageNum != rid.pageNum) {
+      eraseCell (fwdPage, recordDescriptor, home.slotNum);
+      rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                             home.pageNum, fwdPage);
+   }
+   if (rcode == rc::success) {
+      eraseCell (page, recordDescriptor, rid.slotNum);
+      rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                             rid.pageNum, page);
+   }
+   if (rcode == rc::success) {
+      // once no cell refers to them
+      rcode = freeChains (fileHandle, chains);
+   }
+   if (rcode == rc::success) {
+      rcode = updateIndexes (fileHandle, header, rid, &keys, NULL);
+   }
+   free (page);
+   free (fwdPage);
+   return rcode;
+}
+
+// A record that outgrows its page is moved to another page and a
+// forwarding RID is left in its slot, so the RID never changes. A
+// moved record is moved again from where it is, never chained.
+RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle,
+                                        const vector<Attribute> &recordDescriptor,
+                                        const void *data, const RID &rid) {
+   MetricTimer timer (fileHandle.metrics(), LATENCY_UPDATE);
+   RC rcode;
+   if (updateInPlace (fileHandle, recordDescriptor, data, rid, rcode)) {
+      return rcode;
+   }
+   FileLatch latch (fileHandle.latch());
+   TraceCall call (fileHandle, TRACE_UPDATE, rid);
+   if (call.active()) call.setSize (tupleSize (recordDescriptor, data));
+   rcode = keepVersion (fileHandle, recordDescriptor, rid, true);
+   if (rcode != rc::success) return rcode;
+   FileHeader header;
+   rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   char *page = (char*) malloc (PAGE_SIZE);
+   char *fwdPage = (char*) malloc (PAGE_SIZE);
+   RID home;
+   string record;
+   vector<IndexKey> oldKeys, newKeys;
+   vector<PageNum> oldChains;
+   rcode = fetchRecord (fileHandle, rid, page, fwdPage, home);
+   bool moved = rcode == rc::success && home.pageNum != rid.pageNum;
+   if (rcode == rc::success) {
+      string scratch;
+      const char *old = moved
+         ? recordCell (fwdPage, recordDescriptor, home.slotNum, scratch)
+         : recordCell (page, recordDescriptor, rid.slotNum, scratch);
+      rcode = indexKeys (fileHandle, header, recordDescriptor, old, oldKeys);
+      recordChains (old, oldChains);
+   }
+   if (rcode == rc::success) {
+      rcode = encodeRecord (fileHandle, recordDescriptor, data, record);
+   }
+   if (rcode == rc::success) {
+      rcode = indexKeys (fileHandle, header, recordDescriptor, record.data(),
+                         newKeys);
+      if (rcode != rc::success) {
+         freeRecordOverflow (fileHandle, record.data());
+      }
+   }
+   if (rcode != rc::success) {
+      free (page);
+      free (fwdPage);
+      return rcode;
+   }
+
+   if (replaceCell (page, recordDescriptor, rid.slotNum, record, 0)) {
+      // fits at home (again)
+      if (moved) {
+         eraseCell (fwdPage, recordDescriptor, home.slotNum);
+         rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                                home.pageNum, fwdPage);
+      }
+      if (rcode == rc::success) {
+         rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                                rid.pageNum, page);
+      }
+   } else if (moved && replaceCell (fwdPage, recordDescriptor,
+                                    home.slotNum, record, SLOT_MOVED)) {
+      rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                             home.pageNum, fwdPage);
+   } else {
+      // the slot is given its forwarding cell before the record moves,
+      // so that nothing is written if it does not fit
+      if (!replaceCell (page, recordDescriptor, rid.slotNum,
+                        forwardCell (RID()), SLOT_FORWARD)) {
+         RC_MSG (rc::record_too_large, "[slotNum: %u]\n", rid.slotNum);
+         rcode = rc::record_too_large;
+      }
+      // the record is stored at its new home before the cell it had is
+      // erased, so that a failure leaves it where it was. Neither page
+      // has room for it, storeCell() does not pick them.
+      RID newHome;
+      if (rcode == rc::success) {
+         rcode = storeCell (fileHandle, header, recordDescriptor, record,
+                            SLOT_MOVED, newHome);
+      }
+      if (rcode == rc::success && moved) {
+         eraseCell (fwdPage, recordDescriptor, home.slotNum);
+         rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                                home.pageNum, fwdPage);
+      }
+      if (rcode == rc::success) {
+         // same size as the cell it replaces
+         replaceCell (page, recordDescriptor, rid.slotNum,
+                      forwardCell (newHome), SLOT_FORWARD);
+         rcode = writeDataPage (fileHandle, header, recordDescriptor,
+                                rid.pageNum, page);
+      }
+   }
+   // the old overflow chains are freed once the new cell is written, the
+   // new ones if it is not
+   if (rcode == rc::success) {
+      rcode = freeChains (fileHandle, oldChains);
+   } else {
+      freeRecordOverflow (fileHandle, record.data());
+   }
+   if (rcode == rc::success) {
+      rcode = updateIndexes (fileHandle, header, rid, &oldKeys, &newKeys);
+   }
+   free (page);
+   free (fwdPage);
+   return rcode;
+}
+
+// data is a one field record: [null indicator byte][value]
+RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle,
+                                         const vector<Attribute> &recordDescriptor,
+                                         const RID &rid, const string &attributeName,
+                                         void *data) {
+   // [null byte][value] is the projection of the attribute alone
+   return readAttributes (fileHandle, recordDescriptor, rid,
+                          vector<string> (1, attributeName), data);
+}
+
+RC RecordBasedFileManager::readAttributes(FileHandle &fileHandle,
+                                          const vector<Attribute> &recordDescriptor,
+                                          const RID &rid,
+                                          const vector<string> &attributeNames,
+                                          void *data) {
+   vector<unsigned> projection;
+   RC rcode = findAttributes (recordDescriptor, attributeNames, projection);
+   if (rcode != rc::success) return rcode;
+   return readProjection (fileHandle, recordDescriptor, rid, projection, data);
+}
+
+RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle,
+                                         const Schema &schema, const RID &rid,
+                                         const string &attributeName,
+                                         void *data) {
+   return readAttributes (fileHandle, schema, rid,
+                          vector<string> (1, attributeName), data);
+}
+
+RC RecordBasedFileManager::readAttributes(FileHandle &fileHandle,
+                                          const Schema &schema,
+                                          const RID &rid,
+                                          const vector<string> &attributeNames,
+                                          void *data) {
+   vector<unsigned> projection;
+   RC rcode = findAttributes (schema, attributeNames, projection);
+   if (rcode != rc::success) return rcode;
+   return readProjection (fileHandle, schema.descriptor, rid, projection,
+                          data);
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const string &conditionAttribute,
+      const CompOp compOp,                  // comparision type such as "<" and "="
+      const void *value,                    // used in the comparison
+      const vector<string> &attributeNames, // a list of projected attributes
+      RBFM_ScanIterator &rbfm_ScanIterator) {
+   FileLatch latch (fileHandle.latch());
+   RID none = { 0, 0 };
+   TraceCall call (fileHandle, TRACE_SCAN_OPEN, none);
+   RBFM_ScanIterator &it = rbfm_ScanIterator;
+   RC rcode = openScan (fileHandle, recordDescriptor, conditionAttribute,
+                        compOp, value, attributeNames, it);
+   if (rcode != rc::success || it._condAttr < 0) return rcode;
+
+   // the cheapest access path the condition allows: a B+-tree holding
+   // every projected attribute, a hash index for EQ_OP, a B+-tree for a
+   // range, else a zone map to skip pages
+   FileHeader header;
+   rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   AttrType type = recordDescriptor[it._condAttr].type;
+   unsigned len;
+   const char *bytes = valueBytes (type, it._value.data(), len);
+   int hash = findAux (header, AUX_HASH, it._condAttr);
+   int tree = findAux (header, AUX_BTREE, it._condAttr);
+   int zones = findAux (header, AUX_ZONEMAP, it._condAttr);
+   bool covering = tree >= 0;
+   for (unsigned i = 0; i < it._projection.size() && covering; ++i) {
+      unsigned attr = it._projection[i];
+      covering = (int) attr == it._condAttr
+                 || (attr < 32 && header.aux[tree].covered & 1u << attr);
+   }
+   if (hash >= 0 && compOp == EQ_OP && !covering) {
+      it._indexed = true;
+      it._candidate = 0;
+      return hashLookup (fileHandle, header.aux[hash].root,
+                         hashValue (type, bytes, len), it._candidates);
+   }
+   if (tree >= 0 && (compOp != NE_OP || covering)) {
+      // a cut bound may match more keys, the condition is checked anyway
+      string key = btreeKey (type, bytes, len);
+      bool cut = key.size() < len;
+      bool low = compOp == EQ_OP || compOp == GT_OP || compOp == GE_OP;
+      bool high = compOp == EQ_OP || compOp == LT_OP || compOp == LE_OP;
+      it._indexed = true;
+      it._indexOnly = covering;
+      it._covered = header.aux[tree].covered;
+      it._tree = new BTreeCursor;
+      return it._tree->open (fileHandle, type, header.aux[tree].root,
+                             low ? &key : NULL, compOp != GT_OP || cut,
+                             high ? &key : NULL, compOp != LT_OP || cut);
+   }
+   if (zones >= 0) {
+      it._zones = new ZoneCursor (header.aux[zones].root);
+   }
+   return rc::success;
+}
+
+// The indexes only know the current records, a snapshot scan reads
+// every page
+RC RecordBasedFileManager::scan(const Snapshot &snapshot,
+                                const vector<Attribute> &recordDescriptor,
+                                const string &conditionAttribute,
+                                const CompOp compOp, const void *value,
+                                const vector<string> &attributeNames,
+                                RBFM_ScanIterator &rbfm_ScanIterator) {
+   RBFM_ScanIterator &it = rbfm_ScanIterator;
+   it.close();
+   if (snapshot.fileHandle == NULL) return snapshotEnded (snapshot);
+   FileLatch latch (snapshot.fileHandle->latch());
+   VersionStore *versions = versionStore (*snapshot.fileHandle);
+   if (versions == NULL) return snapshotEnded (snapshot);
+   RC rcode = openScan (*snapshot.fileHandle, recordDescriptor,
+                        conditionAttribute, compOp, value, attributeNames,
+                        it);
+   if (rcode != rc::success) return rcode;
+   it._versions = versions;
+   it._timestamp = snapshot.timestamp;
+   return rc::success;
+}
+
+// Sets up a scan reading every page of the file
+RC RecordBasedFileManager::openScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const string &conditionAttribute, const CompOp compOp,
+      const void *value, const vector<string> &attributeNames,
+      RBFM_ScanIterator &rbfm_ScanIterator) {
+   RBFM_ScanIterator &it = rbfm_ScanIterator;
+   it.close();
+
+   it._condAttr = -1;
+   if (compOp != NO_OP) {
+      it._condAttr = findAttribute (recordDescriptor, conditionAttribute);
+      if (it._condAttr < 0) {
+         RC_MSG (rc::attribute_not_found, "[%s]\n",
+                 conditionAttribute.c_str());
+         return rc::attribute_not_found;
+      }
+      AttrType type = recordDescriptor[it._condAttr].type;
+      it._value.assign ((const char*) value, valueLength (type, (const char*) value));
+   }
+   RC rcode = findAttributes (recordDescriptor, attributeNames,
+                              it._projection);
+   if (rcode != rc::success) return rcode;
+   it._fileHandle = &fileHandle;
+   it._descriptor = recordDescriptor;
+   it._compOp = compOp;
+   it._pageNum = 0;
+   it._slotNum = 0;
+   it._slotCount = 0;
+   it._page = (char*) malloc (PAGE_SIZE);
+   it._fwdPage = (char*) malloc (PAGE_SIZE);
+   it._context = new CPageContext;
+   return rc::success;
+}
+
+RC RecordBasedFileManager::createZoneMap(FileHandle &fileHandle,
+                                         const vector<Attribute> &recordDescriptor,
+                                         const string &attributeName) {
+   FileLatch latch (fileHandle.latch());
+   int attr = findAttribute (recordDescriptor, attributeName);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   if (recordDescriptor[attr].type == TypeVarChar) {
+      RC_MSG (rc::unsupported_type, "[%s]\n", attributeName.c_str());
+      return rc::unsupported_type;
+   }
+   bool exists;
+   RC rcode = checkAux (fileHandle, AUX_ZONEMAP, attr, exists);
+   if (rcode != rc::success || exists) return rcode;
+
+   char *page = (char*) malloc (PAGE_SIZE);
+   PageNum root;
+   rcode = allocPage (fileHandle, PAGE_ZONEMAP, page, root);
+   for (PageNum i = 1; i < fileHandle.getNumberOfPages()
+                       && rcode == rc::success; ++i) {
+      rcode = fileHandle.readPage (i, page);
+      if (rcode != rc::success || pageFooter (page)->type != PAGE_DATA) {
+         continue;
+      }
+      Zone zone;
+      summarizePage (page, recordDescriptor, attr, zone);
+      rcode = zoneWrite (fileHandle, root, i, zone);
+   }
+   free (page);
+   if (rcode != rc::success) return rcode;
+   return addAux (fileHandle, AUX_ZONEMAP, recordDescriptor[attr].type,
+                  attr, root);
+}
+
+RC RecordBasedFileManager::createHashIndex(FileHandle &fileHandle,
+                                           const vector<Attribute> &recordDescriptor,
+                                           const string &attributeName) {
+   FileLatch latch (fileHandle.latch());
+   int attr = findAttribute (recordDescriptor, attributeName);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   bool exists;
+   RC rcode = checkAux (fileHandle, AUX_HASH, attr, exists);
+   if (rcode != rc::success || exists) return rcode;
+
+   PageNum root;
+   rcode = hashCreate (fileHandle, root);
+   if (rcode != rc::success) return rcode;
+   AttrType type = recordDescriptor[attr].type;
+   rcode = visitValues (fileHandle, recordDescriptor, attr, 0,
+                        [&](const RID &rid, const char *bytes,
+                            unsigned len, const string&) {
+                           return hashInsert (fileHandle, root,
+                                              hashValue (type, bytes, len),
+                                              rid);
+                        });
+   if (rcode != rc::success) return rcode;
+   return addAux (fileHandle, AUX_HASH, type, attr, root);
+}
+
+RC RecordBasedFileManager::createBTreeIndex(FileHandle &fileHandle,
+                                            const vector<Attribute> &recordDescriptor,
+                                            const string &attributeName) {
+   return createBTreeIndex (fileHandle, recordDescriptor, attributeName,
+                            vector<string>());
+}
+
+RC RecordBasedFileManager::createBTreeIndex(FileHandle &fileHandle,
+                                            const vector<Attribute> &recordDescriptor,
+                                            const string &attributeName,
+                                            const vector<string> &includedAttributes) {
+   FileLatch latch (fileHandle.latch());
+   int attr = findAttribute (recordDescriptor, attributeName);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   uint32_t covered = 0;
+   for (unsigned i = 0; i < includedAttributes.size(); ++i) {
+      int included = findAttribute (recordDescriptor, includedAttributes[i]);
+      if (included < 0) {
+         RC_MSG (rc::attribute_not_found, "[%s]\n",
+                 includedAttributes[i].c_str());
+         return rc::attribute_not_found;
+      }
+      if (included >= 32) {
+         RC_MSG (rc::payload_too_large, "[%s]\n",
+                 includedAttributes[i].c_str());
+         return rc::payload_too_large;
+      }
+      covered |= 1u << included;
+   }
+   const Schema &schema = schemaOf (recordDescriptor);
+   unsigned payloadMax = nullBytes (coveredCount (covered));
+   for (unsigned i = 0; i < recordDescriptor.size() && i < 32; ++i) {
+      if (covered & 1u << i) payloadMax += schema.valueMax[i];
+   }
+   if (payloadMax > BTREE_PAYLOAD_MAX) {
+      RC_MSG (rc::payload_too_large, "[%u bytes]\n", payloadMax);
+      return rc::payload_too_large;
+   }
+   bool exists;
+   RC rcode = checkAux (fileHandle, AUX_BTREE, attr, exists);
+   if (rcode != rc::success || exists) return rcode;
+
+   // bulk loaded from the sorted entries of the records already there
+   AttrType type = recordDescriptor[attr].type;
+   vector<BTreeEntry> entries;
+   rcode = visitValues (fileHandle, recordDescriptor, attr, covered,
+                        [&](const RID &rid, const char *bytes,
+                            unsigned len, const string &payload) {
+                           BTreeEntry entry;
+                           entry.key = btreeKey (type, bytes, len);
+                           entry.rid = rid;
+                           entry.child = NO_PAGE;
+                           entry.payload = payload;
+                           entries.push_back (entry);
+                           return (RC) rc::success;
+                        });
+   PageNum root;
+   if (rcode == rc::success) {
+      rcode = btreeBuild (fileHandle, type, entries, root);
+   }
+   if (rcode != rc::success) return rcode;
+   return addAux (fileHandle, AUX_BTREE, type, attr, root, covered);
+}
+
+RC RecordBasedFileManager::indexScan(FileHandle &fileHandle,
+                                     const vector<Attribute> &recordDescriptor,
+                                     const string &attributeName,
+                                     const void *lowKey, const void *highKey,
+                                     bool lowKeyInclusive,
+                                     bool highKeyInclusive,
+                                     RBFM_IndexScanIterator &rbfm_IndexScanIterator) {
+   FileLatch latch (fileHandle.latch());
+   RBFM_IndexScanIterator &it = rbfm_IndexScanIterator;
+   it.close();
+   int attr = findAttribute (recordDescriptor, attributeName);
+   if (attr < 0) {
+      RC_MSG (rc::attribute_not_found, "[%s]\n", attributeName.c_str());
+      return rc::attribute_not_found;
+   }
+   FileHeader header;
+   RC rcode = readHeader (fileHandle, header);
+   if (rcode != rc::success) return rcode;
+   int tree = findAux (header, AUX_BTREE, attr);
+   if (tree < 0) {
+      RC_MSG (rc::index_not_found, "[%s]\n", attributeName.c_str());
+      return rc::index_not_found;
+   }
+
+   // a bound longer than the keys is cut and then includes its cut value
+   AttrType type = recordDescriptor[attr].type;
+   string low, high;
+   unsigned len;
+   const char *bytes;
+   if (lowKey != NULL) {
+      bytes = valueBytes (type, (const char*) lowKey, len);
+      low = btreeKey (type, bytes, len);
+      lowKeyInclusive |= low.size() < len;
+   }
+   if (highKey != NULL) {
+      bytes = valueBytes (type, (const char*) highKey, len);
+      high = btreeKey (type, bytes, len);
+      highKeyInclusive |= high.size() < len;
+   }
+   it._fileHandle = &fileHandle;
+   it._type = type;
+   it._cursor = new BTreeCursor;
+   return it._cursor->open (fileHandle, type, header.aux[tree].root,
+                            lowKey ? &low : NULL, lowKeyInclusive,
+                            highKey ? &high : NULL, highKeyInclusive);
+}
+
+
+RBFM_ScanIterator::RBFM_ScanIterator() :
+   _fileHandle (NULL), _condAttr (-1), _compOp (NO_OP), _pageNum (0),
+   _slotNum (0), _slotCount (0), _page (NULL), _fwdPage (NULL),
+   _context (NULL), _preselected (false), _zones (NULL), _indexed (false),
+   _candidate (0), _tree (NULL), _indexOnly (false), _covered (0),
+   _versions (NULL), _timestamp (0)
+{
+}
+
+RBFM_ScanIterator::~RBFM_ScanIterator()
+{
+   close();
+}
+
+RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
+   if (_fileHandle == NULL) return RBFM_EOF;
+   MetricTimer timer (_fileHandle->metrics(), LATENCY_SCAN);
+   FileLatch latch (_fileHandle->latch());
+   TraceCall call (*_fileHandle, TRACE_SCAN_NEXT, rid);
+   if (_indexed) return nextIndexed (rid, data);
+   string cellScratch;
+   while (true) {
+      // move on to the next data page
+      if (_pageNum == 0 || _slotNum >= _slotCount) {
+         while (true) {
+            if (++_pageNum >= _fileHandle->getNumberOfPages()) {
+               return RBFM_EOF;
+            }
+            if (_zones != NULL) {
+               // skip the pages that cannot match without reading them
+               Zone zone;
+               RC rcode = _zones->get (*_fileHandle, _pageNum, zone);
+               if (rcode != rc::success) return rcode;
+               if (zoneExcludes (zone, _descriptor[_condAttr].type, _compOp,
+                                 _value.data())) {
+                  continue;
+               }
+            }
+            RC rcode = _fileHandle->readPage (_pageNum, _page);
+            if (rcode != rc::success) return rcode;
+            _slotCount = pageFooter (_page)->type == PAGE_DATA
+                         ? pageFooter (_page)->numSlots : 0;
+            if (_versions != NULL) {
+               // the records deleted since the snapshot only have a
+               // version left, maybe past the last slot or page
+               _slotCount = std::max (_slotCount,
+                                      _versions->slotLimit (_pageNum));
+            }
+            if (_slotCount > 0) break;
+         }
+         uint8_t format = pageFooter (_page)->type == PAGE_DATA
+                          ? pageFooter (_page)->format : (uint8_t) FORMAT_ROW;
+         if (format == FORMAT_COMPRESSED) {
+            // decoded once for all the cells of the page
+            _context->load (_page, _descriptor);
+         }
+         // numeric conditions are evaluated for the whole PAX page at
+         // once, over the column
+         _preselected = format == FORMAT_PAX && _condAttr >= 0
+                        && _descriptor[_condAttr].type != TypeVarChar;
+         if (_preselected) {
+            paxSelect (_page, _descriptor, _condAttr, _compOp,
+                       _value.data(), _selected);
+         }
+         _slotNum = 0;
+         continue;
+      }
+
+      unsigned slotNum = _slotNum++;
+      if (_versions != NULL) {
+         RID current = { _pageNum, slotNum };
+         const Version *version = _versions->find (current, _timestamp);
+         if (version != NULL) {
+            if (version->absent) continue;
+            bool match;
+            RC rcode = emitTuple (version->data.data(), data, match);
+            if (rcode != rc::success) return rcode;
+            if (!match) continue;
+            rid = current;
+            return rc::success;
+         }
+         if (pageFooter (_page)->type != PAGE_DATA
+             || slotNum >= pageFooter (_page)->numSlots) {
+            continue;
+         }
+      }
+      Slot *slot = pageSlot (_page, slotNum);
+      if (slot->offset == SLOT_EMPTY || (slot->length & SLOT_MOVED)) {
+         continue;
+      }
+
+      // the record is either an internal record or a row of a PAX page
+      const char *record = NULL;
+      const char *paxPage = NULL;
+      unsigned row = 0;
+      bool checked = false;
+      if (slot->length & SLOT_FORWARD) {
+         ForwardRef fwd;
+         memcpy (&fwd, pageCell (_page, slotNum), sizeof(fwd));
+         _fileHandle->metrics().add (COUNTER_FORWARD_HOPS);
+         RC rcode = _fileHandle->readPage (fwd.pageNum, _fwdPage);
+         if (rcode != rc::success) return rcode;
+         if (pageFooter (_fwdPage)->format == FORMAT_PAX) {
+            paxPage = _fwdPage;
+            row = pageSlot (_fwdPage, fwd.slotNum)->offset;
+         } else {
+            record = recordCell (_fwdPage, _descriptor, fwd.slotNum,
+                                 cellScratch);
+         }
+      } else if (pageFooter (_page)->format == FORMAT_PAX) {
+         paxPage = _page;
+         row = slot->offset;
+         if (_preselected && !_selected[row]) continue;
+         checked = _preselected;
+      } else if (pageFooter (_page)->format == FORMAT_COMPRESSED) {
+         _context->decode (pageCell (_page, slotNum), cellScratch);
+         record = cellScratch.data();
+      } else {
+         record = pageCell (_page, slotNum);
+      }
+
+      bool match;
+      RC rcode = emit (record, paxPage, row, checked, data, match);
+      if (rcode != rc::success) return rcode;
+      if (!match) continue;
+      rid.pageNum = _pageNum;
+      rid.slotNum = slotNum;
+      return rc::success;
+   }
+}
+
+// The candidates of an index lookup: in file order for a hash index,
+// in key order for a B+-tree
+RC RBFM_ScanIterator::nextIndexed(RID &rid, void *data) {
+   string cellScratch;
+   while (true) {
+      RID candidate;
+      if (_tree != NULL) {
+         BTreeEntry entry;
+         RC rcode = _tree->next (*_fileHandle, entry);
+         if (rcode != rc::success) return rcode;
+         bool match;
+         if (_indexOnly && emitEntry (entry, data, match)) {
+            if (!match) continue;
+            rid = entry.rid;
+            return rc::success;
+         }
+         candidate = entry.rid;
+      } else if (_candidate < _candidates.size()) {
+         candidate = _candidates[_candidate++];
+      } else {
+         return RBFM_EOF;
+      }
+      // consecutive candidates often share a page (_pageNum is the one
+      // in _page)
+      RID home;
+      bool loaded = candidate.pageNum == _pageNum;
+      _pageNum = 0;
+      RC rcode = fetchRecord (*_fileHandle, candidate, _page, _fwdPage,
+                              home, loaded);
+      if (rcode != rc::success) return rcode;
+      _pageNum = candidate.pageNum;
+      char *homePage = home.pageNum == candidate.pageNum ? _page : _fwdPage;
+      const char *record = NULL;
+      const char *paxPage = NULL;
+      unsigned row = 0;
+      if (pageFooter (homePage)->format == FORMAT_PAX) {
+         paxPage = homePage;
+         row = pageSlot (homePage, home.slotNum)->offset;
+      } else {
+         record = recordCell (homePage, _descriptor, home.slotNum,
+                              cellScratch);
+      }
+      bool match;
+      rcode = emit (record, paxPage, row, false, data, match);
+      if (rcode != rc::success) return rcode;
+      if (match) {
+         rid = candidate;
+         return rc::success;
+      }
+   }
+}
+
+// Checks the condition on a record (see recordField), unless it has
+// already been, and writes its projection to data:
+// [null bitmap of the projection][projected values]
+RC RBFM_ScanIterator::emit(const char *record, const char *paxPage,
+                           unsigned row, bool checked, void *data,
+                           bool &match) {
+   string scratch;
+   const char *bytes;
+   unsigned len;
+   bool null;
+   match = false;
+   if (_condAttr >= 0 && !checked) {
+      RC rcode = recordField (*_fileHandle, _descriptor, record, paxPage,
+                              row, _condAttr, scratch, bytes, len, null);
+      if (rcode != rc::success) return rcode;
+      if (null || !compareField (_descriptor[_condAttr].type, bytes, len,
+                                 _compOp, _value.data())) {
+         return rc::success;
+      }
+   }
+
+   RC rcode = projectRecord (*_fileHandle, _descriptor, record, paxPage,
+                             row, _projection, data);
+   match = rcode == rc::success;
+   return rcode;
+}
+
+// Like emit, from a record in the API format (a version kept for a
+// snapshot)
+RC RBFM_ScanIterator::emitTuple(const char *tuple, void *data,
+                                bool &match) {
+   unsigned fieldCount = _descriptor.size();
+   vector<const char*> values (fieldCount, NULL);  // NULL if null
+   vector<unsigned> lens (fieldCount, 0);
+   const char *in = tuple + nullBytes (fieldCount);
+   for (unsigned i = 0; i < fieldCount; ++i) {
+      if (isNull (tuple, i)) continue;
+      values[i] = valueBytes (_descriptor[i].type, in, lens[i]);
+      in += valueLength (_descriptor[i].type, in);
+   }
+   match = false;
+   if (_condAttr >= 0
+       && (values[_condAttr] == NULL
+           || !compareField (_descriptor[_condAttr].type, values[_condAttr],
+                             lens[_condAttr], _compOp, _value.data()))) {
+      return rc::success;
+   }
+
+   char *out = (char*) data;
+   unsigned projBytes = nullBytes (_projection.size());
+   memset (out, 0, projBytes);
+   out += projBytes;
+   for (unsigned i = 0; i < _projection.size(); ++i) {
+      unsigned attr = _projection[i];
+      if (values[attr] == NULL) {
+         setNull ((char*) data, i);
+      } else {
+         out += writeValue (_descriptor[attr].type, values[attr],
+                            lens[attr], out);
+      }
+   }
+   match = true;
+   return rc::success;
+}
+
+// Like emit, from an entry of a covering B+-tree on the condition
+// attribute instead of the record
+// RETURNS: false if the entry lacks a value (a cut VarChar key), the
+//          record must be read
+bool RBFM_ScanIterator::emitEntry(const BTreeEntry &entry, void *data,
+                                  bool &match) {
+   const char *bytes;
+   unsigned len;
+   bool null;
+   match = false;
+   if (!entryField (_descriptor, _condAttr, _covered, entry, _condAttr,
+                    bytes, len, null)) {
+      return false;
+   }
+   if (!compareField (_descriptor[_condAttr].type, bytes, len, _compOp,
+                      _value.data())) {
+      return true;
+   }
+
+   char *out = (char*) data;
+   unsigned projBytes = nullBytes (_projection.size());
+   memset (out, 0, projBytes);
+   out += projBytes;
+   for (unsigned i = 0; i < _projection.size(); ++i) {
+      unsigned attr = _projection[i];
+      if (!entryField (_descriptor, _condAttr, _covered, entry, attr, bytes,
+                       len, null)) {
+         return false;
+      }
+      if (null) {
+         setNull ((char*) data, i);
+      } else {
+         out += writeValue (_descriptor[attr].type, bytes, len, out);
+      }
+   }
+   match = true;
+   return true;
+}
+
+RC RBFM_ScanIterator::close() {
+   free (_page);
+   free (_fwdPage);
+   delete _context;
+   delete _zones;
+   delete _tree;
+   _page = NULL;
+   _fwdPage = NULL;
+   _context = NULL;
+   _zones = NULL;
+   _indexed = false;
+   _candidates.clear();
+   _tree = NULL;
+   _indexOnly = false;
+   _covered = 0;
+   _versions = NULL;
+   _fileHandle = NULL;
+   return rc::success;
+}
+
+RBFM_IndexScanIterator::RBFM_IndexScanIterator() :
+   _fileHandle (NULL), _type (TypeInt), _cursor (NULL)
+{
+}
+
+RBFM_IndexScanIterator::~RBFM_IndexScanIterator()
+{
+   close();
+}
+
+RC RBFM_IndexScanIterator::getNextEntry(RID &rid, void *key) {
+   if (_cursor == NULL) return RBFM_EOF;
+   FileLatch latch (_fileHandle->latch());
+   BTreeEntry entry;
+   RC rcode = _cursor->next (*_fileHandle, entry);
+   if (rcode != rc::success) return rcode;
+   rid = entry.rid;
+   writeValue (_type, entry.key.data(), entry.key.size(), (char*) key);
+   return rc::success;
+}
+
+RC RBFM_IndexScanIterator::close() {
+   delete _cursor;
+   _cursor = NULL;
+   _fileHandle = NULL;
+   return rc::success;
 }
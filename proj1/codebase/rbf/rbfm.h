@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <climits>
+#include <stdint.h>
 
 #include "../rbf/pfm.h"
 
@@ -57,20 +58,110 @@ the project
 //  }
 //  rbfmScanIterator.close();
 
+struct CPageContext;
+struct ZoneCursor;
+struct BTreeCursor;
+struct BTreeEntry;
+struct VersionStore;
+struct Schema;
+
 class RBFM_ScanIterator {
 public:
-  RBFM_ScanIterator() {};
-  ~RBFM_ScanIterator() {};
+  RBFM_ScanIterator();
+  ~RBFM_ScanIterator();
 
   // Never keep the results in the memory. When getNextRecord() is 
   // called, a satisfying record needs to be fetched from the file.
   // "data" follows the same format as 
   //  RecordBasedFileManager::insertRecord().
-  RC getNextRecord(RID &rid, void *data) { return RBFM_EOF; };
-  RC close() { return -1; };
+  RC getNextRecord(RID &rid, void *data);
+  RC close();
+
+private:
+  friend class RecordBasedFileManager;
+
+  RBFM_ScanIterator(const RBFM_ScanIterator&) = delete;
+  RBFM_ScanIterator& operator=(const RBFM_ScanIterator&) = delete;
+
+  RC nextIndexed(RID &rid, void *data);
+  RC emit(const char *record, const char *paxPage, unsigned row,
+          bool checked, void *data, bool &match);
+  bool emitEntry(const BTreeEntry &entry, void *data, bool &match);
+  RC emitTuple(const char *tuple, void *data, bool &match);
+
+  FileHandle *_fileHandle;
+  vector<Attribute> _descriptor;
+  int _condAttr;             // -1 if there is no condition
+  CompOp _compOp;
+  string _value;             // copy of the comparison value
+  vector<unsigned> _projection;
+  PageNum _pageNum;          // page in _page, 0 before the first one
+  unsigned _slotNum;         // next slot to look at
+  unsigned _slotCount;       // slots of _page to look at
+  char *_page;
+  char *_fwdPage;            // target page of a forwarded record
+  CPageContext *_context;    // of _page if it is compressed
+  bool _preselected;         // _selected holds the condition for the
+  vector<uint8_t> _selected; // rows of _page (PAX pages)
+  ZoneCursor *_zones;        // zone map of the condition attribute
+  bool _indexed;             // the records are _candidates, found by
+  vector<RID> _candidates;   // a hash index lookup
+  unsigned _candidate;       // next one
+  BTreeCursor *_tree;        // or the entries of a B+-tree range
+  bool _indexOnly;           // which hold all the projected attributes
+  uint32_t _covered;         // payload of the entries, see AuxEntry
+  VersionStore *_versions;   // of the snapshot read, NULL if none
+  uint64_t _timestamp;       // of the snapshot
+};
+
+
+// RBFM_IndexScanIterator goes through the entries of a B+-tree index in
+// key order, see RecordBasedFileManager::indexScan()
+class RBFM_IndexScanIterator {
+public:
+  RBFM_IndexScanIterator();
+  ~RBFM_IndexScanIterator();
+
+  // key is the value of the entry in the API format (no null byte).
+  // VarChar keys longer than BTREE_KEY_MAX (btree.h) are cut.
+  RC getNextEntry(RID &rid, void *key);
+  RC close();
+
+private:
+  friend class RecordBasedFileManager;
+
+  RBFM_IndexScanIterator(const RBFM_IndexScanIterator&) = delete;
+  RBFM_IndexScanIterator& operator=(const RBFM_IndexScanIterator&) = delete;
+
+  FileHandle *_fileHandle;
+  AttrType _type;
+  BTreeCursor *_cursor;
 };
 
 
+// A consistent view of the records of an open file: the records as
+// they were when the snapshot was taken, whatever the changes made
+// since (see RecordBasedFileManager::beginSnapshot())
+typedef struct
+{
+  FileHandle *fileHandle;  // NULL once ended
+  uint64_t timestamp;
+} Snapshot;
+
+
+// File options, given to RecordBasedFileManager::createFile()
+typedef enum {
+  RBFM_COMPRESSED = 0x1, // dictionary / frame of reference encoded
+                         // pages, more records per page for repetitive
+                         // data at the cost of re-encoding a page on
+                         // every change (see cpage.h)
+  RBFM_PAX = 0x2         // one minipage per attribute inside each page,
+                         // for scans projecting few attributes (see
+                         // pax.h); cannot be combined with
+                         // RBFM_COMPRESSED
+} FileOption;
+
+
 class RecordBasedFileManager
 {
 public: 
@@ -78,6 +169,9 @@ public:
   static RecordBasedFileManager* instance();
 
   RC createFile(const string &fileName);
+
+  // options is a bitwise or of FileOption
+  RC createFile(const string &fileName, unsigned options);
   
   RC destroyFile(const string &fileName);
   
@@ -109,7 +203,32 @@ public:
   // For example, refer to the Q8 of Project 1 wiki page.
   RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
 
+  // Like insertRecord, but only into the last page of the file or a new
+  // one, never into the free space left by earlier records: a scan of a
+  // new file filled this way returns the records in the order they were
+  // appended (freed pages are reused first).
+  RC appendRecord(FileHandle &fileHandle,
+                  const vector<Attribute> &recordDescriptor,
+                  const void *data, RID &rid);
+
+  // Appends the records to new data pages at the end of the file, each
+  // built in memory and written once, without reading the pages of the
+  // file: loads many records faster than insertRecord. rids[i] is the
+  // RID of records[i]. Indexes and zone maps are kept up to date.
+  RC bulkAppend(FileHandle &fileHandle,
+                const vector<Attribute> &recordDescriptor,
+                const vector<const void*> &records, vector<RID> &rids);
+
   RC readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data);
+
+  // Reads the record of rids[i] into data[i], like readRecord, reading
+  // the pages in ascending order and each of them once (plus the pages
+  // records were moved to by an update).
+  // RETURNS: the error of the first RID in page order that could not be
+  //          read, the records after it are not read
+  RC readRecords(FileHandle &fileHandle,
+                 const vector<Attribute> &recordDescriptor,
+                 const vector<RID> &rids, const vector<void*> &data);
   
   // This method will be mainly used for debugging/testing. 
   // The format is as follows:
@@ -141,6 +260,23 @@ part 1 of the project
                    const RID &rid, const string &attributeName, 
                    void *data);
 
+  // Reads several attributes of a record with one visit of its page.
+  // data follows the format of the records returned by a scan
+  // projecting attributeNames: [null bitmap][values].
+  RC readAttributes(FileHandle &fileHandle,
+                    const vector<Attribute> &recordDescriptor,
+                    const RID &rid, const vector<string> &attributeNames,
+                    void *data);
+
+  // The same with the Schema of the record descriptor (schemaOf(),
+  // schema.h), resolved once by a caller reading many records: the names
+  // are looked up in it and the descriptor is not compared again.
+  RC readAttribute(FileHandle &fileHandle, const Schema &schema,
+                   const RID &rid, const string &attributeName, void *data);
+  RC readAttributes(FileHandle &fileHandle, const Schema &schema,
+                    const RID &rid, const vector<string> &attributeNames,
+                    void *data);
+
   // Scan returns an iterator to allow the caller to go through the results one by one. 
   RC scan(FileHandle &fileHandle,
       const vector<Attribute> &recordDescriptor,
@@ -150,6 +286,78 @@ part 1 of the project
       const vector<string> &attributeNames, // a list of projected attributes
       RBFM_ScanIterator &rbfm_ScanIterator);
 
+  // Keeps a zone map (min, max and null count of every page, see
+  // zonemap.h) of a TypeInt or TypeReal attribute, built from the
+  // records already in the file and maintained by the changes that
+  // follow. Scans with a condition on the attribute skip the pages that
+  // cannot match without reading them.
+  RC createZoneMap(FileHandle &fileHandle,
+                   const vector<Attribute> &recordDescriptor,
+                   const string &attributeName);
+
+  // Keeps a hash index (see hashindex.h) from the values of an
+  // attribute to the RIDs of the records, built from the records
+  // already in the file and maintained by the changes that follow.
+  // Scans with an EQ_OP condition on the attribute only read the
+  // records the index points to.
+  RC createHashIndex(FileHandle &fileHandle,
+                     const vector<Attribute> &recordDescriptor,
+                     const string &attributeName);
+
+  // Keeps a B+-tree index (see btree.h) from the values of an attribute
+  // to the RIDs of the records, bulk loaded from the records already in
+  // the file and maintained by the changes that follow. Scans with a
+  // condition other than NE_OP on the attribute only read the records
+  // of the matching key range.
+  RC createBTreeIndex(FileHandle &fileHandle,
+                      const vector<Attribute> &recordDescriptor,
+                      const string &attributeName);
+
+  // The same, with the values of includedAttributes (among the first 32
+  // of the descriptor) also kept in the leaf entries. Scans with a
+  // condition on attributeName projecting only those attributes and
+  // attributeName are answered from the leaves without reading the
+  // records. If the file already has a B+-tree on attributeName,
+  // nothing is done.
+  RC createBTreeIndex(FileHandle &fileHandle,
+                      const vector<Attribute> &recordDescriptor,
+                      const string &attributeName,
+                      const vector<string> &includedAttributes);
+
+  // Goes through the entries of the B+-tree index of an attribute with
+  // keys between lowKey and highKey (API format, NULL for no bound) in
+  // key order.
+  RC indexScan(FileHandle &fileHandle,
+               const vector<Attribute> &recordDescriptor,
+               const string &attributeName,
+               const void *lowKey, const void *highKey,
+               bool lowKeyInclusive, bool highKeyInclusive,
+               RBFM_IndexScanIterator &rbfm_IndexScanIterator);
+
+  // Takes a snapshot of the records of an open file. Until it ends,
+  // the changes made to the file keep the records they replace in
+  // memory (see mvcc.h) for the reads through the snapshot, which never
+  // see a change made after it was taken. Scans through a snapshot must
+  // be closed before it ends; the file must be closed after.
+  RC beginSnapshot(FileHandle &fileHandle, Snapshot &snapshot);
+  // POST: the versions kept only for the snapshot are dropped
+  RC endSnapshot(Snapshot &snapshot);
+
+  // readRecord() of the record of rid as it was when the snapshot was
+  // taken
+  RC readRecord(const Snapshot &snapshot,
+                const vector<Attribute> &recordDescriptor, const RID &rid,
+                void *data);
+
+  // scan() of the records as they were when the snapshot was taken. The
+  // pages are read one after the other, the indexes of the file are not
+  // used.
+  RC scan(const Snapshot &snapshot,
+          const vector<Attribute> &recordDescriptor,
+          const string &conditionAttribute, const CompOp compOp,
+          const void *value, const vector<string> &attributeNames,
+          RBFM_ScanIterator &rbfm_ScanIterator);
+
 public:
 
 protected:
@@ -157,6 +365,18 @@ protected:
   ~RecordBasedFileManager();
 
 private:
+  RC storeRecord(FileHandle &fileHandle,
+                 const vector<Attribute> &recordDescriptor,
+                 const void *data, RID &rid, bool append);
+  RC keepVersion(FileHandle &fileHandle,
+                 const vector<Attribute> &recordDescriptor, const RID &rid,
+                 bool exists);
+  RC openScan(FileHandle &fileHandle,
+              const vector<Attribute> &recordDescriptor,
+              const string &conditionAttribute, const CompOp compOp,
+              const void *value, const vector<string> &attributeNames,
+              RBFM_ScanIterator &rbfm_ScanIterator);
+
   static RecordBasedFileManager *_rbf_manager;
   PagedFileManager *_pfm;
 };
@@ -0,0 +1,87 @@
+// replay.cc -- replays a trace of record calls (trace.h) on a new file
+//
+// usage: replay TRACE FILE [row|compressed|pax] [paced] [json]
+//
+// FILE is created with the page format given, row by default, and
+// destroyed at the end. paced keeps the timing of the trace, the calls
+// are made at full speed otherwise. Prints the throughput and the
+// latencies of the calls, all the metrics of the file as JSON with json.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "trace.h"
+
+using namespace std;
+
+static void usage(const char *program) {
+   fprintf (stderr, "usage: %s TRACE FILE [row|compressed|pax] [paced] "
+            "[json]\n", program);
+}
+
+int main(int argc, char **argv) {
+   if (argc < 3) {
+      usage (argv[0]);
+      return 1;
+   }
+   unsigned options = 0;
+   bool paced = false, json = false;
+   for (int i = 3; i < argc; ++i) {
+      if (!strcmp (argv[i], "compressed")) {
+         options = RBFM_COMPRESSED;
+      } else if (!strcmp (argv[i], "pax")) {
+         options = RBFM_PAX;
+      } else if (!strcmp (argv[i], "paced")) {
+         paced = true;
+      } else if (!strcmp (argv[i], "json")) {
+         json = true;
+      } else if (strcmp (argv[i], "row")) {
+         usage (argv[0]);
+         return 1;
+      }
+   }
+
+   vector<TraceEvent> events;
+   RC rc = readTrace (argv[1], events);
+   if (rc != rc::success) return 1;
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   FileHandle fileHandle;
+   rc = rbfm->createFile (argv[2], options);
+   if (rc == rc::success) rc = rbfm->openFile (argv[2], fileHandle);
+   if (rc != rc::success) return 1;
+
+   ReplayResult result;
+   rc = replayTrace (fileHandle, events, paced, result);
+   if (rc == rc::success) {
+      MetricsSnapshot metrics;
+      fileHandle.metrics().collect (metrics);
+      printf ("%u calls in %.3fs: %.0f calls/s, %u records loaded first, "
+              "%u failed, %u pages\n", result.events, result.seconds,
+              result.seconds > 0 ? result.events / result.seconds : 0,
+              result.preloaded, result.errors,
+              fileHandle.getNumberOfPages());
+      static const char *names[] = { "insert", "read", "update", "delete",
+                                     "scan" };
+      static const Latency latencies[] = { LATENCY_INSERT, LATENCY_READ,
+                                           LATENCY_UPDATE, LATENCY_DELETE,
+                                           LATENCY_SCAN };
+      printf ("%-8s %10s %10s %10s %10s %10s\n", "ns", "count", "p50", "p90",
+              "p99", "max");
+      for (unsigned i = 0; i < 5; ++i) {
+         const Histogram &h = metrics.latencies[latencies[i]];
+         if (h.count == 0) continue;
+         printf ("%-8s %10llu %10llu %10llu %10llu %10llu\n", names[i],
+                 (unsigned long long) h.count,
+                 (unsigned long long) h.quantile (0.5),
+                 (unsigned long long) h.quantile (0.9),
+                 (unsigned long long) h.quantile (0.99),
+                 (unsigned long long) h.max);
+      }
+      if (json) printf ("%s\n", metrics.json().c_str());
+   }
+   rbfm->closeFile (fileHandle);
+   rbfm->destroyFile (argv[2]);
+   return rc == rc::success ? 0 : 1;
+}
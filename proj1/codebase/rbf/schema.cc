@@ -0,0 +1,80 @@
+#include <functional>
+#include <mutex>
+
+#include "schema.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+static size_t descriptorHash(const vector<Attribute> &recordDescriptor) {
+   size_t h = recordDescriptor.size();
+   hash<string> hashName;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      const Attribute &attr = recordDescriptor[i];
+      size_t k = hashName (attr.name) ^ (attr.length * 31 + attr.type);
+      h ^= k + 0x9e3779b9 + (h << 6) + (h >> 2);
+   }
+   return h;
+}
+
+static bool sameDescriptor(const vector<Attribute> &a,
+                           const vector<Attribute> &b) {
+   if (a.size() != b.size()) return false;
+   for (unsigned i = 0; i < a.size(); ++i) {
+      if (a[i].type != b[i].type || a[i].length != b[i].length
+          || a[i].name != b[i].name) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+const Schema& schemaOf(const vector<Attribute> &recordDescriptor) {
+   // nodes do not move when the table grows
+   static unordered_multimap<size_t, Schema> registry;
+   static mutex registryLatch;
+   lock_guard<mutex> latch (registryLatch);
+   size_t h = descriptorHash (recordDescriptor);
+   auto range = registry.equal_range (h);
+   for (auto i = range.first; i != range.second; ++i) {
+      if (sameDescriptor (i->second.descriptor, recordDescriptor)) {
+         return i->second;
+      }
+   }
+
+   Schema *schema = &registry.insert (make_pair (h, Schema()))->second;
+   schema->descriptor = recordDescriptor;
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      unsigned max = sizeof(uint32_t);
+      if (recordDescriptor[i].type == TypeVarChar) {
+         max += recordDescriptor[i].length;
+      }
+      schema->valueMax.push_back (max);
+      // the first of equal names wins, as in a linear search
+      schema->positions.insert (make_pair (recordDescriptor[i].name, i));
+   }
+   return *schema;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+int Schema::find(const string &name) const {
+   if (descriptor.size() <= SCHEMA_LINEAR_MAX) {
+      for (unsigned i = 0; i < descriptor.size(); ++i) {
+         if (descriptor[i].name == name) return i;
+      }
+      return -1;
+   }
+   auto i = positions.find (name);
+   return i == positions.end() ? -1 : (int) i->second;
+}
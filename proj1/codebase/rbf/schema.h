@@ -0,0 +1,35 @@
+#ifndef _schema_h_
+#define _schema_h_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../rbf/rbfm.h"
+
+// Registry of the record descriptors seen by the record functions.
+// Descriptors are interned by their content (names, types and lengths):
+// equal descriptors share one Schema, built the first time one is seen.
+// schemaOf() hashes and compares the whole descriptor under a latch, so
+// scans and operators resolve their Schema once when they are opened and
+// keep it; record calls given a Schema (readAttributes()) skip it.
+// Schemas live as long as the program, the registry can be used by
+// concurrent threads.
+
+// Up to this many attributes, find() compares the names one by one:
+// cheaper than hashing the name (see schemabench)
+const unsigned SCHEMA_LINEAR_MAX = 16;
+
+struct Schema {
+    vector<Attribute> descriptor;
+    unordered_map<string, unsigned> positions;
+    vector<unsigned> valueMax;  // largest API format value of each
+                                // attribute
+
+    // RETURNS: position of the attribute, -1 if there is none
+    int find(const string &name) const;
+};
+
+const Schema& schemaOf(const vector<Attribute> &recordDescriptor);
+
+#endif
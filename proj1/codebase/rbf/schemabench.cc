@@ -0,0 +1,101 @@
+// schemabench.cc -- cost of resolving attribute names
+//
+// usage: schemabench [lookups=N]
+//
+//   lookups=N             name lookups timed per way and descriptor
+//                         (2000000)
+//
+// Looks up every attribute name of a descriptor in turn, three ways:
+//   linear   compares the name against each attribute, as the record
+//            functions did before the schema registry (the baseline)
+//   schemaOf resolves the Schema of the descriptor, then finds the name:
+//            what a record call costs when it is given a descriptor
+//   held     finds the name in a Schema resolved once, as scans,
+//            operators and the record calls given a Schema do
+// for the employee descriptor (4 attributes), the large one of
+// test_util.h (30) and one of 64 attributes, and prints the nanoseconds
+// per lookup. SCHEMA_LINEAR_MAX (schema.h) is where held stops comparing
+// names and hashes them.
+
+#include <chrono>
+#include <map>
+
+#include "rbfm.h"
+#include "schema.h"
+#include "test_util.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// the name lookup of the record functions before the schema registry
+static int linearFind(const vector<Attribute> &recordDescriptor,
+                      const string &attributeName) {
+   for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      if (recordDescriptor[i].name == attributeName) return i;
+   }
+   return -1;
+}
+
+// RETURNS: nanoseconds per lookup
+template <class Find>
+static double timeLookups(const vector<Attribute> &recordDescriptor,
+                          unsigned lookups, const Find &find) {
+   // the sum keeps the lookups from being optimized away
+   volatile int sum = 0;
+   Clock::time_point start = Clock::now();
+   for (unsigned i = 0; i < lookups; ++i) {
+      sum += find (recordDescriptor[i % recordDescriptor.size()].name);
+   }
+   chrono::duration<double, nano> elapsed = Clock::now() - start;
+   return elapsed.count() / lookups;
+}
+
+int main(int argc, char **argv) {
+   unsigned lookups = 2000000;
+   for (int i = 1; i < argc; ++i) {
+      if (sscanf (argv[i], "lookups=%u", &lookups) != 1 || lookups == 0) {
+         fprintf (stderr, "usage: %s [lookups=N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   map<unsigned, vector<Attribute> > descriptors;
+   vector<Attribute> employee;
+   createRecordDescriptor (employee);
+   descriptors[employee.size()] = employee;
+   vector<Attribute> large;
+   createLargeRecordDescriptor (large);
+   descriptors[large.size()] = large;
+   vector<Attribute> wide;
+   for (unsigned i = 0; i < 64; ++i) {
+      Attribute attr;
+      attr.name = "Attr" + to_string (i);
+      attr.type = TypeInt;
+      attr.length = sizeof(int);
+      wide.push_back (attr);
+   }
+   descriptors[wide.size()] = wide;
+
+   printf("%10s %10s %10s %10s  (ns per lookup)\n", "attributes",
+          "linear", "schemaOf", "held");
+   for (auto d = descriptors.begin(); d != descriptors.end(); ++d) {
+      const vector<Attribute> &recordDescriptor = d->second;
+      const Schema &schema = schemaOf (recordDescriptor);
+      double linear = timeLookups (recordDescriptor, lookups,
+                                   [&](const string &name) {
+         return linearFind (recordDescriptor, name);
+      });
+      double resolved = timeLookups (recordDescriptor, lookups,
+                                     [&](const string &name) {
+         return schemaOf (recordDescriptor).find (name);
+      });
+      double held = timeLookups (recordDescriptor, lookups,
+                                 [&](const string &name) {
+         return schema.find (name);
+      });
+      printf("%10u %10.1f %10.1f %10.1f\n", d->first, linear, resolved,
+             held);
+   }
+   return 0;
+}
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+struct Trace {
+    FILE *file;
+    chrono::steady_clock::time_point origin;
+};
+
+// the traces of the traced files
+static unordered_map<FileHandle*, Trace>& traces() {
+   static unordered_map<FileHandle*, Trace> registry;
+   return registry;
+}
+
+// guards the registry, a trace is written under the latch of its file
+static mutex tracesLatch;
+
+// lets the calls on files that are not traced skip the registry
+static atomic<unsigned> traceCount (0);
+
+static Trace* traceOf(FileHandle &fileHandle) {
+   if (traceCount == 0) return NULL;
+   lock_guard<mutex> latch (tracesLatch);
+   auto i = traces().find (&fileHandle);
+   return i == traces().end() ? NULL : &i->second;
+}
+
+static uint64_t traceKey(const TraceEvent &event) {
+   return (uint64_t) event.pageNum << 32 | event.slotNum;
+}
+
+// the fields of a replayed record before its payload
+const unsigned REPLAY_MIN = 1 + sizeof(int) + sizeof(uint32_t);
+const unsigned REPLAY_PAYLOAD_MAX = 65535;
+
+// POST: record is a replayed record of size bytes, as far as it can
+static void replayRecord(int key, unsigned size, string &record) {
+   uint32_t len = size > REPLAY_MIN ? size - REPLAY_MIN : 0;
+   len = std::min (len, REPLAY_PAYLOAD_MAX);
+   record.assign (1, '\0');
+   record.append ((const char*) &key, sizeof(key));
+   record.append ((const char*) &len, sizeof(len));
+   record.append (len, 'r');
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+RC startTrace(FileHandle &fileHandle, const string &traceName) {
+   lock_guard<HandleLatch> fileLatch (fileHandle.latch());
+   lock_guard<mutex> latch (tracesLatch);
+   if (traces().count (&fileHandle)) {
+      RC_MSG (rc::file_handle_in_use, "[trace: %s]\n", traceName.c_str());
+      return rc::file_handle_in_use;
+   }
+   FILE *file = fopen (traceName.c_str(), "wb");
+   if (file == NULL) {
+      RC_MSG (rc::file_create_error, "[trace: %s]\n", traceName.c_str());
+      return rc::file_create_error;
+   }
+   TraceHeader header;
+   header.magic = TRACE_MAGIC;
+   header.eventSize = sizeof(TraceEvent);
+   if (fwrite (&header, sizeof(header), 1, file) != 1) {
+      fclose (file);
+      RC_MSG (rc::file_write_error, "[trace: %s]\n", traceName.c_str());
+      return rc::file_write_error;
+   }
+   Trace &trace = traces()[&fileHandle];
+   trace.file = file;
+   trace.origin = chrono::steady_clock::now();
+   ++traceCount;
+   return rc::success;
+}
+
+RC stopTrace(FileHandle &fileHandle) {
+   lock_guard<HandleLatch> fileLatch (fileHandle.latch());
+   lock_guard<mutex> latch (tracesLatch);
+   auto i = traces().find (&fileHandle);
+   if (i == traces().end()) {
+      RC_MSG (rc::file_handle_empty, "[no trace]\n");
+      return rc::file_handle_empty;
+   }
+   int closed = fclose (i->second.file);
+   traces().erase (i);
+   --traceCount;
+   if (closed != 0) {
+      RC_MSG (rc::file_close_error, "[trace]\n");
+      return rc::file_close_error;
+   }
+   return rc::success;
+}
+
+void dropTrace(FileHandle &fileHandle) {
+   if (traceOf (fileHandle) != NULL) stopTrace (fileHandle);
+}
+
+bool traced(FileHandle &fileHandle) {
+   return traceOf (fileHandle) != NULL;
+}
+
+RC readTrace(const string &traceName, vector<TraceEvent> &events) {
+   events.clear();
+   FILE *file = fopen (traceName.c_str(), "rb");
+   if (file == NULL) {
+      RC_MSG (rc::file_open_error, "[trace: %s]\n", traceName.c_str());
+      return rc::file_open_error;
+   }
+   TraceHeader header;
+   if (fread (&header, sizeof(header), 1, file) != 1
+       || header.magic != TRACE_MAGIC
+       || header.eventSize != sizeof(TraceEvent)) {
+      fclose (file);
+      RC_MSG (rc::not_a_trace_file, "[trace: %s]\n", traceName.c_str());
+      return rc::not_a_trace_file;
+   }
+   // a process that died while tracing may leave half an event
+   TraceEvent event;
+   while (fread (&event, sizeof(event), 1, file) == 1) {
+      events.push_back (event);
+   }
+   fclose (file);
+   return rc::success;
+}
+
+RC replayTrace(FileHandle &fileHandle, const vector<TraceEvent> &events,
+               bool paced, ReplayResult &result) {
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   vector<Attribute> recordDescriptor (2);
+   recordDescriptor[0].name = "Key";
+   recordDescriptor[0].type = TypeInt;
+   recordDescriptor[0].length = sizeof(int);
+   recordDescriptor[1].name = "Payload";
+   recordDescriptor[1].type = TypeVarChar;
+   recordDescriptor[1].length = REPLAY_PAYLOAD_MAX;
+   vector<string> attributeNames;
+   attributeNames.push_back ("Key");
+   attributeNames.push_back ("Payload");
+   memset (&result, 0, sizeof(result));
+
+   // load the records used before the trace inserts them
+   unordered_map<uint64_t, RID> rids;     // traced RID to replayed RID
+   unordered_set<uint64_t> inserted;
+   string record;
+   for (unsigned i = 0; i < events.size(); ++i) {
+      const TraceEvent &event = events[i];
+      uint64_t key = traceKey (event);
+      if (event.op == TRACE_INSERT) inserted.insert (key);
+      if (event.op != TRACE_READ && event.op != TRACE_UPDATE
+          && event.op != TRACE_DELETE) {
+         continue;
+      }
+      if (!inserted.insert (key).second) continue;
+      replayRecord (i, event.size, record);
+      RC rcode = rbfm->insertRecord (fileHandle, recordDescriptor,
+                                     record.data(), rids[key]);
+      if (rcode != rc::success) return rcode;
+      ++result.preloaded;
+   }
+   fileHandle.metrics().reset();
+
+   vector<char> data (REPLAY_MIN + REPLAY_PAYLOAD_MAX);
+   RBFM_ScanIterator scan;
+   bool scanning = false;
+   chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+   for (unsigned i = 0; i < events.size(); ++i) {
+      const TraceEvent &event = events[i];
+      if (paced) {
+         this_thread::sleep_until (begin + chrono::nanoseconds (
+                                              event.start - events[0].start));
+      }
+      uint64_t key = traceKey (event);
+      auto found = rids.find (key);
+      RID rid;
+      RC rcode = rc::success;
+      switch (event.op) {
+         case TRACE_INSERT:
+            replayRecord (i, event.size, record);
+            rcode = rbfm->insertRecord (fileHandle, recordDescriptor,
+                                        record.data(), rid);
+            if (rcode == rc::success) rids[key] = rid;
+            break;
+         case TRACE_READ:
+         case TRACE_UPDATE:
+         case TRACE_DELETE:
+            // a record whose insert failed
+            if (found == rids.end()) {
+               rcode = rc::invalid_rid;
+            } else if (event.op == TRACE_READ) {
+               rcode = rbfm->readRecord (fileHandle, recordDescriptor,
+                                         found->second, data.data());
+            } else if (event.op == TRACE_UPDATE) {
+               replayRecord (i, event.size, record);
+               rcode = rbfm->updateRecord (fileHandle, recordDescriptor,
+                                           record.data(), found->second);
+            } else {
+               rcode = rbfm->deleteRecord (fileHandle, recordDescriptor,
+                                           found->second);
+            }
+            break;
+         case TRACE_SCAN_OPEN:
+         case TRACE_SCAN_NEXT:
+            if (event.op == TRACE_SCAN_OPEN || !scanning) {
+               rcode = rbfm->scan (fileHandle, recordDescriptor, "", NO_OP,
+                                   NULL, attributeNames, scan);
+               scanning = rcode == rc::success;
+            }
+            if (event.op == TRACE_SCAN_NEXT && scanning) {
+               rcode = scan.getNextRecord (rid, data.data());
+               if (rcode == RBFM_EOF) {
+                  rcode = rc::success;
+                  scanning = false;
+               }
+            }
+            break;
+         default:
+            rcode = rc::not_a_trace_file;
+      }
+      result.errors += rcode != rc::success;
+      ++result.events;
+   }
+   scan.close();
+   result.seconds = chrono::duration<double> (chrono::steady_clock::now()
+                                              - begin).count();
+   return rc::success;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+TraceCall::TraceCall(FileHandle &fileHandle, TraceOp op, const RID &rid) :
+   _trace (traceOf (fileHandle)), _op (op), _rid (rid), _size (0)
+{
+   if (_trace != NULL) _start = chrono::steady_clock::now();
+}
+
+TraceCall::~TraceCall()
+{
+   if (_trace == NULL) return;
+   chrono::steady_clock::time_point end = chrono::steady_clock::now();
+   TraceEvent event;
+   memset (&event, 0, sizeof(event));
+   event.start = chrono::duration_cast<chrono::nanoseconds> (
+                    _start - _trace->origin).count();
+   event.latency = std::min<uint64_t> (
+                      chrono::duration_cast<chrono::nanoseconds> (
+                         end - _start).count(), UINT32_MAX);
+   event.size = _size;
+   event.pageNum = _rid.pageNum;
+   event.slotNum = _rid.slotNum;
+   event.op = _op;
+   fwrite (&event, sizeof(event), 1, _trace->file);
+}
@@ -0,0 +1,103 @@
+#ifndef _trace_h_
+#define _trace_h_
+
+#include <chrono>
+#include <vector>
+
+#include "../rbf/rbfm.h"
+
+// Traces of the record calls made on a file, to replay the access
+// pattern of a live process against another build or page format.
+//
+// startTrace() writes an event for each insertRecord(), appendRecord(),
+// readRecord(), updateRecord(), deleteRecord(), scan() and scan
+// getNextRecord() on the handle to a trace file, until stopTrace() or
+// closeFile(). An event holds the call, its RID, the size of its record
+// and when it started and how long it took; not the record itself.
+//
+// replayTrace() runs the events of a trace, in order, on an empty file:
+// the records read, updated or deleted before the trace inserted them
+// are loaded first, then the calls are made at full speed or at the
+// pace of the trace, and their latencies are left in the metrics of the
+// file (metrics.h). The records replayed are a key and a VarChar
+// payload of the traced size; a scan reads every record. The page calls
+// are not traced: they follow from the record calls and the build.
+//
+// The file format:
+//   TraceHeader, then one TraceEvent per call as it ended
+
+typedef enum {
+  TRACE_INSERT = 0,        // insertRecord() and appendRecord()
+  TRACE_READ,
+  TRACE_UPDATE,
+  TRACE_DELETE,
+  TRACE_SCAN_OPEN,         // scan()
+  TRACE_SCAN_NEXT,         // getNextRecord() of a scan
+  TRACE_OPS                // This must be the last op
+} TraceOp;
+
+const uint32_t TRACE_MAGIC = 0x54524331;     // "TRC1"
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t eventSize;    // sizeof(TraceEvent)
+};
+
+struct TraceEvent {
+    uint64_t start;        // ns from the start of the trace
+    uint32_t latency;      // ns, UINT32_MAX if longer
+    uint32_t size;         // of the record in the API format, if any
+    uint32_t pageNum;      // RID
+    uint32_t slotNum;
+    uint8_t  op;           // TraceOp
+    uint8_t  pad[7];
+};
+
+RC startTrace(FileHandle &fileHandle, const string &traceName);
+RC stopTrace(FileHandle &fileHandle);
+// Stops the trace of the file, if any, at closeFile()
+void dropTrace(FileHandle &fileHandle);
+// RETURNS: true if the calls on the file are traced
+bool traced(FileHandle &fileHandle);
+
+RC readTrace(const string &traceName, vector<TraceEvent> &events);
+
+struct ReplayResult {
+    unsigned events;       // replayed
+    unsigned preloaded;    // records loaded before
+    unsigned errors;       // calls that failed
+    double seconds;        // of the replay
+};
+
+// PRE: fileHandle is an open record file with no record
+RC replayTrace(FileHandle &fileHandle, const vector<TraceEvent> &events,
+               bool paced, ReplayResult &result);
+
+struct Trace;
+
+// Writes the event of a record call when it goes out of scope, if the
+// file is traced
+// PRE: the latch of fileHandle is held meanwhile
+class TraceCall
+{
+public:
+  // rid is read at the end of the call
+  TraceCall(FileHandle &fileHandle, TraceOp op, const RID &rid);
+  ~TraceCall();
+
+  // RETURNS: true if the call is traced, its size is worth knowing
+  bool active() const { return _trace != NULL; }
+  void setSize(unsigned size) { _size = size; }
+
+private:
+  TraceCall(const TraceCall&) = delete;
+  TraceCall& operator=(const TraceCall&) = delete;
+
+  Trace *_trace;
+  TraceOp _op;
+  const RID &_rid;
+  unsigned _size;
+  chrono::steady_clock::time_point _start;
+};
+
+#endif
@@ -0,0 +1,409 @@
+// ycsb.cc -- YCSB style load generator over the record API
+//
+// usage: ycsb [NAME=VALUE]...
+//
+//   workload=a|b|c|d|e|f  YCSB core workload preset (a)
+//   read=P update=P insert=P scan=P rmw=P
+//                         the mix, in percents, overriding the preset
+//   dist=zipfian|uniform|latest
+//                         how keys are chosen, from the preset
+//   theta=T               skew of zipfian and latest (0.99)
+//   records=N             loaded before the run (100000)
+//   threads=N             client threads (4)
+//   warmup=S              seconds run before measuring (1)
+//   seconds=S             seconds measured (10)
+//   scanlen=N             records read by a scan (100)
+//   format=row|compressed|pax
+//                         page format of the file (row)
+//   seed=N                of the key choices (1)
+//   json=1                also print the metrics of the file as JSON
+//
+// The records are the employee records of test_util.h (prepareRecord(),
+// createRecordDescriptor()) keyed by Salary, so the results of builds
+// can be compared. A mix with scans first builds a B+-tree on Salary: a
+// scan reads scanlen records from a key on. An update rewrites Age and
+// Height, a read-modify-write (rmw) reads the record first. Throughput
+// is printed every second, then the client latency of each operation.
+// The page calls log to stderr in DEBUG builds (pfm.h): run with
+// 2>/dev/null.
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+typedef enum { OP_READ = 0, OP_UPDATE, OP_INSERT, OP_SCAN, OP_RMW, OPS } Op;
+
+static const char *opNames[OPS] = { "read", "update", "insert", "scan",
+                                    "rmw" };
+
+typedef enum { DIST_ZIPFIAN = 0, DIST_UNIFORM, DIST_LATEST } Distribution;
+
+struct Config {
+    unsigned mix[OPS];     // percents
+    Distribution dist;
+    double theta;
+    unsigned records;
+    unsigned threads;
+    double warmup;
+    double seconds;
+    unsigned scanlen;
+    unsigned options;
+    unsigned seed;
+    bool json;
+};
+
+// Zipfian ranks over n items (Gray et al., "Quickly generating
+// billion-record synthetic databases", as in YCSB)
+class Zipfian {
+public:
+  Zipfian(uint64_t n, double theta) : _n (n), _theta (theta) {
+     double zeta2 = zeta (2, theta);
+     _zetan = zeta (n, theta);
+     _alpha = 1 / (1 - theta);
+     _eta = (1 - pow (2.0 / n, 1 - theta)) / (1 - zeta2 / _zetan);
+  }
+
+  // RETURNS: a rank, 0 the most frequent
+  uint64_t next(mt19937_64 &rng) const {
+     double u = uniform_real_distribution<double> (0, 1) (rng);
+     double uz = u * _zetan;
+     if (uz < 1) return 0;
+     if (uz < 1 + pow (0.5, _theta)) return 1;
+     uint64_t rank = _n * pow (_eta * u - _eta + 1, _alpha);
+     return rank < _n ? rank : _n - 1;
+  }
+
+private:
+  static double zeta(uint64_t n, double theta) {
+     double sum = 0;
+     for (uint64_t i = 1; i <= n; ++i) sum += 1 / pow (i, theta);
+     return sum;
+  }
+
+  uint64_t _n;
+  double _theta, _zetan, _alpha, _eta;
+};
+
+// the ranks of zipfian spread over the keys, so that the hot keys are
+// not all on the first pages
+static uint64_t scramble(uint64_t rank) {
+   uint64_t hash = 0xcbf29ce484222325ULL;      // FNV-1a
+   for (int i = 0; i < 8; ++i) {
+      hash ^= (rank >> (8 * i)) & 0xff;
+      hash *= 0x100000001b3ULL;
+   }
+   return hash;
+}
+
+// The file and the RIDs of its keys, key i has Salary i
+struct Store {
+    RecordBasedFileManager *rbfm;
+    FileHandle fileHandle;
+    vector<Attribute> recordDescriptor;
+    mutex keysLatch;               // of keys, taken before the file's
+    vector<RID> keys;
+};
+
+static void makeRecord(const vector<Attribute> &recordDescriptor,
+                       uint64_t key, unsigned version, char *record,
+                       int *size) {
+   unsigned char nulls[1] = { 0 };
+   char name[32];
+   int nameLength = snprintf (name, sizeof(name), "user%llu",
+                              (unsigned long long) key);
+   prepareRecord (recordDescriptor.size(), nulls, nameLength, name,
+                  20 + (key + version) % 50, 150 + version % 50, key,
+                  record, size);
+}
+
+// Inserts the next key. The inserts of a file are made one at a time
+// anyway, so the keys are known once they are chosen.
+static RC insertKey(Store &store, char *record) {
+   lock_guard<mutex> latch (store.keysLatch);
+   int size;
+   makeRecord (store.recordDescriptor, store.keys.size(), 0, record, &size);
+   RID rid;
+   RC rc = store.rbfm->insertRecord (store.fileHandle,
+                                     store.recordDescriptor, record, rid);
+   if (rc == success) store.keys.push_back (rid);
+   return rc;
+}
+
+struct Client {
+    unsigned id;
+    const Config *config;
+    Store *store;
+    const Zipfian *zipfian;
+    atomic<uint64_t> *done;        // operations
+    atomic<unsigned> *errors;
+    atomic<bool> *measuring;       // once the warmup is over
+    atomic<bool> *stop;
+    Histogram *latencies;          // of the client, by Op
+};
+
+static uint64_t chooseKey(const Client &client, mt19937_64 &rng,
+                          uint64_t count) {
+   switch (client.config->dist) {
+      case DIST_UNIFORM:
+         return uniform_int_distribution<uint64_t> (0, count - 1) (rng);
+      case DIST_LATEST: {
+         uint64_t rank = client.zipfian->next (rng);
+         return rank < count ? count - 1 - rank : 0;
+      }
+      default:
+         return scramble (client.zipfian->next (rng)) % count;
+   }
+}
+
+static void runClient(Client client) {
+   const Config &config = *client.config;
+   Store &store = *client.store;
+   mt19937_64 rng (config.seed * 7919 + client.id);
+   char record[PAGE_SIZE], scanned[PAGE_SIZE];
+   vector<string> attributeNames;
+   for (unsigned i = 0; i < store.recordDescriptor.size(); ++i) {
+      attributeNames.push_back (store.recordDescriptor[i].name);
+   }
+   RBFM_ScanIterator scan;
+   unsigned version = 0;
+   bool measured = false;
+   while (!*client.stop) {
+      if (!measured && *client.measuring) {
+         for (unsigned op = 0; op < OPS; ++op) {
+            client.latencies[op] = Histogram();
+         }
+         measured = true;
+      }
+      unsigned pick = uniform_int_distribution<unsigned> (0, 99) (rng);
+      unsigned op = 0;
+      while (op + 1 < OPS && pick >= config.mix[op]) {
+         pick -= config.mix[op++];
+      }
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      RC rc = success;
+      if (op == OP_INSERT) {
+         rc = insertKey (store, record);
+      } else {
+         uint64_t key;
+         RID rid;
+         {
+            lock_guard<mutex> latch (store.keysLatch);
+            key = chooseKey (client, rng, store.keys.size());
+            rid = store.keys[key];
+         }
+         int size;
+         if (op == OP_READ || op == OP_RMW) {
+            rc = store.rbfm->readRecord (store.fileHandle,
+                                         store.recordDescriptor, rid, record);
+         }
+         if (rc == success && (op == OP_UPDATE || op == OP_RMW)) {
+            makeRecord (store.recordDescriptor, key, ++version, record, &size);
+            rc = store.rbfm->updateRecord (store.fileHandle,
+                                           store.recordDescriptor, record,
+                                           rid);
+         }
+         if (op == OP_SCAN) {
+            int salary = key;
+            rc = store.rbfm->scan (store.fileHandle, store.recordDescriptor,
+                                   "Salary", GE_OP, &salary, attributeNames,
+                                   scan);
+            for (unsigned i = 0; i < config.scanlen && rc == success; ++i) {
+               rc = scan.getNextRecord (rid, scanned);
+            }
+            if (rc == RBFM_EOF) rc = success;
+            scan.close();
+         }
+      }
+      client.latencies[op].add (chrono::duration_cast<chrono::nanoseconds> (
+                                   chrono::steady_clock::now() - start)
+                                   .count());
+      if (rc != success) ++*client.errors;
+      ++*client.done;
+   }
+}
+
+static bool parse(int argc, char **argv, Config &config) {
+   // YCSB core workloads: read, update, insert, scan, rmw
+   static const map<string, vector<unsigned> > presets = {
+      { "a", { 50, 50, 0, 0, 0 } }, { "b", { 95, 5, 0, 0, 0 } },
+      { "c", { 100, 0, 0, 0, 0 } }, { "d", { 95, 0, 5, 0, 0 } },
+      { "e", { 0, 0, 5, 95, 0 } }, { "f", { 50, 0, 0, 0, 50 } }
+   };
+   map<string, string> args;
+   for (int i = 1; i < argc; ++i) {
+      const char *equals = strchr (argv[i], '=');
+      if (equals == NULL) return false;
+      args[string (argv[i], equals - argv[i])] = equals + 1;
+   }
+   string workload = args.count ("workload") ? args["workload"] : "a";
+   if (!presets.count (workload)) return false;
+   for (unsigned op = 0; op < OPS; ++op) {
+      config.mix[op] = presets.at (workload)[op];
+   }
+   config.dist = workload == "d" ? DIST_LATEST : DIST_ZIPFIAN;
+   config.theta = 0.99;
+   config.records = 100000;
+   config.threads = 4;
+   config.warmup = 1;
+   config.seconds = 10;
+   config.scanlen = 100;
+   config.options = 0;
+   config.seed = 1;
+   config.json = false;
+   bool mixed = false;
+   for (auto i = args.begin(); i != args.end(); ++i) {
+      const string &name = i->first, &value = i->second;
+      const char *v = value.c_str();
+      unsigned op = find (opNames, opNames + OPS, name) - opNames;
+      if (op < OPS) {
+         if (!mixed) memset (config.mix, 0, sizeof(config.mix));
+         mixed = true;
+         config.mix[op] = atoi (v);
+      } else if (name == "dist") {
+         if (value == "zipfian") config.dist = DIST_ZIPFIAN;
+         else if (value == "uniform") config.dist = DIST_UNIFORM;
+         else if (value == "latest") config.dist = DIST_LATEST;
+         else return false;
+      } else if (name == "format") {
+         if (value == "row") config.options = 0;
+         else if (value == "compressed") config.options = RBFM_COMPRESSED;
+         else if (value == "pax") config.options = RBFM_PAX;
+         else return false;
+      } else if (name == "theta") {
+         config.theta = atof (v);
+      } else if (name == "records") {
+         config.records = atoi (v);
+      } else if (name == "threads") {
+         config.threads = atoi (v);
+      } else if (name == "warmup") {
+         config.warmup = atof (v);
+      } else if (name == "seconds") {
+         config.seconds = atof (v);
+      } else if (name == "scanlen") {
+         config.scanlen = atoi (v);
+      } else if (name == "seed") {
+         config.seed = atoi (v);
+      } else if (name == "json") {
+         config.json = atoi (v) != 0;
+      } else if (name != "workload") {
+         return false;
+      }
+   }
+   unsigned total = 0;
+   for (unsigned op = 0; op < OPS; ++op) total += config.mix[op];
+   return total == 100 && config.records > 0 && config.threads > 0
+          && config.theta > 0 && config.theta < 1;
+}
+
+int main(int argc, char **argv) {
+   Config config;
+   if (!parse (argc, argv, config)) {
+      fprintf (stderr, "usage: %s [workload=a..f] [read=P] [update=P] "
+               "[insert=P] [scan=P] [rmw=P]\n"
+               "       [dist=zipfian|uniform|latest] [theta=T] "
+               "[records=N] [threads=N]\n"
+               "       [warmup=S] [seconds=S] [scanlen=N] "
+               "[format=row|compressed|pax] [seed=N] [json=1]\n"
+               "  the mix must add up to 100\n", argv[0]);
+      return 1;
+   }
+
+   string fileName = "ycsb.db";
+   Store store;
+   store.rbfm = RecordBasedFileManager::instance();
+   createRecordDescriptor (store.recordDescriptor);
+   remove (fileName.c_str());
+   RC rc = store.rbfm->createFile (fileName, config.options);
+   if (rc == success) rc = store.rbfm->openFile (fileName, store.fileHandle);
+   if (rc != success) return 1;
+
+   // load
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   char record[PAGE_SIZE];
+   for (unsigned key = 0; key < config.records && rc == success; ++key) {
+      rc = insertKey (store, record);
+   }
+   if (rc == success && config.mix[OP_SCAN] > 0) {
+      rc = store.rbfm->createBTreeIndex (store.fileHandle,
+                                         store.recordDescriptor, "Salary");
+   }
+   if (rc != success) return 1;
+   double loaded = chrono::duration<double> (chrono::steady_clock::now()
+                                             - start).count();
+   printf ("load: %u records in %.2fs, %.0f records/s, %u pages\n",
+           config.records, loaded, config.records / loaded,
+           store.fileHandle.getNumberOfPages());
+
+   // run
+   Zipfian zipfian (config.records, config.theta);
+   atomic<uint64_t> done (0);
+   atomic<unsigned> errors (0);
+   atomic<bool> measuring (false), stop (false);
+   vector<Histogram> latencies (config.threads * OPS);
+   vector<thread> clients;
+   for (unsigned i = 0; i < config.threads; ++i) {
+      Client client = { i, &config, &store, &zipfian, &done, &errors,
+                        &measuring, &stop, &latencies[i * OPS] };
+      clients.push_back (thread (runClient, client));
+   }
+   this_thread::sleep_for (chrono::duration<double> (config.warmup));
+   measuring = true;
+   store.fileHandle.metrics().reset();
+   done = 0;
+   errors = 0;
+   start = chrono::steady_clock::now();
+   uint64_t last = 0;
+   for (unsigned second = 1; second <= ceil (config.seconds); ++second) {
+      this_thread::sleep_until (start + chrono::duration<double> (
+                                   std::min<double> (second,
+                                                     config.seconds)));
+      uint64_t now = done;
+      printf ("%4u s: %10llu ops/s\n", second,
+              (unsigned long long) (now - last));
+      fflush (stdout);
+      last = now;
+   }
+   stop = true;
+   double seconds = chrono::duration<double> (chrono::steady_clock::now()
+                                              - start).count();
+   uint64_t total = done;
+   for (unsigned i = 0; i < clients.size(); ++i) clients[i].join();
+
+   printf ("run: %llu ops in %.2fs, %.0f ops/s, %u threads, %u errors\n",
+           (unsigned long long) total, seconds, total / seconds,
+           config.threads, (unsigned) errors);
+   printf ("%-8s %10s %10s %10s %10s %10s %10s\n", "ns", "count", "p50",
+           "p90", "p99", "p999", "max");
+   for (unsigned op = 0; op < OPS; ++op) {
+      Histogram h;
+      for (unsigned i = 0; i < config.threads; ++i) {
+         h.merge (latencies[i * OPS + op]);
+      }
+      if (config.mix[op] == 0 || h.count == 0) continue;
+      printf ("%-8s %10llu %10llu %10llu %10llu %10llu %10llu\n",
+              opNames[op], (unsigned long long) h.count,
+              (unsigned long long) h.quantile (0.5),
+              (unsigned long long) h.quantile (0.9),
+              (unsigned long long) h.quantile (0.99),
+              (unsigned long long) h.quantile (0.999),
+              (unsigned long long) h.max);
+   }
+   if (config.json) {
+      MetricsSnapshot snapshot;
+      store.fileHandle.metrics().collect (snapshot);
+      printf ("%s\n", snapshot.json().c_str());
+   }
+   store.rbfm->closeFile (store.fileHandle);
+   store.rbfm->destroyFile (fileName);
+   return 0;
+}
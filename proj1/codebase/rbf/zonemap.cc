@@ -0,0 +1,144 @@
+#include <cmath>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zonemap.h"
+
+
+//
+// PRIVATE HELPER FUNCTIONS
+//
+
+// sign of (bits - value) for a TypeInt / TypeReal
+static int compareBits(AttrType type, uint32_t bits, const void *value) {
+   if (type == TypeInt) {
+      int32_t a, b;
+      memcpy (&a, &bits, sizeof(a));
+      memcpy (&b, value, sizeof(b));
+      return (a > b) - (a < b);
+   }
+   float a, b;
+   memcpy (&a, &bits, sizeof(a));
+   memcpy (&b, value, sizeof(b));
+   return (a > b) - (a < b);
+}
+
+static Zone* zoneAt(char *page, unsigned i) {
+   return (Zone*) page + i;
+}
+
+
+//
+// PUBLIC FUNCTION DEFINITIONS
+//
+
+void zoneInit(Zone &zone) {
+   memset (&zone, 0, sizeof(zone));
+   zone.state = ZONE_VALID;
+}
+
+void zoneAdd(Zone &zone, AttrType type, const char *value) {
+   if (type == TypeReal) {
+      // a NaN is neither below nor above a bound: no page with one is
+      // skipped
+      float real;
+      memcpy (&real, value, sizeof(real));
+      if (std::isnan (real)) zone.state = ZONE_UNKNOWN;
+   }
+   if (zone.count == 0 || compareBits (type, zone.min, value) > 0) {
+      memcpy (&zone.min, value, sizeof(zone.min));
+   }
+   if (zone.count == 0 || compareBits (type, zone.max, value) < 0) {
+      memcpy (&zone.max, value, sizeof(zone.max));
+   }
+   ++zone.count;
+}
+
+bool zoneExcludes(const Zone &zone, AttrType type, CompOp compOp,
+                  const void *value) {
+   if (zone.state != ZONE_VALID || compOp == NO_OP) return false;
+   if (zone.count == 0) return true;
+   int min = compareBits (type, zone.min, value);
+   int max = compareBits (type, zone.max, value);
+   switch (compOp) {
+      case EQ_OP: return min > 0 || max < 0;
+      case LT_OP: return min >= 0;
+      case LE_OP: return min > 0;
+      case GT_OP: return max <= 0;
+      case GE_OP: return max < 0;
+      case NE_OP: return min == 0 && max == 0;
+      case NO_OP: break;
+   }
+   return false;
+}
+
+RC zoneWrite(FileHandle &fileHandle, PageNum root, PageNum pageNum,
+             const Zone &zone) {
+   char *page = (char*) malloc (PAGE_SIZE);
+   PageNum current = root;
+   RC rcode = fileHandle.readPage (current, page);
+   for (unsigned k = 0; k < pageNum / ZONES_PER_PAGE
+                        && rcode == rc::success; ++k) {
+      PageNum next = pageFooter (page)->next;
+      if (next == NO_PAGE) {
+         // link a new zone map page, its zones are all unknown
+         rcode = allocPage (fileHandle, PAGE_ZONEMAP, page, next);
+         if (rcode != rc::success) break;
+         rcode = fileHandle.readPage (current, page);
+         if (rcode != rc::success) break;
+         pageFooter (page)->next = next;
+         rcode = fileHandle.writePage (current, page);
+         if (rcode != rc::success) break;
+      }
+      current = next;
+      rcode = fileHandle.readPage (current, page);
+   }
+   if (rcode == rc::success && pageFooter (page)->type != PAGE_ZONEMAP) {
+      RC_MSG (rc::bad_page_type, "[pageNum: %u]\n", current);
+      rcode = rc::bad_page_type;
+   }
+   if (rcode == rc::success) {
+      *zoneAt (page, pageNum % ZONES_PER_PAGE) = zone;
+      rcode = fileHandle.writePage (current, page);
+   }
+   free (page);
+   return rcode;
+}
+
+
+//
+// MEMBER FUNCTION DEFINITIONS
+//
+
+ZoneCursor::ZoneCursor(PageNum r) :
+   root (r), pageNum (NO_PAGE), index (0),
+   page ((char*) malloc (PAGE_SIZE))
+{
+}
+
+ZoneCursor::~ZoneCursor()
+{
+   free (page);
+}
+
+RC ZoneCursor::get(FileHandle &fileHandle, PageNum dataPage, Zone &zone) {
+   unsigned target = dataPage / ZONES_PER_PAGE;
+   memset (&zone, 0, sizeof(zone));
+   if (pageNum == NO_PAGE || target < index) {
+      RC rcode = fileHandle.readPage (root, page);
+      if (rcode != rc::success) return rcode;
+      pageNum = root;
+      index = 0;
+   }
+   while (index < target) {
+      PageNum next = pageFooter (page)->next;
+      if (next == NO_PAGE) return rc::success;
+      RC rcode = fileHandle.readPage (next, page);
+      if (rcode != rc::success) return rcode;
+      pageNum = next;
+      ++index;
+   }
+   zone = *zoneAt (page, dataPage % ZONES_PER_PAGE);
+   return rc::success;
+}
@@ -0,0 +1,66 @@
+#ifndef _zonemap_h_
+#define _zonemap_h_
+
+#include "../rbf/rbfm.h"
+#include "../rbf/page.h"
+
+// Zone maps: for one TypeInt / TypeReal attribute, a summary of the
+// values stored on every data page (min, max, null count), so that a
+// scan can skip the pages whose values cannot satisfy its condition
+// without reading them.
+//
+// The map is a chain of PAGE_ZONEMAP pages starting at the root given
+// in FileHeader::aux. Zone map page k holds the zones of the data pages
+// [k * ZONES_PER_PAGE, (k+1) * ZONES_PER_PAGE). A data page is
+// summarized again each time it is written (rbfm.cc).
+
+enum ZoneState {
+    ZONE_UNKNOWN = 0,      // not summarized, the page must be read
+    ZONE_VALID
+};
+
+struct Zone {
+    uint32_t min;          // bits of the TypeInt / TypeReal value
+    uint32_t max;
+    uint16_t count;        // non null values
+    uint16_t nulls;        // null values
+    uint8_t  state;        // ZoneState
+    uint8_t  pad[3];
+};
+
+const unsigned ZONES_PER_PAGE = (PAGE_SIZE - sizeof(PageFooter))
+                                / sizeof(Zone);
+
+// Empty valid zone, values are added to it. Adding a NaN makes the
+// zone unknown.
+void zoneInit(Zone &zone);
+void zoneAdd(Zone &zone, AttrType type, const char *value);
+
+// RETURNS: true if no value v of the zone satisfies "v compOp value",
+//          i.e. the page can be skipped (a null never matches)
+bool zoneExcludes(const Zone &zone, AttrType type, CompOp compOp,
+                  const void *value);
+
+// Stores the zone of data page pageNum, growing the chain up to it
+RC zoneWrite(FileHandle &fileHandle, PageNum root, PageNum pageNum,
+             const Zone &zone);
+
+// Reads the zones of a map, one zone map page at a time. Cheapest when
+// the data pages are asked for in increasing order.
+struct ZoneCursor {
+    PageNum root;
+    PageNum pageNum;       // zone map page in page, NO_PAGE if none
+    unsigned index;        // its position in the chain
+    char *page;
+
+    ZoneCursor(PageNum root);
+    ~ZoneCursor();
+    ZoneCursor(const ZoneCursor&) = delete;
+    ZoneCursor& operator=(const ZoneCursor&) = delete;
+
+    // POST: zone.state is ZONE_UNKNOWN if the map does not reach
+    //       dataPage
+    RC get(FileHandle &fileHandle, PageNum dataPage, Zone &zone);
+};
+
+#endif